@@ -30,6 +30,12 @@
 #define	kDefaultExecutionInterval								10
 #define	kMessageTypeValueHeartbeat								"BEAT"
 
+//---------------------------------------------------------------------
+// Module Global Variables
+//---------------------------------------------------------------------
+static	TPthreadMutexObj								gHeartbeatGenerationLock;
+static	unsigned long									gHeartbeatGeneration = 0;
+
 //*********************************************************************
 // Class THeartbeat
 //*********************************************************************
@@ -40,6 +46,9 @@
 THeartbeat::THeartbeat ()
 	:	Inherited(kUberAgentName,kDefaultExecutionInterval,true)
 {
+	TLockedPthreadMutexObj	lock(gHeartbeatGenerationLock);
+	
+	fGeneration = ++gHeartbeatGeneration;
 }
 
 //---------------------------------------------------------------------
@@ -48,6 +57,9 @@ THeartbeat::THeartbeat ()
 THeartbeat::THeartbeat (time_t intervalInSeconds)
 	:	Inherited(kUberAgentName,intervalInSeconds,true)
 {
+	TLockedPthreadMutexObj	lock(gHeartbeatGenerationLock);
+	
+	fGeneration = ++gHeartbeatGeneration;
 }
 
 //---------------------------------------------------------------------
@@ -63,6 +75,17 @@ THeartbeat::~THeartbeat ()
 void THeartbeat::RunTask ()
 {
 	// std::string	 debugString;
+	
+	{
+		TLockedPthreadMutexObj	lock(gHeartbeatGenerationLock);
+		
+		if (fGeneration != gHeartbeatGeneration)
+		{
+			// A full reconnect queued a newer heartbeat; retire this one
+			SetRerun(false);
+			return;
+		}
+	}
 
 	if (IsConnectedToServer())
 	{
@@ -77,11 +100,7 @@ void THeartbeat::RunTask ()
 		SendToServer(heartbeatMessage,reply,kCompressionModeNone);
 		// debugString = "DEBUG: BEAT: true";
 	}
-	else
-	{
-		// Cancel our rerun flag
-		SetRerun(false);
-		// debugString = "DEBUG: BEAT: false";
-	}
+	// Otherwise skip this beat but stay scheduled, so beats resume after
+	// a quick reconnect
 	// WriteToMessagesLog(debugString);
 }
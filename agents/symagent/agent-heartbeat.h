@@ -40,6 +40,10 @@ class THeartbeat;
 
 //---------------------------------------------------------------------
 // Class THeartbeat
+//
+// Creating a heartbeat supersedes any created earlier: an older one
+// stops rescheduling itself the next time it runs, so a full reconnect
+// that queues a new heartbeat never leaves two of them beating.
 //---------------------------------------------------------------------
 class THeartbeat : public TTaskBase
 {
@@ -67,6 +71,10 @@ class THeartbeat : public TTaskBase
 		
 		virtual void RunTask ();
 			// Entry point for the task.
+	
+	protected:
+		
+		unsigned long							fGeneration;
 };
 
 #endif // AGENT_HEARTBEAT
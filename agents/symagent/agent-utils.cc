@@ -81,6 +81,14 @@ double StringToNumber (const string& s)
 	return num;
 }
 
+//--------------------------------------------------------------------
+// MillisecondsString
+//--------------------------------------------------------------------
+string MillisecondsString (double seconds)
+{
+	return NumberToString(static_cast<unsigned long>(seconds * 1000.0 + 0.5)) + " ms";
+}
+
 //--------------------------------------------------------------------
 // LogSignalAndReraise
 //--------------------------------------------------------------------
@@ -67,6 +67,10 @@ double StringToNumber (const string& s);
 	// Converts the argument to a double, which can be coerced to any
 	// numeric type the caller needs.
 
+string MillisecondsString (double seconds);
+	// Returns the argument as a rounded number of milliseconds followed
+	// by " ms", for log messages.
+
 void LogSignalAndReraise (int sigNum);
 	// Default signal handler, which simply logs the signal and
 	// re-raises it.
@@ -61,6 +61,7 @@ using namespace std;
 #define	kMessageTagCommandDisablePlugins			"DISABLE_PLUGINS"
 #define	kMessageTagCommandShutdown					"SHUTDOWN"
 #define	kMessageTagCommandRestart					"RESTART"
+#define	kMessageTagCommandReloadPlugins				"RELOAD_PLUGINS"
 
 #define	kMessageTagPlugin						"PLUGIN"
 #define	kMessageAttributePluginName					"name"
@@ -68,6 +69,11 @@ using namespace std;
 #define	kMessageAttributePluginSig					"signature"
 #define	kMessageTagPluginConfig						"CONFIG"
 
+#define	kQuickReconnectMaxAttempts				5
+#define	kQuickReconnectBaseWait					1		// seconds
+#define	kQuickReconnectMaxWait					30		// seconds
+#define	kReconnectMaxWait						900		// seconds
+
 #define	kDebugModeOn							0
 #define	kDebugPluginName						"symplugin-mac-lookup"
 
@@ -171,6 +177,7 @@ int main (int argc, char** argv)
 					TPluginMgr		pluginMgrObj;
 					PluginSigMap	pluginSigMap;
 					StdStringList	validPluginList;
+					unsigned long	reconnectAttemptCount = 0;	// consecutive failed connections
 					
 					// Locate our plugins
 					pluginMgrObj.LocatePlugins(pluginSigMap);
@@ -188,7 +195,7 @@ int main (int argc, char** argv)
 					}
 					
 					// Load the valid plugins
-					pluginMgrObj.LoadPlugins(validPluginList);
+					pluginMgrObj.LoadPlugins(validPluginList,pluginSigMap);
 					
 					do
 					{
@@ -215,6 +222,7 @@ int main (int argc, char** argv)
 							if (IsConnectedToServer())
 							{
 								haveConnection = true;
+								reconnectAttemptCount = 0;
 								
 								// Initialize
 								agentInited = Initialize(pluginMgrObj);
@@ -342,7 +350,7 @@ int main (int argc, char** argv)
 						{
 							// We need to just wait for a little while first ...
 							if (onErrorWaitInSeconds > 0)
-								PauseExecution(onErrorWaitInSeconds);
+								PauseExecution(BackoffDelay(onErrorWaitInSeconds,++reconnectAttemptCount,kReconnectMaxWait));
 						}
 						
 						// Let's relaunch another instance of ourselves to make
@@ -429,15 +437,7 @@ bool Initialize (TPluginMgr& pluginMgrObj)
 		}
 	#else
 		if (nodeRef.IsValid())
-		{
-			for (unsigned long x = 0; x < nodeRef.SubnodeCount(); x++)
-			{
-				TPreferenceNode		pluginPrefNode(nodeRef.GetNthSubnode(x));
-				
-				if (EnablePlugin(pluginMgrObj,pluginPrefNode))
-					++pluginsActivated;
-			}
-		}
+			pluginsActivated = EnablePlugins(pluginMgrObj,nodeRef);
 	#endif
 		
 		initialized = true;
@@ -471,74 +471,110 @@ bool Initialize (TPluginMgr& pluginMgrObj)
 }
 
 //---------------------------------------------------------------------
-// EnablePlugin
+// _EnablePluginList (static)
 //---------------------------------------------------------------------
-bool EnablePlugin (TPluginMgr& pluginMgrObj, TPreferenceNode& pluginPrefNode, bool runIfActivated)
+static unsigned long _EnablePluginList (TPluginMgr& pluginMgrObj,
+										const vector<TPreferenceNode>& pluginPrefNodeList,
+										bool runIfActivated)
 {
-	bool		isEnabled = false;
-	string		logMessage;
+	unsigned long			enabledCount = 0;
+	PluginInitRequestList	requestList;
+	StdStringList			pluginNameList;
+	string					logMessage;
 	
-	if (pluginPrefNode.IsValid() && pluginPrefNode.GetTag() == kMessageTagPlugin)
+	for (vector<TPreferenceNode>::const_iterator x = pluginPrefNodeList.begin(); x != pluginPrefNodeList.end(); x++)
 	{
-		string			pluginName(pluginPrefNode.GetAttributeValue(kMessageAttributePluginName));
-		TPreferenceNode	pluginConfigRef = pluginPrefNode.FindNode(kMessageTagPluginConfig);
-		TPlugin*		pluginPtr = pluginMgrObj.GetPluginPtr(pluginName);
+		const TPreferenceNode&	pluginPrefNode(*x);
 		
-		if (pluginPtr)
+		if (pluginPrefNode.IsValid() && pluginPrefNode.GetTag() == kMessageTagPlugin)
 		{
-			bool	isAgentInited = false;
+			string			pluginName(pluginPrefNode.GetAttributeValue(kMessageAttributePluginName));
+			TPlugin*		pluginPtr = pluginMgrObj.GetPluginPtr(pluginName);
 			
-			try
-			{
-				isAgentInited = pluginPtr->AgentInit(pluginConfigRef);
-			}
-			catch (TSymLibErrorObj& errObj)
+			if (pluginPtr)
 			{
-				if (!errObj.IsLogged())
+				PluginInitRequestList_iter	foundIter = requestList.begin();
+				
+				while (foundIter != requestList.end() && foundIter->pluginPtr != pluginPtr)
+					++foundIter;
+				
+				if (foundIter == requestList.end())
 				{
-					logMessage = "While loading plugin '" + pluginPtr->Path() + "': ";
-					logMessage += errObj.GetDescription();
+					PluginInitRequest	request;
 					
-					WriteToErrorLog(logMessage);
-					errObj.MarkAsLogged();
+					request.pluginPtr = pluginPtr;
+					request.isInited = false;
+					request.initSeconds = 0;
+					requestList.push_back(request);
+					pluginNameList.push_back(pluginName);
+					foundIter = requestList.end() - 1;
 				}
-				isAgentInited = false;
-			}
-			catch (...)
-			{
-				// Ignore unknown errors
-				isAgentInited = false;
-			}
-			
-			if (isAgentInited)
-			{
-				pluginPtr->MarkAsActivated();
 				
-				logMessage = "";
-				logMessage += "Plugin '" + pluginPtr->Path() + "' activated as '" + pluginName + "'";
-				WriteToMessagesLog(logMessage);
-				
-				isEnabled = true;
-				
-				if (runIfActivated)
-					pluginPtr->AgentSpawn();
+				// A plugin must not be initialized twice at once; if it is
+				// listed more than once the last configuration wins
+				foundIter->configNode = pluginPrefNode.FindNode(kMessageTagPluginConfig);
 			}
 			else
 			{
 				logMessage = "";
-				logMessage += "Plugin '" + pluginPtr->Path() + "' failed initialization";
+				logMessage += "Server requested plugin '" + pluginName + "' activation but no plugin with that name was found";
 				WriteToErrorLog(logMessage);
 			}
 		}
+	}
+	
+	pluginMgrObj.InitPlugins(requestList);
+	
+	for (unsigned long x = 0; x < requestList.size(); x++)
+	{
+		TPlugin*	pluginPtr = requestList[x].pluginPtr;
+		
+		if (requestList[x].isInited)
+		{
+			pluginPtr->MarkAsActivated();
+			
+			logMessage = "";
+			logMessage += "Plugin '" + pluginPtr->Path() + "' activated as '" + pluginNameList[x] + "'";
+			logMessage += " (initialized in " + MillisecondsString(requestList[x].initSeconds) + ")";
+			WriteToMessagesLog(logMessage);
+			
+			++enabledCount;
+			
+			if (runIfActivated)
+				pluginPtr->AgentSpawn();
+		}
 		else
 		{
 			logMessage = "";
-			logMessage += "Server requested plugin '" + pluginName + "' activation but no plugin with that name was found";
+			logMessage += "Plugin '" + pluginPtr->Path() + "' failed initialization";
 			WriteToErrorLog(logMessage);
 		}
 	}
 	
-	return isEnabled;
+	return enabledCount;
+}
+
+//---------------------------------------------------------------------
+// EnablePlugin
+//---------------------------------------------------------------------
+bool EnablePlugin (TPluginMgr& pluginMgrObj, TPreferenceNode& pluginPrefNode, bool runIfActivated)
+{
+	vector<TPreferenceNode>		pluginPrefNodeList(1,pluginPrefNode);
+	
+	return (_EnablePluginList(pluginMgrObj,pluginPrefNodeList,runIfActivated) > 0);
+}
+
+//---------------------------------------------------------------------
+// EnablePlugins
+//---------------------------------------------------------------------
+unsigned long EnablePlugins (TPluginMgr& pluginMgrObj, const TMessageNode& pluginListNode, bool runIfActivated)
+{
+	vector<TPreferenceNode>		pluginPrefNodeList;
+	
+	for (unsigned long x = 0; x < pluginListNode.SubnodeCount(); x++)
+		pluginPrefNodeList.push_back(TPreferenceNode(pluginListNode.GetNthSubnode(x)));
+	
+	return _EnablePluginList(pluginMgrObj,pluginPrefNodeList,runIfActivated);
 }
 
 //---------------------------------------------------------------------
@@ -566,6 +602,71 @@ void DisablePlugin (TPluginMgr& pluginMgrObj, TPreferenceNode& pluginPrefNode)
 	}
 }
 
+//---------------------------------------------------------------------
+// ReloadPlugins
+//---------------------------------------------------------------------
+unsigned long ReloadPlugins (TPluginMgr& pluginMgrObj, const TMessageNode& pluginListNode)
+{
+	vector<TPreferenceNode>		pluginPrefNodeList;
+	string						logMessage;
+	
+	for (unsigned long x = 0; x < pluginListNode.SubnodeCount(); x++)
+	{
+		TPreferenceNode		pluginPrefNode(pluginListNode.GetNthSubnode(x));
+		
+		if (pluginPrefNode.IsValid() && pluginPrefNode.GetTag() == kMessageTagPlugin)
+		{
+			string		pluginName(pluginPrefNode.GetAttributeValue(kMessageAttributePluginName));
+			
+			if (!pluginMgrObj.GetPluginPtr(pluginName))
+			{
+				logMessage = "";
+				logMessage += "Server requested plugin '" + pluginName + "' reload but no plugin with that name was found";
+				WriteToErrorLog(logMessage);
+			}
+			else if (pluginMgrObj.ReloadPlugin(pluginName))
+			{
+				pluginPrefNodeList.push_back(pluginPrefNode);
+			}
+		}
+	}
+	
+	// Everything else is left running; only the reloaded plugins are
+	// initialized and started again
+	return _EnablePluginList(pluginMgrObj,pluginPrefNodeList,true);
+}
+
+//---------------------------------------------------------------------
+// _QuickReconnect (static)
+//---------------------------------------------------------------------
+static bool _QuickReconnect ()
+{
+	bool	reconnected = false;
+	
+	for (unsigned long attempt = 1; !reconnected && attempt <= kQuickReconnectMaxAttempts && DoMainEventLoop(); attempt++)
+	{
+		try
+		{
+			if (!ReconnectToServer())
+			{
+				// No token, or the server wants a full login
+				break;
+			}
+			
+			reconnected = true;
+		}
+		catch (...)
+		{
+			// Errors have already been logged; don't delay the fallback to
+			// a full login after the last attempt
+			if (attempt < kQuickReconnectMaxAttempts)
+				PauseExecution(BackoffDelay(kQuickReconnectBaseWait,attempt,kQuickReconnectMaxWait));
+		}
+	}
+	
+	return reconnected;
+}
+
 //---------------------------------------------------------------------
 // Run
 //---------------------------------------------------------------------
@@ -595,16 +696,18 @@ void Run (TPluginMgr& pluginMgrObj)
 				PauseExecution(.5);
 		}
 		
-		// Now keep looping while waiting for the plugins to do their thing
+		// Now keep looping while waiting for the plugins to do their thing;
+		// a dropped connection is restored without disturbing the plugins
+		// if the server allows it
 		while (DoMainEventLoop() &&
-			   IsConnectedToServer() &&
+			   (IsConnectedToServer() || _QuickReconnect()) &&
 			   (spawnedCount == 0 || pluginMgrObj.RunningCount() > 0))
 		{
 			TServerReply		serverCommand;
 			
-			PauseExecution(.5);
-			
-			if (GetServerCommand(serverCommand))
+			// Commands are handled as soon as they arrive; the timeout only
+			// bounds how long it takes to notice the loop conditions change
+			if (WaitForServerCommand(serverCommand,.5))
 				ServerCommandDispatch(serverCommand,pluginMgrObj);
 		}
 	}
@@ -693,13 +796,16 @@ void ServerCommandDispatch (TServerReply& serverCommand, TPluginMgr& pluginMgrOb
 		{
 			// We need to enable some plugins
 			WriteToMessagesLog("Enabling agents due to server command");
-			for (unsigned long x = 0; x < commandNode.SubnodeCount(); x++)
-			{
-				TPreferenceNode		pluginPrefNode(commandNode.GetNthSubnode(x));
-				
-				// Enable and execute the plugin
-				EnablePlugin(pluginMgrObj,pluginPrefNode,true);
-			}
+			EnablePlugins(pluginMgrObj,commandNode,true);
+			handled = true;
+		}
+		
+		commandNode = serverCommand.FindNode(kMessageTagCommandReloadPlugins);
+		if (commandNode.IsValid())
+		{
+			// Replace some plugins with the versions currently on disk
+			WriteToMessagesLog("Reloading agents due to server command");
+			ReloadPlugins(pluginMgrObj,commandNode);
 			handled = true;
 		}
 	}
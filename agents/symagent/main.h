@@ -48,9 +48,20 @@ bool EnablePlugin (TPluginMgr& pluginMgrObj, TPreferenceNode& pluginPrefNode, bo
 	// runIfActivated is true then the plugin is executed if it is successfully
 	// enabled.  Returns true if the plugin was actually enabled, false otherwise.
 
+unsigned long EnablePlugins (TPluginMgr& pluginMgrObj, const TMessageNode& pluginListNode, bool runIfActivated = false);
+	// Same as EnablePlugin() for every plugin described by a child of
+	// pluginListNode.  The plugins are initialized concurrently.  Returns
+	// the number of plugins enabled.
+
 void DisablePlugin (TPluginMgr& pluginMgrObj, TPreferenceNode& pluginPrefNode);
 	// Disables a plugin described by the pluginPrefNode argument.
 
+unsigned long ReloadPlugins (TPluginMgr& pluginMgrObj, const TMessageNode& pluginListNode);
+	// Stops, reloads from disk and re-enables every plugin described by a
+	// child of pluginListNode, using the configuration each child carries
+	// just as EnablePlugins() does.  Other plugins and the server
+	// connection are left alone.  Returns the number of plugins enabled.
+
 void Run (TPluginMgr& pluginMgrObj);
 	// Launches enabled plugins and enters the main event loop.
 
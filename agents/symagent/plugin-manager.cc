@@ -24,6 +24,8 @@
 //---------------------------------------------------------------------
 #include "plugin-manager.h"
 
+#include "symlib-threads.h"
+
 #include <sys/types.h>
 
 #if defined(USE_DLOPEN) && USE_DLOPEN && HAVE_DLFCN_H
@@ -64,6 +66,219 @@ using namespace std;
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+typedef	void (*ParallelJobProcPtr)(void* jobPtr, unsigned long index);
+
+struct	ParallelJob
+	{
+		ParallelJobProcPtr				procPtr;
+		void*							jobPtr;
+		unsigned long					itemCount;
+		unsigned long					nextIndex;
+		TPthreadMutexObj				mutex;
+	};
+	
+struct	HashJob
+	{
+		StdStringList					pathList;
+		StdStringList					sigList;
+	};
+	
+struct	LoadJob
+	{
+		const StdStringList*			pathListPtr;
+		const PluginSigMap*				sigMapPtr;
+		vector<TPlugin*>				pluginList;
+		vector<double>					loadSecondsList;
+	};
+
+//---------------------------------------------------------------------
+// _CurrentSeconds (static)
+//---------------------------------------------------------------------
+static double _CurrentSeconds ()
+{
+	struct timeval		timeNow;
+	
+	gettimeofday(&timeNow,NULL);
+	
+	return static_cast<double>(timeNow.tv_sec) + static_cast<double>(timeNow.tv_usec) / 1000000.0;
+}
+
+//---------------------------------------------------------------------
+// _DoParallelJob (static)
+//
+// Claims and runs items from the job until none remain.
+//---------------------------------------------------------------------
+static void _DoParallelJob (ParallelJob& job)
+{
+	while (true)
+	{
+		unsigned long	index = 0;
+		
+		{
+			TLockedPthreadMutexObj	lock(job.mutex);
+			
+			if (job.nextIndex >= job.itemCount)
+				break;
+			index = job.nextIndex++;
+		}
+		
+		try
+		{
+			job.procPtr(job.jobPtr,index);
+		}
+		catch (...)
+		{
+			// Job procedures log their own errors
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// _ParallelJobEntry (static)
+//---------------------------------------------------------------------
+static void* _ParallelJobEntry (void* arg)
+{
+	_DoParallelJob(*reinterpret_cast<ParallelJob*>(arg));
+	
+	return NULL;
+}
+
+//---------------------------------------------------------------------
+// _RunInParallel (static)
+//
+// Calls procPtr once for every index below itemCount, on up to
+// kPluginStartupMaxWorkers threads counting the caller's, and returns
+// when every call has completed.  The items must not depend on each
+// other.
+//---------------------------------------------------------------------
+static void _RunInParallel (unsigned long itemCount, ParallelJobProcPtr procPtr, void* jobPtr)
+{
+	ParallelJob				job;
+	vector<TPthreadObj*>	threadList;
+	unsigned long			workerCount = min(itemCount,static_cast<unsigned long>(kPluginStartupMaxWorkers));
+	
+	job.procPtr = procPtr;
+	job.jobPtr = jobPtr;
+	job.itemCount = itemCount;
+	job.nextIndex = 0;
+	
+	// This thread is one of the workers
+	for (unsigned long x = 1; x < workerCount; x++)
+	{
+		TPthreadObj*	threadObjPtr = new TPthreadObj(_ParallelJobEntry);
+		
+		try
+		{
+			threadObjPtr->Run(&job);
+			threadList.push_back(threadObjPtr);
+		}
+		catch (...)
+		{
+			// The remaining workers pick up its share
+			delete(threadObjPtr);
+		}
+	}
+	
+	_DoParallelJob(job);
+	
+	// Deleting a joinable thread object waits for its thread
+	for (vector<TPthreadObj*>::iterator x = threadList.begin(); x != threadList.end(); x++)
+		delete(*x);
+}
+
+//---------------------------------------------------------------------
+// _HashPlugin (static)
+//---------------------------------------------------------------------
+static void _HashPlugin (void* jobPtr, unsigned long index)
+{
+	HashJob*	hashJobPtr = reinterpret_cast<HashJob*>(jobPtr);
+	string		pluginPath(hashJobPtr->pathList[index]);
+	
+	try
+	{
+		hashJobPtr->sigList[index] = GetFileSignature(pluginPath);
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			WriteToErrorLog("While computing signature of plugin '" + pluginPath + "': " + errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+	}
+	catch (...)
+	{
+		WriteToErrorLog("Unknown error while computing signature of plugin '" + pluginPath + "'");
+	}
+}
+
+//---------------------------------------------------------------------
+// _LoadPlugin (static)
+//---------------------------------------------------------------------
+static void _LoadPlugin (void* jobPtr, unsigned long index)
+{
+	LoadJob*					loadJobPtr = reinterpret_cast<LoadJob*>(jobPtr);
+	string						pluginPath((*loadJobPtr->pathListPtr)[index]);
+	PluginSigMap_const_iter		foundSig = loadJobPtr->sigMapPtr->find(pluginPath);
+	double						startTime = _CurrentSeconds();
+	
+	try
+	{
+		loadJobPtr->pluginList[index] = new TPlugin(pluginPath,(foundSig != loadJobPtr->sigMapPtr->end() ? foundSig->second : string()));
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		string	errString;
+		
+		errString = "Error while loading plugin '" + pluginPath + "': ";
+		errString += errObj.GetDescription();
+		WriteToErrorLog(errString);
+	}
+	catch (...)
+	{
+		string	errString;
+		
+		errString = "Unknown error while loading plugin '" + pluginPath + "'";
+		WriteToErrorLog(errString);
+	}
+	
+	loadJobPtr->loadSecondsList[index] = _CurrentSeconds() - startTime;
+}
+
+//---------------------------------------------------------------------
+// _InitPlugin (static)
+//---------------------------------------------------------------------
+static void _InitPlugin (void* jobPtr, unsigned long index)
+{
+	PluginInitRequest&	request((*reinterpret_cast<PluginInitRequestList*>(jobPtr))[index]);
+	double				startTime = _CurrentSeconds();
+	
+	request.isInited = false;
+	
+	try
+	{
+		request.isInited = request.pluginPtr->AgentInit(request.configNode);
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			string	logMessage;
+			
+			logMessage = "While loading plugin '" + request.pluginPtr->Path() + "': ";
+			logMessage += errObj.GetDescription();
+			
+			WriteToErrorLog(logMessage);
+			errObj.MarkAsLogged();
+		}
+	}
+	catch (...)
+	{
+		// Ignore unknown errors
+	}
+	
+	request.initSeconds = _CurrentSeconds() - startTime;
+}
 
 //*********************************************************************
 // Class TPlugin
@@ -72,9 +287,10 @@ using namespace std;
 //---------------------------------------------------------------------
 // Constructor
 //---------------------------------------------------------------------
-TPlugin::TPlugin (const string& pluginPath)
+TPlugin::TPlugin (const string& pluginPath, const string& signature)
 	:	fHandle(NULL),
 		fPath(pluginPath),
+		fSignature(signature),
 		fAgentNameProcPtr(NULL),
 		fAgentVersionProcPtr(NULL),
 		fAgentDescriptionProcPtr(NULL),
@@ -83,6 +299,7 @@ TPlugin::TPlugin (const string& pluginPath)
 		fAgentRunProcPtr(NULL),
 		fAgentStopProcPtr(NULL),
 		fIsLoaded(false),
+		fIsInited(false),
 		fIsActivated(false)
 {
 	// Go ahead and try to load the plugin
@@ -187,6 +404,43 @@ void TPlugin::AgentStop ()
 	}
 }
 
+//---------------------------------------------------------------------
+// TPlugin::StopTasks
+//---------------------------------------------------------------------
+bool TPlugin::StopTasks ()
+{
+	if (IsRunning())
+	{
+		AgentStop();
+	}
+	else if (fAgentStopProcPtr && fIsInited)
+	{
+		// AgentRun() has returned, but tasks it queued may still be
+		// scheduled; let the plugin tell them to wind down
+		try
+		{
+			fAgentStopProcPtr();
+		}
+		catch (TSymLibErrorObj& errObj)
+		{
+			if (!errObj.IsLogged())
+			{
+				WriteToErrorLog("While stopping plugin at '" + fPath + "': " + errObj.GetDescription());
+				errObj.MarkAsLogged();
+			}
+		}
+		catch (...)
+		{
+			// Keep going so the tasks are still reclaimed
+			WriteToErrorLog("Unknown error while stopping plugin at '" + fPath + "'");
+		}
+	}
+	
+	MarkAsDeactivated();
+	
+	return DestroyOwnedTasks(this,kPluginTaskStopTimeout);
+}
+
 //---------------------------------------------------------------------
 // TPlugin::Load
 //---------------------------------------------------------------------
@@ -266,8 +520,9 @@ bool TPlugin::Load ()
 					throw TSymLibErrorObj(kErrorPluginFunctionMissing,errString);
 				}
 				
-				// Compute and save our signature
-				fSignature = GetFileSignature(fPath);
+				// Compute and save our signature, unless we were given it
+				if (fSignature.empty())
+					fSignature = GetFileSignature(fPath);
 				
 				// Mark the plugin as fully loaded
 				fIsLoaded = true;
@@ -319,13 +574,32 @@ void TPlugin::Unload ()
 		dlclose(fHandle);
 	
 	fHandle = NULL;
+	fSignature = "";
 	fAgentNameProcPtr = NULL;
 	fAgentVersionProcPtr = NULL;
 	fAgentDescriptionProcPtr = NULL;
+	fAgentEnvironmentProcPtr = NULL;
+	fAgentInitProcPtr = NULL;
+	fAgentRunProcPtr = NULL;
+	fAgentStopProcPtr = NULL;
 	fIsLoaded = false;
 	fIsInited = false;
 }
 
+//---------------------------------------------------------------------
+// TPlugin::Reload
+//---------------------------------------------------------------------
+bool TPlugin::Reload ()
+{
+	// Nothing from the old copy can still be running when it is unloaded
+	if (!StopTasks())
+		return false;
+	
+	Unload();
+	
+	return Load();
+}
+
 //*********************************************************************
 // Class TPluginMgr
 //*********************************************************************
@@ -369,61 +643,50 @@ void TPluginMgr::LocatePlugins (PluginSigMap& pluginSigMap)
 //---------------------------------------------------------------------
 // TPluginMgr::LoadPlugins
 //---------------------------------------------------------------------
-bool TPluginMgr::LoadPlugins (const StdStringList& pluginPathList)
+bool TPluginMgr::LoadPlugins (const StdStringList& pluginPathList, const PluginSigMap& pluginSigMap)
 {
 	bool					success = false;
 	TLockedPthreadMutexObj	lock(fLock);
 	
 	if (!pluginPathList.empty())
 	{
-		for (StdStringList_const_iter x = pluginPathList.begin(); x != pluginPathList.end(); x++)
+		LoadJob		loadJob;
+		double		startTime = _CurrentSeconds();
+		
+		loadJob.pathListPtr = &pluginPathList;
+		loadJob.sigMapPtr = &pluginSigMap;
+		loadJob.pluginList.resize(pluginPathList.size(),NULL);
+		loadJob.loadSecondsList.resize(pluginPathList.size(),0);
+		
+		_RunInParallel(pluginPathList.size(),_LoadPlugin,&loadJob);
+		
+		// Register the results in list order so that the first plugin
+		// found with a given name is the one kept
+		for (unsigned long x = 0; x < loadJob.pluginList.size(); x++)
 		{
-			TPlugin*	pluginObjPtr = NULL;
-			string		pluginPath(*x);
+			TPlugin*	pluginObjPtr = loadJob.pluginList[x];
   
-			try
+			if (pluginObjPtr)
 			{
-				pluginObjPtr = new TPlugin(pluginPath);
-      
-				if (pluginObjPtr)
+				if (pluginObjPtr->IsLoaded() && fPluginMap.find(pluginObjPtr->AgentName()) == fPluginMap.end())
 				{
-					if (pluginObjPtr->IsLoaded())
-					{
-						// Add the plugin to our internal map if the name doesn't already exist
-						if (fPluginMap.find(pluginObjPtr->AgentName()) == fPluginMap.end())
-							fPluginMap[pluginObjPtr->AgentName()] = pluginObjPtr;
-            else
-							delete(pluginObjPtr);
-					}
-					else
-					{
-						delete(pluginObjPtr);
-					}
+					string	logString;
+      
+					fPluginMap[pluginObjPtr->AgentName()] = pluginObjPtr;
+					
+					logString = "Plugin '" + pluginObjPtr->Path() + "' loaded as '" + pluginObjPtr->AgentName() + "'";
+					logString += " in " + MillisecondsString(loadJob.loadSecondsList[x]);
+					WriteToMessagesLog(logString);
 				}
-			}
-			catch (TSymLibErrorObj& errObj)
-			{
-				string	errString;
-				
-				errString = "Error while loading plugin '" + pluginPath + "': ";
-				errString += errObj.GetDescription();
-				WriteToErrorLog(errString);
-				
-				if (pluginObjPtr)
-					delete(pluginObjPtr);
-			}
-			catch (...)
-			{
-				string	errString;
-				
-				errString = "Unknown error while loading plugin '" + pluginPath + "'";
-				WriteToErrorLog(errString);
-				
-				if (pluginObjPtr)
+				else
+				{
 					delete(pluginObjPtr);
+				}
 			}
 		}
 		
+		WriteToMessagesLog("Plugin loading completed in " + MillisecondsString(_CurrentSeconds() - startTime));
+		
 		if (!fPluginMap.empty())
 			success = true;
 	}
@@ -431,6 +694,15 @@ bool TPluginMgr::LoadPlugins (const StdStringList& pluginPathList)
 	return success;
 }
 
+//---------------------------------------------------------------------
+// TPluginMgr::InitPlugins
+//---------------------------------------------------------------------
+void TPluginMgr::InitPlugins (PluginInitRequestList& requestList)
+{
+	if (!requestList.empty())
+		_RunInParallel(requestList.size(),_InitPlugin,&requestList);
+}
+
 //---------------------------------------------------------------------
 // TPluginMgr::PluginNameList
 //---------------------------------------------------------------------
@@ -459,6 +731,92 @@ TPlugin* TPluginMgr::GetPluginPtr (const string& pluginName)
 	return pluginObjPtr;
 }
 
+//---------------------------------------------------------------------
+// TPluginMgr::ReloadPlugin
+//---------------------------------------------------------------------
+bool TPluginMgr::ReloadPlugin (const string& pluginName)
+{
+	bool					success = false;
+	TLockedPthreadMutexObj	lock(fLock);
+	PluginMap_iter			foundIter = fPluginMap.find(pluginName);
+	
+	if (foundIter != fPluginMap.end())
+	{
+		TPlugin*	pluginObjPtr = foundIter->second;
+		double		startTime = _CurrentSeconds();
+		string		logString;
+		
+		if (pluginObjPtr->Reload())
+		{
+			string	newName(pluginObjPtr->AgentName());
+			
+			if (newName != pluginName)
+			{
+				// The new version calls itself something else; it can only
+				// replace us if the name is not already taken
+				fPluginMap.erase(foundIter);
+				
+				if (fPluginMap.find(newName) == fPluginMap.end())
+				{
+					fPluginMap[newName] = pluginObjPtr;
+				}
+				else
+				{
+					logString = "Reloaded plugin '" + pluginObjPtr->Path() + "' is now named '" + newName + "', which is already in use";
+					WriteToErrorLog(logString);
+					delete(pluginObjPtr);
+					pluginObjPtr = NULL;
+				}
+			}
+			
+			if (pluginObjPtr)
+			{
+				TLoginDataNode	loginEnvNode;
+				
+				// A freshly-loaded plugin sets up its environment here
+				try
+				{
+					pluginObjPtr->AgentEnvironment(loginEnvNode);
+					success = true;
+				}
+				catch (TSymLibErrorObj& errObj)
+				{
+					if (!errObj.IsLogged())
+					{
+						WriteToErrorLog("While reloading plugin '" + pluginObjPtr->Path() + "': " + errObj.GetDescription());
+						errObj.MarkAsLogged();
+					}
+				}
+				catch (...)
+				{
+					WriteToErrorLog("Unknown error while reloading plugin '" + pluginObjPtr->Path() + "'");
+				}
+				
+				if (success)
+				{
+					logString = "Plugin '" + pluginObjPtr->Path() + "' reloaded as '" + newName + "'";
+					logString += " in " + MillisecondsString(_CurrentSeconds() - startTime);
+					WriteToMessagesLog(logString);
+				}
+			}
+		}
+		else if (pluginObjPtr->IsLoaded())
+		{
+			logString = "Plugin '" + pluginObjPtr->Path() + "' still has running tasks; reload refused and the current version left loaded but stopped";
+			WriteToErrorLog(logString);
+		}
+		else
+		{
+			logString = "Plugin '" + pluginObjPtr->Path() + "' could not be reloaded and has been removed";
+			WriteToErrorLog(logString);
+			fPluginMap.erase(foundIter);
+			delete(pluginObjPtr);
+		}
+	}
+	
+	return success;
+}
+
 //---------------------------------------------------------------------
 // TPluginMgr::StopAllPlugins
 //---------------------------------------------------------------------
@@ -509,6 +867,7 @@ void TPluginMgr::_GetPluginFilenames (PluginSigMap& pluginSigMap, bool throwOnEr
 	string				fullPath;
 	int					statResult;
 	string				errString;
+	HashJob				hashJob;
 	
 	pluginSigMap.clear();
 	
@@ -579,8 +938,9 @@ void TPluginMgr::_GetPluginFilenames (PluginSigMap& pluginSigMap, bool throwOnEr
 									}
 									else
 									{
-										// Remember the file path and the signature
-										pluginSigMap[fullPath] = GetFileSignature(fullPath);
+										// Remember the file path; signatures are
+										// computed once the scan is complete
+										hashJob.pathList.push_back(fullPath);
 									}
 								}
 							}
@@ -604,4 +964,14 @@ void TPluginMgr::_GetPluginFilenames (PluginSigMap& pluginSigMap, bool throwOnEr
 	if (dirPtr)
 		closedir(dirPtr);
 	dirPtr = NULL;
+	
+	// Hashing is the expensive part, so the plugins are done in parallel
+	hashJob.sigList.resize(hashJob.pathList.size());
+	_RunInParallel(hashJob.pathList.size(),_HashPlugin,&hashJob);
+	
+	for (unsigned long x = 0; x < hashJob.pathList.size(); x++)
+	{
+		if (!hashJob.sigList[x].empty())
+			pluginSigMap[hashJob.pathList[x]] = hashJob.sigList[x];
+	}
 }
@@ -30,18 +30,33 @@
 #include "agent-utils.h"
 #include "plugin-api.h"
 
+//---------------------------------------------------------------------
+// Forward Class Definitions
+//---------------------------------------------------------------------
+class TPlugin;
+class TPluginMgr;
+
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kPluginStartupMaxWorkers				4		// plugins hashed, loaded or initialized at once
+#define	kPluginTaskStopTimeout					10		// seconds a plugin's tasks get to finish before unloading
+
 typedef	map<string,string>					PluginSigMap;
 typedef	PluginSigMap::iterator				PluginSigMap_iter;
 typedef	PluginSigMap::const_iterator		PluginSigMap_const_iter;
 
-//---------------------------------------------------------------------
-// Forward Class Definitions
-//---------------------------------------------------------------------
-class TPlugin;
-class TPluginMgr;
+struct	PluginInitRequest
+	{
+		TPlugin*						pluginPtr;
+		TPreferenceNode					configNode;
+		bool							isInited;
+		double							initSeconds;
+	};
+
+typedef	vector<PluginInitRequest>			PluginInitRequestList;
+typedef	PluginInitRequestList::iterator		PluginInitRequestList_iter;
+typedef	PluginInitRequestList::const_iterator	PluginInitRequestList_const_iter;
 
 //---------------------------------------------------------------------
 // Class TPlugin
@@ -80,6 +95,10 @@ class TPlugin
 							
 							Inherited::SetTaskName(fAgentName);
 							
+							// Every task the plugin queues from here on is
+							// tracked as the plugin's own
+							Inherited::SetOwnerRef(fPluginPtr);
+							
 							logString = "Starting " + fAgentName + " task";
 							logString += " (" + NumberToString(reinterpret_cast<unsigned long>(this)) + ")";
 							WriteToMessagesLog(logString);
@@ -120,8 +139,9 @@ class TPlugin
 	
 	public:
 		
-		TPlugin (const string& pluginPath);
-			// Constructor
+		TPlugin (const string& pluginPath, const string& signature = "");
+			// Constructor.  If signature is empty then the plugin's file
+			// signature is computed while loading it.
 	
 	private:
 		
@@ -149,6 +169,12 @@ class TPlugin
 		virtual void AgentStop ();
 			// Calls the agent's AgentStop() API function.
 		
+		virtual bool StopTasks ();
+			// Stops the plugin, deletes every task it queued and waits up
+			// to kPluginTaskStopTimeout seconds for its running tasks to
+			// finish.  Returns false if any are still alive, in which case
+			// the module must not be unloaded.
+		
 		virtual bool Load ();
 			// Attempts to load plugin cited by fPath.  Initializes
 			// all internal slots, resolve symbols, etc..  Returns
@@ -158,6 +184,14 @@ class TPlugin
 			// Unloads the currently-loaded plugin and reinitializes the
 			// internal slots to neutral values.
 		
+		virtual bool Reload ();
+			// Stops the plugin's tasks, unloads it and loads the file at
+			// Path() again, picking up any new version of the plugin.  The
+			// plugin is left deactivated; AgentEnvironment() and AgentInit()
+			// must be called again before it is run.  Returns true if the
+			// plugin was loaded.  If StopTasks() fails the current copy is
+			// left loaded (IsLoaded() stays true) and false is returned.
+		
 		//-----------------------------
 		// Accessors
 		//-----------------------------
@@ -290,9 +324,19 @@ class TPluginMgr
 			// and permissions.  Destructively modifies the argument to contain a
 			// map between found and valid plugins and their file signature.
 		
-		virtual bool LoadPlugins (const StdStringList& pluginPathList);
+		virtual bool LoadPlugins (const StdStringList& pluginPathList,
+								  const PluginSigMap& pluginSigMap = PluginSigMap());
 			// Loads the plugins cited in the argument, which should be a list of
-			// full paths.  Returns true if any plugins were loaded.
+			// full paths.  Signatures found in pluginSigMap, as returned by
+			// LocatePlugins(), are used rather than computed again.  Up to
+			// kPluginStartupMaxWorkers plugins are loaded at once; the load
+			// time of each is logged.  Returns true if any plugins were loaded.
+		
+		virtual void InitPlugins (PluginInitRequestList& requestList);
+			// Calls AgentInit() for each plugin in the list, up to
+			// kPluginStartupMaxWorkers at once, with the request's config node.
+			// Returns when all calls have completed, with isInited and
+			// initSeconds filled in for each request.
 		
 		virtual void PluginNameList (StdStringList& nameList);
 			// Destructively modifies the argument to contain a list of the loaded
@@ -303,6 +347,14 @@ class TPluginMgr
 			// Method returns a pointer to the plugin object associated with the
 			// name cited by the argument or NULL if a matching plugin can't be found.
 		
+		virtual bool ReloadPlugin (const string& pluginName);
+			// Stops, unloads and reloads the named plugin in place, then calls
+			// its AgentEnvironment() function.  Other plugins are not touched.
+			// The plugin must be initialized with AgentInit() before it is
+			// run again.  Returns false if the plugin could not be reloaded;
+			// a plugin whose file can no longer be loaded is removed, while
+			// one whose tasks did not stop in time stays loaded but stopped.
+		
 		virtual void StopAllPlugins ();
 			// Method finds all running plugins and calls each plugin's AgentStop()
 			// API function.
@@ -326,7 +378,8 @@ class TPluginMgr
 		static void _GetPluginFilenames (PluginSigMap& pluginSigMap, bool throwOnError = true);
 			// Destructively modifies the pluginSigMap argument to contain a list
 			// of full paths to plugins and their corresponding signatures.  If
-			// throwOnError is false then exception throwing is disabled.
+			// throwOnError is false then exception throwing is disabled.  Plugins
+			// whose signature cannot be computed are logged and left out.
 	
 	protected:
 		
@@ -0,0 +1,284 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Cached application discovery for the effector plugin
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					16 Mar 2005
+#		Last Modified:				16 Mar 2005
+#		
+#######################################################################
+*/
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "app-discovery.h"
+
+#include <sys/stat.h>
+
+//---------------------------------------------------------------------
+// Namespace stuff
+//---------------------------------------------------------------------
+using namespace std;
+
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static	TAppDiscovery									gAppDiscovery;
+
+//*********************************************************************
+// Class TAppDiscovery
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TAppDiscovery::TAppDiscovery ()
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TAppDiscovery::~TAppDiscovery ()
+{
+}
+
+//---------------------------------------------------------------------
+// TAppDiscovery::Discover
+//---------------------------------------------------------------------
+void TAppDiscovery::Discover (const string& appName,
+							  const StdStringList& searchPathList,
+							  const string& versionCmd,
+							  FoundAppList& foundAppList)
+{
+	ProbeJob				job;
+	vector<TPthreadObj*>	threadList;
+	unsigned long			workerCount = 0;
+	
+	foundAppList.clear();
+	
+	job.ownerPtr = this;
+	job.parentEnvironPtr = GetModEnviron();
+	job.versionCmd = versionCmd;
+	job.pathList.resize(searchPathList.size());
+	job.resultList.resize(searchPathList.size());
+	job.nextPending = 0;
+	
+	// Looking for the application is only a stat() per directory, so it
+	// is done here; copies we have already described are filled in from
+	// the cache and only the others are left for the probes
+	for (unsigned long x = 0; x < searchPathList.size(); x++)
+	{
+		StdStringList	searchDirList;
+		string			foundPath;
+		
+		searchDirList.push_back(searchPathList[x]);
+		foundPath = LocateFile(appName,searchDirList);
+		
+		if (!foundPath.empty() && _StatFile(foundPath,job.resultList[x]))
+		{
+			TLockedPthreadMutexObj		lock(fCacheMutex);
+			ProbeCache_const_iter		foundIter = fCache.find(foundPath);
+			const ProbeResult&			fileInfo(job.resultList[x]);
+			
+			job.pathList[x] = foundPath;
+			
+			if (foundIter != fCache.end() &&
+				foundIter->second.device == fileInfo.device &&
+				foundIter->second.inode == fileInfo.inode &&
+				foundIter->second.modTime == fileInfo.modTime &&
+				foundIter->second.size == fileInfo.size &&
+				foundIter->second.versionCmd == versionCmd)
+			{
+				job.resultList[x] = foundIter->second;
+			}
+			else
+			{
+				job.pendingList.push_back(x);
+			}
+		}
+	}
+	
+	if (!job.pendingList.empty())
+	{
+		// This thread is one of the workers
+		workerCount = min(static_cast<unsigned long>(job.pendingList.size()),static_cast<unsigned long>(kAppDiscoveryMaxWorkers));
+		for (unsigned long x = 1; x < workerCount; x++)
+		{
+			TPthreadObj*	threadObjPtr = new TPthreadObj(_WorkerEntry);
+			
+			try
+			{
+				threadObjPtr->Run(&job);
+				threadList.push_back(threadObjPtr);
+			}
+			catch (...)
+			{
+				// The remaining workers pick up its share
+				delete(threadObjPtr);
+			}
+		}
+		
+		_RunProbes(job);
+		
+		// Deleting a joinable thread object waits for its thread
+		for (vector<TPthreadObj*>::iterator x = threadList.begin(); x != threadList.end(); x++)
+			delete(*x);
+	}
+	
+	for (unsigned long x = 0; x < job.pathList.size(); x++)
+	{
+		if (!job.pathList[x].empty())
+		{
+			FoundApp	foundApp;
+			
+			foundApp.path = job.pathList[x];
+			foundApp.signature = job.resultList[x].signature;
+			foundApp.version = job.resultList[x].version;
+			foundAppList.push_back(foundApp);
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TAppDiscovery::_WorkerEntry (static protected)
+//---------------------------------------------------------------------
+void* TAppDiscovery::_WorkerEntry (void* arg)
+{
+	ProbeJob*	jobPtr = reinterpret_cast<ProbeJob*>(arg);
+	
+	try
+	{
+		// Inherit the run state of the thread that started the discovery
+		CreateModEnviron(jobPtr->parentEnvironPtr);
+		
+		jobPtr->ownerPtr->_RunProbes(*jobPtr);
+	}
+	catch (...)
+	{
+		// Errors have already been logged; the remaining probes are
+		// picked up by the other workers
+	}
+	
+	return NULL;
+}
+
+//---------------------------------------------------------------------
+// TAppDiscovery::_RunProbes (protected)
+//---------------------------------------------------------------------
+void TAppDiscovery::_RunProbes (ProbeJob& job)
+{
+	while (DoPluginEventLoop())
+	{
+		unsigned long	index = 0;
+		
+		{
+			TLockedPthreadMutexObj	lock(job.mutex);
+			
+			if (job.nextPending >= job.pendingList.size())
+				break;
+			index = job.pendingList[job.nextPending++];
+		}
+		
+		// Each entry is claimed by exactly one worker, so its result can
+		// be written without holding the job's lock
+		if (_Probe(job.pathList[index],job.versionCmd,job.resultList[index]))
+		{
+			TLockedPthreadMutexObj	lock(fCacheMutex);
+			
+			fCache[job.pathList[index]] = job.resultList[index];
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TAppDiscovery::_Probe (protected)
+//---------------------------------------------------------------------
+bool TAppDiscovery::_Probe (const string& appPath, const string& versionCmd, ProbeResult& result)
+{
+	bool			isComplete = true;
+	ProbeResult		fileInfo;
+	
+	result.versionCmd = versionCmd;
+	result.version = "";
+	result.signature = "";
+	
+	try
+	{
+		if (!versionCmd.empty())
+		{
+			result.version = ExecApplication(appPath + " " + versionCmd);
+			Trim(result.version);
+		}
+	}
+	catch (...)
+	{
+		isComplete = false;
+	}
+	
+	try
+	{
+		result.signature = GetFileSignature(appPath);
+	}
+	catch (...)
+	{
+		isComplete = false;
+	}
+	
+	// If the file was replaced while we were probing it then what we
+	// have may describe either copy; report it but don't remember it
+	if (isComplete)
+	{
+		if (!_StatFile(appPath,fileInfo) ||
+			fileInfo.device != result.device ||
+			fileInfo.inode != result.inode ||
+			fileInfo.modTime != result.modTime ||
+			fileInfo.size != result.size)
+		{
+			isComplete = false;
+		}
+	}
+	
+	return isComplete;
+}
+
+//---------------------------------------------------------------------
+// TAppDiscovery::_StatFile (static protected)
+//---------------------------------------------------------------------
+bool TAppDiscovery::_StatFile (const string& path, ProbeResult& result)
+{
+	struct stat		fileStat;
+	
+	if (stat(path.c_str(),&fileStat) != 0)
+		return false;
+	
+	result.device = fileStat.st_dev;
+	result.inode = fileStat.st_ino;
+	result.modTime = fileStat.st_mtime;
+	result.size = fileStat.st_size;
+	
+	return true;
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetAppDiscoveryPtr
+//---------------------------------------------------------------------
+TAppDiscovery* GetAppDiscoveryPtr ()
+{
+	return &gAppDiscovery;
+}
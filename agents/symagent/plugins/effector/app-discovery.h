@@ -0,0 +1,155 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Cached application discovery for the effector plugin
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					16 Mar 2005
+#		Last Modified:				16 Mar 2005
+#		
+#######################################################################
+*/
+
+#if !defined(APP_DISCOVERY)
+#define APP_DISCOVERY
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "plugin-config.h"
+
+#include "plugin-defs.h"
+#include "plugin-utils.h"
+
+#include "symlib-threads.h"
+
+#include <sys/types.h>
+
+//---------------------------------------------------------------------
+// Forward Class Declarations
+//---------------------------------------------------------------------
+class TAppDiscovery;
+
+//---------------------------------------------------------------------
+// Definitions
+//---------------------------------------------------------------------
+#define	kAppDiscoveryMaxWorkers							4		// concurrent version probes
+
+struct	FoundApp
+	{
+		string						path;
+		string						signature;
+		string						version;
+	};
+
+typedef	vector<FoundApp>								FoundAppList;
+typedef	FoundAppList::iterator							FoundAppList_iter;
+typedef	FoundAppList::const_iterator					FoundAppList_const_iter;
+
+//---------------------------------------------------------------------
+// Class TAppDiscovery
+//
+// Finds an application in a list of directories and describes each
+// copy found by its signature and the output of its version command.
+// Descriptions are cached by path and are reused for as long as the
+// file keeps the same inode and modification time, so only new or
+// changed copies are probed.  Probes run concurrently, up to
+// kAppDiscoveryMaxWorkers at a time.
+//---------------------------------------------------------------------
+class TAppDiscovery
+{
+	private:
+		
+		struct	ProbeResult
+			{
+				dev_t						device;
+				ino_t						inode;
+				time_t						modTime;
+				off_t						size;
+				string						versionCmd;
+				string						signature;
+				string						version;
+			};
+			
+		typedef	map<string,ProbeResult>					ProbeCache;
+		typedef	ProbeCache::iterator					ProbeCache_iter;
+		typedef	ProbeCache::const_iterator				ProbeCache_const_iter;
+		
+		typedef	vector<ProbeResult>						ProbeResultList;
+		
+		struct	ProbeJob
+			{
+				TAppDiscovery*				ownerPtr;
+				ModEnviron*					parentEnvironPtr;
+				string						versionCmd;
+				StdStringList				pathList;
+				ProbeResultList				resultList;
+				vector<unsigned long>		pendingList;
+				unsigned long				nextPending;
+				TPthreadMutexObj			mutex;
+			};
+			
+	public:
+		
+		TAppDiscovery ();
+			// Constructor
+			
+	private:
+		
+		TAppDiscovery (const TAppDiscovery& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		~TAppDiscovery ();
+			// Destructor
+			
+		void Discover (const string& appName,
+					   const StdStringList& searchPathList,
+					   const string& versionCmd,
+					   FoundAppList& foundAppList);
+			// Destructively modifies foundAppList to contain every copy of
+			// appName found within searchPathList, in search path order.
+			// If versionCmd is not empty it is appended to each copy's
+			// path and run to obtain its version.
+			
+	protected:
+		
+		static void* _WorkerEntry (void* arg);
+			// Worker thread entry point; arg is the ProbeJob.
+			
+		void _RunProbes (ProbeJob& job);
+			// Probes pending entries from the job until none remain.
+			
+		bool _Probe (const string& appPath, const string& versionCmd, ProbeResult& result);
+			// Computes the signature and version of the application at
+			// appPath.  Returns false if either could not be determined,
+			// in which case the result should not be cached.
+			
+		static bool _StatFile (const string& path, ProbeResult& result);
+			// Populates the file identity members of result from path.
+			// Returns false if the file cannot be examined.
+			
+	protected:
+		
+		ProbeCache										fCache;
+		TPthreadMutexObj								fCacheMutex;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+TAppDiscovery* GetAppDiscoveryPtr ();
+	// Returns a pointer to the discovery object shared by the plugin.
+
+//---------------------------------------------------------------------
+#endif // APP_DISCOVERY
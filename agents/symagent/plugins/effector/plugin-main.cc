@@ -24,6 +24,8 @@
 //---------------------------------------------------------------------
 #include "plugin-main.h"
 
+#include "app-discovery.h"
+
 #include "../../plugin-api.h"
 
 #include <iostream>
@@ -206,7 +208,23 @@ void AgentRun ()
 	
 	if (gModGlobalsPtr)
 	{
-		TLockedPthreadMutexObj	lock(gModGlobalsMutex);
+		unsigned int		state = kStateUndefined;
+		string				application;
+		StdStringList		searchPathList;
+		string				versionCmd;
+		
+		// Take a copy of the request so the lock is not held while we
+		// search the disk or run anything
+		{
+			TLockedPthreadMutexObj	lock(gModGlobalsMutex);
+			
+			state = gModGlobalsPtr->state;
+			application = gModGlobalsPtr->application;
+			searchPathList = gModGlobalsPtr->searchPathList;
+			versionCmd = gModGlobalsPtr->versionCmd;
+			
+			gModGlobalsPtr->state = kStateUndefined;
+		}
 		
 		SetRunState(true);
 		
@@ -219,53 +237,34 @@ void AgentRun ()
 			
 			if (IsConnectedToServer())
 			{
-				if (gModGlobalsPtr->state == kStateFindApp)
+				if (state == kStateFindApp)
 				{
-					topNode = messageObj.Append(kXMLTagAppSearch,kXMLAttributeAppName,gModGlobalsPtr->application);
+					FoundAppList	foundAppList;
+					
+					topNode = messageObj.Append(kXMLTagAppSearch,kXMLAttributeAppName,application);
 					
-					for (StdStringList_const_iter aPath = gModGlobalsPtr->searchPathList.begin(); aPath != gModGlobalsPtr->searchPathList.end(); aPath++)
+					GetAppDiscoveryPtr()->Discover(application,searchPathList,versionCmd,foundAppList);
+					
+					for (FoundAppList_const_iter foundApp = foundAppList.begin(); foundApp != foundAppList.end(); foundApp++)
 					{
-						StdStringList		searchDirList;
-						string				foundPath;
-						string				versionInfo;
-						string				appSig;
+						TMessageNode		foundNode;
 						
-						searchDirList.push_back(*aPath);
-						foundPath = LocateFile(gModGlobalsPtr->application,searchDirList);
-						if (!foundPath.empty())
-						{
-							TMessageNode		foundNode;
-							
-							// Found the app here
-							if (!gModGlobalsPtr->versionCmd.empty())
-							{
-								string	getVersionCmd;
-								
-								getVersionCmd = foundPath + " " + gModGlobalsPtr->versionCmd;
-								versionInfo = ExecApplication(getVersionCmd);
-								Trim(versionInfo);
-							}
-							
-							// Compute the signature
-							appSig = GetFileSignature(foundPath);
-							
-							foundNode = topNode.Append(kXMLTagFoundApp,kXMLAttributeFullPath,foundPath);
-							foundNode.AddAttribute(kXMLAttributeSignature,appSig);
-							foundNode.AddAttribute(kXMLAttributeVersion,versionInfo);
-							
-							messageMade = true;
-						}
+						foundNode = topNode.Append(kXMLTagFoundApp,kXMLAttributeFullPath,foundApp->path);
+						foundNode.AddAttribute(kXMLAttributeSignature,foundApp->signature);
+						foundNode.AddAttribute(kXMLAttributeVersion,foundApp->version);
+						
+						messageMade = true;
 					}
 				}
-				else if (gModGlobalsPtr->state == kStateRunApp)
+				else if (state == kStateRunApp)
 				{
-					string	appOutput(ExecApplication(gModGlobalsPtr->application));
+					string	appOutput(ExecApplication(application));
 					string	dataToSend;
 					
 					Trim(appOutput);
 					dataToSend = "<![CDATA[" + appOutput + "]]>";
 					
-					topNode = messageObj.Append(kXMLTagAppResults,kXMLAttributeAppName,gModGlobalsPtr->application);
+					topNode = messageObj.Append(kXMLTagAppResults,kXMLAttributeAppName,application);
 					topNode.SetData(dataToSend);
 					messageMade = true;
 				}
@@ -280,12 +279,10 @@ void AgentRun ()
 		catch (...)
 		{
 			SetRunState(false);
-			gModGlobalsPtr->state = kStateUndefined;
 			throw;
 		}
 	}
 	
-	gModGlobalsPtr->state = kStateUndefined;
 	SetRunState(false);
 }
 
@@ -362,6 +362,9 @@ bool LogWatchCallback (const string& filePath,
 				lineList.pop_back();
 			}
 			
+			// Keep the journaled resume point behind any partial line
+			SetFileWatcherUnclaimedByteCount(taskRef,gModGlobalsPtr->info[taskRef].unclaimedData.length());
+			
 			if (!lineList.empty())
 			{
 				FoundTextList		foundTextList;
@@ -59,15 +59,14 @@ TSendMsg::~TSendMsg ()
 //---------------------------------------------------------------------
 void TSendMsg::RunTask ()
 {
-	if (IsConnectedToServer() && !fFoundTextList.empty())
+	if (!fFoundTextList.empty())
 	{
 		TServerMessage		messageObj;
-		TServerReply		replyObj;
 		
 		Main(messageObj);
 		
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
+		// Send it to the server, or hold it until we're reconnected
+		SendToServerOrSpool(messageObj);
 	}
 }
 
@@ -53,8 +53,15 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <fstream>
+
 #if HAVE_SYS_FCNTL_H
 	#include <sys/fcntl.h>
 #endif
@@ -71,10 +78,6 @@
 	#include <net/if_dl.h>
 #endif
 
-#if !defined(PTHREAD_THREADS_MAX)
-	#define PTHREAD_THREADS_MAX 1024
-#endif
-
 #if !defined(ETH_P_IP)
 	#define ETH_P_IP 0x0800
 #endif
@@ -83,8 +86,7 @@
 // Definitions
 //---------------------------------------------------------------------
 
-#if USE_NETPACKET
-	struct ARPNetPacketReq
+struct ARPPacket
 	{
 		u_short		ar_hrd;							// Format of hardware address	-- ARPHRD_ETHER
 		u_short		ar_pro;							// Format of protocol address	-- ETH_P_IP
@@ -96,33 +98,23 @@
 		u_char		ar_tha[ETHER_ADDR_LEN];			// Target MAC address			-- Broadcast on send, mine on reply
 		u_char		ar_tip[4];						// Target IP address			-- Dest on send, mine on reply
 	};
-#endif
 
 #if USE_BPF
-	struct ARPBPFReq
+	struct ARPBPFFrame
 	{
 		u_char		ether_dhost[ETHER_ADDR_LEN];	// Target MAC address			-- Broadcast on send, mine on reply
 		u_char		ether_shost[ETHER_ADDR_LEN];	// Sender MAC address			-- Mine on send, dest on reply
 		u_short		ether_type;						// ARP Data						-- ETHERTYPE_ARP
-		u_short		ar_hrd;							// Format of hardware address	-- ARPHRD_ETHER
-		u_short		ar_pro;							// Format of protocol address	-- ETH_P_IP
-		u_char		ar_hln;							// Length of hardware address	-- ETHER_ADDR_LEN
-		u_char		ar_pln;							// Length of protocol address	-- 4 bytes (IPv4)
-		u_short		ar_op;							// ARP opcode (command)			-- ARPOP_REQUEST on send ARPOP_REPLY on reply
-		u_char		ar_sha[ETHER_ADDR_LEN];			// Sender MAC address			-- Mine on send, dest on reply
-		u_char		ar_sip[4];						// Sender IP address			-- Mine on send, dest on reply
-		u_char		ar_tha[ETHER_ADDR_LEN];			// Target MAC address			-- Broadcast on send, mine on reply
-		u_char		ar_tip[4];						// Target IP address			-- Dest on send, mine on reply
+		ARPPacket	arp;
 	};
 	
-	struct ARPBPFReply
-	{
-		struct bpf_hdr			bpfHeader;
-		struct ARPBPFReq		data;
-	};
+	#define	kARPBPFBufferSize			32768
 #endif
 
-#define	kARPReplyTimeout				1	// seconds
+#define	kNoResponseMACAddress			"{no_response}"
+
+#define	kNeighborTablePath				"/proc/net/arp"
+#define	kNeighborFlagComplete			0x02		// ATF_COM
 
 //*********************************************************************
 // Class TLookupMACAddrTask
@@ -133,6 +125,10 @@
 //---------------------------------------------------------------------
 TLookupMACAddrTask::TLookupMACAddrTask ()
 	:	Inherited(PROJECT_SHORT_NAME,0,false),
+		fSendRate(kDefaultARPSendRate),
+		fDeltaReports(false),
+		fHaveReported(false),
+		fPassCount(0),
 		fParentEnvironPtr(GetModEnviron())
 {
 }
@@ -149,7 +145,9 @@ TLookupMACAddrTask::~TLookupMACAddrTask ()
 //---------------------------------------------------------------------
 void TLookupMACAddrTask::SetupTask (const string& deviceName,
 									const string& scanTarget,
-									time_t scanInterval)
+									time_t scanInterval,
+									unsigned long sendRate,
+									bool deltaReports)
 {
 	if (!deviceName.empty())
 		fMyDeviceName = deviceName;
@@ -169,11 +167,18 @@ void TLookupMACAddrTask::SetupTask (const string& deviceName,
 		throw TSymLibErrorObj(kErrorInvalidScanTarget,errString);
 	}
 	
+	// Sorted so membership can be tested with a binary search
+	sort(fIPAddressList.begin(),fIPAddressList.end());
+	fIPAddressList.erase(unique(fIPAddressList.begin(),fIPAddressList.end()),fIPAddressList.end());
+	
 	if (scanInterval >= 0)
 	{
 		SetExecutionInterval(scanInterval);
 		SetRerun(scanInterval > 0);
 	}
+	
+	fSendRate = (sendRate > 0 ? sendRate : kDefaultARPSendRate);
+	fDeltaReports = deltaReports;
 }
 
 //---------------------------------------------------------------------
@@ -189,11 +194,37 @@ void TLookupMACAddrTask::RunTask ()
 	
 	if (DoPluginEventLoop())
 	{
-		Main(messageObj);
-		
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
+		try
+		{
+			Main(messageObj);
+			
+			// Send it to the server
+			if (DoPluginEventLoop())
+			{
+				fHaveReported = (SendToServer(messageObj,replyObj) == kResponseCodeOK);
+				
+				if (fHaveReported)
+				{
+					// Remember what the server now knows
+					fReportedMap.clear();
+					for (MACTable_const_iter x = fMACTable.begin(); x != fMACTable.end(); x++)
+						fReportedMap[x->first] = x->second.macAddress;
+				}
+			}
+		}
+		catch (TSymLibErrorObj& errObj)
+		{
+			// Most likely the interface cannot be used right now; try
+			// again on the next pass
+			if (!errObj.IsLogged())
+			{
+				WriteToErrorLog(errObj.GetDescription());
+				errObj.MarkAsLogged();
+			}
+		}
 	}
+	
+	++fPassCount;
 }
 
 //---------------------------------------------------------------------
@@ -201,63 +232,237 @@ void TLookupMACAddrTask::RunTask ()
 //---------------------------------------------------------------------
 void TLookupMACAddrTask::Main (TServerMessage& messageObj)
 {
-	ModEnviron*		environPtr = GetModEnviron();
+	bool	deltaOnly = false;
+	
+	_UpdateMACTable();
 	
-	if (environPtr)
+	if (DoPluginEventLoop())
 	{
-		TMessageNode	macListNode(messageObj.Append("MAC_LIST","",""));
-		unsigned long	maxThreads = 0;
-		unsigned long	addressesPerTask = 0;
-		IPAddressList	ipAddressList;
+		// In delta mode, the first report, the first one after a failed send
+		// and every kFullReportPassInterval'th one are still complete so the
+		// server can resynchronize
+		deltaOnly = (fDeltaReports && fHaveReported && (fPassCount % kFullReportPassInterval) != 0);
 		
-		maxThreads = std::min(static_cast<unsigned long>(PTHREAD_THREADS_MAX),static_cast<unsigned long>(1024))/4;
-		#if USE_BPF
-			maxThreads = std::min(maxThreads,static_cast<unsigned long>(256));
-		#else
-			#if defined(SCAN_LIMIT_190) && SCAN_LIMIT_190
-				maxThreads = 190;
-				// PXN - debug
-				//WriteToMessagesLog("configure for SCAN_LIMIT_190");
-			#endif
-		#endif
-		addressesPerTask = (fIPAddressList.size() / maxThreads) + 1;
+		_CreateXMLMessage(messageObj,deltaOnly);
+	}
+}
+
+//---------------------------------------------------------------------
+// TLookupMACAddrTask::_UpdateMACTable (protected)
+//---------------------------------------------------------------------
+void TLookupMACAddrTask::_UpdateMACTable ()
+{
+	AddressMap		harvestedMap;
+	AddressMap		probeResultMap;
+	AddressMap		observedMap;
+	IPAddressList	probeList;
+	
+	// The kernel already knows about every host we have talked to
+	// recently; those bindings are current and need no probe
+	_HarvestNeighborTable(fMyDeviceName,harvestedMap);
+	for (AddressMap_const_iter x = harvestedMap.begin(); x != harvestedMap.end(); x++)
+	{
+		if (_IsTarget(x->first))
+		{
+			MACTableEntry&	entry = fMACTable[x->first];
+			
+			entry.macAddress = x->second;
+			entry.lastSeenPass = fPassCount;
+		}
+	}
+	
+	// Probe bindings that have not been confirmed lately, plus the silent
+	// addresses every so often in case something new has appeared there;
+	// on the first pass that means everything
+	for (IPAddressList_const_iter x = fIPAddressList.begin(); x != fIPAddressList.end(); x++)
+	{
+		MACTable_const_iter		foundIter = fMACTable.find(*x);
 		
-		macListNode.AddAttribute("device",fMyDeviceName);
-		macListNode.AddAttribute("scan_target",fScanTarget);
+		if (foundIter != fMACTable.end())
+		{
+			if (fPassCount - foundIter->second.lastSeenPass >= kMACEntryStalePasses)
+				probeList.push_back(*x);
+		}
+		else if (fPassCount % kUnknownAddressProbePasses == 0)
+		{
+			probeList.push_back(*x);
+		}
+	}
+	
+	if (!probeList.empty())
+	{
+		TARPSweeper		sweeper(fMyDeviceName,fSendRate);
 		
-		for (IPAddressList_const_iter oneIP = fIPAddressList.begin(); DoPluginEventLoop() && oneIP != fIPAddressList.end(); oneIP++)
+		sweeper.Sweep(probeList,probeResultMap,&observedMap);
+	}
+	
+	if (DoPluginEventLoop())
+	{
+		for (AddressMap_const_iter x = probeResultMap.begin(); x != probeResultMap.end(); x++)
 		{
-			ipAddressList.push_back(*oneIP);
-			if (ipAddressList.size() >= addressesPerTask)
+			if (x->second != kNoResponseMACAddress)
+			{
+				MACTableEntry&	entry = fMACTable[x->first];
+				
+				entry.macAddress = x->second;
+				entry.lastSeenPass = fPassCount;
+			}
+			else
 			{
-				AddTaskToQueue(new TARPTask(fMyDeviceName,ipAddressList),true);
-				ipAddressList.clear();
+				// The binding has expired
+				fMACTable.erase(x->first);
 			}
 		}
 		
-		if (!ipAddressList.empty())
+		// Hosts that announced themselves or asked about someone else
+		// during the sweep
+		for (AddressMap_const_iter x = observedMap.begin(); x != observedMap.end(); x++)
+		{
+			if (_IsTarget(x->first))
+			{
+				MACTableEntry&	entry = fMACTable[x->first];
+				
+				entry.macAddress = x->second;
+				entry.lastSeenPass = fPassCount;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TLookupMACAddrTask::_CreateXMLMessage (protected)
+//---------------------------------------------------------------------
+void TLookupMACAddrTask::_CreateXMLMessage (TServerMessage& messageObj, bool deltaOnly)
+{
+	TMessageNode	macListNode(messageObj.Append("MAC_LIST","",""));
+	
+	macListNode.AddAttribute("device",fMyDeviceName);
+	macListNode.AddAttribute("scan_target",fScanTarget);
+	
+	if (!deltaOnly)
+	{
+		for (IPAddressList_const_iter x = fIPAddressList.begin(); x != fIPAddressList.end(); x++)
 		{
-			AddTaskToQueue(new TARPTask(fMyDeviceName,ipAddressList),true);
-			ipAddressList.clear();
+			TMessageNode			macNode(macListNode.Append("ENTRY","",""));
+			MACTable_const_iter		foundIter = fMACTable.find(*x);
+			struct in_addr			addr;
+			
+			addr.s_addr = *x;
+			macNode.AddAttribute("ip",inet_ntoa(addr));
+			if (foundIter != fMACTable.end())
+				macNode.AddAttribute("mac_id",foundIter->second.macAddress);
+			else
+				macNode.AddAttribute("mac_id",kNoResponseMACAddress);
 		}
+	}
+	else
+	{
+		unsigned long			entryCount = 0;
+		MACTable_const_iter		anEntry = fMACTable.begin();
+		AddressMap_const_iter	oldEntry = fReportedMap.begin();
 		
-		while (DoPluginEventLoop() && environPtr->addressCount < fIPAddressList.size())
-			PauseExecution(1);
+		macListNode.AddAttribute("mode","delta");
 		
-		if (DoPluginEventLoop())
+		// Both maps are sorted by address, so walk them together
+		while (anEntry != fMACTable.end() || oldEntry != fReportedMap.end())
 		{
-			TLockedPthreadMutexObj	lock(environPtr->addressMapLock);
+			struct in_addr		addr;
 			
-			for (AddressMap_const_iter x = environPtr->addressMap.begin(); x != environPtr->addressMap.end(); x++)
+			if (oldEntry == fReportedMap.end() ||
+				(anEntry != fMACTable.end() && anEntry->first < oldEntry->first))
 			{
+				// New binding
 				TMessageNode	macNode(macListNode.Append("ENTRY","",""));
-				struct in_addr	addr;
 				
-				addr.s_addr = x->first;
+				addr.s_addr = anEntry->first;
 				macNode.AddAttribute("ip",inet_ntoa(addr));
-				macNode.AddAttribute("mac_id",x->second);
+				macNode.AddAttribute("mac_id",anEntry->second.macAddress);
+				++entryCount;
+				++anEntry;
+			}
+			else if (anEntry == fMACTable.end() || oldEntry->first < anEntry->first)
+			{
+				// Binding has expired
+				addr.s_addr = oldEntry->first;
+				macListNode.Append("EXPIRED","ip",inet_ntoa(addr));
+				++oldEntry;
+			}
+			else
+			{
+				// Binding was reported before; include it only if it changed
+				if (anEntry->second.macAddress != oldEntry->second)
+				{
+					TMessageNode	macNode(macListNode.Append("ENTRY","",""));
+					
+					addr.s_addr = anEntry->first;
+					macNode.AddAttribute("ip",inet_ntoa(addr));
+					macNode.AddAttribute("mac_id",anEntry->second.macAddress);
+					++entryCount;
+				}
+				++anEntry;
+				++oldEntry;
 			}
 		}
+		
+		macListNode.AddAttribute("count",NumToString(entryCount));
+		macListNode.AddAttribute("total",NumToString(fMACTable.size()));
+	}
+}
+
+//---------------------------------------------------------------------
+// TLookupMACAddrTask::_IsTarget (protected)
+//---------------------------------------------------------------------
+bool TLookupMACAddrTask::_IsTarget (IPAddress ipAddress) const
+{
+	return binary_search(fIPAddressList.begin(),fIPAddressList.end(),ipAddress);
+}
+
+//---------------------------------------------------------------------
+// TLookupMACAddrTask::_HarvestNeighborTable (static protected)
+//---------------------------------------------------------------------
+void TLookupMACAddrTask::_HarvestNeighborTable (const string& deviceName, AddressMap& addressMap)
+{
+	std::ifstream		tableFile(kNeighborTablePath);
+	string				line;
+	
+	addressMap.clear();
+	
+	if (!tableFile)
+		return;
+	
+	// The first line holds the column titles:
+	//   IP address  HW type  Flags  HW address  Mask  Device
+	std::getline(tableFile,line);
+	
+	while (std::getline(tableFile,line))
+	{
+		std::istringstream	lineStream(line);
+		string				ipString;
+		string				hwTypeString;
+		string				flagsString;
+		string				macString;
+		string				maskString;
+		string				device;
+		struct in_addr		addr;
+		
+		if (!(lineStream >> ipString >> hwTypeString >> flagsString >> macString >> maskString >> device))
+			continue;
+		
+		// Incomplete entries are still being resolved and have no address
+		if (device != deviceName ||
+			(strtoul(flagsString.c_str(),NULL,16) & kNeighborFlagComplete) == 0 ||
+			macString.length() != 17 ||
+			macString == "00:00:00:00:00:00" ||
+			inet_aton(ipString.c_str(),&addr) == 0)
+		{
+			continue;
+		}
+		
+		// Match the case used when we resolve addresses ourselves
+		for (string::iterator x = macString.begin(); x != macString.end(); x++)
+			*x = toupper(*x);
+		
+		addressMap[addr.s_addr] = macString;
 	}
 }
 
@@ -385,7 +590,7 @@ unsigned long TLookupMACAddrTask::_ParseScanTarget ()
 				unsigned long	newIP = (baseAddress | htonl(x));
 				
 				fIPAddressList.push_back(newIP);
-
+				
 				// PXN - debug
 				//WriteToMessagesLog(NumToString(newIP));
 			}
@@ -453,493 +658,413 @@ unsigned long TLookupMACAddrTask::_GetNetworkMask (const string& deviceName) con
 	return netMask;
 }
 
-#if USE_NETPACKET
-	//*********************************************************************
-	// Class TARPTaskNetpacket
-	//*********************************************************************
-	
-	//---------------------------------------------------------------------
-	// Constructor
-	//---------------------------------------------------------------------
-	TARPTaskNetpacket::TARPTaskNetpacket (const string& deviceName, const IPAddressList& ipAddressList)
-		:	Inherited(PROJECT_SHORT_NAME,0,false),
-			fParentEnvironPtr(GetModEnviron()),
-			fIPAddressList(ipAddressList),
-			fDeviceName(deviceName)
-	{
-	}
+//*********************************************************************
+// Class TARPSweeper
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TARPSweeper::TARPSweeper (const string& deviceName, unsigned long sendRate)
+	:	fDeviceName(deviceName),
+		fSendRate(sendRate > 0 ? sendRate : kDefaultARPSendRate),
+		fSocket(-1),
+		fInterfaceIndex(0),
+		fMyIPAddress(0),
+		fObservedMapPtr(NULL)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TARPSweeper::~TARPSweeper ()
+{
+	_Close();
+}
+
+//---------------------------------------------------------------------
+// TARPSweeper::Sweep
+//---------------------------------------------------------------------
+void TARPSweeper::Sweep (const IPAddressList& ipAddressList,
+						 AddressMap& addressMap,
+						 AddressMap* observedMapPtr)
+{
+	PendingMap		pendingMap;
+	double			sendInterval = 1.0 / fSendRate;
 	
-	//---------------------------------------------------------------------
-	// Destructor
-	//---------------------------------------------------------------------
-	TARPTaskNetpacket::~TARPTaskNetpacket ()
-	{
-	}
+	addressMap.clear();
 	
-	//---------------------------------------------------------------------
-	// TARPTaskNetpacket::RunTask
-	//---------------------------------------------------------------------
-	void TARPTaskNetpacket::RunTask ()
-	{
-		// Create our thread environment
-		CreateModEnviron(fParentEnvironPtr);
-		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Starting ARP Lookup Task");
+	if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
+		WriteToMessagesLog("Starting ARP sweep of " + NumToString(ipAddressList.size()) + " addresses on " + fDeviceName);
 		
-		for (IPAddressList_const_iter x = fIPAddressList.begin(); x != fIPAddressList.end() && DoPluginEventLoop(); x++)
-			_GetRemoteMACAddress(*x);
-		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Ending ARP Lookup Task");
-	}
+	_Open();
+	fObservedMapPtr = observedMapPtr;
 	
-	//---------------------------------------------------------------------
-	// TARPTaskNetpacket::_GetRemoteMACAddress (protected)
-	//---------------------------------------------------------------------
-	void TARPTaskNetpacket::_GetRemoteMACAddress (unsigned long remoteIPAddress) const
+	try
 	{
-		if (fParentEnvironPtr && remoteIPAddress != 0)
+		for (IPAddressList_const_iter x = ipAddressList.begin(); x != ipAddressList.end(); x++)
 		{
-			string					macAddress;
-			int						sockNum = -1;
-			struct ifreq			ifr;
-			int						nicIndex;
-			struct sockaddr_in		sockInfo;
-			struct sockaddr_ll		bindInfo;
-			struct sockaddr_ll		destInfo;
-			struct sockaddr_ll		replyFrom;
-			SOCKET_SIZE_TYPE		optVal;
-			ARPNetPacketReq			arpPacket;
-			ARPNetPacketReq			arpReply;
-			string					errString;
-			time_t					expireTime;
-			
-			memset(&ifr,0,sizeof(ifr));
-			memset(&bindInfo,0,sizeof(bindInfo));
-			memset(&destInfo,0,sizeof(destInfo));
-			memset(&replyFrom,0,sizeof(replyFrom));
-			memset(&arpPacket,0,sizeof(arpPacket));
-			memset(&arpReply,0,sizeof(arpReply));
+			if (*x == 0)
+				continue;
+				
+			if (*x == fMyIPAddress)
+			{
+				// We're apparently trying to scan ourselves, which is mildly stupid,
+				// but whatever.
+				addressMap[*x] = _MACAddressAsString(reinterpret_cast<const unsigned char*>(fMyMACAddress.data()));
+			}
+			else
+			{
+				pendingMap[*x] = 0;
+			}
+		}
+		
+		for (unsigned int attempt = 0; attempt < kARPSweepMaxAttempts && !pendingMap.empty() && DoPluginEventLoop(); attempt++)
+		{
+			double		nextSendTime = _CurrentTime();
+			double		waitUntilTime = 0;
 			
-			try
+			// Ask every address that has not answered yet, collecting
+			// replies while we wait for the next send slot
+			for (IPAddressList_const_iter x = ipAddressList.begin(); x != ipAddressList.end() && DoPluginEventLoop(); x++)
 			{
-				// Create a socket
-				sockNum = socket(PF_PACKET,SOCK_DGRAM,0);
-				if (sockNum < 0)
-					throw TSymLibErrorObj(errno,"During MAC lookup: Failed to obtain a network socket");
+				PendingMap_iter		foundIter = pendingMap.find(*x);
 				
-				// Get our NIC index
-				strcpy(ifr.ifr_name,fDeviceName.c_str());
-				if (ioctl(sockNum,SIOCGIFINDEX,&ifr) < 0)
+				if (foundIter != pendingMap.end() && foundIter->second == attempt)
 				{
-					errString = "Failed to locate interface '" + fDeviceName + "' in internal index";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				nicIndex = ifr.ifr_ifindex;
-				
-				// Make sure we can use the NIC
-				if (ioctl(sockNum,SIOCGIFFLAGS,&ifr) < 0)
-				{
-					errString = "Failed to get status of interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				if (!(ifr.ifr_flags & IFF_UP))
-				{
-					errString = "During MAC lookup: Interface '" + fDeviceName + "' is not up";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				else if (ifr.ifr_flags & (IFF_NOARP|IFF_LOOPBACK))
-				{
-					errString = "Cannot use ARP on interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				
-				// Get our local address
-				if (ioctl(sockNum,SIOCGIFADDR,&ifr) < 0)
-				{
-					errString = "Failed to acquire IP address from '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				sockInfo = *(reinterpret_cast<struct sockaddr_in*>(&ifr.ifr_addr));
-				
-				// Set our bind info
-				bindInfo.sll_family = AF_PACKET;
-				bindInfo.sll_ifindex = nicIndex;
-				bindInfo.sll_protocol = htons(ETH_P_ARP);
-				
-				// Try to bind the socket to the interface
-				if (bind(sockNum,reinterpret_cast<struct sockaddr*>(&bindInfo),sizeof(bindInfo)) < 0)
-					throw TSymLibErrorObj(errno,"During MAC lookup: bind() failed");
-				
-				// Get socket options
-				optVal = sizeof(bindInfo);
-				if (getsockname(sockNum,reinterpret_cast<struct sockaddr*>(&bindInfo),&optVal) < 0)
-					throw TSymLibErrorObj(errno,"During MAC lookup: getsockname() for sll_halen failed");
-				if (bindInfo.sll_halen == 0)
-				{
-					errString = "Cannot use ARP on interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				
-				if (memcmp(&sockInfo.sin_addr.s_addr,&remoteIPAddress,sizeof(remoteIPAddress)) == 0)
-				{
-					// We're apparently trying to scan ourselves, which is mildly stupid,
-					// but whatever.
-					unsigned char*	ptr = bindInfo.sll_addr;
-					char			macBuffer[24];
-					
-					sprintf(macBuffer,"%02X:%02X:%02X:%02X:%02X:%02X",ptr[0],ptr[1],ptr[2],ptr[3],ptr[4],ptr[5]);
-					macAddress = macBuffer;
-				}
-				else
-				{
-					// Create a destination struct
-					memcpy(&destInfo,&bindInfo,sizeof(bindInfo));
-					memset(destInfo.sll_addr,0xFF,destInfo.sll_halen);
-					
-					// Construct the ARP packet
-					arpPacket.ar_hrd = htons(ARPHRD_ETHER);
-					arpPacket.ar_pro = htons(ETH_P_IP);
-					arpPacket.ar_hln = ETHER_ADDR_LEN;
-					arpPacket.ar_pln = 4;
-					arpPacket.ar_op = htons(ARPOP_REQUEST);
-					memcpy(arpPacket.ar_sha,bindInfo.sll_addr,bindInfo.sll_halen);
-					memcpy(arpPacket.ar_sip,&sockInfo.sin_addr.s_addr,arpPacket.ar_pln);
-					memcpy(arpPacket.ar_tha,destInfo.sll_addr,destInfo.sll_halen);
-					memcpy(arpPacket.ar_tip,&remoteIPAddress,arpPacket.ar_pln);
-					
-					// Send the packet away
-					if (sendto(sockNum,&arpPacket,sizeof(arpPacket),0,reinterpret_cast<struct sockaddr*>(&destInfo),sizeof(destInfo)) < 0)
-						throw TSymLibErrorObj(errno,"Failed to send ARP request packet");
+					// Any packet ends the wait early, so keep collecting
+					// until the send slot actually arrives
+					do
+					{
+						_ReceiveReplies(pendingMap,addressMap,nextSendTime - _CurrentTime());
+					}
+					while (DoPluginEventLoop() && _CurrentTime() < nextSendTime);
 					
-					// Get the reply
-					expireTime = time(NULL) + kARPReplyTimeout;
-					while (time(NULL) < expireTime)
+					// The reply may have arrived while we waited
+					foundIter = pendingMap.find(*x);
+					if (foundIter != pendingMap.end())
 					{
-						struct timeval		selectTimeout;
-						fd_set				selectSet;
-						
-						FD_ZERO(&selectSet);
-						FD_SET(sockNum,&selectSet);
-						selectTimeout.tv_sec = kARPReplyTimeout;
-						selectTimeout.tv_usec = 0;
-						
-						if (select(sockNum+1,&selectSet,NULL,NULL,&selectTimeout) > 0)
-						{
-							optVal = sizeof(replyFrom);
-							if (recvfrom(sockNum,&arpReply,sizeof(arpReply),0,reinterpret_cast<struct sockaddr*>(&replyFrom),&optVal) < 0)
-								throw TSymLibErrorObj(errno,"Failed to receive ARP request packet");
-							
-							if (replyFrom.sll_pkttype == PACKET_HOST ||
-								replyFrom.sll_pkttype == PACKET_BROADCAST ||
-								replyFrom.sll_pkttype == PACKET_MULTICAST)
-							{
-								if (arpReply.ar_op == htons(ARPOP_REQUEST) || arpReply.ar_op == htons(ARPOP_REPLY))
-								{
-									if (arpReply.ar_hrd == htons(replyFrom.sll_hatype))
-									{
-										if (arpReply.ar_pro == htons(ETH_P_IP) &&
-											arpReply.ar_pln == sizeof(remoteIPAddress) &&
-											arpReply.ar_hln == bindInfo.sll_halen)
-										{
-											if (memcmp(arpReply.ar_sip,&remoteIPAddress,sizeof(remoteIPAddress)) == 0 &&
-												memcmp(arpReply.ar_tha,bindInfo.sll_addr,arpReply.ar_hln) == 0)
-											{
-												unsigned char*	ptr = arpReply.ar_sha;
-												char			macBuffer[24];
-												
-												sprintf(macBuffer,"%02X:%02X:%02X:%02X:%02X:%02X",ptr[0],ptr[1],ptr[2],ptr[3],ptr[4],ptr[5]);
-												macAddress = macBuffer;
-												break;
-											}
-										}
-									}
-								}
-							}
-						}
+						_SendRequest(*x);
+						++foundIter->second;
+						nextSendTime += sendInterval;
 					}
 				}
-				
-				if (sockNum != -1)
-					close(sockNum);
 			}
-			catch (TSymLibErrorObj& errObj)
+			
+			// Give the stragglers time to answer, longer on each attempt
+			waitUntilTime = _CurrentTime() + (kARPReplyTimeout << attempt);
+			while (!pendingMap.empty() && DoPluginEventLoop() && _CurrentTime() < waitUntilTime)
+				_ReceiveReplies(pendingMap,addressMap,std::min(waitUntilTime - _CurrentTime(),0.5));
+		}
+	}
+	catch (...)
+	{
+		fObservedMapPtr = NULL;
+		_Close();
+		throw;
+	}
+	
+	fObservedMapPtr = NULL;
+	_Close();
+	
+	for (PendingMap_const_iter x = pendingMap.begin(); x != pendingMap.end(); x++)
+		addressMap[x->first] = kNoResponseMACAddress;
+		
+	if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
+		WriteToMessagesLog("Ending ARP sweep on " + fDeviceName + "; " + NumToString(pendingMap.size()) + " addresses did not respond");
+}
+
+//---------------------------------------------------------------------
+// TARPSweeper::_ReceiveReplies (protected)
+//---------------------------------------------------------------------
+void TARPSweeper::_ReceiveReplies (PendingMap& pendingMap, AddressMap& addressMap, double timeoutInSeconds)
+{
+	struct pollfd		pollInfo;
+	int					timeoutInMS = 0;
+	
+	// Round up so a wait of less than a millisecond still sleeps rather
+	// than turning the send slot loop into a busy spin
+	if (timeoutInSeconds > 0)
+		timeoutInMS = std::max(static_cast<int>(ceil(timeoutInSeconds * 1000)),1);
+		
+	pollInfo.fd = fSocket;
+	pollInfo.events = POLLIN;
+	pollInfo.revents = 0;
+	
+	if (poll(&pollInfo,1,timeoutInMS) <= 0)
+		return;
+		
+	#if USE_NETPACKET
+		// Drain everything that is waiting without blocking
+		while (true)
+		{
+			ARPPacket				arpReply;
+			struct sockaddr_ll		replyFrom;
+			SOCKET_SIZE_TYPE		optVal = sizeof(replyFrom);
+			ssize_t					bytesRead = 0;
+			
+			memset(&replyFrom,0,sizeof(replyFrom));
+			bytesRead = recvfrom(fSocket,&arpReply,sizeof(arpReply),MSG_DONTWAIT,reinterpret_cast<struct sockaddr*>(&replyFrom),&optVal);
+			if (bytesRead < 0)
 			{
-				if (sockNum != -1)
-					close(sockNum);
-				if (!errObj.IsLogged())
-				{
-					WriteToErrorLog(errObj.GetDescription());
-					errObj.MarkAsLogged();
-				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+					break;
+				throw TSymLibErrorObj(errno,"Failed to receive ARP reply packet");
+			}
+			
+			if (bytesRead >= static_cast<ssize_t>(sizeof(arpReply)) &&
+				(replyFrom.sll_pkttype == PACKET_HOST ||
+				 replyFrom.sll_pkttype == PACKET_BROADCAST ||
+				 replyFrom.sll_pkttype == PACKET_MULTICAST))
+			{
+				_HandleReply(&arpReply,pendingMap,addressMap);
 			}
-			catch (...)
+		}
+	#endif
+	
+	#if USE_BPF
+		{
+			// One read returns every captured packet, each with its own header
+			ssize_t		bytesRead = read(fSocket,const_cast<char*>(fIOBuffer.data()),fIOBuffer.length());
+			char*		bufferPtr = const_cast<char*>(fIOBuffer.data());
+			char*		endPtr = NULL;
+			
+			if (bytesRead < 0)
 			{
-				if (sockNum != -1)
-					close(sockNum);
-				WriteToErrorLog("Unknown error while looking up MAC address");
+				if (errno == EAGAIN || errno == EINTR)
+					return;
+				throw TSymLibErrorObj(errno,"Error while waiting for ARP reply packet");
 			}
 			
-			// Update the master map and addressCount
+			endPtr = bufferPtr + bytesRead;
+			while (bufferPtr < endPtr)
 			{
-				TLockedPthreadMutexObj	lock(fParentEnvironPtr->addressMapLock);
+				struct bpf_hdr*		bpfHeaderPtr = reinterpret_cast<struct bpf_hdr*>(bufferPtr);
 				
-				if (macAddress.empty())
-					macAddress = "{no_response}";
-				fParentEnvironPtr->addressMap[remoteIPAddress] = macAddress;
-				++fParentEnvironPtr->addressCount;
+				if (bpfHeaderPtr->bh_caplen >= sizeof(ARPBPFFrame))
+					_HandleReply(&reinterpret_cast<ARPBPFFrame*>(bufferPtr + bpfHeaderPtr->bh_hdrlen)->arp,pendingMap,addressMap);
+					
+				bufferPtr += BPF_WORDALIGN(bpfHeaderPtr->bh_hdrlen + bpfHeaderPtr->bh_caplen);
 			}
 		}
-	}
-#endif // USE_NETPACKET
+	#endif
+}
 
-#if USE_BPF
-	//*********************************************************************
-	// Class TARPTaskBPF
-	//*********************************************************************
+//---------------------------------------------------------------------
+// TARPSweeper::_HandleReply (protected)
+//---------------------------------------------------------------------
+void TARPSweeper::_HandleReply (const void* arpPtr, PendingMap& pendingMap, AddressMap& addressMap)
+{
+	const ARPPacket*	arpReplyPtr = reinterpret_cast<const ARPPacket*>(arpPtr);
 	
-	//---------------------------------------------------------------------
-	// Constructor
-	//---------------------------------------------------------------------
-	TARPTaskBPF::TARPTaskBPF (const string& deviceName, const IPAddressList& ipAddressList)
-		:	Inherited(PROJECT_SHORT_NAME,0,false),
-			fParentEnvironPtr(GetModEnviron()),
-			fIPAddressList(ipAddressList),
-			fDeviceName(deviceName)
+	if ((arpReplyPtr->ar_op == htons(ARPOP_REQUEST) || arpReplyPtr->ar_op == htons(ARPOP_REPLY)) &&
+		arpReplyPtr->ar_hrd == htons(ARPHRD_ETHER) &&
+		arpReplyPtr->ar_pro == htons(ETH_P_IP) &&
+		arpReplyPtr->ar_pln == 4 &&
+		arpReplyPtr->ar_hln == ETHER_ADDR_LEN)
 	{
+		uint32_t			senderIPAddress = 0;
+		PendingMap_iter		foundIter = pendingMap.end();
+		
+		memcpy(&senderIPAddress,arpReplyPtr->ar_sip,sizeof(senderIPAddress));
+		
+		// Probes sent while the sender was still configuring its address
+		// carry no sender address and tell us nothing
+		if (senderIPAddress == 0)
+			return;
+		
+		if (memcmp(arpReplyPtr->ar_tha,fMyMACAddress.data(),ETHER_ADDR_LEN) == 0)
+			foundIter = pendingMap.find(senderIPAddress);
+		
+		if (foundIter != pendingMap.end())
+		{
+			addressMap[foundIter->first] = _MACAddressAsString(arpReplyPtr->ar_sha);
+			pendingMap.erase(foundIter);
+		}
+		else if (fObservedMapPtr)
+		{
+			// Someone else's request or reply, or a gratuitous announcement
+			(*fObservedMapPtr)[senderIPAddress] = _MACAddressAsString(arpReplyPtr->ar_sha);
+		}
 	}
+}
+
+//---------------------------------------------------------------------
+// TARPSweeper::_MACAddressAsString (static protected)
+//---------------------------------------------------------------------
+string TARPSweeper::_MACAddressAsString (const unsigned char* macPtr)
+{
+	char	macBuffer[24];
 	
-	//---------------------------------------------------------------------
-	// Destructor
-	//---------------------------------------------------------------------
-	TARPTaskBPF::~TARPTaskBPF ()
+	sprintf(macBuffer,"%02X:%02X:%02X:%02X:%02X:%02X",macPtr[0],macPtr[1],macPtr[2],macPtr[3],macPtr[4],macPtr[5]);
+	
+	return string(macBuffer);
+}
+
+//---------------------------------------------------------------------
+// TARPSweeper::_CurrentTime (static protected)
+//---------------------------------------------------------------------
+double TARPSweeper::_CurrentTime ()
+{
+	struct timeval		now;
+	
+	gettimeofday(&now,NULL);
+	
+	return now.tv_sec + (now.tv_usec / 1000000.0);
+}
+
+//---------------------------------------------------------------------
+// TARPSweeper::_Close (protected)
+//---------------------------------------------------------------------
+void TARPSweeper::_Close ()
+{
+	if (fSocket != -1)
 	{
+		close(fSocket);
+		fSocket = -1;
 	}
-	
+}
+
+#if USE_NETPACKET
 	//---------------------------------------------------------------------
-	// TARPTaskBPF::RunTask
+	// TARPSweeper::_Open (protected)
 	//---------------------------------------------------------------------
-	void TARPTaskBPF::RunTask ()
+	void TARPSweeper::_Open ()
 	{
-		// Create our thread environment
-		CreateModEnviron(fParentEnvironPtr);
+		struct ifreq			ifr;
+		struct sockaddr_ll		bindInfo;
+		SOCKET_SIZE_TYPE		optVal;
+		string					errString;
 		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Starting ARP Lookup Task");
+		memset(&ifr,0,sizeof(ifr));
+		memset(&bindInfo,0,sizeof(bindInfo));
 		
-		for (IPAddressList_const_iter x = fIPAddressList.begin(); x != fIPAddressList.end() && DoPluginEventLoop(); x++)
-			_GetRemoteMACAddress(*x);
+		_Close();
 		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Ending ARP Lookup Task");
-	}
-	
-	//---------------------------------------------------------------------
-	// TARPTaskBPF::_GetRemoteMACAddress (protected)
-	//---------------------------------------------------------------------
-	void TARPTaskBPF::_GetRemoteMACAddress (unsigned long remoteIPAddress) const
-	{
-		if (fParentEnvironPtr && remoteIPAddress != 0)
+		try
 		{
-			string					macAddress;
-			string					errString;
-			string					myMACAddress;
-			int						sockNum = -1;
-			int						tempSocket = -1;
-			struct ifreq			ifr;
-			struct sockaddr_in		sockInfo;
-			int						ioBufferSize = 0;
-			char*					ioBufferPtr = NULL;
-			ARPBPFReq				arpPacket;
-			int						bytesMoved = 0;
-			
-			memset(&ifr,0,sizeof(ifr));
-			memset(&sockInfo,0,sizeof(sockInfo));
-			memset(&arpPacket,0,sizeof(arpPacket));
+			// Create a socket
+			fSocket = socket(PF_PACKET,SOCK_DGRAM,0);
+			if (fSocket < 0)
+				throw TSymLibErrorObj(errno,"During MAC lookup: Failed to obtain a network socket");
+				
+			// Get our NIC index
+			strcpy(ifr.ifr_name,fDeviceName.c_str());
+			if (ioctl(fSocket,SIOCGIFINDEX,&ifr) < 0)
+			{
+				errString = "Failed to locate interface '" + fDeviceName + "' in internal index";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			fInterfaceIndex = ifr.ifr_ifindex;
 			
-			try
+			// Make sure we can use the NIC
+			if (ioctl(fSocket,SIOCGIFFLAGS,&ifr) < 0)
 			{
-				// Open a temporary socket for ioctl calls
-				tempSocket = socket(AF_INET,SOCK_DGRAM,0);
-				if (tempSocket < 0)
-					throw TSymLibErrorObj(errno,"Unable to open temporary network socket");
-				
-				// Make sure we can use the NIC
-				strcpy(ifr.ifr_name,fDeviceName.c_str());
-				if (ioctl(tempSocket,SIOCGIFFLAGS,&ifr) < 0)
-				{
-					errString = "Failed to get status of interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				if (!(ifr.ifr_flags & IFF_UP))
-				{
-					errString = "Interface '" + fDeviceName + "' is not up";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				else if (ifr.ifr_flags & (IFF_NOARP|IFF_LOOPBACK))
-				{
-					errString = "Cannot use ARP on interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				
-				// Get our local address
-				if (ioctl(tempSocket,SIOCGIFADDR,&ifr) < 0)
-				{
-					errString = "Failed to acquire IP address from '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				sockInfo = *(reinterpret_cast<struct sockaddr_in*>(&ifr.ifr_addr));
-				
-				// Close the temporary socket
-				close(tempSocket);
-				tempSocket = -1;
-				
-				// Get our MAC Address
-				myMACAddress = _GetMyMACAddress();
-				
-				// Open a BPF socket
-				sockNum = _OpenBPFDevice(remoteIPAddress);
-				
-				// Set buffer size for read/write on descriptor
-				ioBufferSize = sizeof(arpPacket) + sizeof(struct bpf_hdr) + 32;
-				if (ioctl(sockNum,BIOCSBLEN,&ioBufferSize) < 0)
-				{
-					errString = "Failed to set the size for I/O buffering for interface '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				
-				// Allocate the buffer
-				ioBufferPtr = new char[ioBufferSize];
-				if (!ioBufferPtr)
-					throw TSymLibErrorObj(errno,"Unable to allocate temporary buffer");
-				
-				// Bind the BPF descriptor to our device
-				strcpy(ifr.ifr_name,fDeviceName.c_str());
-				if (ioctl(sockNum,BIOCSETIF,&ifr) < 0)
-				{
-					errString = "Failed to bind BPF socket to '" + fDeviceName + "'";
-					throw TSymLibErrorObj(errno,errString);
-				}
-				
-				if (memcmp(&sockInfo.sin_addr.s_addr,&remoteIPAddress,sizeof(remoteIPAddress)) == 0)
-				{
-					// We're apparently trying to scan ourselves, which is mildly stupid,
-					// but whatever.
-					const unsigned char*	ptr = reinterpret_cast<const unsigned char*>(myMACAddress.data());
-					char					macBuffer[24];
-					
-					sprintf(macBuffer,"%02X:%02X:%02X:%02X:%02X:%02X",ptr[0],ptr[1],ptr[2],ptr[3],ptr[4],ptr[5]);
-					macAddress = macBuffer;
-				}
-				else
-				{
-					// Construct the ARP packet
-					memcpy(arpPacket.ether_shost,myMACAddress.data(),ETHER_ADDR_LEN);
-					memset(arpPacket.ether_dhost,0xFF,ETHER_ADDR_LEN);
-					arpPacket.ether_type = htons(ETHERTYPE_ARP);
-					arpPacket.ar_hrd = htons(ARPHRD_ETHER);
-					arpPacket.ar_pro = htons(ETH_P_IP);
-					arpPacket.ar_hln = ETHER_ADDR_LEN;
-					arpPacket.ar_pln = 4;
-					arpPacket.ar_op = htons(ARPOP_REQUEST);
-					memcpy(arpPacket.ar_sha,myMACAddress.data(),ETHER_ADDR_LEN);
-					memcpy(arpPacket.ar_sip,&sockInfo.sin_addr.s_addr,arpPacket.ar_pln);
-					memset(arpPacket.ar_tha,0xFF,ETHER_ADDR_LEN);
-					memcpy(arpPacket.ar_tip,&remoteIPAddress,arpPacket.ar_pln);
-					
-					// Send the packet away
-					bytesMoved = write(sockNum,&arpPacket,sizeof(arpPacket));
-					if (bytesMoved <= 0)
-						throw TSymLibErrorObj(errno,"Failed to send ARP request packet");
-					
-					// Wait for the reply
-					bytesMoved = read(sockNum,ioBufferPtr,ioBufferSize);
-					if (bytesMoved < 0)
-					{
-						throw TSymLibErrorObj(errno,"Error while waiting for ARP reply packet");
-					}
-					else if (bytesMoved > 0)
-					{
-						struct bpf_hdr*	bpfHeaderPtr = reinterpret_cast<struct bpf_hdr*>(ioBufferPtr);
-						ARPBPFReq*		arpReplyPtr = reinterpret_cast<ARPBPFReq*>(ioBufferPtr + bpfHeaderPtr->bh_hdrlen);
-						unsigned char*	ptr = arpReplyPtr->ar_sha;
-						char			macBuffer[24];
-						
-						sprintf(macBuffer,"%02X:%02X:%02X:%02X:%02X:%02X",ptr[0],ptr[1],ptr[2],ptr[3],ptr[4],ptr[5]);
-						macAddress = macBuffer;
-					}
-				}
-				
-				if (sockNum != -1)
-					close(sockNum);
-				
-				if (ioBufferPtr)
-				{
-					delete(ioBufferPtr);
-					ioBufferPtr = NULL;
-				}
+				errString = "Failed to get status of interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
 			}
-			catch (TSymLibErrorObj& errObj)
+			if (!(ifr.ifr_flags & IFF_UP))
 			{
-				if (tempSocket != -1)
-					close(tempSocket);
-				if (sockNum != -1)
-					close(sockNum);
-				if (ioBufferPtr)
-				{
-					delete(ioBufferPtr);
-					ioBufferPtr = NULL;
-				}
-				if (!errObj.IsLogged())
-				{
-					WriteToErrorLog(errObj.GetDescription());
-					errObj.MarkAsLogged();
-				}
+				errString = "During MAC lookup: Interface '" + fDeviceName + "' is not up";
+				throw TSymLibErrorObj(errno,errString);
 			}
-			catch (...)
+			else if (ifr.ifr_flags & (IFF_NOARP|IFF_LOOPBACK))
 			{
-				if (tempSocket != -1)
-					close(tempSocket);
-				if (sockNum != -1)
-					close(sockNum);
-				if (ioBufferPtr)
-				{
-					delete(ioBufferPtr);
-					ioBufferPtr = NULL;
-				}
-				WriteToErrorLog("Unknown error while looking up MAC address");
+				errString = "Cannot use ARP on interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
 			}
 			
-			// Update the master map and addressCount
+			// Get our local address
+			if (ioctl(fSocket,SIOCGIFADDR,&ifr) < 0)
 			{
-				TLockedPthreadMutexObj	lock(fParentEnvironPtr->addressMapLock);
+				errString = "Failed to acquire IP address from '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			fMyIPAddress = reinterpret_cast<struct sockaddr_in*>(&ifr.ifr_addr)->sin_addr.s_addr;
+			
+			// Set our bind info
+			bindInfo.sll_family = AF_PACKET;
+			bindInfo.sll_ifindex = fInterfaceIndex;
+			bindInfo.sll_protocol = htons(ETH_P_ARP);
+			
+			// Try to bind the socket to the interface
+			if (bind(fSocket,reinterpret_cast<struct sockaddr*>(&bindInfo),sizeof(bindInfo)) < 0)
+				throw TSymLibErrorObj(errno,"During MAC lookup: bind() failed");
 				
-				if (macAddress.empty())
-					macAddress = "{no_response}";
-				fParentEnvironPtr->addressMap[remoteIPAddress] = macAddress;
-				++fParentEnvironPtr->addressCount;
+			// Get socket options
+			optVal = sizeof(bindInfo);
+			if (getsockname(fSocket,reinterpret_cast<struct sockaddr*>(&bindInfo),&optVal) < 0)
+				throw TSymLibErrorObj(errno,"During MAC lookup: getsockname() for sll_halen failed");
+			if (bindInfo.sll_halen != ETHER_ADDR_LEN)
+			{
+				errString = "Cannot use ARP on interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
 			}
+			fMyMACAddress.assign(reinterpret_cast<const char*>(bindInfo.sll_addr),bindInfo.sll_halen);
+		}
+		catch (...)
+		{
+			_Close();
+			throw;
 		}
 	}
 	
 	//---------------------------------------------------------------------
-	// TARPTaskBPF::_OpenBPFDevice (protected)
+	// TARPSweeper::_SendRequest (protected)
 	//---------------------------------------------------------------------
-	int TARPTaskBPF::_OpenBPFDevice (unsigned long remoteIPAddress) const
+	void TARPSweeper::_SendRequest (IPAddress remoteIPAddress)
 	{
-		int					bpfFD = -1;
+		struct sockaddr_ll		destInfo;
+		ARPPacket				arpPacket;
+		uint32_t				targetIPAddress = remoteIPAddress;
+		
+		memset(&destInfo,0,sizeof(destInfo));
+		memset(&arpPacket,0,sizeof(arpPacket));
+		
+		// Create a destination struct
+		destInfo.sll_family = AF_PACKET;
+		destInfo.sll_ifindex = fInterfaceIndex;
+		destInfo.sll_protocol = htons(ETH_P_ARP);
+		destInfo.sll_halen = ETHER_ADDR_LEN;
+		memset(destInfo.sll_addr,0xFF,destInfo.sll_halen);
+		
+		// Construct the ARP packet
+		arpPacket.ar_hrd = htons(ARPHRD_ETHER);
+		arpPacket.ar_pro = htons(ETH_P_IP);
+		arpPacket.ar_hln = ETHER_ADDR_LEN;
+		arpPacket.ar_pln = 4;
+		arpPacket.ar_op = htons(ARPOP_REQUEST);
+		memcpy(arpPacket.ar_sha,fMyMACAddress.data(),ETHER_ADDR_LEN);
+		memcpy(arpPacket.ar_sip,&fMyIPAddress,arpPacket.ar_pln);
+		memcpy(arpPacket.ar_tha,destInfo.sll_addr,ETHER_ADDR_LEN);
+		memcpy(arpPacket.ar_tip,&targetIPAddress,arpPacket.ar_pln);
+		
+		// Send the packet away; a full transmit queue only costs us this
+		// attempt, since unanswered addresses are retried
+		if (sendto(fSocket,&arpPacket,sizeof(arpPacket),0,reinterpret_cast<struct sockaddr*>(&destInfo),sizeof(destInfo)) < 0 && errno != ENOBUFS)
+			throw TSymLibErrorObj(errno,"Failed to send ARP request packet");
+	}
+#endif // USE_NETPACKET
+
+#if USE_BPF
+	//---------------------------------------------------------------------
+	// TARPSweeper::_Open (protected)
+	//---------------------------------------------------------------------
+	void TARPSweeper::_Open ()
+	{
+		string				errString;
+		int					tempSocket = -1;
+		struct ifreq		ifr;
 		int					ioctlArg = 0;
-		struct timeval		timeout;
 		struct bpf_insn		arpReplyFilterCode[] =
 									{
 										BPF_STMT(BPF_LD|BPF_H|BPF_ABS,ETHER_ADDR_LEN*2),			// Extract Ethertype
-										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ETHERTYPE_ARP,0,5),			// ARP Data?
+										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ETHERTYPE_ARP,0,4),			// ARP Data?
 										BPF_STMT(BPF_LD|BPF_H|BPF_ABS,20),							// Extract ARP opcode
-										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ARPOP_REPLY,0,3),			// ARPOP_REPLY?
-										BPF_STMT(BPF_LD|BPF_W|BPF_ABS,28),							// Extract source IP address
-										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ntohl(remoteIPAddress),0,1),	// Our remote IP address?
-										BPF_STMT(BPF_RET|BPF_K,sizeof(ARPBPFReq)),					// Good return
+										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ARPOP_REPLY,1,0),			// ARPOP_REPLY?
+										BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,ARPOP_REQUEST,0,1),			// ARPOP_REQUEST?
+										BPF_STMT(BPF_RET|BPF_K,sizeof(ARPBPFFrame)),				// Good return
 										BPF_STMT(BPF_RET|BPF_K,0)									// Failed return
 									};
 		struct bpf_program	arpReplyFilter;
@@ -947,61 +1072,145 @@ unsigned long TLookupMACAddrTask::_GetNetworkMask (const string& deviceName) con
 		arpReplyFilter.bf_len = sizeof(arpReplyFilterCode)/sizeof(struct bpf_insn);
 		arpReplyFilter.bf_insns = arpReplyFilterCode;
 		
-		for (int x = 0; x < 256; x++)
-		{
-			char	dev[32];
-			
-			sprintf(dev,"/dev/bpf%d",x);
-			bpfFD = open(dev,O_RDWR);
-			
-			if (bpfFD >= 0)
-				break;
-		}
+		memset(&ifr,0,sizeof(ifr));
+		
+		_Close();
 		
 		try
 		{
-			if (bpfFD < 0)
+			// Open a temporary socket for ioctl calls
+			tempSocket = socket(AF_INET,SOCK_DGRAM,0);
+			if (tempSocket < 0)
+				throw TSymLibErrorObj(errno,"Unable to open temporary network socket");
+				
+			// Make sure we can use the NIC
+			strcpy(ifr.ifr_name,fDeviceName.c_str());
+			if (ioctl(tempSocket,SIOCGIFFLAGS,&ifr) < 0)
+			{
+				errString = "Failed to get status of interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			if (!(ifr.ifr_flags & IFF_UP))
+			{
+				errString = "Interface '" + fDeviceName + "' is not up";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			else if (ifr.ifr_flags & (IFF_NOARP|IFF_LOOPBACK))
+			{
+				errString = "Cannot use ARP on interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			
+			// Get our local address
+			if (ioctl(tempSocket,SIOCGIFADDR,&ifr) < 0)
+			{
+				errString = "Failed to acquire IP address from '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			fMyIPAddress = reinterpret_cast<struct sockaddr_in*>(&ifr.ifr_addr)->sin_addr.s_addr;
+			
+			// Close the temporary socket
+			close(tempSocket);
+			tempSocket = -1;
+			
+			// Get our MAC Address
+			fMyMACAddress = _GetMyMACAddress();
+			
+			// Open a BPF device
+			for (int x = 0; x < 256 && fSocket < 0; x++)
+			{
+				char	dev[32];
+				
+				sprintf(dev,"/dev/bpf%d",x);
+				fSocket = open(dev,O_RDWR);
+			}
+			if (fSocket < 0)
 				throw TSymLibErrorObj(kErrorUnableToObtainBPFDeviceDescriptor,"Unable to acquire BPF device descriptor");
+				
+			// Room for a burst of replies; must be set before binding
+			ioctlArg = kARPBPFBufferSize;
+			if (ioctl(fSocket,BIOCSBLEN,&ioctlArg) < 0)
+			{
+				errString = "Failed to set the size for I/O buffering for interface '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			
+			// Bind the BPF descriptor to our device
+			strcpy(ifr.ifr_name,fDeviceName.c_str());
+			if (ioctl(fSocket,BIOCSETIF,&ifr) < 0)
+			{
+				errString = "Failed to bind BPF socket to '" + fDeviceName + "'";
+				throw TSymLibErrorObj(errno,errString);
+			}
+			
+			// Reads must use the buffer size the kernel actually settled on
+			if (ioctl(fSocket,BIOCGBLEN,&ioctlArg) < 0)
+				throw TSymLibErrorObj(errno,"Unable to obtain BPF buffer size");
+			fIOBuffer.resize(ioctlArg);
 			
 			// Set descriptor to immediate mode
 			ioctlArg = 1;
-			if (ioctl(bpfFD,BIOCIMMEDIATE,&ioctlArg) < 0)
+			if (ioctl(fSocket,BIOCIMMEDIATE,&ioctlArg) < 0)
 				throw TSymLibErrorObj(errno,"Unable to put BPF device into immediate mode");
-			
+				
 			// Accept only incoming packets
 			ioctlArg = 0;
-			if (ioctl(bpfFD,BIOCGSEESENT,&ioctlArg) < 0)
+			if (ioctl(fSocket,BIOCGSEESENT,&ioctlArg) < 0)
 				throw TSymLibErrorObj(errno,"Unable to put BPF device into scan-incoming-only mode");
-			
+				
 			// Don't let the interface add headers
 			ioctlArg = 0;
-			if (ioctl(bpfFD,BIOCGHDRCMPLT,&ioctlArg) < 0)
+			if (ioctl(fSocket,BIOCGHDRCMPLT,&ioctlArg) < 0)
 				throw TSymLibErrorObj(errno,"Unable to strip header inclusion in BPF device");
-			
-			// Set the timeout
-			timeout.tv_sec = kARPReplyTimeout;
-			timeout.tv_usec = 0;
-			if (ioctl(bpfFD,BIOCSRTIMEOUT,&timeout) < 0)
-				throw TSymLibErrorObj(errno,"Unable to install I/O timeout on BPF device");
-			
-			// Set the filter
-			if (ioctl(bpfFD,BIOCSETF,&arpReplyFilter) < 0)
+				
+			// Set the filter; every request and reply is wanted, not just
+			// those from one address
+			if (ioctl(fSocket,BIOCSETF,&arpReplyFilter) < 0)
 				throw TSymLibErrorObj(errno,"Unable to install BPF filter on device");
 		}
 		catch (...)
 		{
-			if (bpfFD != -1)
-				close(bpfFD);
+			if (tempSocket != -1)
+				close(tempSocket);
+			_Close();
 			throw;
 		}
+	}
+	
+	//---------------------------------------------------------------------
+	// TARPSweeper::_SendRequest (protected)
+	//---------------------------------------------------------------------
+	void TARPSweeper::_SendRequest (IPAddress remoteIPAddress)
+	{
+		ARPBPFFrame		arpFrame;
+		uint32_t		targetIPAddress = remoteIPAddress;
+		
+		memset(&arpFrame,0,sizeof(arpFrame));
 		
-		return bpfFD;
+		// Construct the ARP packet
+		memcpy(arpFrame.ether_shost,fMyMACAddress.data(),ETHER_ADDR_LEN);
+		memset(arpFrame.ether_dhost,0xFF,ETHER_ADDR_LEN);
+		arpFrame.ether_type = htons(ETHERTYPE_ARP);
+		arpFrame.arp.ar_hrd = htons(ARPHRD_ETHER);
+		arpFrame.arp.ar_pro = htons(ETH_P_IP);
+		arpFrame.arp.ar_hln = ETHER_ADDR_LEN;
+		arpFrame.arp.ar_pln = 4;
+		arpFrame.arp.ar_op = htons(ARPOP_REQUEST);
+		memcpy(arpFrame.arp.ar_sha,fMyMACAddress.data(),ETHER_ADDR_LEN);
+		memcpy(arpFrame.arp.ar_sip,&fMyIPAddress,arpFrame.arp.ar_pln);
+		memset(arpFrame.arp.ar_tha,0xFF,ETHER_ADDR_LEN);
+		memcpy(arpFrame.arp.ar_tip,&targetIPAddress,arpFrame.arp.ar_pln);
+		
+		// Send the packet away; a full transmit queue only costs us this
+		// attempt, since unanswered addresses are retried
+		if (write(fSocket,&arpFrame,sizeof(arpFrame)) <= 0 && errno != ENOBUFS)
+			throw TSymLibErrorObj(errno,"Failed to send ARP request packet");
 	}
 	
 	//---------------------------------------------------------------------
-	// TARPTaskBPF::_GetMyMACAddress (protected)
+	// TARPSweeper::_GetMyMACAddress (protected)
 	//---------------------------------------------------------------------
-	string TARPTaskBPF::_GetMyMACAddress () const
+	string TARPSweeper::_GetMyMACAddress () const
 	{
 		string		myMACAddress;
 		int			mib[6];
@@ -1053,5 +1262,4 @@ unsigned long TLookupMACAddrTask::_GetNetworkMask (const string& deviceName) con
 		
 		return myMACAddress;
 	}
-	
 #endif // USE_BPF
@@ -41,11 +41,18 @@ using symbiot::TMessageNode;
 // Forward Class Declarations
 //---------------------------------------------------------------------
 class TLookupMACAddrTask;
+class TARPSweeper;
 
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
 #define	kDefaultExecutionInterval						60*10	// 10 minutes
+#define	kDefaultARPSendRate								512		// requests per second
+#define	kARPSweepMaxAttempts							3
+#define	kARPReplyTimeout								1		// seconds; doubled after each attempt
+#define	kMACEntryStalePasses							3		// re-probe bindings not confirmed for this many passes
+#define	kUnknownAddressProbePasses						6		// probe silent addresses every Nth pass
+#define	kFullReportPassInterval							10		// in delta mode, every Nth report is complete
 
 #define		kErrorNetworkDeviceNotSpecified				-24201
 #define		kErrorScanTargetNotSpecified				-24202
@@ -58,6 +65,18 @@ typedef		vector<unsigned long>						IPAddressList;
 typedef		IPAddressList::iterator						IPAddressList_iter;
 typedef		IPAddressList::const_iterator				IPAddressList_const_iter;
 
+struct	MACTableEntry
+	{
+		MACAddress			macAddress;
+		unsigned long		lastSeenPass;		// Pass on which the binding was last confirmed
+	};
+
+// Every binding we currently believe in, whether learned by probing,
+// from the kernel's neighbor table or from ARP traffic we overheard
+typedef		map<IPAddress,MACTableEntry>				MACTable;
+typedef		MACTable::iterator							MACTable_iter;
+typedef		MACTable::const_iterator					MACTable_const_iter;
+
 //---------------------------------------------------------------------
 // Class TLookupMACAddrTask
 //---------------------------------------------------------------------
@@ -84,7 +103,9 @@ class TLookupMACAddrTask : public TTaskBase
 		
 		virtual void SetupTask (const string& deviceName,
 								const string& scanTarget,
-								time_t scanInterval = 0);
+								time_t scanInterval = 0,
+								unsigned long sendRate = 0,
+								bool deltaReports = false);
 			// Sets up the object for future MAC address lookups.  The deviceName
 			// argument indicates which network interface to use.  The scanTarget
 			// argument tells the plugin what to scan.  Valid formats for this
@@ -94,6 +115,11 @@ class TLookupMACAddrTask : public TTaskBase
 			//		IPv4 dotted-quad address
 			//		host name with network mask (eg, myhost.mydomain.com/28)
 			//		IPv4 address with network mask (eg, 192.168.1.0/28)
+			//
+			// The sendRate argument limits the number of ARP requests sent
+			// per second; zero means kDefaultARPSendRate.  If deltaReports
+			// is true then, after the first report, only bindings that are
+			// new, changed or expired are sent to the server.
 		
 		virtual void RunTask ();
 			// Thread entry point for the task.  Really just a wrapper for Main().
@@ -103,6 +129,25 @@ class TLookupMACAddrTask : public TTaskBase
 	
 	protected:
 		
+		virtual void _UpdateMACTable ();
+			// Refreshes fMACTable from the kernel's neighbor table, then
+			// probes only those target addresses whose bindings are stale
+			// or that are unknown and due for another try.  Bindings that
+			// fail a probe are dropped.
+		
+		virtual void _CreateXMLMessage (TServerMessage& messageObj, bool deltaOnly);
+			// Creates the outbound server message from fMACTable.  If
+			// deltaOnly is true then only the differences between fMACTable
+			// and fReportedMap are included.
+		
+		virtual bool _IsTarget (IPAddress ipAddress) const;
+			// Returns true if ipAddress is one of the addresses we scan.
+		
+		static void _HarvestNeighborTable (const string& deviceName, AddressMap& addressMap);
+			// Destructively modifies addressMap to contain the complete
+			// entries for deviceName in the kernel's ARP cache.  Does
+			// nothing on platforms without /proc/net/arp.
+		
 		virtual unsigned long _ParseScanTarget ();
 			// Parses the string contained in fScanTarget, exploding it into
 			// a list of IP addresses to scan.  Returns the number of resulting
@@ -121,110 +166,101 @@ class TLookupMACAddrTask : public TTaskBase
 		string									fMyDeviceName;
 		string									fScanTarget;
 		IPAddressList							fIPAddressList;
+		unsigned long							fSendRate;
+		MACTable								fMACTable;
+		AddressMap								fReportedMap;
+		bool									fDeltaReports;
+		bool									fHaveReported;
+		unsigned long							fPassCount;
 		ModEnviron*								fParentEnvironPtr;
 			
 };
 
-#if USE_NETPACKET
-	//---------------------------------------------------------------------
-	// Class TARPTaskNetpacket
-	//---------------------------------------------------------------------
-	class TARPTaskNetpacket : public TTaskBase
-	{
-		private:
-			
-			typedef	TTaskBase						Inherited;
+//---------------------------------------------------------------------
+// Class TARPSweeper
+//
+// Resolves a list of IPv4 addresses to MAC addresses using a single
+// link-layer socket.  Requests go out at a fixed rate and replies are
+// collected in between; addresses that stay silent are asked again,
+// with the wait for stragglers doubling each time.
+//---------------------------------------------------------------------
+class TARPSweeper
+{
+	private:
 		
-		public:
-			
-			TARPTaskNetpacket (const string& deviceName, const IPAddressList& ipAddressList);
-				// Constructor
+		typedef	map<IPAddress,unsigned int>			PendingMap;
+		typedef	PendingMap::iterator				PendingMap_iter;
+		typedef	PendingMap::const_iterator			PendingMap_const_iter;
+	
+	public:
 		
-		private:
-			
-			TARPTaskNetpacket (const TARPTaskNetpacket& obj) {}
-				// Copy constructor is illegal
+		TARPSweeper (const string& deviceName, unsigned long sendRate = kDefaultARPSendRate);
+			// Constructor.  The sendRate argument is the maximum number of
+			// requests sent per second.
+	
+	private:
 		
-		public:
-			
-			virtual ~TARPTaskNetpacket ();
-				// Destructor
-			
-			virtual void RunTask ();
-				// Thread entry point for the task.
+		TARPSweeper (const TARPSweeper& obj) {}
+			// Copy constructor is illegal
+	
+	public:
 		
-		protected:
-			
-			virtual void _GetRemoteMACAddress (unsigned long remoteIPAddress) const;
-				// Given a remote IP address expressed as an unsigned long in network
-				// byte order, this method uses ARP to determine the corresponding
-				// MAC address.  The pair is then written to a thread-specific
-				// global structure.
+		~TARPSweeper ();
+			// Destructor
 		
-		protected:
-			
-			ModEnviron*								fParentEnvironPtr;
-			IPAddressList							fIPAddressList;
-			string									fDeviceName;
-				
-	};
+		void Sweep (const IPAddressList& ipAddressList,
+					AddressMap& addressMap,
+					AddressMap* observedMapPtr = NULL);
+			// Destructively modifies addressMap to contain the MAC address of
+			// every address in ipAddressList, or "{no_response}" for those
+			// that never answered.  If observedMapPtr is not NULL, the sender
+			// of every other ARP packet seen during the sweep is added to it.
+			// Returns early if the plugin is told to stop.  Throws an
+			// exception if the interface cannot be used.
 	
-	typedef TARPTaskNetpacket TARPTask;
-#endif
-
-#if USE_BPF
-	//---------------------------------------------------------------------
-	// Class TARPTaskBPF
-	//---------------------------------------------------------------------
-	class TARPTaskBPF : public TTaskBase
-	{
-		private:
-			
-			typedef	TTaskBase						Inherited;
+	protected:
 		
-		public:
-			
-			TARPTaskBPF (const string& deviceName, const IPAddressList& ipAddressList);
-				// Constructor
+		void _Open ();
+			// Opens and binds the link-layer socket and learns our own
+			// IP and MAC addresses.
 		
-		private:
-			
-			TARPTaskBPF (const TARPTaskBPF& obj) {}
-				// Copy constructor is illegal
+		void _Close ();
+			// Closes the socket, if open.
 		
-		public:
-			
-			virtual ~TARPTaskBPF ();
-				// Destructor
-			
-			virtual void RunTask ();
-				// Thread entry point for the task.
+		void _SendRequest (IPAddress remoteIPAddress);
+			// Broadcasts one ARP request for remoteIPAddress.
 		
-		protected:
-			
-			virtual void _GetRemoteMACAddress (unsigned long remoteIPAddress) const;
-				// Given a remote IP address expressed as an unsigned long in network
-				// byte order, this method uses ARP to determine the corresponding
-				// MAC address.  The pair is then written to a thread-specific
-				// global structure.
-			
-			virtual int _OpenBPFDevice (unsigned long remoteIPAddress) const;
-				// Returns the file descriptor for an open BPF device.
-			
-			virtual string _GetMyMACAddress () const;
+		void _ReceiveReplies (PendingMap& pendingMap, AddressMap& addressMap, double timeoutInSeconds);
+			// Waits up to timeoutInSeconds for the socket to become readable,
+			// then reads the replies that are waiting.  Addresses that
+			// answered are moved from pendingMap to addressMap.
+		
+		void _HandleReply (const void* arpPtr, PendingMap& pendingMap, AddressMap& addressMap);
+			// Examines one received ARP packet (without link-layer header).
+		
+		static string _MACAddressAsString (const unsigned char* macPtr);
+			// Returns the six bytes at macPtr as a colon-delimited hex string.
+		
+		static double _CurrentTime ();
+			// Returns the time of day in seconds, with microsecond resolution.
+		
+		#if USE_BPF
+			string _GetMyMACAddress () const;
 				// Returns the MAC address of the fDeviceName as a compacted string
 				// (not human-readable).
-		
-		protected:
-			
-			ModEnviron*								fParentEnvironPtr;
-			IPAddressList							fIPAddressList;
-			string									fDeviceName;
-				
-	};
+		#endif
 	
-	typedef TARPTaskBPF TARPTask;
-#endif
+	protected:
+		
+		string									fDeviceName;
+		unsigned long							fSendRate;
+		int										fSocket;
+		int										fInterfaceIndex;
+		IPAddress								fMyIPAddress;
+		string									fMyMACAddress;
+		string									fIOBuffer;
+		AddressMap*								fObservedMapPtr;
+};
 
 //---------------------------------------------------------------------
 #endif // LOOKUP_TASK
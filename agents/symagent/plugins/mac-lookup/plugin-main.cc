@@ -47,7 +47,9 @@ struct	ScanParams
 		string				device;
 		string				target;
 		time_t				scanInterval;
-		ScanParams () : scanInterval(0) {}
+		unsigned long		sendRate;
+		bool				deltaReports;
+		ScanParams () : scanInterval(0),sendRate(0),deltaReports(false) {}
 	};
 
 typedef	vector<ScanParams>								ScanParamsList;
@@ -175,6 +177,8 @@ bool AgentInit (const TPreferenceNode& preferenceNode)
 							string			device(prefNode.GetAttributeValue("device"));
 							string			target(prefNode.GetAttributeValue("target"));
 							time_t			scanInterval(static_cast<time_t>(StringToNum(prefNode.GetAttributeValue("interval"))));
+							unsigned long	sendRate(static_cast<unsigned long>(StringToNum(prefNode.GetAttributeValue("rate"))));
+							bool			deltaReports(prefNode.GetAttributeValue("report") == "delta");
 							
 							// Assign a default watch interval if we weren't given one
 							if (scanInterval <= 0)
@@ -191,6 +195,8 @@ bool AgentInit (const TPreferenceNode& preferenceNode)
 										aParam.device = *y;
 										aParam.target = target;
 										aParam.scanInterval = scanInterval;
+										aParam.sendRate = sendRate;
+										aParam.deltaReports = deltaReports;
 										
 										gModGlobalsPtr->scanParamsList.push_back(aParam);
 										
@@ -204,6 +210,8 @@ bool AgentInit (const TPreferenceNode& preferenceNode)
 									aParam.device = device;
 									aParam.target = target;
 									aParam.scanInterval = scanInterval;
+									aParam.sendRate = sendRate;
+									aParam.deltaReports = deltaReports;
 									
 									gModGlobalsPtr->scanParamsList.push_back(aParam);
 									
@@ -244,7 +252,7 @@ void AgentRun ()
 					TLookupMACAddrTask*		taskObjPtr = new TLookupMACAddrTask;
 					
 					taskObjPtrList.push_back(taskObjPtr);
-					taskObjPtr->SetupTask(x->device,x->target,x->scanInterval);
+					taskObjPtr->SetupTask(x->device,x->target,x->scanInterval,x->sendRate,x->deltaReports);
 					AddTaskToQueue(taskObjPtr,true);
 				}
 				
@@ -33,6 +33,30 @@
 //---------------------------------------------------------------------
 static	pthread_key_t									gEnvironKey;
 static	ModEnviron*										gMainModEnvironPtr = NULL;
+static	bool											gEnvironKeyCreated = false;
+
+//---------------------------------------------------------------------
+// Class TModEnvironKeyReleaser
+//
+// The single static instance is destroyed when the module is unloaded.
+// It deletes the environment key so that reloading the plugin does not
+// leak a pthread key whose destructor points into the unloaded module.
+//---------------------------------------------------------------------
+class TModEnvironKeyReleaser
+{
+	public:
+		
+		~TModEnvironKeyReleaser ()
+			{
+				if (gEnvironKeyCreated)
+				{
+					pthread_key_delete(gEnvironKey);
+					gEnvironKeyCreated = false;
+				}
+			}
+};
+
+static	TModEnvironKeyReleaser							gEnvironKeyReleaser;
 
 //---------------------------------------------------------------------
 // InitModEnviron
@@ -41,9 +65,13 @@ void InitModEnviron ()
 {
 	int		errNum = 0;
 	
-	errNum = pthread_key_create(&gEnvironKey,DestroyModEnviron);
-	if (errNum != 0)
-		throw TSymLibErrorObj(errNum,"Unable to initialize thread environment");
+	if (!gEnvironKeyCreated)
+	{
+		errNum = pthread_key_create(&gEnvironKey,DestroyModEnviron);
+		if (errNum != 0)
+			throw TSymLibErrorObj(errNum,"Unable to initialize thread environment");
+		gEnvironKeyCreated = true;
+	}
 	
 	// Setup a toplevel environmental pointer
 	CreateModEnviron();
@@ -76,7 +104,6 @@ void CreateModEnviron (ModEnviron* parentEnvironPtr)
 		environPtr->runState = parentEnvironPtr->runState;
 	else
 		environPtr->runState = false;
-	environPtr->addressCount = 0;
 	
 	errNum = pthread_setspecific(gEnvironKey,environPtr);
 	if (errNum != 0)
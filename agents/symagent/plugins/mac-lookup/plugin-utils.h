@@ -48,9 +48,6 @@ struct	ModEnviron
 	{
 		ModEnviron*			parentEnvironPtr;
 		bool				runState;
-		unsigned long		addressCount;
-		AddressMap			addressMap;
-		TPthreadMutexObj	addressMapLock;
 		
 		bool GetRunState () { return runState && (!parentEnvironPtr || parentEnvironPtr->GetRunState()); }
 		void SetRunState (bool newState)
@@ -239,21 +239,21 @@ TSendInfoTask::~TSendInfoTask ()
 void TSendInfoTask::RunTask ()
 {
 	TServerMessage		messageObj;
-	TServerReply		replyObj;
 	
 	// Create our thread environment
 	CreateModEnviron(fParentEnvironPtr);
 	
-	if (IsConnectedToServer() && DoPluginEventLoop())
+	if (DoPluginEventLoop())
 	{
 		// Create the outbound message
 		CreateTrafficeMessage(messageObj);
 	}
 	
-	if (IsConnectedToServer() && DoPluginEventLoop())
+	if (DoPluginEventLoop())
 	{
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
+		// Send it to the server; traffic captured while we're
+		// disconnected is spooled rather than lost
+		SendToServerOrSpool(messageObj);
 	}
 }
 
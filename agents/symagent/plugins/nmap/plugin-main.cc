@@ -25,10 +25,13 @@
 #include "plugin-main.h"
 
 #include "plugin-send-info.h"
+#include "scan-state.h"
 
 #include "../../plugin-api.h"
 
+#include <cctype>
 #include <iostream>
+#include <memory>
 #include <unistd.h>
 
 //---------------------------------------------------------------------
@@ -44,9 +47,10 @@ using namespace std;
 struct	NmapExecInfo
 	{
 		string						application;
-		string						appArgs;
+		StdStringList				appArgList;
 		time_t						scanInterval;
 		string						serverRef;
+		bool						deltaReports;
 	};
 
 typedef	vector<NmapExecInfo>							NMAPArgsList;
@@ -56,10 +60,15 @@ typedef	NMAPArgsList::const_iterator					NMAPArgsList_const_iter;
 typedef	map<AppExecRef,string>							ServerRefMap;
 typedef	ServerRefMap::const_iterator					ServerRefMap_const_iter;
 
+typedef	map<AppExecRef,TNmapScanParser*>				ScanParserMap;
+typedef	ScanParserMap::iterator							ScanParserMap_iter;
+typedef	ScanParserMap::const_iterator					ScanParserMap_const_iter;
+
 struct	ModGlobals
 	{
 		NMAPArgsList				nmapArgsList;
 		ServerRefMap				serverRefMap;
+		ScanParserMap				scanParserMap;
 	};
 
 typedef	vector<AppExecRef>								AppExecRefList;
@@ -165,36 +174,34 @@ bool AgentInit (const TPreferenceNode& preferenceNode)
 					string			args(prefNode.GetAttributeValue("args"));
 					string			serverRef(prefNode.GetAttributeValue("ref"));
 					time_t			scanInterval(static_cast<time_t>(StringToNum(prefNode.GetAttributeValue("interval"))));
+					bool			deltaReports(prefNode.GetAttributeValue("report") == "delta");
 					StdStringList	argList;
+					NmapExecInfo	info;
 					
-					// Split the args into a list
-					SplitStdString (' ',args,argList,false);
+					// Split the args into a list, honoring quotes
+					SplitNmapArgs(args,argList);
 					
-					// Put the arg list back together, skipping -o options
-					args = "";
+					// Build the argument list, starting with the option that causes
+					// nmap to output its findings in XML format to stdout and
+					// skipping any -o options from the server.  nmap is launched
+					// without a shell, so each entry reaches it unchanged.
+					info.appArgList.push_back("-oX");
+					info.appArgList.push_back("-");
 					for (StdStringList_const_iter i = argList.begin(); i != argList.end(); i++)
 					{
 						if (i->find("-o") != 0 && *i != "-")
-						{
-							if (!args.empty())
-								args += " ";
-							args += *i;
-						}
+							info.appArgList.push_back(*i);
 					}
 					
 					if (scanInterval < 0)
 						scanInterval = 0;
 					
-					if (!args.empty())
+					if (info.appArgList.size() > 2)
 					{
-						NmapExecInfo		info;
-						
-						// Build the command, including the option that causes nmap
-						// to output its findings in XML format to stdout
 						info.application = nmapPath;
-						info.appArgs = "-oX - " + args;
 						info.scanInterval = scanInterval;
 						info.serverRef = serverRef;
+						info.deltaReports = deltaReports;
 						
 						gModGlobalsPtr->nmapArgsList.push_back(info);
 					}
@@ -234,10 +241,20 @@ void AgentRun ()
 					
 					for (NMAPArgsList_iter x = gModGlobalsPtr->nmapArgsList.begin(); x != gModGlobalsPtr->nmapArgsList.end(); x++)
 					{
-						AppExecRef		appExecRef = CreateAppExecTask(x->application,x->appArgs,"",x->scanInterval);
+						AppExecRef		appExecRef = CreateAppExecTask(x->application,x->appArgList,"",x->scanInterval);
 						
 						appExecRefList.push_back(appExecRef);
-						AddAppExecCallback(appExecRef,HandleNmapOutput);
+						if (x->deltaReports)
+						{
+							// Parse the output as nmap produces it instead
+							// of collecting all of it first
+							SetAppExecStreamOutput(appExecRef,true);
+							AddAppExecCallback(appExecRef,HandleNmapStreamOutput);
+						}
+						else
+						{
+							AddAppExecCallback(appExecRef,HandleNmapOutput);
+						}
 						QueueAppExecTask(appExecRef,true);
 						
 						gModGlobalsPtr->serverRefMap[appExecRef] = x->serverRef;
@@ -280,6 +297,8 @@ void AgentRun ()
 							DestroyAppExecTask(appExecRefList.back());
 						appExecRefList.pop_back();
 					}
+					
+					DestroyScanParsers();
 				}
 			}
 		}
@@ -291,6 +310,7 @@ void AgentRun ()
 					DestroyAppExecTask(appExecRefList.back());
 				appExecRefList.pop_back();
 			}
+			DestroyScanParsers();
 			SetRunState(false);
 			throw;
 		}
@@ -325,6 +345,60 @@ string LocateNmap ()
 	return LocateFile("nmap",dirList);
 }
 
+//---------------------------------------------------------------------
+// SplitNmapArgs
+//---------------------------------------------------------------------
+void SplitNmapArgs (const string& args, StdStringList& argList)
+{
+	string		currentArg;
+	bool		inArg = false;
+	char		quoteChar = 0;
+	
+	argList.clear();
+	
+	for (string::size_type x = 0; x < args.length(); x++)
+	{
+		char	ch = args[x];
+		
+		if (quoteChar != 0)
+		{
+			if (ch == quoteChar)
+				quoteChar = 0;
+			else if (ch == '\\' && quoteChar == '"' && x + 1 < args.length() && (args[x + 1] == '"' || args[x + 1] == '\\'))
+				currentArg += args[++x];
+			else
+				currentArg += ch;
+		}
+		else if (ch == '\'' || ch == '"')
+		{
+			quoteChar = ch;
+			inArg = true;
+		}
+		else if (ch == '\\' && x + 1 < args.length())
+		{
+			currentArg += args[++x];
+			inArg = true;
+		}
+		else if (isspace(static_cast<unsigned char>(ch)))
+		{
+			if (inArg)
+			{
+				argList.push_back(currentArg);
+				currentArg = "";
+				inArg = false;
+			}
+		}
+		else
+		{
+			currentArg += ch;
+			inArg = true;
+		}
+	}
+	
+	if (inArg)
+		argList.push_back(currentArg);
+}
+
 //---------------------------------------------------------------------
 // HandleNmapOutput
 //---------------------------------------------------------------------
@@ -352,3 +426,92 @@ bool HandleNmapOutput (const std::string& returnedData,
 	// will always return true here
 	return true;
 }
+
+//---------------------------------------------------------------------
+// HandleNmapStreamOutput
+//---------------------------------------------------------------------
+bool HandleNmapStreamOutput (const std::string& returnedData,
+							 AppExecRef taskRef,
+							 void* /* userData */)
+{
+	TNmapScanParser*	parserObjPtr = NULL;
+	string				serverRef;
+	
+	if (gModGlobalsPtr)
+	{
+		TLockedPthreadMutexObj		lock(gModGlobalsMutex);
+		ServerRefMap_const_iter 	foundIter = gModGlobalsPtr->serverRefMap.find(taskRef);
+		ScanParserMap_iter			foundParser = gModGlobalsPtr->scanParserMap.find(taskRef);
+		
+		if (foundIter != gModGlobalsPtr->serverRefMap.end())
+			serverRef = foundIter->second;
+		
+		if (foundParser != gModGlobalsPtr->scanParserMap.end())
+		{
+			parserObjPtr = foundParser->second;
+		}
+		else if (!returnedData.empty())
+		{
+			// First output of a new scan; the raw output is kept only
+			// if this scan will be reported in full
+			parserObjPtr = new TNmapScanParser(IsFullNmapReportDue(serverRef));
+			gModGlobalsPtr->scanParserMap[taskRef] = parserObjPtr;
+		}
+		
+		// Empty data marks the end of the scan; the parser is ours now
+		if (returnedData.empty())
+			gModGlobalsPtr->scanParserMap.erase(taskRef);
+	}
+	
+	if (parserObjPtr)
+	{
+		if (!returnedData.empty())
+		{
+			try
+			{
+				parserObjPtr->Parse(returnedData);
+			}
+			catch (...)
+			{
+				// The exec task stops reading and ends the output with an
+				// empty block; make sure this scan's parser is gone by then
+				{
+					TLockedPthreadMutexObj		lock(gModGlobalsMutex);
+					
+					gModGlobalsPtr->scanParserMap.erase(taskRef);
+				}
+				delete(parserObjPtr);
+				WriteToErrorLog("Error while parsing nmap output for '" + serverRef + "'; scan not reported");
+				throw;
+			}
+		}
+		else
+		{
+			auto_ptr<TNmapScanParser>	parserObjHolder(parserObjPtr);
+			
+			if (!parserObjPtr->Finish())
+				WriteToErrorLog("nmap output for '" + serverRef + "' was incomplete or malformed; scan not reported");
+			else if (IsConnectedToServer())
+				AddTaskToQueue(new TSendInfoTask(*parserObjPtr,serverRef),true);
+		}
+	}
+	
+	// This is the only callback for any nmap call, so we
+	// will always return true here
+	return true;
+}
+
+//---------------------------------------------------------------------
+// DestroyScanParsers
+//---------------------------------------------------------------------
+void DestroyScanParsers ()
+{
+	if (gModGlobalsPtr)
+	{
+		TLockedPthreadMutexObj		lock(gModGlobalsMutex);
+		
+		for (ScanParserMap_iter x = gModGlobalsPtr->scanParserMap.begin(); x != gModGlobalsPtr->scanParserMap.end(); x++)
+			delete(x->second);
+		gModGlobalsPtr->scanParserMap.clear();
+	}
+}
@@ -41,10 +41,31 @@ string LocateNmap ();
 	// application and, if it is found, returns a full path to it.
 	// If not found then an empty string is returned.
 
+void SplitNmapArgs (const string& args, StdStringList& argList);
+	// Splits the server-supplied nmap argument string into argList the
+	// way a shell would split words: runs of whitespace separate
+	// arguments, single and double quotes group text containing
+	// whitespace and a backslash escapes the next character.  No other
+	// shell processing (variables, globbing, redirection) is done, since
+	// nmap is launched directly.  An unterminated quote runs to the end
+	// of the string.
+
 bool HandleNmapOutput (const std::string& returnedData,
 					   AppExecRef taskRef,
 					   void* userData);
 	// Callback function that handle's nmap output
 
+bool HandleNmapStreamOutput (const std::string& returnedData,
+							 AppExecRef taskRef,
+							 void* userData);
+	// Callback function that handles nmap output, block by block, for
+	// scans reported in delta mode.  The output is parsed as it arrives
+	// and, once nmap finishes, the parsed scan is queued for reporting.
+	// The scan's parser is destroyed when the final, empty block arrives
+	// or as soon as parsing throws, whichever comes first.
+
+void DestroyScanParsers ();
+	// Destroys the parsers of any scans that did not finish.
+
 //---------------------------------------------------------------------
 #endif // PLUGIN_MAIN
@@ -26,6 +26,8 @@
 
 #include "plugin-utils.h"
 
+#include <algorithm>
+
 //---------------------------------------------------------------------
 // Namespace stuff
 //---------------------------------------------------------------------
@@ -35,6 +37,34 @@ using namespace std;
 // Module Definitions
 //---------------------------------------------------------------------
 
+//---------------------------------------------------------------------
+// _IsSamePort (static)
+//---------------------------------------------------------------------
+static bool _IsSamePort (const NmapPortMap::value_type& port1, const NmapPortMap::value_type& port2)
+{
+	return (port1.first == port2.first &&
+			port1.second.state == port2.second.state &&
+			port1.second.service == port2.second.service);
+}
+
+//---------------------------------------------------------------------
+// _AppendPortNode (static)
+//---------------------------------------------------------------------
+static void _AppendPortNode (TMessageNode& hostNode, const NmapPortMap::value_type& port, const string& change)
+{
+	TMessageNode		portNode(hostNode.Append("PORT","",""));
+	string::size_type	slashPos = port.first.find('/');
+	
+	portNode.AddAttribute("protocol",port.first.substr(0,slashPos));
+	portNode.AddAttribute("portid",port.first.substr(slashPos+1));
+	portNode.AddAttribute("change",change);
+	if (change != "removed")
+	{
+		portNode.AddAttribute("state",port.second.state);
+		portNode.AddAttribute("service",port.second.service);
+	}
+}
+
 //*********************************************************************
 // Class TSendInfoTask
 //*********************************************************************
@@ -45,7 +75,22 @@ using namespace std;
 TSendInfoTask::TSendInfoTask (const string& nmapData, const string& serverRef)
 	:	Inherited(PROJECT_SHORT_NAME,0,false),
 		fData(nmapData),
-		fServerRef(serverRef)
+		fServerRef(serverRef),
+		fHasScanState(false),
+		fDeltaOnly(false)
+{
+}
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TSendInfoTask::TSendInfoTask (const TNmapScanParser& scanParser, const string& serverRef)
+	:	Inherited(PROJECT_SHORT_NAME,0,false),
+		fData(scanParser.RawOutput()),
+		fServerRef(serverRef),
+		fHasScanState(true),
+		fDeltaOnly(!scanParser.KeepsRawOutput()),
+		fHostMap(scanParser.HostMap())
 {
 }
 
@@ -65,15 +110,24 @@ void TSendInfoTask::RunTask ()
 	{
 		TServerMessage		messageObj;
 		TServerReply		replyObj;
+		bool				wasReported = false;
 		
 		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
 			WriteToMessagesLog("Starting nmap data transmission task");
 		
 		// Create the outbound message
-		_CreateMessage(messageObj);
+		if (fDeltaOnly)
+			_CreateDeltaMessage(messageObj);
+		else
+			_CreateMessage(messageObj);
 		
 		// Send it to the server
-		SendToServer(messageObj,replyObj);
+		wasReported = (SendToServer(messageObj,replyObj) == kResponseCodeOK);
+		
+		// Remember what the server now knows so the next scan can be
+		// compared against it
+		if (fHasScanState)
+			SetReportedNmapState(fServerRef,fHostMap,wasReported);
 		
 		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
 			WriteToMessagesLog("Ending nmap data transmission task");
@@ -110,3 +164,107 @@ void TSendInfoTask::_CreateMessage (TServerMessage& parentMessage)
 	nmapNode = parentMessage.Append("NMAP_OUTPUT","ref",fServerRef);
 	nmapNode.SetData(fData);
 }
+
+//---------------------------------------------------------------------
+// TSendInfoTask::_CreateDeltaMessage (protected)
+//---------------------------------------------------------------------
+void TSendInfoTask::_CreateDeltaMessage (TServerMessage& parentMessage)
+{
+	TMessageNode			nmapNode(parentMessage.Append("NMAP_OUTPUT","ref",fServerRef));
+	NmapHostMap				oldHostMap;
+	NmapPortMap				emptyPortMap;
+	unsigned long			hostCount = 0;
+	NmapHostMap_const_iter	aHost = fHostMap.begin();
+	NmapHostMap_const_iter	oldHost;
+	
+	GetReportedNmapState(fServerRef,oldHostMap);
+	oldHost = oldHostMap.begin();
+	
+	nmapNode.AddAttribute("mode","delta");
+	
+	// Both maps are sorted by address, so walk them together
+	while (aHost != fHostMap.end() || oldHost != oldHostMap.end())
+	{
+		if (oldHost == oldHostMap.end() ||
+			(aHost != fHostMap.end() && aHost->first < oldHost->first))
+		{
+			// New host
+			TMessageNode	hostNode(nmapNode.Append("HOST","addr",aHost->first));
+			
+			hostNode.AddAttribute("change","added");
+			hostNode.AddAttribute("status",aHost->second.status);
+			hostNode.AddAttribute("name",aHost->second.hostName);
+			_AppendPorts(hostNode,aHost->second.portMap,emptyPortMap);
+			++hostCount;
+			++aHost;
+		}
+		else if (aHost == fHostMap.end() || oldHost->first < aHost->first)
+		{
+			// Host is no longer there
+			TMessageNode	hostNode(nmapNode.Append("HOST","addr",oldHost->first));
+			
+			hostNode.AddAttribute("change","removed");
+			++hostCount;
+			++oldHost;
+		}
+		else
+		{
+			// Host was reported before; include it only if it changed
+			if (aHost->second.status != oldHost->second.status ||
+				aHost->second.hostName != oldHost->second.hostName ||
+				aHost->second.portMap.size() != oldHost->second.portMap.size() ||
+				!equal(aHost->second.portMap.begin(),aHost->second.portMap.end(),oldHost->second.portMap.begin(),_IsSamePort))
+			{
+				TMessageNode	hostNode(nmapNode.Append("HOST","addr",aHost->first));
+				
+				hostNode.AddAttribute("change","changed");
+				hostNode.AddAttribute("status",aHost->second.status);
+				hostNode.AddAttribute("name",aHost->second.hostName);
+				_AppendPorts(hostNode,aHost->second.portMap,oldHost->second.portMap);
+				++hostCount;
+			}
+			++aHost;
+			++oldHost;
+		}
+	}
+	
+	nmapNode.AddAttribute("count",NumToString(hostCount));
+	nmapNode.AddAttribute("total",NumToString(fHostMap.size()));
+}
+
+//---------------------------------------------------------------------
+// TSendInfoTask::_AppendPorts (protected)
+//---------------------------------------------------------------------
+void TSendInfoTask::_AppendPorts (TMessageNode& hostNode,
+								  const NmapPortMap& portMap,
+								  const NmapPortMap& oldPortMap)
+{
+	NmapPortMap_const_iter	aPort = portMap.begin();
+	NmapPortMap_const_iter	oldPort = oldPortMap.begin();
+	
+	// Both maps are sorted by protocol and port, so walk them together
+	while (aPort != portMap.end() || oldPort != oldPortMap.end())
+	{
+		if (oldPort == oldPortMap.end() ||
+			(aPort != portMap.end() && aPort->first < oldPort->first))
+		{
+			// Newly found port
+			_AppendPortNode(hostNode,*aPort,"added");
+			++aPort;
+		}
+		else if (aPort == portMap.end() || oldPort->first < aPort->first)
+		{
+			// Port is no longer reported
+			_AppendPortNode(hostNode,*oldPort,"removed");
+			++oldPort;
+		}
+		else
+		{
+			// Port state or service has changed
+			if (!_IsSamePort(*aPort,*oldPort))
+				_AppendPortNode(hostNode,*aPort,"changed");
+			++aPort;
+			++oldPort;
+		}
+	}
+}
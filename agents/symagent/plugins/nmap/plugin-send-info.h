@@ -28,6 +28,7 @@
 #include "plugin-config.h"
 
 #include "plugin-defs.h"
+#include "scan-state.h"
 
 //---------------------------------------------------------------------
 // Import namespace symbols
@@ -59,6 +60,11 @@ class TSendInfoTask : public TTaskBase
 		TSendInfoTask (const string& nmapData, const string& serverRef);
 			// Constructor
 	
+		TSendInfoTask (const TNmapScanParser& scanParser, const string& serverRef);
+			// Constructor for a scan parsed in delta mode.  If the parser
+			// kept nmap's raw output then that is sent as-is, otherwise
+			// only the differences from the last reported scan are sent.
+	
 	private:
 		
 		TSendInfoTask (const TSendInfoTask& obj) {}
@@ -77,10 +83,23 @@ class TSendInfoTask : public TTaskBase
 		virtual void _CreateMessage (TServerMessage& parentMessage);
 			// Populates the argument with the nmap information.
 	
+		virtual void _CreateDeltaMessage (TServerMessage& parentMessage);
+			// Populates the argument with the hosts, ports and services
+			// that have changed since the last reported scan.
+		
+		virtual void _AppendPorts (TMessageNode& hostNode,
+								   const NmapPortMap& portMap,
+								   const NmapPortMap& oldPortMap);
+			// Appends a node to hostNode for every entry that differs
+			// between portMap and oldPortMap.
+	
 	protected:
 		
 		string									fData;
 		string									fServerRef;
+		bool									fHasScanState;
+		bool									fDeltaOnly;
+		NmapHostMap								fHostMap;
 };
 
 #endif // SNIFF_TASK
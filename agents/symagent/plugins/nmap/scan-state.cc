@@ -0,0 +1,264 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Incremental parsing of nmap XML output and the state of the
+#		scans already reported to the server
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					14 Mar 2005
+#		Last Modified:				14 Mar 2005
+#		
+#######################################################################
+*/
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "scan-state.h"
+
+#include "plugin-utils.h"
+
+//---------------------------------------------------------------------
+// Namespace stuff
+//---------------------------------------------------------------------
+using namespace std;
+
+//---------------------------------------------------------------------
+// Module Definitions
+//---------------------------------------------------------------------
+struct	ReportedScan
+	{
+		NmapHostMap					hostMap;
+		unsigned long				scanCount;
+		bool						haveReported;
+		ReportedScan () : scanCount(0),haveReported(false) {}
+	};
+	
+typedef	map<string,ReportedScan>						ReportedScanMap;
+typedef	ReportedScanMap::iterator						ReportedScanMap_iter;
+typedef	ReportedScanMap::const_iterator					ReportedScanMap_const_iter;
+
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static	ReportedScanMap									gReportedScanMap;
+static	TPthreadMutexObj								gReportedScanMapMutex;
+
+//*********************************************************************
+// Class TNmapScanParser
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TNmapScanParser::TNmapScanParser (bool keepRawOutput)
+	:	fParserRef(NULL),
+		fKeepRawOutput(keepRawOutput),
+		fParseFailed(false),
+		fSawFinished(false)
+{
+	StdStringList	watchTagList;
+	
+	// Hosts are reported one at a time; the run statistics at the very
+	// end tell us that nmap completed its scan
+	watchTagList.push_back("host");
+	watchTagList.push_back("finished");
+	
+	fParserRef = CreateXMLStreamParser(watchTagList,_HandleElement,this);
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TNmapScanParser::~TNmapScanParser ()
+{
+	if (fParserRef)
+		DestroyXMLStreamParser(fParserRef);
+}
+
+//---------------------------------------------------------------------
+// TNmapScanParser::Parse
+//---------------------------------------------------------------------
+void TNmapScanParser::Parse (const string& data)
+{
+	if (fKeepRawOutput)
+		fRawOutput += data;
+		
+	if (fParserRef && !fParseFailed)
+	{
+		if (!ParseXMLStreamData(fParserRef,data,false))
+			fParseFailed = true;
+	}
+}
+
+//---------------------------------------------------------------------
+// TNmapScanParser::Finish
+//---------------------------------------------------------------------
+bool TNmapScanParser::Finish ()
+{
+	if (fParserRef && !fParseFailed)
+	{
+		if (!ParseXMLStreamData(fParserRef,"",true))
+			fParseFailed = true;
+	}
+	
+	return (fParserRef && !fParseFailed && fSawFinished);
+}
+
+//---------------------------------------------------------------------
+// TNmapScanParser::_HandleElement (static protected)
+//---------------------------------------------------------------------
+void TNmapScanParser::_HandleElement (const TMessageNode& elementNode, void* userData)
+{
+	TNmapScanParser*	parserObjPtr = reinterpret_cast<TNmapScanParser*>(userData);
+	
+	if (elementNode.GetTag() == "host")
+		parserObjPtr->_AddHost(elementNode);
+	else if (elementNode.GetTag() == "finished")
+		parserObjPtr->fSawFinished = true;
+}
+
+//---------------------------------------------------------------------
+// TNmapScanParser::_AddHost (protected)
+//---------------------------------------------------------------------
+void TNmapScanParser::_AddHost (const TMessageNode& hostNode)
+{
+	string			address;
+	string			macAddress;
+	NmapHostState	hostState;
+	
+	for (unsigned long x = 0; x < hostNode.SubnodeCount(); x++)
+	{
+		const TMessageNode	subnode(hostNode.GetNthSubnode(x));
+		const string		tag(subnode.GetTag());
+		
+		if (tag == "status")
+		{
+			hostState.status = subnode.GetAttributeValue("state");
+		}
+		else if (tag == "address")
+		{
+			if (subnode.GetAttributeValue("addrtype") == "mac")
+				macAddress = subnode.GetAttributeValue("addr");
+			else if (address.empty())
+				address = subnode.GetAttributeValue("addr");
+		}
+		else if (tag == "hostnames")
+		{
+			if (subnode.SubnodeCount() > 0)
+				hostState.hostName = subnode.GetNthSubnode(0).GetAttributeValue("name");
+		}
+		else if (tag == "ports")
+		{
+			for (unsigned long y = 0; y < subnode.SubnodeCount(); y++)
+			{
+				const TMessageNode	portNode(subnode.GetNthSubnode(y));
+				
+				if (portNode.GetTag() == "port")
+				{
+					NmapPortState	portState;
+					string			portKey(portNode.GetAttributeValue("protocol") + "/" + portNode.GetAttributeValue("portid"));
+					
+					for (unsigned long z = 0; z < portNode.SubnodeCount(); z++)
+					{
+						const TMessageNode	portInfoNode(portNode.GetNthSubnode(z));
+						
+						if (portInfoNode.GetTag() == "state")
+						{
+							portState.state = portInfoNode.GetAttributeValue("state");
+						}
+						else if (portInfoNode.GetTag() == "service")
+						{
+							const char*		kServiceAttributes[] = {"name","product","version","extrainfo",NULL};
+							
+							// Fold the service identification into one string
+							for (unsigned long n = 0; kServiceAttributes[n]; n++)
+							{
+								string	value(portInfoNode.GetAttributeValue(kServiceAttributes[n]));
+								
+								if (!value.empty())
+								{
+									if (!portState.service.empty())
+										portState.service += " ";
+									portState.service += value;
+								}
+							}
+						}
+					}
+					
+					hostState.portMap[portKey] = portState;
+				}
+			}
+		}
+	}
+	
+	// Hosts seen only at the link layer are known by their MAC address
+	if (address.empty())
+		address = macAddress;
+		
+	if (!address.empty())
+		fHostMap[address] = hostState;
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// IsFullNmapReportDue
+//---------------------------------------------------------------------
+bool IsFullNmapReportDue (const string& serverRef)
+{
+	TLockedPthreadMutexObj		lock(gReportedScanMapMutex);
+	ReportedScanMap_const_iter	foundIter = gReportedScanMap.find(serverRef);
+	
+	if (foundIter == gReportedScanMap.end())
+		return true;
+		
+	return (!foundIter->second.haveReported || (foundIter->second.scanCount % kFullReportScanInterval) == 0);
+}
+
+//---------------------------------------------------------------------
+// GetReportedNmapState
+//---------------------------------------------------------------------
+void GetReportedNmapState (const string& serverRef, NmapHostMap& hostMap)
+{
+	TLockedPthreadMutexObj		lock(gReportedScanMapMutex);
+	ReportedScanMap_const_iter	foundIter = gReportedScanMap.find(serverRef);
+	
+	hostMap.clear();
+	
+	if (foundIter != gReportedScanMap.end())
+		hostMap = foundIter->second.hostMap;
+}
+
+//---------------------------------------------------------------------
+// SetReportedNmapState
+//---------------------------------------------------------------------
+void SetReportedNmapState (const string& serverRef, const NmapHostMap& hostMap, bool wasReported)
+{
+	TLockedPthreadMutexObj		lock(gReportedScanMapMutex);
+	ReportedScan&				reportedScan = gReportedScanMap[serverRef];
+	
+	if (wasReported)
+	{
+		reportedScan.hostMap = hostMap;
+		reportedScan.haveReported = true;
+		++reportedScan.scanCount;
+	}
+	else
+	{
+		reportedScan.hostMap.clear();
+		reportedScan.haveReported = false;
+		reportedScan.scanCount = 0;
+	}
+}
@@ -0,0 +1,145 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Incremental parsing of nmap XML output and the state of the
+#		scans already reported to the server
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					14 Mar 2005
+#		Last Modified:				14 Mar 2005
+#		
+#######################################################################
+*/
+
+#if !defined(SCAN_STATE)
+#define SCAN_STATE
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "plugin-config.h"
+
+#include "plugin-defs.h"
+
+//---------------------------------------------------------------------
+// Forward Class Declarations
+//---------------------------------------------------------------------
+class TNmapScanParser;
+
+//---------------------------------------------------------------------
+// Definitions
+//---------------------------------------------------------------------
+#define	kFullReportScanInterval							10		// in delta mode, every Nth report is complete
+
+struct	NmapPortState
+	{
+		string						state;
+		string						service;
+	};
+
+typedef	map<string,NmapPortState>						NmapPortMap;		// key = "protocol/portid"
+typedef	NmapPortMap::iterator							NmapPortMap_iter;
+typedef	NmapPortMap::const_iterator						NmapPortMap_const_iter;
+
+struct	NmapHostState
+	{
+		string						status;
+		string						hostName;
+		NmapPortMap					portMap;
+	};
+
+typedef	map<string,NmapHostState>						NmapHostMap;		// key = address
+typedef	NmapHostMap::iterator							NmapHostMap_iter;
+typedef	NmapHostMap::const_iterator						NmapHostMap_const_iter;
+
+//---------------------------------------------------------------------
+// Class TNmapScanParser
+//
+// Parses the XML output of one nmap run as it arrives, keeping only
+// the state of each host found rather than the whole document.  The
+// raw output is retained as well only if it was asked for.
+//---------------------------------------------------------------------
+class TNmapScanParser
+{
+	public:
+		
+		TNmapScanParser (bool keepRawOutput);
+			// Constructor
+			
+	private:
+		
+		TNmapScanParser (const TNmapScanParser& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		~TNmapScanParser ();
+			// Destructor
+			
+		void Parse (const string& data);
+			// Parses the next block of nmap output.
+			
+		bool Finish ();
+			// Tells the parser there is no more output.  Returns true if
+			// the output was a well-formed and complete nmap report.
+			
+		// ------------------------------
+		// Accessors
+		// ------------------------------
+		
+		inline const NmapHostMap& HostMap () const
+			{ return fHostMap; }
+			
+		inline const string& RawOutput () const
+			{ return fRawOutput; }
+			
+		inline bool KeepsRawOutput () const
+			{ return fKeepRawOutput; }
+			
+	protected:
+		
+		static void _HandleElement (const TMessageNode& elementNode, void* userData);
+			// Callback for the streaming XML parser.
+			
+		void _AddHost (const TMessageNode& hostNode);
+			// Records the state of the host described by hostNode.
+			
+	protected:
+		
+		XMLStreamRef									fParserRef;
+		NmapHostMap										fHostMap;
+		string											fRawOutput;
+		bool											fKeepRawOutput;
+		bool											fParseFailed;
+		bool											fSawFinished;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+bool IsFullNmapReportDue (const string& serverRef);
+	// Returns true if the next report for serverRef must be complete
+	// rather than a list of changes; that is the case for the first
+	// report, the first one after a failed send and every
+	// kFullReportScanInterval'th one after that.
+
+void GetReportedNmapState (const string& serverRef, NmapHostMap& hostMap);
+	// Destructively modifies hostMap to contain the host state last
+	// reported to the server for serverRef.
+
+void SetReportedNmapState (const string& serverRef, const NmapHostMap& hostMap, bool wasReported);
+	// Records the outcome of a report for serverRef.  If wasReported is
+	// true hostMap becomes the state that future reports are compared
+	// against; otherwise the next report will be complete.
+
+//---------------------------------------------------------------------
+#endif // SCAN_STATE
@@ -25,6 +25,7 @@
 //---------------------------------------------------------------------
 // Includes
 //---------------------------------------------------------------------
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -56,20 +57,97 @@ typedef	map<pair<int,string>,string>					ServiceMap;
 typedef	ServiceMap::iterator							ServiceMap_iter;
 typedef	ServiceMap::const_iterator						ServiceMap_const_iter;
 
+// Binary IP address in network byte order; IPv4 addresses occupy the
+// first four bytes.  Converted to text only when a report is built.
+struct	NetworkAddress
+	{
+		unsigned char		bytes[16];
+	};
+	
 struct	NetworkConnection
 	{
 		int					protoFamily;	// matches key within ProtoFamilyMap
 		int					protoID;		// matches key within ProtocolMap
-		string				sourceAddr;
+		NetworkAddress		sourceAddr;
 		long				sourcePort;
-		string				destAddr;
+		NetworkAddress		destAddr;
 		long				destPort;
 	};
 
 // Lookup between an Inode (next) and a network connection
-typedef	map<long,NetworkConnection>						NetworkConnectionMap;
-typedef	NetworkConnectionMap::iterator					NetworkConnectionMap_iter;
-typedef	NetworkConnectionMap::const_iterator			NetworkConnectionMap_const_iter;
+typedef	pair<long,NetworkConnection>					NetworkConnectionEntry;
+typedef	vector<NetworkConnectionEntry>					NetworkConnectionList;
+typedef	NetworkConnectionList::iterator					NetworkConnectionList_iter;
+typedef	NetworkConnectionList::const_iterator			NetworkConnectionList_const_iter;
+
+//---------------------------------------------------------------------
+// Class TNetworkConnectionTable
+//
+// Flat, inode-sorted table of network connections.  Collectors append
+// entries in whatever order they find them and call Sort() when done;
+// lookups are then binary searches over contiguous memory, which is far
+// cheaper than a node-based map when there are many thousands of sockets.
+//---------------------------------------------------------------------
+class TNetworkConnectionTable
+{
+	public:
+		
+		TNetworkConnectionTable () {}
+			// Constructor
+		
+		~TNetworkConnectionTable () {}
+			// Destructor
+		
+		inline void clear ()
+			{ fEntryList.clear(); }
+		
+		inline void reserve (unsigned long count)
+			{ fEntryList.reserve(count); }
+		
+		inline unsigned long size () const
+			{ return fEntryList.size(); }
+		
+		inline void Add (long inode, const NetworkConnection& connectInfo)
+			{ fEntryList.push_back(NetworkConnectionEntry(inode,connectInfo)); }
+			// Appends an entry.  The table must be sorted before Find() is used.
+		
+		void Sort ()
+			{
+				// Stable so that, among duplicate inodes, the first one added wins
+				std::stable_sort(fEntryList.begin(),fEntryList.end(),_LessInode);
+				fEntryList.erase(std::unique(fEntryList.begin(),fEntryList.end(),_SameInode),fEntryList.end());
+			}
+			// Sorts the entries by inode and removes duplicates.
+		
+		const NetworkConnection* Find (long inode) const
+			{
+				NetworkConnectionList_const_iter	foundIter = std::lower_bound(fEntryList.begin(),fEntryList.end(),NetworkConnectionEntry(inode,NetworkConnection()),_LessInode);
+				
+				if (foundIter != fEntryList.end() && foundIter->first == inode)
+					return &foundIter->second;
+				
+				return NULL;
+			}
+			// Returns a pointer to the connection with the given inode, or
+			// NULL if there is none.
+		
+		inline bool Contains (long inode) const
+			{ return Find(inode) != NULL; }
+	
+	protected:
+		
+		static bool _LessInode (const NetworkConnectionEntry& entry1, const NetworkConnectionEntry& entry2)
+			{ return entry1.first < entry2.first; }
+		
+		static bool _SameInode (const NetworkConnectionEntry& entry1, const NetworkConnectionEntry& entry2)
+			{ return entry1.first == entry2.first; }
+	
+	protected:
+		
+		NetworkConnectionList						fEntryList;
+};
+
+typedef	TNetworkConnectionTable							NetworkConnectionMap;
 
 // List of open files/network conneciton IDs.  Can be anything, really.  The numbers
 // here are used to lookup information within NetworkConnectionMap.
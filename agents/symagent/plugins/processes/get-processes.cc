@@ -26,18 +26,6 @@
 
 #include "plugin-utils.h"
 
-#if defined(USE_PROC_FS) && USE_PROC_FS
-	#include "linux-proc.h"
-#else
-	#if defined(USE_KVM_PROC) && USE_KVM_PROC
-		#include "kvm-proc.h"
-	#else
-		#if defined(USE_WINDOWS) && USE_WINDOWS
-			#include "windows-proc.h"
-		#endif
-	#endif
-#endif
-
 #include <sys/types.h>
 
 #if HAVE_DIRENT_H
@@ -70,12 +58,16 @@
 //---------------------------------------------------------------------
 #define	kXMLTagProcessList							"PROCESS_LIST"
 #define	kXMLTagProcess								"PROCESS"
+#define	kXMLTagProcessExit							"PROCESS_EXIT"
 #define	kXMLTagConnectionList						"CONNECTION_LIST"
 #define	kXMLTagConnection							"CONNECTION"
 #define	kXMLTagConnectionSource						"SRC"
 #define	kXMLTagConnectionDestination				"DST"
 
 #define	kXMLAttributeCount							"count"
+#define	kXMLAttributeTotal							"total"
+#define	kXMLAttributeMode							"mode"
+#define	kXMLAttributeValueDelta						"delta"
 #define	kXMLAttributeConnectionCount				"connections"
 #define	kXMLAttributeProcID							"proc_id"
 #define	kXMLAttributeProcPath						"path"
@@ -97,9 +89,24 @@ static const unsigned long							kReadWriteBlockSize = 4096;
 //---------------------------------------------------------------------
 // Constructor
 //---------------------------------------------------------------------
-TCollectProcessInfo::TCollectProcessInfo (time_t intervalInSeconds, bool rerun)
-	:	Inherited(PROJECT_SHORT_NAME,intervalInSeconds,rerun)
+TCollectProcessInfo::TCollectProcessInfo (time_t intervalInSeconds,
+										  bool rerun,
+										  bool deltaReports,
+										  bool useProcEvents)
+	:	Inherited(PROJECT_SHORT_NAME,intervalInSeconds,rerun),
+		fDeltaReports(deltaReports),
+		fHaveReported(false),
+		fPassCount(0)
 {
+	if (useProcEvents)
+	{
+		#if defined(USE_PROC_FS) && USE_PROC_FS
+			if (!fCollectorObj.EnableProcessEvents())
+				WriteToErrorLog("Process events unavailable; polling /proc instead");
+		#else
+			WriteToErrorLog("Process events are not supported on this platform; polling instead");
+		#endif
+	}
 }
 
 //---------------------------------------------------------------------
@@ -116,19 +123,37 @@ void TCollectProcessInfo::RunTask ()
 {
 	TServerMessage		messageObj;
 	TServerReply		replyObj;
+	bool				deltaOnly = false;
+	bool				wasReported = false;
 	
 	// Call the main method for gathering the info
 	Main();
 	
+	// In delta mode, the first report, the first one after a failed send and
+	// every kFullReportPassInterval'th one are still complete so the server
+	// can resynchronize
+	deltaOnly = (fDeltaReports && fHaveReported && (fPassCount % kFullReportPassInterval) != 0);
+	++fPassCount;
+	
 	// Create the XML message for the server
-	_CreateXMLMessage(messageObj);
+	_CreateXMLMessage(messageObj,deltaOnly);
 	
 	#if kDebugWithoutServer
 		std::cout << messageObj.AsString() << std::endl;
+		wasReported = true;
 	#else
 		// Send it to the server
-		SendToServer(messageObj,replyObj);
+		wasReported = (SendToServer(messageObj,replyObj) == kResponseCodeOK);
 	#endif
+	
+	if (fDeltaReports)
+	{
+		// Remember what the server now knows; fProcessInfoMap is rebuilt
+		// from scratch on the next pass anyway
+		fHaveReported = wasReported;
+		if (wasReported)
+			fReportedProcessInfoMap.swap(fProcessInfoMap);
+	}
 }
 
 //---------------------------------------------------------------------
@@ -136,8 +161,6 @@ void TCollectProcessInfo::RunTask ()
 //---------------------------------------------------------------------
 void TCollectProcessInfo::Main ()
 {
-	TInfoCollector		collectorObj;
-	
 	if (fProtocolMap.empty())
 		_InitProtocolList();
 	
@@ -147,7 +170,9 @@ void TCollectProcessInfo::Main ()
 	if (fServiceMap.empty())
 		_InitServiceList();
 	
-	collectorObj.Collect(fProcessInfoMap,fNetworkConnectionMap);
+	// The collector object lives as long as we do so it can cache
+	// information between passes
+	fCollectorObj.Collect(fProcessInfoMap,fNetworkConnectionMap);
 }
 
 //---------------------------------------------------------------------
@@ -207,44 +232,176 @@ void TCollectProcessInfo::_InitServiceList ()
 //---------------------------------------------------------------------
 // TCollectProcessInfo::_CreateXMLMessage (protected)
 //---------------------------------------------------------------------
-void TCollectProcessInfo::_CreateXMLMessage (TServerMessage& parentMessage)
+void TCollectProcessInfo::_CreateXMLMessage (TServerMessage& parentMessage, bool deltaOnly)
 {
-	TMessageNode		processListNode = parentMessage.Append(kXMLTagProcessList,kXMLAttributeCount,NumToString(fProcessInfoMap.size()));
+	if (!deltaOnly)
+	{
+		TMessageNode		processListNode = parentMessage.Append(kXMLTagProcessList,kXMLAttributeCount,NumToString(fProcessInfoMap.size()));
+		
+		for (ProcessInfoMap_const_iter aProcess = fProcessInfoMap.begin(); aProcess != fProcessInfoMap.end(); aProcess++)
+			_AppendProcessNode(processListNode,aProcess->first,aProcess->second);
+	}
+	else
+	{
+		TMessageNode				processListNode = parentMessage.Append(kXMLTagProcessList,kXMLAttributeMode,kXMLAttributeValueDelta);
+		unsigned long				processCount = 0;
+		ProcessInfoMap_const_iter	aProcess = fProcessInfoMap.begin();
+		ProcessInfoMap_const_iter	oldProcess = fReportedProcessInfoMap.begin();
+		
+		// Both maps are sorted by process ID, so walk them together
+		while (aProcess != fProcessInfoMap.end() || oldProcess != fReportedProcessInfoMap.end())
+		{
+			if (oldProcess == fReportedProcessInfoMap.end() ||
+				(aProcess != fProcessInfoMap.end() && aProcess->first < oldProcess->first))
+			{
+				// New process
+				_AppendProcessNode(processListNode,aProcess->first,aProcess->second);
+				++processCount;
+				++aProcess;
+			}
+			else if (aProcess == fProcessInfoMap.end() || oldProcess->first < aProcess->first)
+			{
+				// Process has exited
+				processListNode.Append(kXMLTagProcessExit,kXMLAttributeProcID,NumToString(oldProcess->first));
+				++oldProcess;
+			}
+			else
+			{
+				// Process was reported before; include it only if it changed
+				if (!_IsSameProcessInfo(aProcess->second,oldProcess->second))
+				{
+					_AppendProcessNode(processListNode,aProcess->first,aProcess->second);
+					++processCount;
+				}
+				++aProcess;
+				++oldProcess;
+			}
+		}
+		
+		processListNode.AddAttribute(kXMLAttributeCount,NumToString(processCount));
+		processListNode.AddAttribute(kXMLAttributeTotal,NumToString(fProcessInfoMap.size()));
+	}
+}
+
+//---------------------------------------------------------------------
+// TCollectProcessInfo::_AppendProcessNode (protected)
+//---------------------------------------------------------------------
+void TCollectProcessInfo::_AppendProcessNode (TMessageNode& processListNode,
+											  pid_t procID,
+											  const ProcessInfo& procInfo)
+{
+	TMessageNode	processNode(processListNode.Append(kXMLTagProcess,"",""));
+	unsigned long	netConnectCount = procInfo.inodeList.size();
+	
+	processNode.AddAttribute(kXMLAttributeProcID,NumToString(procID));
+	processNode.AddAttribute(kXMLAttributeProcPath,procInfo.path);
+	processNode.AddAttribute(kXMLAttributeProcSignature,procInfo.appSig);
+	processNode.AddAttribute(kXMLAttributeProcOwnerID,NumToString(procInfo.ownerID));
+//	processNode.AddAttribute(kXMLAttributeProcGroupID,NumToString(procInfo.groupID));
+	processNode.AddAttribute(kXMLAttributeConnectionCount,NumToString(netConnectCount));
 	
-	for (ProcessInfoMap_const_iter aProcess = fProcessInfoMap.begin(); aProcess != fProcessInfoMap.end(); aProcess++)
+	for (InodeList_const_iter aInode = procInfo.inodeList.begin(); aInode != procInfo.inodeList.end(); aInode++)
 	{
-		TMessageNode	processNode(processListNode.Append(kXMLTagProcess,"",""));
-		unsigned long	netConnectCount = aProcess->second.inodeList.size();
+		const NetworkConnection*	connectInfoPtr = fNetworkConnectionMap.Find(*aInode);
+		
+		if (!connectInfoPtr)
+			continue;
+		
+		const NetworkConnection&	connectInfo(*connectInfoPtr);
+		TMessageNode				netConnectNode(processNode.Append(kXMLTagConnection,"",""));
+		TMessageNode				sourceNode(netConnectNode.Append(kXMLTagConnectionSource,"",""));
+		TMessageNode				destNode(netConnectNode.Append(kXMLTagConnectionDestination,"",""));
+		string						serviceName;
+		
+		netConnectNode.AddAttribute(kXMLAttributeConnectionProtocol,fProtocolMap[connectInfo.protoID]);
+		netConnectNode.AddAttribute(kXMLAttributeConnectionProtocolFamily,fProtoFamilyMap[connectInfo.protoFamily]);
+		
+		sourceNode.AddAttribute(kXMLAttributeIPAddress,_AddressAsString(connectInfo.protoFamily,connectInfo.sourceAddr));
+		sourceNode.AddAttribute(kXMLAttributePort,NumToString(connectInfo.sourcePort));
 		
-		processNode.AddAttribute(kXMLAttributeProcID,NumToString(aProcess->first));
-		processNode.AddAttribute(kXMLAttributeProcPath,aProcess->second.path);
-		processNode.AddAttribute(kXMLAttributeProcSignature,aProcess->second.appSig);
-		processNode.AddAttribute(kXMLAttributeProcOwnerID,NumToString(aProcess->second.ownerID));
-	//	processNode.AddAttribute(kXMLAttributeProcGroupID,NumToString(aProcess->second.groupID));
-		processNode.AddAttribute(kXMLAttributeConnectionCount,NumToString(netConnectCount));
+		destNode.AddAttribute(kXMLAttributeIPAddress,_AddressAsString(connectInfo.protoFamily,connectInfo.destAddr));
+		destNode.AddAttribute(kXMLAttributePort,NumToString(connectInfo.destPort));
 		
-		for (InodeList_const_iter aInode = aProcess->second.inodeList.begin(); aInode != aProcess->second.inodeList.end(); aInode++)
+		serviceName = _LookupServiceName(fProtocolMap[connectInfo.protoID],connectInfo.sourcePort,connectInfo.destPort);
+		
+		netConnectNode.AddAttribute(kXMLAttributeService,serviceName);
+	}
+}
+
+//---------------------------------------------------------------------
+// TCollectProcessInfo::_IsSameProcessInfo (static protected)
+//---------------------------------------------------------------------
+bool TCollectProcessInfo::_IsSameProcessInfo (const ProcessInfo& info1, const ProcessInfo& info2)
+{
+	// Inode lists are kept sorted, so a straight comparison works
+	return (info1.ownerID == info2.ownerID &&
+			info1.groupID == info2.groupID &&
+			info1.path == info2.path &&
+			info1.appSig == info2.appSig &&
+			info1.inodeList == info2.inodeList);
+}
+
+//---------------------------------------------------------------------
+// TCollectProcessInfo::_AddressAsString (static protected)
+//---------------------------------------------------------------------
+string TCollectProcessInfo::_AddressAsString (int protoFamily, const NetworkAddress& address)
+{
+	string		addrStr;
+	int			niFlags = NI_NUMERICHOST;
+	
+	#ifdef NI_WITHSCOPEID
+		niFlags |= NI_WITHSCOPEID;
+	#endif
+	
+	addrStr.resize(NI_MAXHOST);
+	
+	if (protoFamily == AF_INET)
+	{
+		struct sockaddr_in		socketInfo;
+		
+		memset(&socketInfo,0,sizeof(socketInfo));
+		socketInfo.sin_family = AF_INET;
+		#if defined(HAVE_STRUCT_SOCKADDR_IN_SIN_LEN)
+			socketInfo.sin_len = sizeof(socketInfo);
+		#endif
+		memcpy(&socketInfo.sin_addr,address.bytes,sizeof(socketInfo.sin_addr));
+		
+		if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
+			addrStr.resize(strlen(addrStr.c_str()));
+		else
+			addrStr = "";
+	}
+	#if HAVE_DECL_AF_INET6
+		else if (protoFamily == AF_INET6)
 		{
-			NetworkConnection	connectInfo(fNetworkConnectionMap[*aInode]);
-			TMessageNode		netConnectNode(processNode.Append(kXMLTagConnection,"",""));
-			TMessageNode		sourceNode(netConnectNode.Append(kXMLTagConnectionSource,"",""));
-			TMessageNode		destNode(netConnectNode.Append(kXMLTagConnectionDestination,"",""));
-			string				serviceName;
-			
-			netConnectNode.AddAttribute(kXMLAttributeConnectionProtocol,fProtocolMap[connectInfo.protoID]);
-			netConnectNode.AddAttribute(kXMLAttributeConnectionProtocolFamily,fProtoFamilyMap[connectInfo.protoFamily]);
-			
-			sourceNode.AddAttribute(kXMLAttributeIPAddress,connectInfo.sourceAddr);
-			sourceNode.AddAttribute(kXMLAttributePort,NumToString(connectInfo.sourcePort));
+			struct sockaddr_in6		socketInfo;
 			
-			destNode.AddAttribute(kXMLAttributeIPAddress,connectInfo.destAddr);
-			destNode.AddAttribute(kXMLAttributePort,NumToString(connectInfo.destPort));
+			memset(&socketInfo,0,sizeof(socketInfo));
+			socketInfo.sin6_family = AF_INET6;
+			#if defined(HAVE_STRUCT_SOCKADDR_IN6_SIN6_LEN)
+				socketInfo.sin6_len = sizeof(socketInfo);
+			#endif
+			memcpy(&socketInfo.sin6_addr,address.bytes,sizeof(socketInfo.sin6_addr));
 			
-			serviceName = _LookupServiceName(fProtocolMap[connectInfo.protoID],connectInfo.sourcePort,connectInfo.destPort);
+			// KAME-derived stacks embed the scope ID of link-local addresses
+			if (IN6_IS_ADDR_LINKLOCAL(&socketInfo.sin6_addr) && *(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])) != 0)
+			{
+				socketInfo.sin6_scope_id = ntohs(*(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])));
+				socketInfo.sin6_addr.s6_addr[2] = socketInfo.sin6_addr.s6_addr[3] = 0;
+			}
 			
-			netConnectNode.AddAttribute(kXMLAttributeService,serviceName);
+			if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
+				addrStr.resize(strlen(addrStr.c_str()));
+			else
+				addrStr = "";
 		}
+	#endif
+	else
+	{
+		addrStr = "";
 	}
+	
+	return addrStr;
 }
 
 //---------------------------------------------------------------------
@@ -287,3 +444,14 @@ string TCollectProcessInfo::_LookupServiceName (const string& protocol, int srcP
 //		</PROCESS_LIST>
 // </AGENT>
 //*********************************************************************
+//
+// In delta mode, unchanged processes are omitted and exited processes
+// are listed by ID only:
+//
+// <AGENT agent_id="symagent-processes" instance="0" timestamp="1070462005777">
+//		<PROCESS_LIST count="1" mode="delta" total="58">
+//			<PROCESS connections="0" owner_id="0" path="/usr/bin/crond" proc_id="912" sig="n0WzGn3x8LRdkjPdxTVjXBxVGHo="></PROCESS>
+//			<PROCESS_EXIT proc_id="877"></PROCESS_EXIT>
+//		</PROCESS_LIST>
+// </AGENT>
+//*********************************************************************
@@ -30,6 +30,18 @@
 #include "plugin-defs.h"
 #include "common-info.h"
 
+#if defined(USE_PROC_FS) && USE_PROC_FS
+	#include "linux-proc.h"
+#else
+	#if defined(USE_KVM_PROC) && USE_KVM_PROC
+		#include "kvm-proc.h"
+	#else
+		#if defined(USE_WINDOWS) && USE_WINDOWS
+			#include "windows-proc.h"
+		#endif
+	#endif
+#endif
+
 //---------------------------------------------------------------------
 // Import namespace symbols
 //---------------------------------------------------------------------
@@ -45,6 +57,7 @@ class TCollectProcessInfo;
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kFullReportPassInterval						10	// in delta mode, every Nth report is complete
 
 //---------------------------------------------------------------------
 // Class TCollectProcessInfo
@@ -57,8 +70,15 @@ class TCollectProcessInfo : public TTaskBase
 	
 	public:
 		
-		TCollectProcessInfo (time_t intervalInSeconds, bool rerun);
-			// Constructor
+		TCollectProcessInfo (time_t intervalInSeconds,
+							 bool rerun,
+							 bool deltaReports = false,
+							 bool useProcEvents = false);
+			// Constructor.  If deltaReports is true then, after the first
+			// report, only processes that have started, changed or exited
+			// since the last report are sent to the server.  If useProcEvents
+			// is true, and the platform supports it, process starts and exits
+			// are tracked through kernel events rather than by polling.
 	
 	private:
 		
@@ -88,10 +108,23 @@ class TCollectProcessInfo : public TTaskBase
 		virtual void _InitServiceList ();
 			// Initialize the fServiceMap internal slot.
 		
-		virtual void _CreateXMLMessage (TServerMessage& parentMessage);
+		virtual void _CreateXMLMessage (TServerMessage& parentMessage, bool deltaOnly);
 			// Creates the outbound server message using the information found
 			// in the internal slots.  The message is inserted into the argument,
-			// modifying it.
+			// modifying it.  If deltaOnly is true then only the differences
+			// between fProcessInfoMap and fReportedProcessInfoMap are included.
+		
+		virtual void _AppendProcessNode (TMessageNode& processListNode,
+										 pid_t procID,
+										 const ProcessInfo& procInfo);
+			// Appends a PROCESS node, including its connections, to the
+			// argument.
+		
+		static bool _IsSameProcessInfo (const ProcessInfo& info1, const ProcessInfo& info2);
+			// Returns true if the two arguments describe the same state.
+		
+		static string _AddressAsString (int protoFamily, const NetworkAddress& address);
+			// Converts the binary address to a numeric string and returns it.
 		
 		virtual string _LookupServiceName (const string& protocol, int srcPort, int destPort);
 			// Given the source and destination ports of a communication,
@@ -105,6 +138,11 @@ class TCollectProcessInfo : public TTaskBase
 		ServiceMap									fServiceMap;
 		NetworkConnectionMap						fNetworkConnectionMap;
 		ProcessInfoMap								fProcessInfoMap;
+		ProcessInfoMap								fReportedProcessInfoMap;
+		TInfoCollector								fCollectorObj;
+		bool										fDeltaReports;
+		bool										fHaveReported;
+		unsigned long								fPassCount;
 };
 
 //---------------------------------------------------------------------
@@ -256,19 +256,19 @@ void TInfoCollector::Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap&
 											
 											if (ref != 0)
 											{
-												if (netConnMap.find(ref) == netConnMap.end())
-												{
-													NetworkConnection			connInfo;
-													
-													connInfo.protoID = protocolInfo.pr_protocol;
-													connInfo.protoFamily = domainInfo.dom_family;
-													connInfo.sourceAddr = _IPAddressAsString(inpcbInfo.inp_laddr);
-													connInfo.destAddr = _IPAddressAsString(inpcbInfo.inp_faddr);
-													connInfo.sourcePort = htons(inpcbInfo.inp_lport);
-													connInfo.destPort = htons(inpcbInfo.inp_fport);
-													
-													netConnMap[ref] = connInfo;
-												}
+												NetworkConnection			connInfo;
+												
+												memset(&connInfo,0,sizeof(connInfo));
+												
+												connInfo.protoID = protocolInfo.pr_protocol;
+												connInfo.protoFamily = domainInfo.dom_family;
+												memcpy(connInfo.sourceAddr.bytes,&inpcbInfo.inp_laddr,sizeof(inpcbInfo.inp_laddr));
+												memcpy(connInfo.destAddr.bytes,&inpcbInfo.inp_faddr,sizeof(inpcbInfo.inp_faddr));
+												connInfo.sourcePort = htons(inpcbInfo.inp_lport);
+												connInfo.destPort = htons(inpcbInfo.inp_fport);
+												
+												// Duplicates are weeded out when the table is sorted
+												netConnMap.Add(ref,connInfo);
 												
 												procInfo.inodeList.push_back(ref);
 											}
@@ -288,19 +288,19 @@ void TInfoCollector::Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap&
 												
 												if (ref != 0)
 												{
-													if (netConnMap.find(ref) == netConnMap.end())
-													{
-														NetworkConnection			connInfo;
-														
-														connInfo.protoID = protocolInfo.pr_protocol;
-														connInfo.protoFamily = domainInfo.dom_family;
-														connInfo.sourceAddr = _IPAddressAsString(inpcbInfo.in6p_laddr);
-														connInfo.destAddr = _IPAddressAsString(inpcbInfo.in6p_faddr);
-														connInfo.sourcePort = htons(inpcbInfo.in6p_lport);
-														connInfo.destPort = htons(inpcbInfo.in6p_fport);
-														
-														netConnMap[ref] = connInfo;
-													}
+													NetworkConnection			connInfo;
+													
+													memset(&connInfo,0,sizeof(connInfo));
+													
+													connInfo.protoID = protocolInfo.pr_protocol;
+													connInfo.protoFamily = domainInfo.dom_family;
+													memcpy(connInfo.sourceAddr.bytes,&inpcbInfo.in6p_laddr,sizeof(inpcbInfo.in6p_laddr));
+													memcpy(connInfo.destAddr.bytes,&inpcbInfo.in6p_faddr,sizeof(inpcbInfo.in6p_faddr));
+													connInfo.sourcePort = htons(inpcbInfo.in6p_lport);
+													connInfo.destPort = htons(inpcbInfo.in6p_fport);
+													
+													// Duplicates are weeded out when the table is sorted
+													netConnMap.Add(ref,connInfo);
 													
 													procInfo.inodeList.push_back(ref);
 												}
@@ -351,70 +351,6 @@ void TInfoCollector::Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap&
 		kvm_close(kvmHandle);
 		kvmHandle = NULL;
 	}
-}
-
-//---------------------------------------------------------------------
-// TInfoCollector::_IPAddressAsString (static protected)
-//---------------------------------------------------------------------
-string TInfoCollector::_IPAddressAsString (const struct in_addr& addr)
-{
-	string					addrStr;
-	struct sockaddr_in		socketInfo;
-	int						niFlags = NI_NUMERICHOST;
-	
-	#ifdef NI_WITHSCOPEID
-		niFlags |= NI_WITHSCOPEID;
-	#endif
-	
-	addrStr.resize(NI_MAXHOST);
-	memset(&socketInfo,0,sizeof(socketInfo));
-	socketInfo.sin_family = AF_INET;
-	#if defined(HAVE_STRUCT_SOCKADDR_IN_SIN_LEN)
-		socketInfo.sin_len = sizeof(socketInfo);
-	#endif
-	socketInfo.sin_addr = addr;
 	
-	if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
-		addrStr.resize(strlen(addrStr.c_str()));
-	else
-		addrStr = "";
-	
-	return addrStr;
+	netConnMap.Sort();
 }
-
-#if HAVE_DECL_AF_INET6
-	//---------------------------------------------------------------------
-	// TInfoCollector::_IPAddressAsString (static protected)
-	//---------------------------------------------------------------------
-	string TInfoCollector::_IPAddressAsString (const struct in6_addr& addr)
-	{
-		string					addrStr;
-		struct sockaddr_in6		socketInfo;
-		int						niFlags = NI_NUMERICHOST;
-		
-		#ifdef NI_WITHSCOPEID
-			niFlags |= NI_WITHSCOPEID;
-		#endif
-		
-		addrStr.resize(NI_MAXHOST);
-		memset(&socketInfo,0,sizeof(socketInfo));
-		socketInfo.sin6_family = AF_INET6;
-		#if defined(HAVE_STRUCT_SOCKADDR_IN6_SIN6_LEN)
-			socketInfo.sin6_len = sizeof(socketInfo);
-		#endif
-		socketInfo.sin6_addr = addr;
-		
-		if (IN6_IS_ADDR_LINKLOCAL(&addr) && *(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])) != 0)
-		{
-			socketInfo.sin6_scope_id = ntohs(*(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])));
-			socketInfo.sin6_addr.s6_addr[2] = socketInfo.sin6_addr.s6_addr[3] = 0;
-		}
-		
-		if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
-			addrStr.resize(strlen(addrStr.c_str()));
-		else
-			addrStr = "";
-		
-		return addrStr;
-	}
-#endif
@@ -102,14 +102,6 @@ class TInfoCollector
 				
 				return bytesRead;
 			}
-		
-		static string _IPAddressAsString (const struct in_addr& addr);
-			// Converts the given IPv4 address structure to a string and returns it.
-		
-		#if HAVE_DECL_AF_INET6
-			static string _IPAddressAsString (const struct in6_addr& addr);
-				// Converts the given IPv6 address structure to a string and returns it.
-		#endif
 };
 
 //---------------------------------------------------------------------
@@ -45,15 +45,305 @@
 	#endif
 #endif
 
+#include <algorithm>
+#include <set>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <fnmatch.h>
 #include <unistd.h>
 
+#if USE_PROC_CONNECTOR
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <linux/netlink.h>
+	#include <linux/connector.h>
+	#include <linux/cn_proc.h>
+#endif
+
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
 static const unsigned long							kReadWriteBlockSize = 4096;
+static const int									kProcEventSocketBufferSize = 1024 * 1024;
+static const int									kProcEventPollTimeout = 1000;	// milliseconds
+
+//*********************************************************************
+// Class TProcEventMonitor
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TProcEventMonitor::TProcEventMonitor ()
+	:	fSocket(-1),
+		fThreadObjPtr(NULL),
+		fIsRunning(false),
+		fHasFailed(false),
+		fLostEvents(false)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TProcEventMonitor::~TProcEventMonitor ()
+{
+	Stop();
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::Start
+//---------------------------------------------------------------------
+bool TProcEventMonitor::Start ()
+{
+	#if USE_PROC_CONNECTOR
+		struct sockaddr_nl		localAddr;
+		int						bufferSize = kProcEventSocketBufferSize;
+		
+		if (fIsRunning)
+			return true;
+		
+		// Only root may join the proc connector's multicast group
+		fSocket = socket(PF_NETLINK,SOCK_DGRAM,NETLINK_CONNECTOR);
+		if (fSocket == -1)
+			return false;
+		
+		// Bursts of forks can be large; a bigger buffer makes overruns rarer
+		setsockopt(fSocket,SOL_SOCKET,SO_RCVBUF,&bufferSize,sizeof(bufferSize));
+		
+		memset(&localAddr,0,sizeof(localAddr));
+		localAddr.nl_family = AF_NETLINK;
+		localAddr.nl_groups = CN_IDX_PROC;
+		localAddr.nl_pid = 0;
+		
+		if (bind(fSocket,reinterpret_cast<struct sockaddr*>(&localAddr),sizeof(localAddr)) != 0 ||
+			!_SendControl(PROC_CN_MCAST_LISTEN))
+		{
+			close(fSocket);
+			fSocket = -1;
+			return false;
+		}
+		
+		fLostEvents = false;
+		fHasFailed = false;
+		fEventList.clear();
+		fIsRunning = true;
+		
+		// Joinable, so that Stop() can wait for it
+		fThreadObjPtr = new ListenerThread(this,false,false,false);
+		try
+		{
+			fThreadObjPtr->Run();
+		}
+		catch (...)
+		{
+			delete(fThreadObjPtr);
+			fThreadObjPtr = NULL;
+			
+			fIsRunning = false;
+			_SendControl(PROC_CN_MCAST_IGNORE);
+			close(fSocket);
+			fSocket = -1;
+		}
+	#endif
+	
+	return fIsRunning;
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::Stop
+//---------------------------------------------------------------------
+void TProcEventMonitor::Stop ()
+{
+	#if USE_PROC_CONNECTOR
+		if (fIsRunning)
+		{
+			// The thread notices within one poll timeout
+			fIsRunning = false;
+		}
+		
+		if (fThreadObjPtr)
+		{
+			// Deleting the thread object joins the thread
+			delete(fThreadObjPtr);
+			fThreadObjPtr = NULL;
+		}
+		
+		if (fSocket != -1)
+		{
+			_SendControl(PROC_CN_MCAST_IGNORE);
+			close(fSocket);
+			fSocket = -1;
+		}
+	#endif
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::TakeEvents
+//---------------------------------------------------------------------
+bool TProcEventMonitor::TakeEvents (ProcessEventList& eventList)
+{
+	TLockedPthreadMutexObj		lock(fEventListMutex);
+	bool						lostEvents = fLostEvents;
+	
+	eventList.clear();
+	eventList.swap(fEventList);
+	fLostEvents = false;
+	
+	return !lostEvents;
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::ThreadMain
+//---------------------------------------------------------------------
+void TProcEventMonitor::ThreadMain (void* /* argPtr */)
+{
+	try
+	{
+		_Run();
+	}
+	catch (...)
+	{
+		// Make sure the collector falls back to polling
+		TLockedPthreadMutexObj		lock(fEventListMutex);
+		
+		fLostEvents = true;
+		fHasFailed = true;
+	}
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::_Run (protected)
+//---------------------------------------------------------------------
+void TProcEventMonitor::_Run ()
+{
+	#if USE_PROC_CONNECTOR
+		// Keep the buffer aligned for the netlink header
+		long		buffer[1024];
+		
+		while (fIsRunning)
+		{
+			struct pollfd			pollInfo;
+			struct sockaddr_nl		fromAddr;
+			socklen_t				fromAddrSize = sizeof(fromAddr);
+			ssize_t					bytesRead = 0;
+			
+			pollInfo.fd = fSocket;
+			pollInfo.events = POLLIN;
+			pollInfo.revents = 0;
+			
+			if (poll(&pollInfo,1,kProcEventPollTimeout) <= 0)
+				continue;
+			
+			bytesRead = recvfrom(fSocket,buffer,sizeof(buffer),0,reinterpret_cast<struct sockaddr*>(&fromAddr),&fromAddrSize);
+			if (bytesRead < 0)
+			{
+				if (errno == ENOBUFS)
+				{
+					// The kernel dropped events because we fell behind
+					TLockedPthreadMutexObj		lock(fEventListMutex);
+					
+					fLostEvents = true;
+				}
+				continue;
+			}
+			
+			// Ignore anything that did not come from the kernel
+			if (fromAddr.nl_pid != 0)
+				continue;
+			
+			for (struct nlmsghdr* msgHeaderPtr = reinterpret_cast<struct nlmsghdr*>(buffer);
+				 NLMSG_OK(msgHeaderPtr,static_cast<unsigned int>(bytesRead));
+				 msgHeaderPtr = NLMSG_NEXT(msgHeaderPtr,bytesRead))
+			{
+				struct cn_msg*		connMsgPtr = NULL;
+				struct proc_event*	eventPtr = NULL;
+				
+				if (msgHeaderPtr->nlmsg_type == NLMSG_ERROR || msgHeaderPtr->nlmsg_type == NLMSG_NOOP)
+					continue;
+				
+				connMsgPtr = reinterpret_cast<struct cn_msg*>(NLMSG_DATA(msgHeaderPtr));
+				if (connMsgPtr->id.idx != CN_IDX_PROC || connMsgPtr->id.val != CN_VAL_PROC)
+					continue;
+				
+				eventPtr = reinterpret_cast<struct proc_event*>(connMsgPtr->data);
+				switch (eventPtr->what)
+				{
+					case proc_event::PROC_EVENT_FORK:
+						// New threads are reported as forks too; we want processes only
+						if (eventPtr->event_data.fork.child_pid == eventPtr->event_data.fork.child_tgid)
+							_AddEvent(eventPtr->event_data.fork.child_tgid,false);
+						break;
+					
+					case proc_event::PROC_EVENT_EXEC:
+						_AddEvent(eventPtr->event_data.exec.process_tgid,false);
+						break;
+					
+					case proc_event::PROC_EVENT_EXIT:
+						if (eventPtr->event_data.exit.process_pid == eventPtr->event_data.exit.process_tgid)
+							_AddEvent(eventPtr->event_data.exit.process_tgid,true);
+						break;
+					
+					default:
+						break;
+				}
+			}
+		}
+	#endif
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::_SendControl (protected)
+//---------------------------------------------------------------------
+bool TProcEventMonitor::_SendControl (int operation)
+{
+	bool	sent = false;
+	
+	#if USE_PROC_CONNECTOR
+		long					buffer[(NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op)) / sizeof(long)) + 1];
+		struct nlmsghdr*		msgHeaderPtr = reinterpret_cast<struct nlmsghdr*>(buffer);
+		struct cn_msg*			connMsgPtr = NULL;
+		enum proc_cn_mcast_op	op = static_cast<enum proc_cn_mcast_op>(operation);
+		
+		memset(buffer,0,sizeof(buffer));
+		
+		msgHeaderPtr->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+		msgHeaderPtr->nlmsg_type = NLMSG_DONE;
+		msgHeaderPtr->nlmsg_pid = getpid();
+		
+		connMsgPtr = reinterpret_cast<struct cn_msg*>(NLMSG_DATA(msgHeaderPtr));
+		connMsgPtr->id.idx = CN_IDX_PROC;
+		connMsgPtr->id.val = CN_VAL_PROC;
+		connMsgPtr->len = sizeof(op);
+		memcpy(connMsgPtr->data,&op,sizeof(op));
+		
+		sent = (send(fSocket,msgHeaderPtr,msgHeaderPtr->nlmsg_len,0) == static_cast<ssize_t>(msgHeaderPtr->nlmsg_len));
+	#endif
+	
+	return sent;
+}
+
+//---------------------------------------------------------------------
+// TProcEventMonitor::_AddEvent (protected)
+//---------------------------------------------------------------------
+void TProcEventMonitor::_AddEvent (pid_t pid, bool isExit)
+{
+	ProcessEvent	event;
+	
+	event.pid = pid;
+	event.isExit = isExit;
+	
+	// Read the details now; the process may be gone by the next pass
+	if (!isExit && !TInfoCollector::ReadProcessInfo(pid,event.info))
+		return;
+	
+	TLockedPthreadMutexObj		lock(fEventListMutex);
+	
+	if (fEventList.size() < kProcEventQueueLimit)
+		fEventList.push_back(event);
+	else
+		fLostEvents = true;
+}
 
 //*********************************************************************
 // Class TInfoCollector
@@ -63,6 +353,8 @@ static const unsigned long							kReadWriteBlockSize = 4096;
 // Constructor
 //---------------------------------------------------------------------
 TInfoCollector::TInfoCollector ()
+	:	fEventMonitorPtr(NULL),
+		fPassesUntilReconcile(0)
 {
 }
 
@@ -70,7 +362,11 @@ TInfoCollector::TInfoCollector ()
 // Constructor
 //---------------------------------------------------------------------
 TInfoCollector::TInfoCollector (const TInfoCollector& obj)
+	:	fProcessCache(obj.fProcessCache),
+		fEventMonitorPtr(NULL),
+		fPassesUntilReconcile(0)
 {
+	// The copy polls /proc; call EnableProcessEvents() on it if needed
 }
 
 //---------------------------------------------------------------------
@@ -78,6 +374,12 @@ TInfoCollector::TInfoCollector (const TInfoCollector& obj)
 //---------------------------------------------------------------------
 TInfoCollector::~TInfoCollector ()
 {
+	if (fEventMonitorPtr)
+	{
+		fEventMonitorPtr->Stop();
+		delete(fEventMonitorPtr);
+		fEventMonitorPtr = NULL;
+	}
 }
 
 //---------------------------------------------------------------------
@@ -85,8 +387,64 @@ TInfoCollector::~TInfoCollector ()
 //---------------------------------------------------------------------
 void TInfoCollector::Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap& netConnMap)
 {
+	ProcessEventList	eventList;
+	bool				haveAllEvents = false;
+	
 	_GetNetworkConnections(netConnMap);
-	_GetRunningProcessInfo(procInfoMap,netConnMap);
+	
+	if (fEventMonitorPtr)
+		haveAllEvents = fEventMonitorPtr->TakeEvents(eventList) && fEventMonitorPtr->IsRunning();
+	
+	if (haveAllEvents && fPassesUntilReconcile > 0)
+	{
+		_ApplyProcessEvents(procInfoMap,netConnMap,eventList);
+		--fPassesUntilReconcile;
+	}
+	else
+	{
+		// Polling, or time to reconcile; events already taken are covered
+		// by the scan and any that arrive during it are harmless to replay
+		_GetRunningProcessInfo(procInfoMap,netConnMap);
+		fPassesUntilReconcile = ((fEventMonitorPtr && fEventMonitorPtr->IsRunning()) ? kProcEventReconcilePasses - 1 : 0);
+	}
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::EnableProcessEvents
+//---------------------------------------------------------------------
+bool TInfoCollector::EnableProcessEvents ()
+{
+	if (!fEventMonitorPtr)
+	{
+		fEventMonitorPtr = new TProcEventMonitor;
+		if (!fEventMonitorPtr->Start())
+		{
+			delete(fEventMonitorPtr);
+			fEventMonitorPtr = NULL;
+		}
+		
+		// The next pass must be a full scan to seed the cache
+		fPassesUntilReconcile = 0;
+	}
+	
+	return (fEventMonitorPtr != NULL);
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::ReadProcessInfo (static)
+//---------------------------------------------------------------------
+bool TInfoCollector::ReadProcessInfo (pid_t procID, CachedProcessInfo& cacheEntry)
+{
+	string		procDirPath("/proc/" + NumToString(procID));
+	string		statText;
+	
+	_ReadWholeFile(procDirPath + "/stat",statText,false,false);
+	if (!_ParseProcessStat(statText,cacheEntry.commandName,cacheEntry.startTime))
+		return false;
+	
+	_ReadProcessOwnerAndPath(procDirPath,cacheEntry);
+	
+	return true;
 }
 
 //---------------------------------------------------------------------
@@ -94,269 +452,353 @@ void TInfoCollector::Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap&
 //---------------------------------------------------------------------
 void TInfoCollector::_GetNetworkConnections (NetworkConnectionMap& netConnMap)
 {
-	string			tempString;
-	StdStringList	tempStringList;
+	string			tableText;
 	
 	netConnMap.clear();
 	
-	// ----- TCP connection info ---------------
+	// The same buffer is reused for all four tables, which are read in
+	// full no matter how many sockets there are
+	
+	_ReadWholeFile("/proc/net/tcp",tableText,false,false,0);
+	_ParseSocketTable(tableText,IPPROTO_TCP,AF_INET,netConnMap);
+	
+	_ReadWholeFile("/proc/net/udp",tableText,false,false,0);
+	_ParseSocketTable(tableText,IPPROTO_UDP,AF_INET,netConnMap);
+	
+	_ReadWholeFile("/proc/net/tcp6",tableText,false,false,0);
+	_ParseSocketTable(tableText,IPPROTO_TCP,AF_INET6,netConnMap);
 	
-	_ReadWholeFile("/proc/net/tcp",tempString,false,false);
-	SplitStdString('\n',tempString,tempStringList,false);
-	if (!tempStringList.empty())
+	_ReadWholeFile("/proc/net/udp6",tableText,false,false,0);
+	_ParseSocketTable(tableText,IPPROTO_UDP,AF_INET6,netConnMap);
+	
+	netConnMap.Sort();
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::_GetRunningProcessInfo (protected)
+//---------------------------------------------------------------------
+void TInfoCollector::_GetRunningProcessInfo (ProcessInfoMap& procInfoMap, const NetworkConnectionMap& netConnMap)
+{
+	vector<pid_t>		pidList;
+	ProcessCacheMap		newProcessCache;
+	string				tempString;
+	
+	procInfoMap.clear();
+	
+	// Get the process IDs of the running processes
+	_GetProcessIDList(pidList);
+	
+	for (vector<pid_t>::const_iterator x = pidList.begin(); x != pidList.end(); x++)
 	{
-		for (StdStringList_const_iter x = tempStringList.begin(); x != tempStringList.end(); x++)
+		string					procDirPath("/proc/" + NumToString(*x));
+		CachedProcessInfo		cacheEntry;
+		ProcessCacheMap_iter	foundIter;
+		
+		// The start time and command name tell us whether this is the same
+		// process we saw last time; the stat file is tiny and always readable
+		_ReadWholeFile(procDirPath + "/stat",tempString,false,false);
+		if (!_ParseProcessStat(tempString,cacheEntry.commandName,cacheEntry.startTime))
 		{
-			if (x->length() > 90 && x->find("local_address") == string::npos)
-			{
-				NetworkConnection		connectInfo;
-				string					inodeStr;
-				int						inodeIndex = 0;
-				int						inode = 0;
-				
-				// Each line is one connection
-				connectInfo.protoID = IPPROTO_TCP;
-				connectInfo.protoFamily = AF_INET;
-				connectInfo.sourceAddr = _HexEthernetToIPv4Addr(x->substr(6,8));
-				connectInfo.sourcePort = ntohs(_HexEthernetToUInt(x->substr(15,4)));
-				connectInfo.destAddr = _HexEthernetToIPv4Addr(x->substr(20,8));
-				connectInfo.destPort = ntohs(_HexEthernetToUInt(x->substr(29,4)));
-				
-				inodeIndex = 91;
-				while (isdigit((*x)[inodeIndex]))
-					inodeStr += (*x)[inodeIndex++];
-				inode = static_cast<int>(StringToNum(inodeStr));
-				
-				netConnMap[inode] = connectInfo;
-			}
+			// Process went away
+			continue;
 		}
+		
+		foundIter = fProcessCache.find(*x);
+		if (foundIter != fProcessCache.end() &&
+			foundIter->second.startTime == cacheEntry.startTime &&
+			foundIter->second.commandName == cacheEntry.commandName)
+		{
+			// Same process as before
+			cacheEntry.procInfo = foundIter->second.procInfo;
+			cacheEntry.needsSignature = foundIter->second.needsSignature;
+		}
+		else
+		{
+			_ReadProcessOwnerAndPath(procDirPath,cacheEntry);
+		}
+		
+		if (cacheEntry.needsSignature)
+		{
+			// Create the signature for that binary
+			cacheEntry.procInfo.appSig = GetApplicationSignature(cacheEntry.procInfo.path);
+			cacheEntry.needsSignature = false;
+		}
+		
+		// Open sockets change all the time, so always get the network connections
+		procInfoMap[*x] = cacheEntry.procInfo;
+		_GetProcessSocketInodes(procDirPath + "/fd/",netConnMap,procInfoMap[*x].inodeList);
+		
+		cacheEntry.hasSockets = !procInfoMap[*x].inodeList.empty();
+		newProcessCache[*x] = cacheEntry;
 	}
 	
-	// ----- UDP connection info ---------------
+	// Processes not seen this time drop out of the cache
+	fProcessCache.swap(newProcessCache);
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::_ApplyProcessEvents (protected)
+//---------------------------------------------------------------------
+void TInfoCollector::_ApplyProcessEvents (ProcessInfoMap& procInfoMap,
+										  const NetworkConnectionMap& netConnMap,
+										  const ProcessEventList& eventList)
+{
+	std::set<pid_t>		startedSet;
+	ProcessCacheMap		exitedProcessMap;
+	
+	procInfoMap.clear();
 	
-	_ReadWholeFile("/proc/net/udp",tempString,false,false);
-	SplitStdString('\n',tempString,tempStringList,false);
-	if (!tempStringList.empty())
+	// Events are in the order the kernel sent them, so a PID that was
+	// reused within the interval ends up with its latest process
+	for (ProcessEventList_const_iter anEvent = eventList.begin(); anEvent != eventList.end(); anEvent++)
 	{
-		for (StdStringList_const_iter x = tempStringList.begin(); x != tempStringList.end(); x++)
+		if (!anEvent->isExit)
+		{
+			fProcessCache[anEvent->pid] = anEvent->info;
+			startedSet.insert(anEvent->pid);
+		}
+		else
 		{
-			if (x->length() > 90 && x->find("local_address") == string::npos)
+			ProcessCacheMap_iter	foundIter = fProcessCache.find(anEvent->pid);
+			
+			if (foundIter != fProcessCache.end())
 			{
-				NetworkConnection		connectInfo;
-				string					inodeStr;
-				int						inodeIndex = 0;
-				int						inode = 0;
-				
-				// Each line is one connection
-				connectInfo.protoID = IPPROTO_UDP;
-				connectInfo.protoFamily = AF_INET;
-				connectInfo.sourceAddr = _HexEthernetToIPv4Addr(x->substr(6,8));
-				connectInfo.sourcePort = ntohs(_HexEthernetToUInt(x->substr(15,4)));
-				connectInfo.destAddr = _HexEthernetToIPv4Addr(x->substr(20,8));
-				connectInfo.destPort = ntohs(_HexEthernetToUInt(x->substr(29,4)));
-				
-				inodeIndex = 91;
-				while (isdigit((*x)[inodeIndex]))
-					inodeStr += (*x)[inodeIndex++];
-				inode = static_cast<int>(StringToNum(inodeStr));
-				
-				netConnMap[inode] = connectInfo;
+				// Processes that came and went since the last pass would
+				// otherwise never be reported at all
+				if (startedSet.find(anEvent->pid) != startedSet.end())
+				{
+					exitedProcessMap[anEvent->pid] = foundIter->second;
+					startedSet.erase(anEvent->pid);
+				}
+				fProcessCache.erase(foundIter);
 			}
 		}
 	}
 	
-	// ----- TCP6 connection info ---------------
+	for (ProcessCacheMap_iter x = exitedProcessMap.begin(); x != exitedProcessMap.end(); x++)
+	{
+		if (x->second.needsSignature)
+			x->second.procInfo.appSig = GetApplicationSignature(x->second.procInfo.path);
+		
+		// A live process with the same PID, if any, takes precedence below
+		procInfoMap[x->first] = x->second.procInfo;
+	}
 	
-	_ReadWholeFile("/proc/net/tcp6",tempString,false,false);
-	SplitStdString('\n',tempString,tempStringList,false);
-	if (!tempStringList.empty())
+	for (ProcessCacheMap_iter x = fProcessCache.begin(); x != fProcessCache.end(); x++)
 	{
-		for (StdStringList_const_iter x = tempStringList.begin(); x != tempStringList.end(); x++)
+		CachedProcessInfo&	cacheEntry = x->second;
+		ProcessInfo&		procInfo = procInfoMap[x->first];
+		
+		if (cacheEntry.needsSignature)
 		{
-			if (x->length() > 90 && x->find("local_address") == string::npos)
-			{
-				NetworkConnection		connectInfo;
-				string					inodeStr;
-				int						inodeIndex = 0;
-				int						inode = 0;
-				
-				// Each line is one connection
-				connectInfo.protoID = IPPROTO_TCP;
-				connectInfo.protoFamily = AF_INET6;
-				connectInfo.sourceAddr = _HexEthernetToIPv6Addr(x->substr(6,32));
-				connectInfo.sourcePort = ntohs(_HexEthernetToUInt(x->substr(39,4)));
-				connectInfo.destAddr = _HexEthernetToIPv6Addr(x->substr(44,32));
-				connectInfo.destPort = ntohs(_HexEthernetToUInt(x->substr(77,4)));
-				
-				inodeIndex = 139;
-				while (isdigit((*x)[inodeIndex]))
-					inodeStr += (*x)[inodeIndex++];
-				inode = static_cast<int>(StringToNum(inodeStr));
-				
-				netConnMap[inode] = connectInfo;
-			}
+			cacheEntry.procInfo.appSig = GetApplicationSignature(cacheEntry.procInfo.path);
+			cacheEntry.needsSignature = false;
+		}
+		
+		procInfo = cacheEntry.procInfo;
+		
+		// Walking a process's descriptors is the expensive part, so skip
+		// the ones that had no sockets; the next full scan catches any
+		// that have opened one since
+		if (cacheEntry.hasSockets || startedSet.find(x->first) != startedSet.end())
+		{
+			_GetProcessSocketInodes("/proc/" + NumToString(x->first) + "/fd/",netConnMap,procInfo.inodeList);
+			cacheEntry.hasSockets = !procInfo.inodeList.empty();
 		}
 	}
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::_ReadProcessOwnerAndPath (static protected)
+//---------------------------------------------------------------------
+void TInfoCollector::_ReadProcessOwnerAndPath (const string& procDirPath, CachedProcessInfo& cacheEntry)
+{
+	struct stat		statInfo;
+	string			deletedSuffix(" (deleted)");
+	
+	cacheEntry.procInfo = ProcessInfo();
+	cacheEntry.hasSockets = false;
+	cacheEntry.needsSignature = false;
+	
+	// Save the owner and group ID
+	if (stat(procDirPath.c_str(),&statInfo) == 0)
+	{
+		cacheEntry.procInfo.ownerID = statInfo.st_uid;
+		cacheEntry.procInfo.groupID = statInfo.st_gid;
+	}
 	
-	// ----- UDP6 connection info ---------------
+	// Get the real path of the process
+	_ReadSymbolicLink(procDirPath + "/exe",cacheEntry.procInfo.path,false);
+	if (cacheEntry.procInfo.path.length() > deletedSuffix.length() &&
+		cacheEntry.procInfo.path.compare(cacheEntry.procInfo.path.length() - deletedSuffix.length(),deletedSuffix.length(),deletedSuffix) == 0)
+	{
+		// The process is apparently not still on disk; use its original name
+		cacheEntry.procInfo.path.erase(cacheEntry.procInfo.path.length() - deletedSuffix.length());
+	}
+	
+	if (!cacheEntry.procInfo.path.empty())
+	{
+		// Signing the binary is left to the caller so that it can be done
+		// outside of time-critical code
+		cacheEntry.needsSignature = true;
+	}
+	else
+	{
+		// We probably tried to read a zombie process or a kernel thread.
+		// Use the name from /proc/#/stat instead.  Note that we don't
+		// compute the signature, mainly because we don't really know
+		// where the binary is.
+		cacheEntry.procInfo.path = "[" + cacheEntry.commandName + "]";
+	}
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::_GetProcessIDList (static protected)
+//---------------------------------------------------------------------
+void TInfoCollector::_GetProcessIDList (vector<pid_t>& pidList)
+{
+	struct dirent*		dirEntryPtr = NULL;
+	struct dirent		dirEntry;
+	DIR*				dirPtr = NULL;
+	
+	pidList.clear();
 	
-	_ReadWholeFile("/proc/net/udp6",tempString,false,false);
-	SplitStdString('\n',tempString,tempStringList,false);
-	if (!tempStringList.empty())
+	dirPtr = opendir("/proc/");
+	if (!dirPtr)
+		throw TSymLibErrorObj(errno,"While attempting to obtain contents of directory '/proc/'");
+	
+	try
 	{
-		for (StdStringList_const_iter x = tempStringList.begin(); x != tempStringList.end(); x++)
+		do
 		{
-			if (x->length() > 90 && x->find("local_address") == string::npos)
+			#if defined(_PTHREADS) && HAVE_READDIR_R
+				// Use the reentrant version
+				if (readdir_r(dirPtr,&dirEntry,&dirEntryPtr) != 0)
+					throw TSymLibErrorObj(errno,"While attempting to obtain contents of directory '/proc/'");
+			#else
+				dirEntryPtr = readdir(dirPtr);
+				// Get a copy so other processes don't trip us up
+				if (dirEntryPtr)
+					memcpy(&dirEntry,dirEntryPtr,sizeof(dirEntry));
+			#endif
+			
+			if (dirEntryPtr)
 			{
-				NetworkConnection		connectInfo;
-				string					inodeStr;
-				int						inodeIndex = 0;
-				int						inode = 0;
+				// Process directories have names containing only digits; no
+				// need to stat them to find that out
+				const char*		namePtr = dirEntry.d_name;
+				pid_t			procPID = 0;
 				
-				// Each line is one connection
-				connectInfo.protoID = IPPROTO_UDP;
-				connectInfo.protoFamily = AF_INET6;
-				connectInfo.sourceAddr = _HexEthernetToIPv6Addr(x->substr(6,32));
-				connectInfo.sourcePort = ntohs(_HexEthernetToUInt(x->substr(39,4)));
-				connectInfo.destAddr = _HexEthernetToIPv6Addr(x->substr(44,32));
-				connectInfo.destPort = ntohs(_HexEthernetToUInt(x->substr(77,4)));
+				while (isdigit(*namePtr))
+					procPID = (procPID * 10) + (*namePtr++ - '0');
 				
-				inodeIndex = 91;
-				while (isdigit((*x)[inodeIndex]))
-					inodeStr += (*x)[inodeIndex++];
-				inode = static_cast<int>(StringToNum(inodeStr));
-				
-				netConnMap[inode] = connectInfo;
+				if (*namePtr == 0 && namePtr != dirEntry.d_name)
+					pidList.push_back(procPID);
 			}
 		}
+		while (dirEntryPtr);
+	}
+	catch (...)
+	{
+		closedir(dirPtr);
+		throw;
 	}
+	
+	closedir(dirPtr);
 }
 
 //---------------------------------------------------------------------
-// TInfoCollector::_GetRunningProcessInfo (static protected)
+// TInfoCollector::_ParseProcessStat (static protected)
 //---------------------------------------------------------------------
-void TInfoCollector::_GetRunningProcessInfo (ProcessInfoMap& procInfoMap, const NetworkConnectionMap& netConnMap)
+bool TInfoCollector::_ParseProcessStat (const string& statText,
+										string& commandName,
+										unsigned long long& startTime)
 {
-	StdStringList		filenameList;
+	bool					parsed = false;
+	string::size_type		openPos = statText.find('(');
+	string::size_type		closePos = statText.rfind(')');
 	
-	procInfoMap.clear();
+	// The command name is enclosed in parentheses and may itself contain
+	// spaces or parentheses, so fields are counted from the last ')'
+	if (openPos != string::npos && closePos != string::npos && closePos > openPos)
+	{
+		string::size_type	pos = closePos + 1;
+		
+		commandName = statText.substr(openPos + 1,closePos - openPos - 1);
+		
+		// Skip to field 22 (the start time); the state is field 3
+		for (int fieldNum = 2; fieldNum < 22 && pos != string::npos; fieldNum++)
+			pos = statText.find_first_not_of(' ',statText.find(' ',pos));
+		
+		if (pos != string::npos && isdigit(statText[pos]))
+		{
+			startTime = 0;
+			while (pos < statText.length() && isdigit(statText[pos]))
+				startTime = (startTime * 10) + (statText[pos++] - '0');
+			parsed = true;
+		}
+	}
 	
-	// Get the subdirectories with names containing only numbers
-	// (these are the process IDs of the running processes)
-	_GetDirContents("/proc/",filenameList,false,false,true,true,"[0-9]*",true);
+	return parsed;
+}
+
+//---------------------------------------------------------------------
+// TInfoCollector::_GetProcessSocketInodes (static protected)
+//---------------------------------------------------------------------
+void TInfoCollector::_GetProcessSocketInodes (const string& fdDirPath,
+											  const NetworkConnectionMap& netConnMap,
+											  InodeList& inodeList)
+{
+	struct dirent*		dirEntryPtr = NULL;
+	struct dirent		dirEntry;
+	DIR*				dirPtr = NULL;
+	string				linkPath;
+	char				linkBuffer[64];
+	const char			kSocketPrefix[] = "socket:[";
+	const int			kSocketPrefixLen = sizeof(kSocketPrefix) - 1;
 	
-	for (StdStringList_const_iter x = filenameList.begin(); x != filenameList.end(); x++)
+	inodeList.clear();
+	
+	dirPtr = opendir(fdDirPath.c_str());
+	if (dirPtr)
 	{
-		struct stat		statInfo;
-		string			onePath;
-		
-		onePath = "/proc/" + *x;
-		if (stat(onePath.c_str(),&statInfo) == 0)
+		do
 		{
-			ProcessInfo		procInfo;
-			pid_t			procPID = static_cast<pid_t>(StringToNum(*x));
-			StdStringList	netConnList;
-			string			tempString;
-			StdStringList	tempStringList;
-			
-			// Save the owner and group ID
-			procInfo.ownerID = statInfo.st_uid;
-			procInfo.groupID = statInfo.st_gid;
-			
-			// Get the real path of the process
-			onePath = "/proc/" + *x + "/maps";
-			_ReadWholeFile(onePath,tempString,false,false);
-			SplitStdString('\n',tempString,tempStringList,false);
-			if (!tempStringList.empty())
-			{
-				StdStringList	itemList;
-				
-				SplitStdString(' ',tempStringList.front(),itemList,false);
-				if (!itemList.empty())
-				{
-					procInfo.path = itemList.back();
-					if (procInfo.path == "(deleted)")
-					{
-						// The process is apparently not still on disk; try to find it's original name
-						procInfo.path = "";
-						if (itemList.size() > 1)
-						{
-							procInfo.path = itemList[itemList.size()-2];
-						}
-					}
-					
-					// Create the signature for that binary
-					if (!procInfo.path.empty())
-						procInfo.appSig = GetApplicationSignature(procInfo.path);
-				}
-			}
-			
-			if (procInfo.path.empty())
-			{
-				// We probably tried to read a zombie process or one that's completely
-				// swapped out.  An alternative location for the name of the application
-				// is in /proc/#/stat.  Note that we don't compute the signature, mainly
-				// because we don't really know where the binary is.
-				unsigned int	foundPos = 0;
-				
-				onePath = "/proc/" + *x + "/stat";
-				_ReadWholeFile(onePath,tempString,false,false);
-				foundPos = tempString.find("(");
-				if (foundPos != string::npos)
-				{
-					procInfo.path = "[";
-					++foundPos;
-					while (foundPos < tempString.length())
-					{
-						if (tempString[foundPos] == ')')
-						{
-							procInfo.path += "]";
-							break;
-						}
-						else
-						{
-							procInfo.path += tempString[foundPos];
-							++foundPos;
-						}
-					}
-				}
-			}
+			#if defined(_PTHREADS) && HAVE_READDIR_R
+				if (readdir_r(dirPtr,&dirEntry,&dirEntryPtr) != 0)
+					dirEntryPtr = NULL;
+			#else
+				dirEntryPtr = readdir(dirPtr);
+				if (dirEntryPtr)
+					memcpy(&dirEntry,dirEntryPtr,sizeof(dirEntry));
+			#endif
 			
-			// Get the network connections
-			onePath = "/proc/" + *x + "/fd/";
-			_GetDirContents(onePath,netConnList,false,true,false,true,"",false);
-			for (StdStringList_const_iter y = netConnList.begin(); y != netConnList.end(); y++)
+			if (dirEntryPtr && dirEntry.d_name[0] != '.')
 			{
-				unsigned int		foundPos = 0;
+				int		linkSize = 0;
 				
-				onePath = "/proc/" + *x + "/fd/" + *y;
-				_ReadSymbolicLink(onePath,tempString,false);
-				foundPos = tempString.find("socket");
-				if (foundPos != string::npos)
+				// Every entry is a symlink; sockets read as "socket:[<inode>]"
+				linkPath = fdDirPath + dirEntry.d_name;
+				linkSize = readlink(linkPath.c_str(),linkBuffer,sizeof(linkBuffer) - 1);
+				if (linkSize > kSocketPrefixLen && memcmp(linkBuffer,kSocketPrefix,kSocketPrefixLen) == 0)
 				{
-					int		inode = 0;
+					long	inode = 0;
 					
-					for (unsigned int i = foundPos; i < tempString.length(); i++)
-					{
-						if (isdigit(tempString[i]))
-							inode = (inode * 10) + (tempString[i] - '0');
-						else if (tempString[i] == ' ')
-							break;
-					}
+					for (int i = kSocketPrefixLen; i < linkSize && isdigit(linkBuffer[i]); i++)
+						inode = (inode * 10) + (linkBuffer[i] - '0');
 					
-					if (netConnMap.find(inode) != netConnMap.end())
-					{
-						if (find(procInfo.inodeList.begin(),procInfo.inodeList.end(),inode) == procInfo.inodeList.end())
-							procInfo.inodeList.push_back(inode);
-					}
+					if (netConnMap.Contains(inode))
+						inodeList.push_back(inode);
 				}
 			}
-			
-			sort(procInfo.inodeList.begin(),procInfo.inodeList.end());
-			
-			procInfoMap[procPID] = procInfo;
 		}
+		while (dirEntryPtr);
+		
+		closedir(dirPtr);
 	}
+	
+	sort(inodeList.begin(),inodeList.end());
+	inodeList.erase(unique(inodeList.begin(),inodeList.end()),inodeList.end());
 }
 
 //---------------------------------------------------------------------
@@ -478,7 +920,8 @@ void TInfoCollector::_GetDirContents (const string& dirPath,
 void TInfoCollector::_ReadWholeFile (const string& filePath,
 										  string& bufferObj,
 										  bool followSymLinks,
-										  bool throwOnError)
+										  bool throwOnError,
+										  unsigned long maxFileSize)
 {
 	int		openFlags = O_RDONLY;
 	int		fd = 0;
@@ -486,8 +929,8 @@ void TInfoCollector::_ReadWholeFile (const string& filePath,
 	if (!followSymLinks)
 		openFlags |= O_NOFOLLOW;
 	
-	// Zero out the buffer argument
-	bufferObj = "";
+	// Zero out the buffer argument; its storage is kept for reuse
+	bufferObj.resize(0);
 	
 	fd = open(filePath.c_str(),openFlags);
 	if (fd == -1 && throwOnError)
@@ -500,20 +943,21 @@ void TInfoCollector::_ReadWholeFile (const string& filePath,
 	
 	if (fd != -1)
 	{
+		unsigned long		totalBytesRead = 0;
+		
 		try
 		{
-			unsigned long		totalBytesRead = 0;
-			unsigned long		maxFileSize = 8192;
-			
 			do
 			{
-				string		interimBuffer;
-				char*		buffStartPtr = NULL;
-				ssize_t		bytesRead = 0;
+				unsigned long		bytesWanted = kReadWriteBlockSize;
+				ssize_t				bytesRead = 0;
+				
+				if (maxFileSize > 0)
+					bytesWanted = std::min(bytesWanted,maxFileSize-totalBytesRead);
 				
-				interimBuffer.resize(kReadWriteBlockSize);
-				buffStartPtr = const_cast<char*>(interimBuffer.data());
-				bytesRead = read(fd,buffStartPtr,std::min(kReadWriteBlockSize,maxFileSize-totalBytesRead));
+				// Read straight into the tail of the buffer
+				bufferObj.resize(totalBytesRead + bytesWanted);
+				bytesRead = read(fd,const_cast<char*>(bufferObj.data()) + totalBytesRead,bytesWanted);
 				if (bytesRead < 0)
 				{
 					string		errString;
@@ -524,7 +968,6 @@ void TInfoCollector::_ReadWholeFile (const string& filePath,
 				}
 				else if (bytesRead > 0)
 				{
-					bufferObj.append(interimBuffer,0,bytesRead);
 					totalBytesRead += bytesRead;
 				}
 				else
@@ -533,12 +976,14 @@ void TInfoCollector::_ReadWholeFile (const string& filePath,
 					break;
 				}
 			}
-			while (totalBytesRead < maxFileSize);
+			while (maxFileSize == 0 || totalBytesRead < maxFileSize);
 			
+			bufferObj.resize(totalBytesRead);
 			close(fd);
 		}
 		catch (...)
 		{
+			bufferObj.resize(totalBytesRead);
 			close(fd);
 			if (throwOnError)
 				throw;
@@ -578,166 +1023,162 @@ void TInfoCollector::_ReadSymbolicLink (const string& filePath,
 }
 
 //---------------------------------------------------------------------
-// TInfoCollector::_HexEthernetToUInt (static protected)
+// TInfoCollector::_ParseSocketTable (static protected)
 //---------------------------------------------------------------------
-uint16_t TInfoCollector::_HexEthernetToUInt (const string& addrStr)
+void TInfoCollector::_ParseSocketTable (const string& tableText,
+										int protoID,
+										int protoFamily,
+										NetworkConnectionMap& netConnMap)
 {
-	uint16_t			num = 0;
-	unsigned char*		numPtr = reinterpret_cast<unsigned char*>(&num);
-	unsigned int		digitCount = addrStr.length() / 2;
-	unsigned int		digitOffset = 0;
+	const char*		textPtr = tableText.data();
+	const char*		endPtr = textPtr + tableText.length();
+	const char*		linePtr = NULL;
+	
+	// Lines are at least 128 characters wide, so this is an upper bound
+	netConnMap.reserve(netConnMap.size() + (tableText.length() / 128) + 1);
 	
-	if (digitCount > sizeof(num))
-		digitCount = sizeof(num);
-	digitOffset = sizeof(num) - digitCount;
+	// The first line holds the column titles
+	linePtr = static_cast<const char*>(memchr(textPtr,'\n',endPtr - textPtr));
+	linePtr = (linePtr ? linePtr + 1 : endPtr);
 	
-	// Stuff the numeric variable big-endian (network byte order)
-	for (unsigned int x = 0; x < digitCount; x++)
+	while (linePtr < endPtr)
 	{
-		unsigned int	ch1 = toupper(addrStr[x*2]);
-		unsigned int	ch2 = toupper(addrStr[x*2+1]);
-		unsigned int	temp = 0;
+		const char*			lineEndPtr = static_cast<const char*>(memchr(linePtr,'\n',endPtr - linePtr));
+		const char*			fieldPtr = NULL;
+		NetworkConnection	connectInfo;
+		long				inode = 0;
 		
-		if (ch1 > '9')
-			ch1 = ch1 - 'A' + 10;
-		else
-			ch1 = ch1 - '0';
-		if (ch2 > '9')
-			ch2 = ch2 - 'A' + 10;
-		else
-			ch2 = ch2 - '0';
+		if (!lineEndPtr)
+			lineEndPtr = endPtr;
+		
+		// Fields are whitespace-delimited rather than fixed-width because
+		// the leading slot number grows wider on busy hosts:
+		//   sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode ...
+		fieldPtr = _SkipFields(linePtr,lineEndPtr,1);
+		if (fieldPtr)
+			fieldPtr = _ParseSocketAddress(fieldPtr,lineEndPtr,protoFamily,connectInfo.sourceAddr,connectInfo.sourcePort);
+		if (fieldPtr)
+			fieldPtr = _ParseSocketAddress(fieldPtr,lineEndPtr,protoFamily,connectInfo.destAddr,connectInfo.destPort);
+		if (fieldPtr)
+			fieldPtr = _SkipFields(fieldPtr,lineEndPtr,6);
+		if (fieldPtr)
+		{
+			while (fieldPtr < lineEndPtr && *fieldPtr == ' ')
+				++fieldPtr;
+			while (fieldPtr < lineEndPtr && isdigit(*fieldPtr))
+				inode = (inode * 10) + (*fieldPtr++ - '0');
+		}
 		
-		temp = ch1 * 16 + ch2;
-		numPtr[x + digitOffset] = temp;
+		// Sockets without an inode, such as those in TIME_WAIT, cannot
+		// belong to any process
+		if (inode != 0)
+		{
+			connectInfo.protoID = protoID;
+			connectInfo.protoFamily = protoFamily;
+			netConnMap.Add(inode,connectInfo);
+		}
+		
+		linePtr = (lineEndPtr < endPtr ? lineEndPtr + 1 : endPtr);
 	}
-	
-	return num;
 }
 
 //---------------------------------------------------------------------
-// TInfoCollector::_HexEthernetToULong (static protected)
+// TInfoCollector::_ParseSocketAddress (static protected)
 //---------------------------------------------------------------------
-unsigned long TInfoCollector::_HexEthernetToULong (const string& addrStr)
+const char* TInfoCollector::_ParseSocketAddress (const char* textPtr,
+												 const char* endPtr,
+												 int protoFamily,
+												 NetworkAddress& address,
+												 long& port)
 {
-	unsigned long		num = 0;
-	unsigned char*		numPtr = reinterpret_cast<unsigned char*>(&num);
-	unsigned int		digitCount = addrStr.length() / 2;
-	unsigned int		digitOffset = 0;
+	unsigned int		wordCount = (protoFamily == AF_INET6 ? 4 : 1);
+	uint32_t			word = 0;
+	
+	memset(&address,0,sizeof(address));
+	port = 0;
 	
-	if (digitCount > sizeof(num))
-		digitCount = sizeof(num);
-	digitOffset = sizeof(num) - digitCount;
+	while (textPtr < endPtr && *textPtr == ' ')
+		++textPtr;
 	
-	// Stuff the numeric variable big-endian (network byte order)
-	for (unsigned int x = 0; x < digitCount; x++)
+	// The kernel prints each 32-bit word of the address as a native
+	// integer, so storing the parsed words back unchanged recreates
+	// the original network-order bytes
+	for (unsigned int x = 0; x < wordCount && textPtr; x++)
 	{
-		unsigned int	ch1 = toupper(addrStr[x*2]);
-		unsigned int	ch2 = toupper(addrStr[x*2+1]);
-		unsigned int	temp = 0;
-		
-		if (ch1 > '9')
-			ch1 = ch1 - 'A' + 10;
-		else
-			ch1 = ch1 - '0';
-		if (ch2 > '9')
-			ch2 = ch2 - 'A' + 10;
-		else
-			ch2 = ch2 - '0';
-		
-		temp = ch1 * 16 + ch2;
-		numPtr[x + digitOffset] = temp;
+		textPtr = _ParseHexWord(textPtr,endPtr,8,word);
+		if (textPtr)
+			memcpy(address.bytes + (x * sizeof(word)),&word,sizeof(word));
 	}
 	
-	return num;
-}
-
-//---------------------------------------------------------------------
-// TInfoCollector::_HexEthernetToIPv4Addr (static protected)
-//---------------------------------------------------------------------
-string TInfoCollector::_HexEthernetToIPv4Addr (const string& addrStr)
-{
-	struct in_addr		address;
-	
-	address.s_addr = htonl(_HexEthernetToULong(addrStr));
+	// The port, on the other hand, is printed in host byte order
+	if (textPtr && textPtr < endPtr && *textPtr == ':')
+	{
+		textPtr = _ParseHexWord(textPtr + 1,endPtr,4,word);
+		port = word;
+	}
+	else
+	{
+		textPtr = NULL;
+	}
 	
-	return _IPAddressAsString(address);
+	return textPtr;
 }
 
 //---------------------------------------------------------------------
-// TInfoCollector::_HexEthernetToIPv6Addr (static protected)
+// TInfoCollector::_ParseHexWord (static protected)
 //---------------------------------------------------------------------
-string TInfoCollector::_HexEthernetToIPv6Addr (const string& addrStr)
+const char* TInfoCollector::_ParseHexWord (const char* textPtr,
+										   const char* endPtr,
+										   unsigned int maxDigits,
+										   uint32_t& value)
 {
-	struct in6_addr		address;
+	const char*		startPtr = textPtr;
 	
-	for (unsigned int x = 0; x < 4; x++)
-		address.s6_addr32[x] = htonl(_HexEthernetToULong(addrStr.substr(x*8,8)));
+	value = 0;
 	
-	return _IPAddressAsString(address);
+	while (textPtr < endPtr && static_cast<unsigned int>(textPtr - startPtr) < maxDigits)
+	{
+		char			ch = *textPtr;
+		unsigned int	digit = 0;
+		
+		if (ch >= '0' && ch <= '9')
+			digit = ch - '0';
+		else if (ch >= 'A' && ch <= 'F')
+			digit = ch - 'A' + 10;
+		else if (ch >= 'a' && ch <= 'f')
+			digit = ch - 'a' + 10;
+		else
+			break;
+		
+		value = (value << 4) | digit;
+		++textPtr;
+	}
+	
+	return (textPtr != startPtr ? textPtr : NULL);
 }
 
 //---------------------------------------------------------------------
-// TInfoCollector::_IPAddressAsString (static protected)
+// TInfoCollector::_SkipFields (static protected)
 //---------------------------------------------------------------------
-string TInfoCollector::_IPAddressAsString (const struct in_addr& addr)
+const char* TInfoCollector::_SkipFields (const char* textPtr,
+										 const char* endPtr,
+										 unsigned int fieldCount)
 {
-	string					addrStr;
-	struct sockaddr_in		socketInfo;
-	int						niFlags = NI_NUMERICHOST;
-	
-	#ifdef NI_WITHSCOPEID
-		niFlags |= NI_WITHSCOPEID;
-	#endif
-	
-	addrStr.resize(NI_MAXHOST);
-	memset(&socketInfo,0,sizeof(socketInfo));
-	socketInfo.sin_family = AF_INET;
-	#if defined(HAVE_STRUCT_SOCKADDR_IN_SIN_LEN)
-		socketInfo.sin_len = sizeof(socketInfo);
-	#endif
-	socketInfo.sin_addr = addr;
-	
-	if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
-		addrStr.resize(strlen(addrStr.c_str()));
-	else
-		addrStr = "";
-	
-	return addrStr;
-}
-
-#if HAVE_DECL_AF_INET6
-	//---------------------------------------------------------------------
-	// TInfoCollector::_IPAddressAsString (static protected)
-	//---------------------------------------------------------------------
-	string TInfoCollector::_IPAddressAsString (const struct in6_addr& addr)
+	for (unsigned int x = 0; x < fieldCount && textPtr; x++)
 	{
-		string					addrStr;
-		struct sockaddr_in6		socketInfo;
-		int						niFlags = NI_NUMERICHOST;
-		
-		#ifdef NI_WITHSCOPEID
-			niFlags |= NI_WITHSCOPEID;
-		#endif
-		
-		addrStr.resize(NI_MAXHOST);
-		memset(&socketInfo,0,sizeof(socketInfo));
-		socketInfo.sin6_family = AF_INET6;
-		#if defined(HAVE_STRUCT_SOCKADDR_IN6_SIN6_LEN)
-			socketInfo.sin6_len = sizeof(socketInfo);
-		#endif
-		socketInfo.sin6_addr = addr;
-		
-		if (IN6_IS_ADDR_LINKLOCAL(&addr) && *(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])) != 0)
+		while (textPtr < endPtr && (*textPtr == ' ' || *textPtr == '\t'))
+			++textPtr;
+		
+		if (textPtr < endPtr)
 		{
-			socketInfo.sin6_scope_id = ntohs(*(reinterpret_cast<u_int16_t*>(&socketInfo.sin6_addr.s6_addr[2])));
-			socketInfo.sin6_addr.s6_addr[2] = socketInfo.sin6_addr.s6_addr[3] = 0;
+			while (textPtr < endPtr && *textPtr != ' ' && *textPtr != '\t')
+				++textPtr;
 		}
-		
-		if (getnameinfo(reinterpret_cast<struct sockaddr*>(&socketInfo),sizeof(socketInfo),const_cast<char*>(addrStr.data()),addrStr.capacity()-1,NULL,0,niFlags) == 0)
-			addrStr.resize(strlen(addrStr.c_str()));
 		else
-			addrStr = "";
-		
-		return addrStr;
+		{
+			textPtr = NULL;
+		}
 	}
-#endif
+	
+	return textPtr;
+}
@@ -30,16 +30,128 @@
 #include "plugin-defs.h"
 #include "common-info.h"
 
+#include "symlib-threads.h"
+
 #include <netdb.h>
 
 //---------------------------------------------------------------------
 // Forward Class Declarations
 //---------------------------------------------------------------------
+class TProcEventMonitor;
 class TInfoCollector;
 
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#if defined(HAVE_LINUX_CONNECTOR_H) && HAVE_LINUX_CONNECTOR_H && defined(HAVE_LINUX_CN_PROC_H) && HAVE_LINUX_CN_PROC_H
+	#define	USE_PROC_CONNECTOR							1
+#else
+	#define	USE_PROC_CONNECTOR							0
+#endif
+
+#define	kProcEventReconcilePasses						10		// full /proc scan every Nth pass when using events
+#define	kProcEventQueueLimit							65536	// pending events before we give up and rescan
+
+struct	CachedProcessInfo
+	{
+		unsigned long long	startTime;		// Field 22 of /proc/<pid>/stat; with the PID, identifies the process
+		string				commandName;	// Field 2 of /proc/<pid>/stat; changes when the process calls exec()
+		ProcessInfo			procInfo;		// Everything but the inode list, which is always refreshed
+		bool				hasSockets;		// True if the process had network sockets open when last checked
+		bool				needsSignature;	// True if procInfo.appSig has yet to be computed
+		
+		CachedProcessInfo () : startTime(0),hasSockets(false),needsSignature(false) {}
+	};
+	
+struct	ProcessEvent
+	{
+		pid_t				pid;
+		bool				isExit;
+		CachedProcessInfo	info;			// Captured when the event arrived; unused for exits
+	};
+	
+typedef	vector<ProcessEvent>							ProcessEventList;
+typedef	ProcessEventList::iterator						ProcessEventList_iter;
+typedef	ProcessEventList::const_iterator				ProcessEventList_const_iter;
+
+// Lookup between a process ID and the information we last collected for it
+typedef	map<pid_t,CachedProcessInfo>					ProcessCacheMap;
+typedef	ProcessCacheMap::iterator						ProcessCacheMap_iter;
+typedef	ProcessCacheMap::const_iterator					ProcessCacheMap_const_iter;
+
+//---------------------------------------------------------------------
+// Class TProcEventMonitor
+//
+// Listens to the kernel's proc connector (a netlink multicast group) on
+// its own thread and queues process start and exit events until the
+// collector asks for them.  Process details are read from /proc as soon
+// as a start event arrives so that even short-lived processes are seen.
+//---------------------------------------------------------------------
+class TProcEventMonitor
+{
+	public:
+		
+		TProcEventMonitor ();
+			// Constructor.  Does not start listening; call Start().
+	
+	private:
+		
+		TProcEventMonitor (const TProcEventMonitor& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		~TProcEventMonitor ();
+			// Destructor
+		
+		bool Start ();
+			// Subscribes to process events and starts the listener thread.
+			// Returns false if the kernel does not support the proc connector
+			// or we lack the privileges to use it.
+		
+		void Stop ();
+			// Stops the listener thread and closes the socket.
+		
+		bool TakeEvents (ProcessEventList& eventList);
+			// Destructively modifies eventList to contain the events received
+			// since the last call, in order, and empties the internal queue.
+			// Returns false if any events were lost in the meantime, in which
+			// case the caller should rescan /proc.
+		
+		// ------------------------------
+		// Accessors
+		// ------------------------------
+		
+		inline bool IsRunning () const
+			{ return fIsRunning && !fHasFailed; }
+	
+		void ThreadMain (void* argPtr = NULL);
+			// Listener thread entry point.  Receives and dispatches events
+			// until Stop() is called.
+	
+	protected:
+		
+		typedef	TContextPthreadObj<TProcEventMonitor>			ListenerThread;
+		
+		void _Run ();
+			// Does the work of ThreadMain().
+		
+		bool _SendControl (int operation);
+			// Sends a PROC_CN_MCAST_* subscription request to the kernel.
+		
+		void _AddEvent (pid_t pid, bool isExit);
+			// Queues a single event.
+	
+	protected:
+		
+		int											fSocket;
+		ListenerThread*								fThreadObjPtr;
+		volatile bool								fIsRunning;
+		volatile bool								fHasFailed;
+		bool										fLostEvents;
+		ProcessEventList							fEventList;
+		TPthreadMutexObj							fEventListMutex;
+};
 
 //---------------------------------------------------------------------
 // Class TInfoCollector
@@ -61,15 +173,60 @@ class TInfoCollector
 		virtual void Collect (ProcessInfoMap& procInfoMap, NetworkConnectionMap& netConnMap);
 			// Collects the information and destructively modifies the arguments
 			// to contain it.
+		
+		virtual bool EnableProcessEvents ();
+			// Switches process discovery from polling /proc to the kernel's
+			// proc connector, with a full /proc scan every
+			// kProcEventReconcilePasses passes as a safety net.  Returns
+			// false, leaving polling in effect, if events are unavailable.
+		
+		static bool ReadProcessInfo (pid_t procID, CachedProcessInfo& cacheEntry);
+			// Reads everything but the signature and open sockets of the given
+			// process from /proc, destructively modifying cacheEntry.  Returns
+			// false if the process has gone away.
 	
 	protected:
 		
+		virtual void _ApplyProcessEvents (ProcessInfoMap& procInfoMap,
+										  const NetworkConnectionMap& netConnMap,
+										  const ProcessEventList& eventList);
+			// Updates fProcessCache from the events and then builds
+			// procInfoMap from it.  Open sockets are refreshed only for new
+			// processes and those that had sockets before.  Processes that
+			// both started and exited since the last pass are included once.
+		
+		static void _ReadProcessOwnerAndPath (const string& procDirPath, CachedProcessInfo& cacheEntry);
+			// Fills in the owner, group and executable path of cacheEntry
+			// from the process's /proc directory.  The command name must
+			// already be set.
+		
 		static void _GetNetworkConnections (NetworkConnectionMap& netConnMap);
 			// Collects information about the currently-open network
-			// connections and stores it internally.
+			// connections and stores it internally.  The result is sorted
+			// by inode.
+		
+		virtual void _GetRunningProcessInfo (ProcessInfoMap& procInfoMap, const NetworkConnectionMap& netConnMap);
+			// Collects information about the currently-running processes.
+			// Processes seen on an earlier call, with the same start time
+			// and command name, are taken from fProcessCache rather than
+			// being reread; only their open sockets are refreshed.
+		
+		static void _GetProcessIDList (vector<pid_t>& pidList);
+			// Destructively modifies pidList to contain the IDs of all
+			// processes currently listed in /proc.
 		
-		static void _GetRunningProcessInfo (ProcessInfoMap& procInfoMap, const NetworkConnectionMap& netConnMap);
-			// Collects information about the currently-running processes
+		static bool _ParseProcessStat (const string& statText,
+									   string& commandName,
+									   unsigned long long& startTime);
+			// Extracts the command name and start time from the contents
+			// of a /proc/<pid>/stat file.  Returns false if the text
+			// could not be parsed.
+		
+		static void _GetProcessSocketInodes (const string& fdDirPath,
+											 const NetworkConnectionMap& netConnMap,
+											 InodeList& inodeList);
+			// Destructively modifies inodeList to contain the sorted inodes
+			// of the sockets in fdDirPath that also appear in netConnMap.
 		
 		static void _GetDirContents (const string& dirPath,
 									 StdStringList& filenameList,
@@ -87,9 +244,11 @@ class TInfoCollector
 		static void _ReadWholeFile (const string& filePath,
 									string& bufferObj,
 									bool followSymLinks = true,
-									bool throwOnError = true);
+									bool throwOnError = true,
+									unsigned long maxFileSize = 8192);
 			// Reads the file indicated by filePath, destructively modifying
-			// bufferObj to with the file's contents.
+			// bufferObj to with the file's contents.  At most maxFileSize
+			// bytes are read; zero means there is no limit.
 		
 		static void _ReadSymbolicLink (const string& filePath,
 									   string& bufferObj,
@@ -97,32 +256,42 @@ class TInfoCollector
 			// Reads the contents of the symbolic link pointed to by filePath,
 			// destructively modifying bufferObj with the contents.
 		
-		static uint16_t _HexEthernetToUInt (const string& addrStr);
-			// Given a hexadecimal string up to four characters long, this
-			// method converts the string to a number and returns it in network
-			// byte order.
-		
-		
-		static unsigned long _HexEthernetToULong (const string& addrStr);
-			// Given a hexadecimal string up to eight characters long, this
-			// method converts the string to a number and returns it in network
-			// byte order.
+		static void _ParseSocketTable (const string& tableText,
+									   int protoID,
+									   int protoFamily,
+									   NetworkConnectionMap& netConnMap);
+			// Parses the contents of one /proc/net/{tcp,udp,tcp6,udp6} file
+			// in a single pass, appending an entry to netConnMap for each
+			// socket that has an inode.
 		
-		static string _HexEthernetToIPv4Addr (const string& addrStr);
-			// Converts the hexadecimal string representing an IPv4 address
-			// to a readable string and returns it.
+		static const char* _ParseSocketAddress (const char* textPtr,
+												const char* endPtr,
+												int protoFamily,
+												NetworkAddress& address,
+												long& port);
+			// Parses one "<hex address>:<hex port>" field starting at textPtr,
+			// storing the binary address and the port.  Returns a pointer
+			// just past the field or NULL if it is malformed.
 		
-		static string _HexEthernetToIPv6Addr (const string& addrStr);
-			// Converts the hexadecimal string representing an IPv6 address
-			// to a readable string and returns it.
+		static const char* _ParseHexWord (const char* textPtr,
+										  const char* endPtr,
+										  unsigned int maxDigits,
+										  uint32_t& value);
+			// Parses up to maxDigits hexadecimal digits starting at textPtr.
+			// Returns a pointer to the first character not consumed, or NULL
+			// if there were no digits.
 		
-		static string _IPAddressAsString (const struct in_addr& addr);
-			// Converts the given IPv4 address structure to a string and returns it.
+		static const char* _SkipFields (const char* textPtr,
+										const char* endPtr,
+										unsigned int fieldCount);
+			// Skips leading whitespace and then fieldCount whitespace-delimited
+			// fields, returning a pointer to the whitespace after the last one.
+	
+	protected:
 		
-		#if HAVE_DECL_AF_INET6
-			static string _IPAddressAsString (const struct in6_addr& addr);
-				// Converts the given IPv6 address structure to a string and returns it.
-		#endif
+		ProcessCacheMap								fProcessCache;
+		TProcEventMonitor*							fEventMonitorPtr;
+		unsigned long								fPassesUntilReconcile;
 };
 
 //---------------------------------------------------------------------
@@ -53,7 +53,11 @@ using std::vector;
 #define	kErrorKVMReadFailed								-24102
 
 #define	kMessageTagTransmitInterval						"TRANSMIT_INTERVAL"
+#define	kMessageTagReportMode							"REPORT_MODE"
+#define	kMessageTagEventSource							"EVENT_SOURCE"
 #define	kMessageAttributeValue							"value"
+#define	kMessageAttributeValueDelta						"delta"
+#define	kMessageAttributeValueNetlink					"netlink"
 
 //---------------------------------------------------------------------
 #endif // PLUGIN_DEFS
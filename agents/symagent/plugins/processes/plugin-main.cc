@@ -44,6 +44,8 @@ using namespace std;
 // Module Globals
 //---------------------------------------------------------------------
 static time_t											gLoopDuration = 0;
+static bool												gDeltaReports = false;
+static bool												gProcessEvents = false;
 static pthread_once_t									gModInitControl = PTHREAD_ONCE_INIT;
 
 //---------------------------------------------------------------------
@@ -77,6 +79,8 @@ void AgentEnvironment (TLoginDataNode& loginEnvNode)
 {
 	pthread_once(&gModInitControl,InitModEnviron);
 	gLoopDuration = 0;
+	gDeltaReports = false;
+	gProcessEvents = false;
 }
 
 //---------------------------------------------------------------------
@@ -86,8 +90,20 @@ bool AgentInit (const TPreferenceNode& preferenceNode)
 {
 	bool				initialized = false;
 	TPreferenceNode		transmitNode(preferenceNode.FindNode(kMessageTagTransmitInterval,"",""));
+	TPreferenceNode		reportModeNode(preferenceNode.FindNode(kMessageTagReportMode,"",""));
+	TPreferenceNode		eventSourceNode(preferenceNode.FindNode(kMessageTagEventSource,"",""));
 	
 	gLoopDuration = 0;
+	gDeltaReports = false;
+	gProcessEvents = false;
+	
+	// Optional; the server must ask for delta reports explicitly
+	if (reportModeNode.IsValid())
+		gDeltaReports = (reportModeNode.GetAttributeValue(kMessageAttributeValue) == kMessageAttributeValueDelta);
+	
+	// Optional; kernel process events instead of polling /proc
+	if (eventSourceNode.IsValid())
+		gProcessEvents = (eventSourceNode.GetAttributeValue(kMessageAttributeValue) == kMessageAttributeValueNetlink);
 	
 	if (transmitNode.IsValid())
 	{
@@ -125,7 +141,7 @@ void AgentRun ()
 	
 	try
 	{
-		taskObjPtr = new TCollectProcessInfo(gLoopDuration,gLoopDuration > 0);
+		taskObjPtr = new TCollectProcessInfo(gLoopDuration,gLoopDuration > 0,gDeltaReports,gProcessEvents);
 		
 		AddTaskToQueue(taskObjPtr,true);
 		
@@ -38,15 +38,10 @@
 // Definitions
 //---------------------------------------------------------------------
 
-typedef	map<string,string>								AppSignatureCache;
-typedef	AppSignatureCache::iterator						AppSignatureCache_iter;
-typedef	AppSignatureCache::const_iterator				AppSignatureCache_const_iter;
-
 struct	ModEnviron
 	{
 		ModEnviron*			parentEnvironPtr;
 		bool				runState;
-		AppSignatureCache	appSigCache;
 		
 		bool GetRunState () { return runState && (!parentEnvironPtr || parentEnvironPtr->GetRunState()); }
 		void SetRunState (bool newState)
@@ -108,8 +103,9 @@ void Trim (string& s);
 	// from the beginning and end.
 
 string GetApplicationSignature (const string& appPath);
-	// Returns a SHA1 signature for the application indicated by the path.
-	// Will cache the signatures and return from cache if possible.
+	// Returns a SHA1 signature for the application indicated by the path,
+	// or an empty string if it cannot be computed.  Signatures are cached
+	// by libsymbiot for the whole process.
 
 //---------------------------------------------------------------------
 // NumToString
@@ -184,6 +184,8 @@ void GetNetworkList(	ProcessInfoMap&			procInfoMap,
 
 	GetTCPConnections( procInfoMap, netConnMap, connectionKey );
 	GetUDPConnections( procInfoMap, netConnMap, connectionKey );
+
+	netConnMap.Sort();							// keys are already ascending; cheap
 }
 
 //------------------------------------------------------------
@@ -224,19 +226,24 @@ void GetTCPConnections( ProcessInfoMap&			procInfoMap,
 			procInfo = (*processIter).second; 
 			NetworkConnection		connectInfo;
 
+			memset( &connectInfo, 0, sizeof(connectInfo) );
 			connectInfo.protoFamily	=	AF_INET;
 			connectInfo.protoID		=	IPPROTO_TCP;	
 
 			// local
+			#ifdef printnet
 			sprintf( localaddr, "%s", ConvertToIp(tcpExTable->table[i].dwLocalAddr, localname) );
-			connectInfo.sourceAddr	=	localaddr;
+			#endif
+			memcpy( connectInfo.sourceAddr.bytes, &tcpExTable->table[i].dwLocalAddr, sizeof(DWORD) );	// network order
 			connectInfo.sourcePort	= htons( (WORD) (UINT) tcpExTable->table[i].dwLocalPort );
 			// remote
+			#ifdef printnet
 			sprintf( remoteaddr, "%s", ConvertToIp(tcpExTable->table[i].dwRemoteAddr, remotename) );
-			connectInfo.destAddr	=	remoteaddr;
+			#endif
+			memcpy( connectInfo.destAddr.bytes, &tcpExTable->table[i].dwRemoteAddr, sizeof(DWORD) );	// network order
 			connectInfo.destPort	= 
 				tcpExTable->table[i].dwRemoteAddr ? htons((WORD) (UINT) tcpExTable->table[i].dwRemotePort) : 0;
-			netConnMap[connectionKey]	=	connectInfo;
+			netConnMap.Add( connectionKey, connectInfo );
 
 			procInfo.inodeList.push_back( connectionKey );		// map connection key to process id
 			(*processIter).second	=	procInfo;
@@ -245,9 +252,9 @@ void GetTCPConnections( ProcessInfoMap&			procInfoMap,
 			#ifdef printnet
 			printf( "connectInfo.protoFamily: %d\n", connectInfo.protoFamily );
 			printf( "connectInfo.protoID:     %d\n", connectInfo.protoID );
-			printf( "connectInfo.sourceAddr:  %s\n", connectInfo.sourceAddr.c_str() );
+			printf( "connectInfo.sourceAddr:  %s\n", localaddr );
 			printf( "connectInfo.sourcePort:  %u\n", connectInfo.sourcePort );
-			printf( "connectInfo.destAddr:    %s\n", connectInfo.destAddr.c_str() );
+			printf( "connectInfo.destAddr:    %s\n", remoteaddr );
 			printf( "connectInfo.destPort:    %u\n", connectInfo.destPort );
 			printf( "process id:              %d\n", tcpExTable->table[i].dwProcessId );
 			printf( "connectionKey:           %d\n", connectionKey );
@@ -297,16 +304,18 @@ void GetUDPConnections(	ProcessInfoMap&			procInfoMap,
 			procInfo = (*processIter).second; 
 			NetworkConnection		connectInfo;
 
+			memset( &connectInfo, 0, sizeof(connectInfo) );
 			connectInfo.protoFamily		=	AF_INET;
 			connectInfo.protoID			=	IPPROTO_UDP;	
 
 			// local
+			#ifdef printnet
 			sprintf( localaddr, "%s", ConvertToIp(udpExTable->table[i].dwLocalAddr, localname) );
-			connectInfo.sourceAddr		=	localaddr;
+			#endif
+			memcpy( connectInfo.sourceAddr.bytes, &udpExTable->table[i].dwLocalAddr, sizeof(DWORD) );	// network order
 			connectInfo.sourcePort		=	htons( (WORD) (UINT) udpExTable->table[i].dwLocalPort );
-			connectInfo.destAddr		=   "";
 			connectInfo.destPort		=   0;
-			netConnMap[connectionKey]	=	connectInfo;
+			netConnMap.Add( connectionKey, connectInfo );
 			
 			procInfo.inodeList.push_back( connectionKey );		// map connection key to process id
 			(*processIter).second		=	procInfo;
@@ -315,7 +324,7 @@ void GetUDPConnections(	ProcessInfoMap&			procInfoMap,
 			#ifdef printnet
 			printf( "connectInfo.protoFamily: %d\n", connectInfo.protoFamily );
 			printf( "connectInfo.protoID:     %d\n", connectInfo.protoID );
-			printf( "connectInfo.sourceAddr:  %s\n", connectInfo.sourceAddr.c_str() );
+			printf( "connectInfo.sourceAddr:  %s\n", localaddr );
 			printf( "connectInfo.sourcePort:  %u\n", connectInfo.sourcePort );
 			printf( "process id:              %d\n", udpExTable->table[i].dwProcessId );
 			printf( "connectionKey:           %d\n", connectionKey );
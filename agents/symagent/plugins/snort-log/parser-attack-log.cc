@@ -84,26 +84,22 @@ TParserAttackLog::~TParserAttackLog ()
 //---------------------------------------------------------------------
 void TParserAttackLog::RunTask ()
 {
-	if (IsConnectedToServer())
-	{
-		TServerMessage		messageObj;
-		TServerReply		replyObj;
-		NoticeCode			noticeCodes = kNoticeNone;
-		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Starting Snort Attack Log (parse and send) Task");
-		
-		Main(messageObj,noticeCodes);
-		
-		if (noticeCodes != kNoticeNone)
-			gNoticesObj.AddNotice(fLogFilePath,noticeCodes);
-		
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
-		
-		if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
-			WriteToMessagesLog("Ending Snort Attack Log (parse and send) Task");
-	}
+	TServerMessage		messageObj;
+	NoticeCode			noticeCodes = kNoticeNone;
+	
+	if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
+		WriteToMessagesLog("Starting Snort Attack Log (parse and send) Task");
+	
+	Main(messageObj,noticeCodes);
+	
+	if (noticeCodes != kNoticeNone)
+		gNoticesObj.AddNotice(fLogFilePath,noticeCodes);
+	
+	// Send it to the server, or hold it until we're reconnected
+	SendToServerOrSpool(messageObj);
+	
+	if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication)
+		WriteToMessagesLog("Ending Snort Attack Log (parse and send) Task");
 }
 
 //---------------------------------------------------------------------
@@ -111,256 +107,437 @@ void TParserAttackLog::RunTask ()
 //---------------------------------------------------------------------
 void TParserAttackLog::Main (TServerMessage& messageObj, NoticeCode& noticeCodes)
 {
-	StdStringList	entryList;
-	TMessageNode	snortNode;
+	const char*				dataBegin = fDataToParse.data();
+	const char*				dataEnd = dataBegin + fDataToParse.length();
+	const char*				lineBegin = NULL;
+	const char*				lineEnd = NULL;
+	unsigned long			entryCount = 0;
+	TSnortTimeBase			timeBase;
+	SnortIncidentFields		incidentFields;
+	TMessageNode			snortNode;
 	
-	SplitStdString('\n',fDataToParse,entryList,false);
+	// Count the non-empty lines so the count attribute can lead the node
+	for (lineBegin = dataBegin; lineBegin < dataEnd; lineBegin = lineEnd + 1)
+	{
+		lineEnd = static_cast<const char*>(memchr(lineBegin,'\n',dataEnd - lineBegin));
+		if (!lineEnd)
+			lineEnd = dataEnd;
+		if (lineEnd > lineBegin)
+			++entryCount;
+	}
 	
-	snortNode = messageObj.Append(kXMLTagNIDS,kXMLAttributeLogEntryCount,NumToString(entryList.size()));
+	snortNode = messageObj.Append(kXMLTagNIDS,kXMLAttributeLogEntryCount,NumToString(entryCount));
 	snortNode.AddAttribute(kXMLAttributeFile,fLogFilePath);
 	snortNode.AddAttribute(kXMLAttributePlatform,kXMLAttributeValueSnort);
 	
-	for (StdStringList_const_iter oneLine = entryList.begin(); oneLine != entryList.end(); oneLine++)
+	for (lineBegin = dataBegin; lineBegin < dataEnd; lineBegin = lineEnd + 1)
 	{
-		SnortIncidentFieldMap	fieldMap;
+		lineEnd = static_cast<const char*>(memchr(lineBegin,'\n',dataEnd - lineBegin));
+		if (!lineEnd)
+			lineEnd = dataEnd;
 		
-		// Convert the log line into a snort field map
-		_ParseOneLine(*oneLine,fieldMap,noticeCodes);
-		
-		// Convert the gathered information into an XML entry
-		_PopulateXMLMessage(fieldMap,snortNode,fOutputFormat);
+		if (lineEnd > lineBegin)
+		{
+			// Convert the log line into field slices
+			_ParseOneLine(lineBegin,lineEnd,timeBase,incidentFields,noticeCodes);
+			
+			// Convert the gathered information into an XML entry
+			_PopulateXMLMessage(incidentFields,snortNode,fOutputFormat);
+		}
 	}
 }
 
 //---------------------------------------------------------------------
 // TParserAttackLog::_ParseOneLine (static protected)
 //---------------------------------------------------------------------
-void TParserAttackLog::_ParseOneLine (const string& logLine, SnortIncidentFieldMap& fieldMap, NoticeCode& noticeCodes)
+void TParserAttackLog::_ParseOneLine (const char* lineBegin,
+									  const char* lineEnd,
+									  TSnortTimeBase& timeBase,
+									  SnortIncidentFields& incidentFields,
+									  NoticeCode& noticeCodes)
 {
-	StdStringList		fieldList;
-	StdStringList		tempStringList;
+	const char				kFieldDelimiter[] = "[**]";
+	const unsigned long		kFieldDelimiterLen = sizeof(kFieldDelimiter) - 1;
+	const char				kClassificationTag[] = "Classification: ";
+	const unsigned long		kClassificationTagLen = sizeof(kClassificationTag) - 1;
+	const char				kPriorityTag[] = "Priority: ";
+	const unsigned long		kPriorityTagLen = sizeof(kPriorityTag) - 1;
+	SnortFieldSlice			line;
+	SnortFieldSlice			fieldList[3];
+	unsigned long			fieldCount = 0;
 	
 	// Clear the argument we'll be modifying
-	fieldMap.clear();
+	for (int x = 0; x < kSnortIncidentFieldCount; x++)
+		incidentFields.fields[x].begin = incidentFields.fields[x].end = NULL;
+	incidentFields.timestamp = 0.0;
+	incidentFields.hasTimestamp = false;
 	
-	// Split the log line into fields, ignoring empties
-	SplitStdString("[**]",logLine,fieldList,false);
+	// Split the log line into fields, ignoring empties; we only
+	// care about the first three
+	line.begin = lineBegin;
+	line.end = lineEnd;
+	_TrimSlice(line);
+	while (line.begin < line.end && fieldCount < 3)
+	{
+		const char*		foundPos = _FindInSlice(line,kFieldDelimiter);
+		
+		if (foundPos > line.begin)
+		{
+			fieldList[fieldCount].begin = line.begin;
+			fieldList[fieldCount].end = foundPos;
+			_TrimSlice(fieldList[fieldCount]);
+			++fieldCount;
+		}
+		
+		if (foundPos < line.end)
+			line.begin = foundPos + kFieldDelimiterLen;
+		else
+			line.begin = line.end;
+	}
 	
-	// Insert common entries into the field map
-	if (fieldList.size() > 0)
+	// Insert common entries into the field list
+	if (fieldCount > 0)
 	{
 		// Snort timestamp
-		// Store this as converted to our normal timestamp format
-		fieldMap[kSnortIncidentTimestamp] = NumToString(static_cast<unsigned long long>(_SnortTimestampToNum(fieldList[0],noticeCodes) * 1000));
+		incidentFields.timestamp = timeBase.TimestampToNum(fieldList[0].begin,fieldList[0].end,noticeCodes);
+		incidentFields.hasTimestamp = true;
 		
-		if (fieldList.size() > 1)
+		if (fieldCount > 1 && _FindInSlice(fieldList[1],"snort_decoder") == fieldList[1].end)
 		{
-			if (fieldList[1].find("snort_decoder") == string::npos)
+			// Field format:  "[<IncidentID>] <<Interface>> <IncidentDescription>"
+			// IncididentID format:  "[x:x:x]
+			// Interface format:  <Name> -- optional
+			// IncidentDescription format:  remainder of fields, spaces included
+			const char*			cursor = fieldList[1].begin;
+			SnortFieldSlice		idToken;
+			SnortFieldSlice		nextToken;
+			
+			if (_NextToken(cursor,fieldList[1].end,' ',idToken) && _NextToken(cursor,fieldList[1].end,' ',nextToken))
 			{
-				// Field format:  "[<IncidentID>] <<Interface>> <IncidentDescription>"
-				// IncididentID format:  "[x:x:x]
-				// Interface format:  <Name> -- optional
-				// IncidentDescription format:  remainder of fields, spaces included
-				SplitStdString(' ',fieldList[1],tempStringList,false);
-				if (tempStringList.size() >= 2)
+				SnortFieldSlice&	description(incidentFields.fields[kSnortIncidentDescription]);
+				
+				_RemoveEnclosingChars(idToken,'[',']');
+				incidentFields.fields[kSnortIncidentID] = idToken;
+				
+				if (*nextToken.begin == '<')
 				{
-					_RemoveEnclosingChars(tempStringList[0],'[',']');
-					fieldMap[kSnortIncidentID] = tempStringList[0];
-					tempStringList.erase(tempStringList.begin());
-					if (tempStringList.front()[0] == '<')
-					{
-						// Extract network interface
-						_RemoveEnclosingChars(tempStringList[0],'<','>');
-						fieldMap[kSnortIncidentInterface] = tempStringList[0];
-						tempStringList.erase(tempStringList.begin());
-					}
-					else
-					{
-						// We don't have device information
-						noticeCodes = static_cast<NoticeCode>(static_cast<int>(noticeCodes) | kNoticeMissingDevice);
-					}
-					fieldMap[kSnortIncidentDescription] = JoinStdStringList(' ',tempStringList);
+					// Extract network interface
+					SnortFieldSlice		interfaceToken(nextToken);
+					
+					_RemoveEnclosingChars(interfaceToken,'<','>');
+					incidentFields.fields[kSnortIncidentInterface] = interfaceToken;
+					
+					if (!_NextToken(cursor,fieldList[1].end,' ',nextToken))
+						nextToken.begin = fieldList[1].end;
 				}
 				else
 				{
-					// Stuff it all into the description
-					fieldMap[kSnortIncidentDescription] = fieldList[1];
+					// We don't have device information
+					noticeCodes = static_cast<NoticeCode>(static_cast<int>(noticeCodes) | kNoticeMissingDevice);
 				}
 				
-				if (fieldList.size() > 2)
+				description.begin = nextToken.begin;
+				description.end = fieldList[1].end;
+			}
+			else
+			{
+				// Stuff it all into the description
+				incidentFields.fields[kSnortIncidentDescription] = fieldList[1];
+			}
+			
+			if (fieldCount > 2)
+			{
+				// Field format:  "[<Classification>] [<Priority>] {<Protocol>} <Source> -> <Destination>"
+				// Classification format:	"Classification: <Description>" -- optional
+				// Priority format:	"Priority: <value>" -- optional
+				// Source format: "<IPAddress>:<Port>" -- port can be optional
+				// Destination format: "<IPAddress>:<Port>" -- port can be optional
+				
+				// First, let's break the string on the protocol.  Items before the
+				// protocol are optional and need to be handled differently.
+				const char*			protocolPos = static_cast<const char*>(memchr(fieldList[2].begin,'{',fieldList[2].end - fieldList[2].begin));
+				SnortFieldSlice		descriptions;
+				SnortFieldSlice		packetInfo;
+				SnortFieldSlice		packetTokens[4];
+				unsigned long		packetTokenCount = 0;
+				SnortFieldSlice		extraToken;
+				
+				if (!protocolPos)
+					protocolPos = fieldList[2].begin;
+				descriptions.begin = fieldList[2].begin;
+				descriptions.end = protocolPos;
+				packetInfo.begin = protocolPos;
+				packetInfo.end = fieldList[2].end;
+				
+				// Walk through the description string, finding bracketed items
+				cursor = static_cast<const char*>(memchr(descriptions.begin,'[',descriptions.end - descriptions.begin));
+				while (cursor)
 				{
-					// Field format:  "[<Classification>] [<Priority>] {<Protocol>} <Source> -> <Destination>"
-					// Classification format:	"Classification: <Description>" -- optional
-					// Priority format:	"Priority: <value>" -- optional
-					// Source format: "<IPAddress>:<Port>" -- port can be optional
-					// Destination format: "<IPAddress>:<Port>" -- port can be optional
+					SnortFieldSlice		parameter;
 					
-					// First, let's break the string on the protocol.  Items before the
-					// protocol are optional and need to be handled differently.
-					string			descriptions;
-					string			packetInfo;
-					unsigned long	pos = 0;
+					parameter.begin = cursor;
+					parameter.end = static_cast<const char*>(memchr(cursor,']',descriptions.end - cursor));
+					parameter.end = (parameter.end ? parameter.end + 1 : descriptions.end);
+					cursor = parameter.end;
 					
-					SplitStdString('{',fieldList[2],tempStringList,false);
+					_RemoveEnclosingChars(parameter,'[',']');
+					_TrimSlice(parameter);
 					
-					if (!tempStringList.empty())
+					// Now look for our possible values
+					if (static_cast<unsigned long>(parameter.end - parameter.begin) >= kClassificationTagLen &&
+						memcmp(parameter.begin,kClassificationTag,kClassificationTagLen) == 0)
 					{
-						if (tempStringList.size() == 1)
-						{
-							packetInfo += "{" + tempStringList[0];
-						}
-						else
-						{
-							descriptions = tempStringList[0];
-							tempStringList.erase(tempStringList.begin());
-							packetInfo += "{" + JoinStdStringList(' ',tempStringList);
-						}
+						SnortFieldSlice		value;
+						
+						value.begin = parameter.begin + kClassificationTagLen;
+						value.end = parameter.end;
+						_TrimSlice(value);
+						if (value.begin < value.end)
+							incidentFields.fields[kSnortIncidentClassification] = value;
 					}
-					
-					// Walk through the description string, finding bracketed items
-					pos = descriptions.find('[');
-					while (pos != string::npos)
+					else if (static_cast<unsigned long>(parameter.end - parameter.begin) >= kPriorityTagLen &&
+							 memcmp(parameter.begin,kPriorityTag,kPriorityTagLen) == 0)
 					{
-						unsigned long	endPos = descriptions.find(']',pos);
-						string			parameter;
-						const string	kClassificationTag("Classification: ");
-						const string	kPriorityTag("Priority: ");
-						
-						if (endPos != string::npos)
-						{
-							++endPos;
-							parameter = descriptions.substr(pos,endPos-pos);
-						}
-						else
-							parameter = descriptions.substr(pos,descriptions.length() - pos);
-						
-						_RemoveEnclosingChars(parameter,'[',']');
-						Trim(parameter);
+						SnortFieldSlice		value;
 						
-						// Now look for our possible values
-						if (parameter.find(kClassificationTag) == 0)
-						{
-							unsigned long	valuePos = kClassificationTag.length();
-							string			value(parameter.substr(valuePos,parameter.length()-valuePos));
-							
-							Trim(value);
-							if (!value.empty())
-								fieldMap[kSnortIncidentClassification] = value;
-						}
-						else if (parameter.find(kPriorityTag) == 0)
-						{
-							unsigned long	valuePos = kPriorityTag.length();
-							string			value(parameter.substr(valuePos,parameter.length()-valuePos));
-							
-							Trim(value);
-							if (!value.empty())
-								fieldMap[kSnortIncidentPriority] = value;
-						}
-						
-						if (endPos < descriptions.length())
-							pos = descriptions.find('[',endPos);
-						else
-							break;
+						value.begin = parameter.begin + kPriorityTagLen;
+						value.end = parameter.end;
+						_TrimSlice(value);
+						if (value.begin < value.end)
+							incidentFields.fields[kSnortIncidentPriority] = value;
 					}
 					
-					// Now break up the packet info stuff -- should be four items
-					SplitStdString(' ',packetInfo,tempStringList,false);
-					if (tempStringList.size() == 4)
+					if (cursor < descriptions.end)
+						cursor = static_cast<const char*>(memchr(cursor,'[',descriptions.end - cursor));
+					else
+						break;
+				}
+				
+				// Now break up the packet info stuff -- should be four items
+				cursor = packetInfo.begin;
+				while (packetTokenCount < 4 && _NextToken(cursor,packetInfo.end,' ',packetTokens[packetTokenCount]))
+					++packetTokenCount;
+				
+				if (packetTokenCount == 4 && !_NextToken(cursor,packetInfo.end,' ',extraToken))
+				{
+					SnortFieldSlice		protocol(packetTokens[0]);
+					SnortFieldSlice		sourceIP(packetTokens[1]);
+					SnortFieldSlice		sourcePort;
+					SnortFieldSlice		destinationIP(packetTokens[3]);
+					SnortFieldSlice		destinationPort;
+					SnortFieldSlice		addressToken;
+					
+					sourcePort.begin = sourcePort.end = NULL;
+					destinationPort.begin = destinationPort.end = NULL;
+					
+					// See if the source and destination need their ports parsed out
+					cursor = packetTokens[1].begin;
+					if (_NextToken(cursor,packetTokens[1].end,':',addressToken) &&
+						_NextToken(cursor,packetTokens[1].end,':',sourcePort))
 					{
-						string	protocol(tempStringList[0]);
-						string	sourceIP(tempStringList[1]);
-						string	sourcePort;
-						string	destinationIP(tempStringList[3]);
-						string	destinationPort;
-						
-						// See if the source and destination need their ports parsed out
-						SplitStdString(':',sourceIP,tempStringList,false);
-						if (tempStringList.size() > 1)
-						{
-							sourceIP = tempStringList[0];
-							sourcePort = tempStringList[1];
-						}
-						SplitStdString(':',destinationIP,tempStringList,false);
-						if (tempStringList.size() > 1)
-						{
-							destinationIP = tempStringList[0];
-							destinationPort = tempStringList[1];
-						}
-						
-						_RemoveEnclosingChars(protocol,'{','}');
-						Trim(protocol);
-						if (!protocol.empty())
-						{
-							MakeLowerCase(protocol);
-							fieldMap[kSnortIncidentProtocol] = protocol;
-						}
-						
-						Trim(sourceIP);
-						if (!sourceIP.empty())
-							fieldMap[kSnortIncidentSourceIPAddress] = sourceIP;
-						
-						Trim(sourcePort);
-						if (!sourcePort.empty())
-							fieldMap[kSnortIncidentSourcePort] = sourcePort;
-						
-						Trim(destinationIP);
-						if (!destinationIP.empty())
-							fieldMap[kSnortIncidentDestinationIPAddress] = destinationIP;
-						
-						Trim(destinationPort);
-						if (!destinationPort.empty())
-							fieldMap[kSnortIncidentDestinationPort] = destinationPort;
+						sourceIP = addressToken;
 					}
+					cursor = packetTokens[3].begin;
+					if (_NextToken(cursor,packetTokens[3].end,':',addressToken) &&
+						_NextToken(cursor,packetTokens[3].end,':',destinationPort))
+					{
+						destinationIP = addressToken;
+					}
+					
+					_RemoveEnclosingChars(protocol,'{','}');
+					_TrimSlice(protocol);
+					if (protocol.begin < protocol.end)
+						incidentFields.fields[kSnortIncidentProtocol] = protocol;
+					
+					_TrimSlice(sourceIP);
+					if (sourceIP.begin < sourceIP.end)
+						incidentFields.fields[kSnortIncidentSourceIPAddress] = sourceIP;
+					
+					_TrimSlice(sourcePort);
+					if (sourcePort.begin < sourcePort.end)
+						incidentFields.fields[kSnortIncidentSourcePort] = sourcePort;
+					
+					_TrimSlice(destinationIP);
+					if (destinationIP.begin < destinationIP.end)
+						incidentFields.fields[kSnortIncidentDestinationIPAddress] = destinationIP;
+					
+					_TrimSlice(destinationPort);
+					if (destinationPort.begin < destinationPort.end)
+						incidentFields.fields[kSnortIncidentDestinationPort] = destinationPort;
 				}
 			}
 		}
 	}
 }
 
+//---------------------------------------------------------------------
+// TParserAttackLog::_TrimSlice (static protected)
+//---------------------------------------------------------------------
+void TParserAttackLog::_TrimSlice (SnortFieldSlice& slice)
+{
+	while (slice.begin < slice.end && isspace(static_cast<unsigned char>(slice.end[-1])))
+		--slice.end;
+	while (slice.begin < slice.end && isspace(static_cast<unsigned char>(slice.begin[0])))
+		++slice.begin;
+}
+
 //---------------------------------------------------------------------
 // TParserAttackLog::_RemoveEnclosingChars (static protected)
 //---------------------------------------------------------------------
-void TParserAttackLog::_RemoveEnclosingChars (string& s, char beginningChar, char endingChar)
+void TParserAttackLog::_RemoveEnclosingChars (SnortFieldSlice& slice, char beginningChar, char endingChar)
+{
+	while (slice.begin < slice.end && slice.end[-1] == endingChar)
+		--slice.end;
+	while (slice.begin < slice.end && slice.begin[0] == beginningChar)
+		++slice.begin;
+}
+
+//---------------------------------------------------------------------
+// TParserAttackLog::_FindInSlice (static protected)
+//---------------------------------------------------------------------
+const char* TParserAttackLog::_FindInSlice (const SnortFieldSlice& slice, const char* pattern)
+{
+	const unsigned long		kPatternLen = strlen(pattern);
+	
+	if (kPatternLen > 0)
+	{
+		const char*		cursor = slice.begin;
+		
+		while (static_cast<unsigned long>(slice.end - cursor) >= kPatternLen)
+		{
+			cursor = static_cast<const char*>(memchr(cursor,pattern[0],slice.end - cursor - kPatternLen + 1));
+			if (!cursor)
+				break;
+			if (memcmp(cursor,pattern,kPatternLen) == 0)
+				return cursor;
+			++cursor;
+		}
+	}
+	
+	return slice.end;
+}
+
+//---------------------------------------------------------------------
+// TParserAttackLog::_NextToken (static protected)
+//---------------------------------------------------------------------
+bool TParserAttackLog::_NextToken (const char*& cursor, const char* end, char delimiter, SnortFieldSlice& token)
 {
-	while (!s.empty() && s[s.length()-1] == endingChar)
-		s.erase(s.length()-1,1);
-	while (!s.empty() && s[0] == beginningChar)
-		s.erase(0,1);
+	while (cursor < end && *cursor == delimiter)
+		++cursor;
+	
+	if (cursor >= end)
+		return false;
+	
+	token.begin = cursor;
+	while (cursor < end && *cursor != delimiter)
+		++cursor;
+	token.end = cursor;
+	
+	return true;
 }
 
 //---------------------------------------------------------------------
-// TParserAttackLog::_WithRemovedChars (static protected)
+// TParserAttackLog::_SliceToString (static protected)
 //---------------------------------------------------------------------
-string TParserAttackLog::_WithRemovedChars (const string& s, const string& charBag)
+string TParserAttackLog::_SliceToString (const SnortFieldSlice& slice)
 {
-	string	tempString;
+	if (slice.begin < slice.end)
+		return string(slice.begin,slice.end - slice.begin);
 	
-	for (unsigned long x = 0; x < s.length(); x++)
+	return string();
+}
+
+//---------------------------------------------------------------------
+// TParserAttackLog::_SliceToJoinedString (static protected)
+//---------------------------------------------------------------------
+string TParserAttackLog::_SliceToJoinedString (const SnortFieldSlice& slice)
+{
+	string			joined;
+	const char*		cursor = slice.begin;
+	SnortFieldSlice	word;
+	
+	while (cursor && _NextToken(cursor,slice.end,' ',word))
 	{
-		if (charBag.find(s[x]) == string::npos)
-			tempString.push_back(s[x]);
+		if (!joined.empty())
+			joined += ' ';
+		joined.append(word.begin,word.end - word.begin);
 	}
 	
-	return tempString;
+	return joined;
 }
 
 //---------------------------------------------------------------------
-// TParserAttackLog::_SnortTimestampToNum (static protected)
+// TParserAttackLog::_PopulateXMLMessage (static protected)
 //---------------------------------------------------------------------
-double TParserAttackLog::_SnortTimestampToNum (const string& snortTimestamp, NoticeCode& noticeCode)
+void TParserAttackLog::_PopulateXMLMessage (const SnortIncidentFields& incidentFields,
+											TMessageNode& parentNode,
+											const string& outputFormat)
+{
+	TMessageNode		entryNode(parentNode.Append(kXMLTagNIDSLogEntry,"",""));
+	TMessageNode		typeNode(entryNode.Append(kXMLTagLogEntryType,"",""));
+	TMessageNode		netNode(entryNode.Append(kXMLTagPacketInfo,"",""));
+	TMessageNode		sourceNode(netNode.Append(kXMLTagNetworkSource,"",""));
+	TMessageNode		destNode(netNode.Append(kXMLTagNetworkDestination,"",""));
+	string				protocol(_SliceToString(incidentFields.fields[kSnortIncidentProtocol]));
+	
+	// Store the timestamp as converted to our normal timestamp format
+	if (incidentFields.hasTimestamp)
+		entryNode.AddAttribute(kXMLAttributeSnortTimestamp,NumToString(static_cast<unsigned long long>(incidentFields.timestamp * 1000)));
+	else
+		entryNode.AddAttribute(kXMLAttributeSnortTimestamp,"");
+	entryNode.AddAttribute(kXMLAttributePriority,_SliceToString(incidentFields.fields[kSnortIncidentPriority]));
+	
+	typeNode.AddAttribute(kXMLAttributeSnortID,_SliceToString(incidentFields.fields[kSnortIncidentID]));
+	
+	MakeLowerCase(protocol);
+	netNode.AddAttribute(kXMLAttributeNetworkProtocol,protocol);
+	netNode.AddAttribute(kXMLAttributeDevice,_SliceToString(incidentFields.fields[kSnortIncidentInterface]));
+	
+	sourceNode.AddAttribute(kXMLAttributeIPAddress,_SliceToString(incidentFields.fields[kSnortIncidentSourceIPAddress]));
+	sourceNode.AddAttribute(kXMLAttributePort,_SliceToString(incidentFields.fields[kSnortIncidentSourcePort]));
+	
+	destNode.AddAttribute(kXMLAttributeIPAddress,_SliceToString(incidentFields.fields[kSnortIncidentDestinationIPAddress]));
+	destNode.AddAttribute(kXMLAttributePort,_SliceToString(incidentFields.fields[kSnortIncidentDestinationPort]));
+	
+	if (outputFormat != kMessageAttributeValueCompact)
+	{
+		typeNode.AddAttribute(kXMLAttributeSnortDescription,_SliceToJoinedString(incidentFields.fields[kSnortIncidentDescription]));
+		typeNode.AddAttribute(kXMLAttributeSnortClassification,_SliceToString(incidentFields.fields[kSnortIncidentClassification]));
+	}
+}
+
+//*********************************************************************
+// Class TSnortTimeBase
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TSnortTimeBase::TSnortTimeBase ()
+	:	fCachedYear(-1),
+		fCachedMonth(-1),
+		fCachedBase(0)
 {
-	double		timestampNum = 0.0;
 	time_t		timeInSec = time(NULL);
-	struct tm	timeInfo;
 	
-	// First, get the current time in order to get the timezone stuff correct
+	// Get the current time once in order to get the timezone stuff correct
 	#if HAVE_LOCALTIME_R
-		localtime_r(&timeInSec,&timeInfo);
+		localtime_r(&timeInSec,&fNowInfo);
 	#else
-		memcpy(&timeInfo,localtime(&timeInSec),sizeof(timeInfo));
+		memcpy(&fNowInfo,localtime(&timeInSec),sizeof(fNowInfo));
 	#endif
+}
+
+//---------------------------------------------------------------------
+// TSnortTimeBase::TimestampToNum
+//---------------------------------------------------------------------
+double TSnortTimeBase::TimestampToNum (const char* begin, const char* end, NoticeCode& noticeCode)
+{
+	double			timestampNum = 0.0;
+	long			timeOffset = 0;
+	int				year = fNowInfo.tm_year;
+	const char*		fraction = NULL;
 	
-	// Stuff the timeInfo struct with data pulled from the snort timestamp
 	// Note that the timestamp can be in one of two formats:
 	// 		MM/DD-HH:MM:SS.SSSSSS
 	// 		0  0  0  0  1 1
@@ -372,104 +549,96 @@ double TParserAttackLog::_SnortTimestampToNum (const string& snortTimestamp, Not
 	// Also, note that snort can report the timestamp in UTC time rather than
 	// local time.  Unfortunately, there is no external indication of this while
 	// examining the logfiles.  Here, we assume that the timestamp is in local time.
+	// Since the DST flag is fixed to the current one for every entry, an
+	// entry's time is always a linear offset from the start of its month.
 	
-	if (snortTimestamp[5] == '-')
+	if (end - begin >= 14 && begin[5] == '-')
 	{
 		// First format for the timestamp (missing the year)
-		
-		// Month, 0-11
-		timeInfo.tm_mon = static_cast<int>(StringToNum(snortTimestamp.substr(0,2)) - 1);
-		
-		// Day, 1-31
-		timeInfo.tm_mday = static_cast<int>(StringToNum(snortTimestamp.substr(3,2)));
-		
-		// Hour, 0-23
-		timeInfo.tm_hour = static_cast<int>(StringToNum(snortTimestamp.substr(6,2)));
-		
-		// Minute, 0-59
-		timeInfo.tm_min = static_cast<int>(StringToNum(snortTimestamp.substr(9,2)));
-		
-		// Seconds, 0-59 (integer portion only)
-		timeInfo.tm_sec = static_cast<int>(StringToNum(snortTimestamp.substr(12,2)));
-		
-		// Convert this struct back to a time_t value
-		timeInSec = mktime(&timeInfo);
-		
-		// Tack on the fractional seconds
-		timestampNum = timeInSec + StringToNum(snortTimestamp.substr(14));
+		timeOffset = (_ParseDigits(begin,end,3,2) - 1) * 86400L
+					 + _ParseDigits(begin,end,6,2) * 3600L
+					 + _ParseDigits(begin,end,9,2) * 60L
+					 + _ParseDigits(begin,end,12,2);
+		fraction = begin + 14;
 		
 		// Tell our caller that we didn't have the year
 		noticeCode = static_cast<NoticeCode>(static_cast<int>(noticeCode) | kNoticeMissingYear);
 	}
-	else
+	else if (end - begin >= 17)
 	{
 		// Second format for the timestamp
-		
-		// Month, 0-11
-		timeInfo.tm_mon = static_cast<int>(StringToNum(snortTimestamp.substr(0,2)) - 1);
-		
-		// Day, 1-31
-		timeInfo.tm_mday = static_cast<int>(StringToNum(snortTimestamp.substr(3,2)));
-		
-		// Year - 1900
-		timeInfo.tm_year = static_cast<int>(StringToNum(snortTimestamp.substr(6,2)));
-		if (timeInfo.tm_year < 50)
+		year = _ParseDigits(begin,end,6,2);
+		if (year < 50)
 		{
 			// Assume it's later than 2000
-			timeInfo.tm_year += 100;
+			year += 100;
 		}
 		
-		// Hour, 0-23
-		timeInfo.tm_hour = static_cast<int>(StringToNum(snortTimestamp.substr(9,2)));
-		
-		// Minute, 0-59
-		timeInfo.tm_min = static_cast<int>(StringToNum(snortTimestamp.substr(12,2)));
-		
-		// Seconds, 0-59 (integer portion only)
-		timeInfo.tm_sec = static_cast<int>(StringToNum(snortTimestamp.substr(15,2)));
-		
-		// Convert this struct back to a time_t value
-		timeInSec = mktime(&timeInfo);
+		timeOffset = (_ParseDigits(begin,end,3,2) - 1) * 86400L
+					 + _ParseDigits(begin,end,9,2) * 3600L
+					 + _ParseDigits(begin,end,12,2) * 60L
+					 + _ParseDigits(begin,end,15,2);
+		fraction = begin + 17;
+	}
+	
+	if (fraction)
+	{
+		timestampNum = static_cast<double>(_MonthBase(year,_ParseDigits(begin,end,0,2) - 1)) + timeOffset;
 		
 		// Tack on the fractional seconds
-		timestampNum = timeInSec + StringToNum(snortTimestamp.substr(17));
+		if (fraction < end && *fraction == '.')
+		{
+			unsigned long	fractionValue = 0;
+			unsigned long	fractionDivisor = 1;
+			
+			for (++fraction; fraction < end && fractionDivisor < 1000000000UL && isdigit(static_cast<unsigned char>(*fraction)); ++fraction)
+			{
+				fractionValue = fractionValue * 10 + (*fraction - '0');
+				fractionDivisor *= 10;
+			}
+			
+			timestampNum += static_cast<double>(fractionValue) / fractionDivisor;
+		}
 	}
 	
 	return timestampNum;
 }
 
 //---------------------------------------------------------------------
-// TParserAttackLog::_PopulateXMLMessage (static protected)
+// TSnortTimeBase::_MonthBase (protected)
 //---------------------------------------------------------------------
-void TParserAttackLog::_PopulateXMLMessage (SnortIncidentFieldMap& fieldMap,
-											TMessageNode& parentNode,
-											const string& outputFormat)
+time_t TSnortTimeBase::_MonthBase (int year, int month)
 {
-	TMessageNode		entryNode(parentNode.Append(kXMLTagNIDSLogEntry,"",""));
-	TMessageNode		typeNode(entryNode.Append(kXMLTagLogEntryType,"",""));
-	TMessageNode		netNode(entryNode.Append(kXMLTagPacketInfo,"",""));
-	TMessageNode		sourceNode(netNode.Append(kXMLTagNetworkSource,"",""));
-	TMessageNode		destNode(netNode.Append(kXMLTagNetworkDestination,"",""));
-	
-	entryNode.AddAttribute(kXMLAttributeSnortTimestamp,fieldMap[kSnortIncidentTimestamp]);
-	entryNode.AddAttribute(kXMLAttributePriority,fieldMap[kSnortIncidentPriority]);
-	
-	typeNode.AddAttribute(kXMLAttributeSnortID,fieldMap[kSnortIncidentID]);
-	
-	netNode.AddAttribute(kXMLAttributeNetworkProtocol,fieldMap[kSnortIncidentProtocol]);
-	netNode.AddAttribute(kXMLAttributeDevice,fieldMap[kSnortIncidentInterface]);
+	if (year != fCachedYear || month != fCachedMonth)
+	{
+		struct tm	timeInfo(fNowInfo);
+		
+		timeInfo.tm_year = year;
+		timeInfo.tm_mon = month;
+		timeInfo.tm_mday = 1;
+		timeInfo.tm_hour = 0;
+		timeInfo.tm_min = 0;
+		timeInfo.tm_sec = 0;
+		
+		fCachedBase = mktime(&timeInfo);
+		fCachedYear = year;
+		fCachedMonth = month;
+	}
 	
-	sourceNode.AddAttribute(kXMLAttributeIPAddress,fieldMap[kSnortIncidentSourceIPAddress]);
-	sourceNode.AddAttribute(kXMLAttributePort,fieldMap[kSnortIncidentSourcePort]);
+	return fCachedBase;
+}
+
+//---------------------------------------------------------------------
+// TSnortTimeBase::_ParseDigits (static protected)
+//---------------------------------------------------------------------
+int TSnortTimeBase::_ParseDigits (const char* begin, const char* end, unsigned long offset, unsigned long count)
+{
+	int		value = 0;
 	
-	destNode.AddAttribute(kXMLAttributeIPAddress,fieldMap[kSnortIncidentDestinationIPAddress]);
-	destNode.AddAttribute(kXMLAttributePort,fieldMap[kSnortIncidentDestinationPort]);
+	for (const char* p = begin + offset; p < end && p < begin + offset + count && isdigit(static_cast<unsigned char>(*p)); p++)
+		value = value * 10 + (*p - '0');
 	
-	if (outputFormat != kMessageAttributeValueCompact)
-	{
-		typeNode.AddAttribute(kXMLAttributeSnortDescription,fieldMap[kSnortIncidentDescription]);
-		typeNode.AddAttribute(kXMLAttributeSnortClassification,fieldMap[kSnortIncidentClassification]);
-	}
+	return value;
 }
 
 //*********************************************************************
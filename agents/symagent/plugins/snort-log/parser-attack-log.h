@@ -57,12 +57,27 @@ typedef	enum
 				kSnortIncidentSourceIPAddress,
 				kSnortIncidentSourcePort,
 				kSnortIncidentDestinationIPAddress,
-				kSnortIncidentDestinationPort
+				kSnortIncidentDestinationPort,
+				kSnortIncidentFieldCount
 			}	SnortIncidentFieldCode;
 
-typedef	map<SnortIncidentFieldCode,string>				SnortIncidentFieldMap;
-typedef	SnortIncidentFieldMap::iterator					SnortIncidentFieldMap_iter;
-typedef	SnortIncidentFieldMap::const_iterator			SnortIncidentFieldMap_const_iter;
+typedef	struct
+			{
+				const char*			begin;
+				const char*			end;
+			}	SnortFieldSlice;
+	// A field within a log line, referenced in place; begin == end
+	// means the field was not present
+
+typedef	struct
+			{
+				SnortFieldSlice		fields[kSnortIncidentFieldCount];
+				double				timestamp;
+				bool				hasTimestamp;
+			}	SnortIncidentFields;
+	// All of the fields parsed from one log line; the timestamp slot
+	// in fields[] is unused as the converted value lives in timestamp,
+	// which is only meaningful if hasTimestamp is true
 
 typedef	enum
 		{
@@ -131,6 +146,44 @@ class TNotices
 		
 };
 
+//---------------------------------------------------------------------
+// Class TSnortTimeBase
+//---------------------------------------------------------------------
+class TSnortTimeBase
+{
+	public:
+		
+		TSnortTimeBase ();
+			// Constructor
+		
+		~TSnortTimeBase () {}
+			// Destructor
+		
+		double TimestampToNum (const char* begin, const char* end, NoticeCode& noticeCode);
+			// Converts a snort timestamp in the form MM/DD-HH:MM:SS.SSSSSS
+			// or MM/DD/YY-HH:MM:SS.SSSSSS to a double, like CurrentMilliseconds().
+			// Only the first timestamp seen for a given year and month
+			// requires a call to mktime(); the rest are simple arithmetic
+			// against the cached start of that month.
+	
+	protected:
+		
+		time_t _MonthBase (int year, int month);
+			// Returns the time_t value for midnight on the first day of
+			// the given month, caching the result.
+		
+		static int _ParseDigits (const char* begin, const char* end, unsigned long offset, unsigned long count);
+			// Returns the integer value of the count digits found at offset
+			// within the given range.  Non-digit characters end the parse.
+	
+	protected:
+		
+		struct tm										fNowInfo;
+		int												fCachedYear;
+		int												fCachedMonth;
+		time_t											fCachedBase;
+};
+
 //---------------------------------------------------------------------
 // Class TParserAttackLog
 //---------------------------------------------------------------------
@@ -166,29 +219,44 @@ class TParserAttackLog : public TTaskBase
 	
 	protected:
 		
-		static void _ParseOneLine (const string& logLine, SnortIncidentFieldMap& fieldMap, NoticeCode& noticeCodes);
-			// Parses the given logLine into fields and then into
-			// a snort field map.  fieldMap is destructively modified
-			// to contain the results.
+		static void _ParseOneLine (const char* lineBegin,
+								   const char* lineEnd,
+								   TSnortTimeBase& timeBase,
+								   SnortIncidentFields& incidentFields,
+								   NoticeCode& noticeCodes);
+			// Parses the given log line into fields in a single pass,
+			// without copying any of the line's text.  incidentFields
+			// is destructively modified to contain slices of the line.
+		
+		static void _TrimSlice (SnortFieldSlice& slice);
+			// Removes whitespace from the beginning and end of the slice.
 		
-		static void _RemoveEnclosingChars (string& s, char beginningChar, char endingChar);
+		static void _RemoveEnclosingChars (SnortFieldSlice& slice, char beginningChar, char endingChar);
 			// Removes characters from beginning and end of the given
-			// string, destructively modifying it.
+			// slice, destructively modifying it.
 		
-		static string _WithRemovedChars (const string& s, const string& charBag);
-			// Removes characters found in charBag from the string s, returning
-			// the results.
+		static const char* _FindInSlice (const SnortFieldSlice& slice, const char* pattern);
+			// Returns a pointer to the first occurrence of pattern within
+			// slice, or slice.end if it is not found.
 		
-		static double _SnortTimestampToNum (const string& snortTimestamp, NoticeCode& noticeCode);
-			// Converts a snort timestamp in the form MM/DD-HH:MM:SS.SSSSSS
-			// to a double, like CurrentMilliseconds().
+		static bool _NextToken (const char*& cursor, const char* end, char delimiter, SnortFieldSlice& token);
+			// Sets token to the next run of non-delimiter characters at
+			// or after cursor, advancing cursor past it.  Returns false if
+			// there are no more tokens.
+		
+		static string _SliceToString (const SnortFieldSlice& slice);
+			// Returns a temporary string containing a copy of the slice.
+		
+		static string _SliceToJoinedString (const SnortFieldSlice& slice);
+			// Returns a temporary string containing the space-delimited
+			// words within the slice, each separated by a single space.
 		
-		static void _PopulateXMLMessage (SnortIncidentFieldMap& fieldMap,
+		static void _PopulateXMLMessage (const SnortIncidentFields& incidentFields,
 										 TMessageNode& parentNode,
 										 const string& outputFormat);
 			// Creates a message suitable for the server out of the given
-			// fieldMap data, destructively modifying messageObj to contain
-			// that message.
+			// incidentFields data, destructively modifying parentNode to
+			// contain that message.
 	
 	protected:
 		
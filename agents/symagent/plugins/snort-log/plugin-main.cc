@@ -341,6 +341,13 @@ bool SnortLogCallback (const string& filePath,
 			}
 		}
 		
+		{
+			TLockedPthreadMutexObj	lock(gModGlobalsMutex);
+			
+			// Keep the journaled resume point behind any partial line
+			SetFileWatcherUnclaimedByteCount(taskRef,gModGlobalsPtr->info[taskRef].unclaimedData.length());
+		}
+		
 		if (!newLogData.empty())
 		{
 			// debugString = "DEBUG: SnortLogCallback: Pre TParserAttackLog";
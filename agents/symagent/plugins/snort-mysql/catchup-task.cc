@@ -22,8 +22,6 @@
 #include "catchup-task.h"
 #include "plugin-utils.h"
 
-#include <mysql/mysql.h>
-
 //*********************************************************************
 // Class TCatchUpTask
 //*********************************************************************
@@ -105,136 +103,145 @@ void TCatchUpTask::SetupTask (const string& db,
 //---------------------------------------------------------------------
 void TCatchUpTask::RunTask ()
 {
-	TServerMessage		messageObj;
-	TServerReply		  replyObj;
-	
+  bool moreEvents = true;
+
   // Create our thread environment
 	CreateModEnviron(fParentEnvironPtr);
 
   WriteToMessagesLog("in CatchUp RunTask");
   
-  if (DoPluginEventLoop()) {
-		Main(messageObj);
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
+  // Send one batch per message; keep going while batches come back full
+  while (moreEvents && DoPluginEventLoop()) {
+    TServerMessage		messageObj;
+    TServerReply		  replyObj;
+    string            batchMaxCid;
+    unsigned long     eventCount = 0;
+
+    if (!Main(messageObj, batchMaxCid, eventCount)) {
+      // Nothing to send; try again on the next run
+      moreEvents = false;
+    } else if (SendToServer(messageObj,replyObj) == kResponseCodeOK) {
+      // Only now is it safe to move past these events
+      if (eventCount > 0) {
+        fmaxCid.assign(batchMaxCid);
+      }
+      moreEvents = (eventCount >= kSnortEventBatchSize);
+    } else {
+      WriteToErrorLog("Catch up batch not accepted by server; will resend below cid " + fmaxCid);
+      moreEvents = false;
+    }
   }
 
+  WriteToMessagesLog(" CatchUp fmaxCid: " + fmaxCid);
+  WriteToMessagesLog("CatchUp fminCid: " + fminCid);
+
   WriteToMessagesLog("done with CatchUp RunTask");
 }
 
 //---------------------------------------------------------------------
 // TCatchUpTask::Main
 //---------------------------------------------------------------------
-void TCatchUpTask::Main (TServerMessage& messageObj)
+bool TCatchUpTask::Main (TServerMessage& messageObj, string& maxCid, unsigned long& eventCount)
 {
     WriteToMessagesLog("In CatchUp Main");
     WriteToMessagesLog("CatchUp fmaxCid: " + fmaxCid);
     WriteToMessagesLog("CatchUp fminCid: " + fminCid);
     TMessageNode  eventListNode(messageObj.Append("EVENT_LIST", "", ""));
 
-    MYSQL       *conn;
-    MYSQL_RES   *result;
-    MYSQL_ROW   row;
+    MySQLParamList  paramList;
+    std::string     query = GetQuery(paramList);
+    StdStringList   row;
+    unsigned long   counter = 0;
+    bool            success = false;
+
+    try
+    {
+        // Connections and their prepared statements are shared by all of
+        // the plugin's tasks and live across runs
+        TMySQLConnectionLease   connLease(fserverName, fuserName, fpassword, fdbName);
+
+        if (!connLease->Execute(query, paramList)) {
+            connLease.MarkFailed();
+            return false;
+        }
 
-    // TODO: Maybe we should cache this connection
-    conn = mysql_init(NULL);
+        if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication) {
+            WriteToMessagesLog("Catch Up query:");
+            WriteToMessagesLog(query);
+        }
 
-    if (conn == NULL) {
-        WriteToErrorLog("MySQL init ERROR");
-    }
+        // Rows are streamed from the server one at a time; the batch
+        // limit in the query bounds how much we hold in the message
+        while (connLease->FetchRow(row) && row.size() >= 7) {
+            const string& cid(row[0]);
+            const string& sig(row[1]);
+            const string& timestamp(row[2]);
+            const string& ip_src(row[3]);
+            const string& ip_dst(row[4]);
+            const string& class_id(row[5]);
+            const string& priority(row[6]);
+
+            TMessageNode eventNode(eventListNode.Append("EVENT","",""));
+
+            eventNode.AddAttribute("cid", cid);
+            eventNode.AddAttribute("sig", sig);
+            eventNode.AddAttribute("src", ip_src);
+            eventNode.AddAttribute("dst", ip_dst);
+            eventNode.AddAttribute("timestamp", timestamp);
+            eventNode.AddAttribute("class_id", class_id);
+            eventNode.AddAttribute("priority", priority);
+
+            // Rows arrive in descending cid order, so the last one seen
+            // is the new upper bound
+            maxCid.assign(cid);
+
+            counter++;
+        }
 
+        if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication) {
+            WriteToMessagesLog("After query: " + NumToString(counter) + " events");
+        }
 
-    if (mysql_real_connect(conn, fserverName.c_str(), fuserName.c_str(), fpassword.c_str(), fdbName.c_str(), 0, NULL, 0) == NULL) {
-        WriteToErrorLog("MySQL connect ERROR"); 
+        success = true;
     }
-   
-
-    /* 
-     * Make sure this query is good.  segfault otherwise.
-     * TODO: Figure out the right way to handle bad queries (try/catch, etc.)
-     *
-     */
-    
-    /*std::string query =  "select inet_ntoa(iphdr.ip_src), inet_ntoa(iphdr.ip_dst), signature.sig_sid, signature.sig_name, count(*) "; 
-                query += "as sum from event, signature, iphdr where event.timestamp >= \"";
-                query += fstartTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and event.timestamp < \"";
-                query += fendTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and iphdr.cid = event.cid and signature.sig_id = event.signature group by ip_src, ip_dst, sig_name order by count(*) desc";
-                */
-
-    std::string query = GetQuery();
-    
-    mysql_query(conn, query.c_str());
-    WriteToMessagesLog("Catch Up query:");
-    WriteToMessagesLog(query);
-   
-    result = mysql_store_result(conn);
-   
-    int i_fmaxCid = static_cast<int>(StringToNum(fmaxCid));
-
-    while ((row = mysql_fetch_row(result))) {
-        string cid(row[0]);
-        string sig(row[1]);
-        string timestamp(row[2]);
-        string ip_src(row[3]);
-        string ip_dst(row[4]);
-        string class_id(row[5]);
-        string priority(row[6]);
-        
-        TMessageNode eventNode(eventListNode.Append("EVENT","",""));
-        
-        eventNode.AddAttribute("cid", cid);
-        eventNode.AddAttribute("sig", sig);
-        eventNode.AddAttribute("src", ip_src);
-        eventNode.AddAttribute("dst", ip_dst);
-        eventNode.AddAttribute("timestamp", timestamp);
-        eventNode.AddAttribute("class_id", class_id);
-        eventNode.AddAttribute("priority", priority);
-
-
-        int i_cid = static_cast<int>(StringToNum(cid));
-
-        if (i_cid < i_fmaxCid) {
-          i_fmaxCid = i_cid;
-        }
+    catch (TSymLibErrorObj& errObj)
+    {
+        WriteToErrorLog(errObj.GetDescription());
     }
 
-    WriteToMessagesLog("After query: ");
-
-    fmaxCid.assign(IntToString(i_fmaxCid));
+    WriteToMessagesLog("Done with CatchUp Main");
 
-    WriteToMessagesLog(" CatchUp fmaxCid: " + fmaxCid);
-    WriteToMessagesLog("CatchUp fminCid: " + fminCid);
+    eventCount = counter;
 
-    mysql_free_result(result);
-    mysql_close(conn);
-    WriteToMessagesLog("Done with CatchUp Main");
+    return success;
 }
 
 //---------------------------------------------------------------------
 // TCatchUpTask::GetQuery
 //---------------------------------------------------------------------
-std::string TCatchUpTask::GetQuery ()
+std::string TCatchUpTask::GetQuery (MySQLParamList& paramList)
 {
     std::string query;
     std::string direction = " desc ";
-    std::string limit = " limit 1000 ";
 
     // Swap min and max for catchup logic
     //fmaxCid.swap(fminCid);
 
     query = "select event.cid, signature.sig_name, event.timestamp, inet_ntoa(iphdr.ip_src), inet_ntoa(iphdr.ip_dst), signature.sig_class_id, signature.sig_priority from event, signature, iphdr where iphdr.cid = event.cid and event.signature = signature.sig_id";
-    
-    query += " and event.cid >= ";
-    query += fminCid.c_str();
-    
-    query += " and event.cid < ";
-    query+= fmaxCid.c_str();
+
+    query += " and event.cid >= ?";
+    query += " and event.cid < ?";
 
     query += " order by event.cid ";
     query += direction;
 
-    query += limit;
+    // Keyset pagination:  each batch ends just below the last one sent
+    query += " limit ?";
+
+    paramList.clear();
+    paramList.push_back(static_cast<unsigned long long>(StringToNum(fminCid)));
+    paramList.push_back(static_cast<unsigned long long>(StringToNum(fmaxCid)));
+    paramList.push_back(kSnortEventBatchSize);
+
     return query;
 }
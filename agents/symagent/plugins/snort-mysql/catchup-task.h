@@ -25,7 +25,7 @@
 
 #include "plugin-defs.h"
 #include "plugin-utils.h"
-#include <mysql/mysql.h>
+#include "mysql-pool.h"
 //---------------------------------------------------------------------
 // Import namespace symbols
 //---------------------------------------------------------------------
@@ -83,12 +83,21 @@ class TCatchUpTask : public TTaskBase
 								time_t scanInterval = 10);
 		
 		virtual void RunTask ();
-			// Thread entry point for the task.  Really just a wrapper for Main().
+			// Thread entry point for the task.  Calls Main() and sends the
+			// result to the server repeatedly until a partial batch is seen.
 		
-		virtual void Main (TServerMessage& messageObj);
-			// ¥¥¥
+		virtual bool Main (TServerMessage& messageObj, string& maxCid, unsigned long& eventCount);
+			// Streams at most kSnortEventBatchSize events below fmaxCid,
+			// newest first, into messageObj.  The lowest cid in the batch is
+			// returned in maxCid and the number of events in eventCount;
+			// fmaxCid is not changed here, so that it only moves once the
+			// server has accepted the batch.  Returns false if the events
+			// could not be queried, in which case messageObj should not
+			// be sent.
 		
-    virtual std::string GetQuery ();
+    virtual std::string GetQuery (MySQLParamList& paramList);
+      // Returns the prepared statement text for this task, destructively
+      // modifying paramList to contain the values for its placeholders.
 
 	protected:
 		
@@ -98,8 +107,6 @@ class TCatchUpTask : public TTaskBase
 		string									  fpassword;
     string                    fmaxCid;
     string                    fminCid;
-
-    MYSQL                     fconn;
 		ModEnviron*								fParentEnvironPtr;
 			
 };
@@ -22,8 +22,6 @@
 #include "gather-task.h"
 #include "plugin-utils.h"
 
-#include <mysql/mysql.h>
-
 //*********************************************************************
 // Class TGatherEventsTask
 //*********************************************************************
@@ -105,143 +103,144 @@ void TGatherEventsTask::SetupTask (const string& db,
 //---------------------------------------------------------------------
 void TGatherEventsTask::RunTask ()
 {
-	TServerMessage		messageObj;
-	TServerReply		  replyObj;
-	
+  bool moreEvents = true;
+
   // Create our thread environment
 	CreateModEnviron(fParentEnvironPtr);
 
   WriteToMessagesLog("in RunTask");
   
-  if (DoPluginEventLoop()) {
-		Main(messageObj);
-		// Send it to the server
-		SendToServer(messageObj,replyObj);
+  // Send one batch per message; keep going while batches come back full
+  while (moreEvents && DoPluginEventLoop()) {
+    TServerMessage		messageObj;
+    TServerReply		  replyObj;
+    string            batchMaxCid;
+    string            batchMinCid;
+    unsigned long     eventCount = 0;
+
+    if (!Main(messageObj, batchMaxCid, batchMinCid, eventCount)) {
+      // Nothing to send; try again on the next run
+      moreEvents = false;
+    } else if (SendToServer(messageObj,replyObj) == kResponseCodeOK) {
+      // Only now is it safe to move past these events
+      if (eventCount > 0) {
+        fmaxCid.assign(batchMaxCid);
+        fminCid.assign(batchMinCid);
+      }
+      moreEvents = (eventCount >= kSnortEventBatchSize);
+    } else {
+      WriteToErrorLog("Event batch not accepted by server; will resend after cid " + fmaxCid);
+      moreEvents = false;
+    }
   }
 
+  WriteToMessagesLog("fmaxCid: " + fmaxCid);
+  WriteToMessagesLog("fminCid: " + fminCid);
+
   WriteToMessagesLog("done with RunTask");
 }
 
 //---------------------------------------------------------------------
 // TGatherEventsTask::Main
 //---------------------------------------------------------------------
-void TGatherEventsTask::Main (TServerMessage& messageObj)
+bool TGatherEventsTask::Main (TServerMessage& messageObj, string& maxCid, string& minCid, unsigned long& eventCount)
 {
     WriteToMessagesLog("In GatherTasks Main");
     WriteToMessagesLog("fmaxCid: " + fmaxCid);
     WriteToMessagesLog("fminCid: " + fminCid);
     TMessageNode  eventListNode(messageObj.Append("EVENT_LIST", "", ""));
 
-    MYSQL       *conn;
-    MYSQL_RES   *result;
-    MYSQL_ROW   row;
-
-    // TODO: Maybe we should cache this connection
-    conn = mysql_init(NULL);
-
-    if (conn == NULL) {
-        WriteToErrorLog("MySQL init ERROR");
-    }
+    MySQLParamList  paramList;
+    std::string     query = GetQuery(paramList);
+    StdStringList   row;
+    unsigned long   counter = 0;
+    bool            success = false;
+
+    try
+    {
+        // Connections and their prepared statements are shared by all of
+        // the plugin's tasks and live across runs
+        TMySQLConnectionLease   connLease(fserverName, fuserName, fpassword, fdbName);
+
+        if (!connLease->Execute(query, paramList)) {
+            connLease.MarkFailed();
+            return false;
+        }
 
+        if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication) {
+            WriteToMessagesLog("query:");
+            WriteToMessagesLog(query);
+        }
 
-    if (mysql_real_connect(conn, fserverName.c_str(), fuserName.c_str(), fpassword.c_str(), fdbName.c_str(), 0, NULL, 0) == NULL) {
-        WriteToErrorLog("MySQL connect ERROR"); 
-    }
-   
-
-    /* 
-     * Make sure this query is good.  segfault otherwise.
-     * TODO: Figure out the right way to handle bad queries (try/catch, etc.)
-     *
-     */
-    
-    /*std::string query =  "select inet_ntoa(iphdr.ip_src), inet_ntoa(iphdr.ip_dst), signature.sig_sid, signature.sig_name, count(*) "; 
-                query += "as sum from event, signature, iphdr where event.timestamp >= \"";
-                query += fstartTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and event.timestamp < \"";
-                query += fendTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and iphdr.cid = event.cid and signature.sig_id = event.signature group by ip_src, ip_dst, sig_name order by count(*) desc";
-                */
-
-    std::string query = GetQuery();
-    
-    mysql_query(conn, query.c_str());
-    WriteToMessagesLog("query:");
-    WriteToMessagesLog(query);
-   
-    result = mysql_store_result(conn);
-   
-    int min_cid = 0;
-    int max_cid = 0;
-
-    int counter = 0;
-
-    while ((row = mysql_fetch_row(result))) {
-        string cid(row[0]);
-        string sig(row[1]);
-        string timestamp(row[2]);
-        string ip_src(row[3]);
-        string ip_dst(row[4]);
-        string class_id(row[5]);
-        string priority(row[6]);
-        
-        TMessageNode eventNode(eventListNode.Append("EVENT","",""));
-        
-        eventNode.AddAttribute("cid", cid);
-        eventNode.AddAttribute("sig", sig);
-        eventNode.AddAttribute("src", ip_src);
-        eventNode.AddAttribute("dst", ip_dst);
-        eventNode.AddAttribute("timestamp", timestamp);
-        eventNode.AddAttribute("class_id", class_id);
-        eventNode.AddAttribute("priority", priority);
-
-
-        int i_cid = static_cast<int>(StringToNum(cid));
-
-        if (i_cid < min_cid) {
-          min_cid = i_cid;
+        // Rows are streamed from the server one at a time; the batch
+        // limit in the query bounds how much we hold in the message
+        while (connLease->FetchRow(row) && row.size() >= 7) {
+            const string& cid(row[0]);
+            const string& sig(row[1]);
+            const string& timestamp(row[2]);
+            const string& ip_src(row[3]);
+            const string& ip_dst(row[4]);
+            const string& class_id(row[5]);
+            const string& priority(row[6]);
+
+            TMessageNode eventNode(eventListNode.Append("EVENT","",""));
+
+            eventNode.AddAttribute("cid", cid);
+            eventNode.AddAttribute("sig", sig);
+            eventNode.AddAttribute("src", ip_src);
+            eventNode.AddAttribute("dst", ip_dst);
+            eventNode.AddAttribute("timestamp", timestamp);
+            eventNode.AddAttribute("class_id", class_id);
+            eventNode.AddAttribute("priority", priority);
+
+            // Rows arrive in ascending cid order
+            if (counter == 0) {
+              minCid.assign(cid);
+            }
+            maxCid.assign(cid);
+
+            counter++;
         }
-     
-        if (i_cid > max_cid) {
-          max_cid = i_cid;
+
+        if ((GetDynamicDebuggingFlags() & kDynDebugLogServerCommunication) == kDynDebugLogServerCommunication) {
+            WriteToMessagesLog("After query: " + NumToString(counter) + " events");
         }
 
-        counter++;
+        success = true;
     }
-
-    WriteToMessagesLog("After query: ");
-    WriteToMessagesLog("max cid: " + IntToString(max_cid));
-    WriteToMessagesLog("min cid: " + IntToString(min_cid));
-
-    // If we got at least one result, let's use the cids as our new max and min.
-    if (counter > 0) {
-      fmaxCid.assign(IntToString(max_cid));
-      fminCid.assign(IntToString(min_cid));
+    catch (TSymLibErrorObj& errObj)
+    {
+        WriteToErrorLog(errObj.GetDescription());
     }
-   
-    WriteToMessagesLog("fmaxCid: " + fmaxCid);
-    WriteToMessagesLog("fminCid: " + fminCid);
 
-    mysql_free_result(result);
-    mysql_close(conn);
     WriteToMessagesLog("Done with GatherTasks Main");
+
+    eventCount = counter;
+
+    return success;
 }
 
 //---------------------------------------------------------------------
 // TGatherEventsTask::GetQuery
 //---------------------------------------------------------------------
-std::string TGatherEventsTask::GetQuery ()
+std::string TGatherEventsTask::GetQuery (MySQLParamList& paramList)
 {
     std::string query;
     std::string direction = "asc";
 
     query = "select event.cid, signature.sig_name, event.timestamp, inet_ntoa(iphdr.ip_src), inet_ntoa(iphdr.ip_dst), signature.sig_class_id, signature.sig_priority from event, signature, iphdr where iphdr.cid = event.cid and event.signature = signature.sig_id";
-    
-    query += " and event.cid > ";
-    query += fmaxCid.c_str();
-    
+
+    query += " and event.cid > ?";
+
     query += " order by event.cid ";
     query += direction;
 
+    // Keyset pagination:  each batch starts just past the last one sent
+    query += " limit ?";
+
+    paramList.clear();
+    paramList.push_back(static_cast<unsigned long long>(StringToNum(fmaxCid)));
+    paramList.push_back(kSnortEventBatchSize);
+
     return query;
 }
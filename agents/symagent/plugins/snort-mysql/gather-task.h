@@ -29,7 +29,7 @@
 
 #include "plugin-defs.h"
 #include "plugin-utils.h"
-#include <mysql/mysql.h>
+#include "mysql-pool.h"
 //---------------------------------------------------------------------
 // Import namespace symbols
 //---------------------------------------------------------------------
@@ -87,12 +87,21 @@ class TGatherEventsTask : public TTaskBase
 								time_t scanInterval = 1);
 		
 		virtual void RunTask ();
-			// Thread entry point for the task.  Really just a wrapper for Main().
+			// Thread entry point for the task.  Calls Main() and sends the
+			// result to the server repeatedly until a partial batch is seen.
 		
-		virtual void Main (TServerMessage& messageObj);
-			// ¥¥¥
+		virtual bool Main (TServerMessage& messageObj, string& maxCid, string& minCid, unsigned long& eventCount);
+			// Streams at most kSnortEventBatchSize events newer than fmaxCid
+			// into messageObj.  The highest and lowest cids in the batch are
+			// returned in maxCid and minCid and the number of events in
+			// eventCount; fmaxCid is not changed here, so that it only
+			// advances once the server has accepted the batch.  Returns
+			// false if the events could not be queried, in which case
+			// messageObj should not be sent.
 		
-    virtual std::string GetQuery ();
+    virtual std::string GetQuery (MySQLParamList& paramList);
+      // Returns the prepared statement text for this task, destructively
+      // modifying paramList to contain the values for its placeholders.
 
 	protected:
 		
@@ -103,8 +112,6 @@ class TGatherEventsTask : public TTaskBase
     string                    fmaxCid;
     string                    fminCid;
     bool                      fcatchUp; 
-
-    MYSQL                     fconn;
 		ModEnviron*								fParentEnvironPtr;
 			
 };
@@ -0,0 +1,553 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Pooled MySQL connections for the snort-mysql plugin tasks
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					07 Mar 2005
+#		Last Modified:				07 Mar 2005
+#		
+#######################################################################
+*/
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "mysql-pool.h"
+
+#include <mysql/errmsg.h>
+
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static TMySQLConnectionPool							gMySQLConnectionPool;
+
+//*********************************************************************
+// Class TMySQLConnection
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TMySQLConnection::TMySQLConnection (const string& server,
+									const string& user,
+									const string& pass,
+									const string& db)
+	:	fServer(server),
+		fUser(user),
+		fPass(pass),
+		fDB(db),
+		fConnPtr(NULL),
+		fActiveStatementPtr(NULL),
+		fLastUsedTime(0)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TMySQLConnection::~TMySQLConnection ()
+{
+	Close();
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::Connect
+//---------------------------------------------------------------------
+void TMySQLConnection::Connect ()
+{
+	Close();
+	
+	fConnPtr = mysql_init(NULL);
+	if (!fConnPtr)
+		throw TSymLibErrorObj(kErrorMySQLConnectFailed,"MySQL init ERROR");
+		
+	if (mysql_real_connect(fConnPtr,fServer.c_str(),fUser.c_str(),fPass.c_str(),fDB.c_str(),0,NULL,0) == NULL)
+	{
+		string	errString("MySQL connect ERROR: ");
+		
+		errString += mysql_error(fConnPtr);
+		mysql_close(fConnPtr);
+		fConnPtr = NULL;
+		
+		throw TSymLibErrorObj(kErrorMySQLConnectFailed,errString);
+	}
+	
+	MarkUsed();
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::Close
+//---------------------------------------------------------------------
+void TMySQLConnection::Close ()
+{
+	FinishResult();
+	
+	for (PreparedStatementMap_iter x = fStatementMap.begin(); x != fStatementMap.end(); x++)
+	{
+		if (x->second.stmtPtr)
+			mysql_stmt_close(x->second.stmtPtr);
+	}
+	fStatementMap.clear();
+	
+	if (fConnPtr)
+	{
+		mysql_close(fConnPtr);
+		fConnPtr = NULL;
+	}
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::IsUsable
+//---------------------------------------------------------------------
+bool TMySQLConnection::IsUsable ()
+{
+	bool	isUsable = (fConnPtr != NULL);
+	
+	if (isUsable && time(NULL) - fLastUsedTime >= kMySQLPoolPingIdleSeconds)
+	{
+		isUsable = (mysql_ping(fConnPtr) == 0);
+		if (isUsable)
+			MarkUsed();
+	}
+	
+	return isUsable;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::Execute
+//---------------------------------------------------------------------
+bool TMySQLConnection::Execute (const string& sql, const MySQLParamList& paramList)
+{
+	bool				executed = false;
+	PreparedStatement*	statementPtr = NULL;
+	unsigned int		errorCode = 0;
+	
+	FinishResult();
+	
+	statementPtr = _Prepare(sql,errorCode);
+	if (statementPtr)
+	{
+		executed = _BindAndExecute(statementPtr,paramList);
+		if (!executed)
+			errorCode = mysql_stmt_errno(statementPtr->stmtPtr);
+	}
+	
+	// An idle pooled connection the server has dropped usually fails in
+	// the prepare of a new statement rather than in the execute
+	if (!executed && _IsConnectionLost(errorCode))
+	{
+		// The server went away; reconnect and try exactly once more.
+		// Reconnecting discards all prepared statements.
+		WriteToMessagesLog("MySQL connection lost; reconnecting");
+		
+		try
+		{
+			Connect();
+			statementPtr = _Prepare(sql,errorCode);
+			if (statementPtr)
+				executed = _BindAndExecute(statementPtr,paramList);
+		}
+		catch (TSymLibErrorObj& errObj)
+		{
+			_LogError("reconnect",errObj.GetDescription());
+		}
+	}
+	
+	if (executed)
+	{
+		fActiveStatementPtr = statementPtr;
+		MarkUsed();
+	}
+	
+	return executed;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::FetchRow
+//---------------------------------------------------------------------
+bool TMySQLConnection::FetchRow (StdStringList& row)
+{
+	bool	fetched = false;
+	
+	row.clear();
+	
+	if (fActiveStatementPtr)
+	{
+		PreparedStatement&	statement(*fActiveStatementPtr);
+		int					result = mysql_stmt_fetch(statement.stmtPtr);
+		
+		if (result == 0 || result == MYSQL_DATA_TRUNCATED)
+		{
+			row.reserve(statement.columnCount);
+			
+			for (unsigned long x = 0; x < statement.columnCount; x++)
+			{
+				if (statement.resultNulls[x])
+				{
+					row.push_back(string());
+				}
+				else if (statement.resultLengths[x] <= kMySQLColumnBufferSize)
+				{
+					row.push_back(string(&statement.resultBuffer[x * kMySQLColumnBufferSize],statement.resultLengths[x]));
+				}
+				else
+				{
+					// Column was truncated; pull the whole thing
+					vector<char>	wideBuffer(statement.resultLengths[x]);
+					MYSQL_BIND		wideBind;
+					
+					memset(&wideBind,0,sizeof(wideBind));
+					wideBind.buffer_type = MYSQL_TYPE_STRING;
+					wideBind.buffer = &wideBuffer[0];
+					wideBind.buffer_length = wideBuffer.size();
+					
+					if (mysql_stmt_fetch_column(statement.stmtPtr,&wideBind,x,0) == 0)
+						row.push_back(string(&wideBuffer[0],wideBuffer.size()));
+					else
+						row.push_back(string(&statement.resultBuffer[x * kMySQLColumnBufferSize],kMySQLColumnBufferSize));
+				}
+			}
+			
+			fetched = true;
+		}
+		else
+		{
+			if (result != MYSQL_NO_DATA)
+				_LogError("fetch",mysql_stmt_error(statement.stmtPtr));
+			FinishResult();
+		}
+	}
+	
+	return fetched;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::FinishResult
+//---------------------------------------------------------------------
+void TMySQLConnection::FinishResult ()
+{
+	if (fActiveStatementPtr)
+	{
+		mysql_stmt_free_result(fActiveStatementPtr->stmtPtr);
+		mysql_stmt_reset(fActiveStatementPtr->stmtPtr);
+		fActiveStatementPtr = NULL;
+	}
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::Matches
+//---------------------------------------------------------------------
+bool TMySQLConnection::Matches (const string& server,
+								const string& user,
+								const string& pass,
+								const string& db) const
+{
+	return (fServer == server && fUser == user && fPass == pass && fDB == db);
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::_Prepare (protected)
+//---------------------------------------------------------------------
+TMySQLConnection::PreparedStatement* TMySQLConnection::_Prepare (const string& sql, unsigned int& errorCode)
+{
+	PreparedStatement*			statementPtr = NULL;
+	PreparedStatementMap_iter	foundIter = fStatementMap.find(sql);
+	
+	errorCode = 0;
+	
+	if (foundIter != fStatementMap.end())
+	{
+		statementPtr = &foundIter->second;
+	}
+	else if (fConnPtr)
+	{
+		MYSQL_STMT*		stmtPtr = mysql_stmt_init(fConnPtr);
+		
+		if (!stmtPtr)
+		{
+			errorCode = mysql_errno(fConnPtr);
+			_LogError("prepare",mysql_error(fConnPtr));
+		}
+		else if (mysql_stmt_prepare(stmtPtr,sql.c_str(),sql.length()) != 0)
+		{
+			errorCode = mysql_stmt_errno(stmtPtr);
+			_LogError("prepare",mysql_stmt_error(stmtPtr));
+			mysql_stmt_close(stmtPtr);
+		}
+		else
+		{
+			MYSQL_RES*	metadataPtr = mysql_stmt_result_metadata(stmtPtr);
+			
+			// Build the statement in place; the result bindings point into
+			// the statement's own buffers, so it must never be copied
+			statementPtr = &fStatementMap[sql];
+			statementPtr->stmtPtr = stmtPtr;
+			statementPtr->columnCount = (metadataPtr ? mysql_num_fields(metadataPtr) : 0);
+			
+			if (metadataPtr)
+				mysql_free_result(metadataPtr);
+				
+			if (statementPtr->columnCount > 0)
+			{
+				statementPtr->resultBinds.resize(statementPtr->columnCount);
+				statementPtr->resultBuffer.resize(statementPtr->columnCount * kMySQLColumnBufferSize);
+				statementPtr->resultLengths.resize(statementPtr->columnCount);
+				statementPtr->resultNulls.resize(statementPtr->columnCount);
+				
+				memset(&statementPtr->resultBinds[0],0,statementPtr->columnCount * sizeof(MYSQL_BIND));
+				for (unsigned long x = 0; x < statementPtr->columnCount; x++)
+				{
+					MYSQL_BIND&		bind(statementPtr->resultBinds[x]);
+					
+					bind.buffer_type = MYSQL_TYPE_STRING;
+					bind.buffer = &statementPtr->resultBuffer[x * kMySQLColumnBufferSize];
+					bind.buffer_length = kMySQLColumnBufferSize;
+					bind.length = &statementPtr->resultLengths[x];
+					bind.is_null = &statementPtr->resultNulls[x];
+				}
+				
+				if (mysql_stmt_bind_result(stmtPtr,&statementPtr->resultBinds[0]) != 0)
+				{
+					errorCode = mysql_stmt_errno(stmtPtr);
+					_LogError("bind result",mysql_stmt_error(stmtPtr));
+					mysql_stmt_close(stmtPtr);
+					fStatementMap.erase(sql);
+					statementPtr = NULL;
+				}
+			}
+		}
+	}
+	
+	return statementPtr;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::_BindAndExecute (protected)
+//---------------------------------------------------------------------
+bool TMySQLConnection::_BindAndExecute (PreparedStatement* statementPtr, const MySQLParamList& paramList)
+{
+	bool				executed = false;
+	MySQLParamList		params(paramList);
+	vector<MYSQL_BIND>	paramBinds(params.size());
+	
+	if (mysql_stmt_param_count(statementPtr->stmtPtr) != params.size())
+	{
+		_LogError("execute","parameter count mismatch");
+	}
+	else
+	{
+		if (!params.empty())
+		{
+			memset(&paramBinds[0],0,params.size() * sizeof(MYSQL_BIND));
+			for (unsigned long x = 0; x < params.size(); x++)
+			{
+				paramBinds[x].buffer_type = MYSQL_TYPE_LONGLONG;
+				paramBinds[x].buffer = &params[x];
+				paramBinds[x].is_unsigned = 1;
+			}
+		}
+		
+		if (!params.empty() && mysql_stmt_bind_param(statementPtr->stmtPtr,&paramBinds[0]) != 0)
+			_LogError("bind param",mysql_stmt_error(statementPtr->stmtPtr));
+		else if (mysql_stmt_execute(statementPtr->stmtPtr) != 0)
+			_LogError("execute",mysql_stmt_error(statementPtr->stmtPtr));
+		else
+			executed = true;
+	}
+	
+	return executed;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::_IsConnectionLost (protected)
+//---------------------------------------------------------------------
+bool TMySQLConnection::_IsConnectionLost (unsigned int errorCode) const
+{
+	return (errorCode == CR_SERVER_GONE_ERROR || errorCode == CR_SERVER_LOST);
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnection::_LogError (protected)
+//---------------------------------------------------------------------
+void TMySQLConnection::_LogError (const string& context, const string& message) const
+{
+	WriteToErrorLog("MySQL " + context + " ERROR: " + message);
+}
+
+//*********************************************************************
+// Class TMySQLConnectionPool
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TMySQLConnectionPool::TMySQLConnectionPool ()
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TMySQLConnectionPool::~TMySQLConnectionPool ()
+{
+	Clear();
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnectionPool::Acquire
+//---------------------------------------------------------------------
+TMySQLConnection* TMySQLConnectionPool::Acquire (const string& server,
+												 const string& user,
+												 const string& pass,
+												 const string& db)
+{
+	TMySQLConnection*	connPtr = NULL;
+	
+	{
+		TLockedPthreadMutexObj	lock(fMutex);
+		
+		for (ConnectionList_iter x = fIdleList.begin(); x != fIdleList.end(); x++)
+		{
+			if ((*x)->Matches(server,user,pass,db))
+			{
+				connPtr = *x;
+				fIdleList.erase(x);
+				break;
+			}
+		}
+	}
+	
+	if (connPtr && !connPtr->IsUsable())
+	{
+		// Stale connection; reconnect it outside the lock
+		try
+		{
+			connPtr->Connect();
+		}
+		catch (...)
+		{
+			delete(connPtr);
+			throw;
+		}
+	}
+	
+	if (!connPtr)
+	{
+		connPtr = new TMySQLConnection(server,user,pass,db);
+		
+		try
+		{
+			connPtr->Connect();
+		}
+		catch (...)
+		{
+			delete(connPtr);
+			throw;
+		}
+	}
+	
+	return connPtr;
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnectionPool::Release
+//---------------------------------------------------------------------
+void TMySQLConnectionPool::Release (TMySQLConnection* connPtr, bool isHealthy)
+{
+	if (connPtr)
+	{
+		connPtr->FinishResult();
+		
+		if (isHealthy)
+		{
+			TLockedPthreadMutexObj	lock(fMutex);
+			
+			if (fIdleList.size() < kMySQLPoolMaxIdleConnections)
+			{
+				fIdleList.push_back(connPtr);
+				connPtr = NULL;
+			}
+		}
+		
+		if (connPtr)
+			delete(connPtr);
+	}
+}
+
+//---------------------------------------------------------------------
+// TMySQLConnectionPool::Clear
+//---------------------------------------------------------------------
+void TMySQLConnectionPool::Clear ()
+{
+	ConnectionList	oldList;
+	
+	{
+		TLockedPthreadMutexObj	lock(fMutex);
+		
+		oldList.swap(fIdleList);
+	}
+	
+	for (ConnectionList_iter x = oldList.begin(); x != oldList.end(); x++)
+		delete(*x);
+}
+
+//*********************************************************************
+// Class TMySQLConnectionLease
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TMySQLConnectionLease::TMySQLConnectionLease (const string& server,
+											  const string& user,
+											  const string& pass,
+											  const string& db)
+	:	fConnPtr(NULL),
+		fIsHealthy(true)
+{
+	// The client library wants per-thread setup in every thread that
+	// touches a connection; task threads come and go, so it is torn
+	// down again when the lease ends
+	mysql_thread_init();
+	
+	try
+	{
+		fConnPtr = GetMySQLConnectionPoolPtr()->Acquire(server,user,pass,db);
+	}
+	catch (...)
+	{
+		mysql_thread_end();
+		throw;
+	}
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TMySQLConnectionLease::~TMySQLConnectionLease ()
+{
+	GetMySQLConnectionPoolPtr()->Release(fConnPtr,fIsHealthy);
+	mysql_thread_end();
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetMySQLConnectionPoolPtr
+//---------------------------------------------------------------------
+TMySQLConnectionPool* GetMySQLConnectionPoolPtr ()
+{
+	return &gMySQLConnectionPool;
+}
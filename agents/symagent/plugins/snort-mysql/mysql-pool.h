@@ -0,0 +1,275 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Pooled MySQL connections for the snort-mysql plugin tasks
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					07 Mar 2005
+#		Last Modified:				07 Mar 2005
+#		
+#######################################################################
+*/
+
+#if !defined(MYSQL_POOL)
+#define MYSQL_POOL
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "plugin-config.h"
+
+#include "plugin-defs.h"
+#include "plugin-utils.h"
+
+#include <mysql/mysql.h>
+
+//---------------------------------------------------------------------
+// Forward Class Declarations
+//---------------------------------------------------------------------
+class TMySQLConnection;
+class TMySQLConnectionPool;
+class TMySQLConnectionLease;
+
+//---------------------------------------------------------------------
+// Definitions
+//---------------------------------------------------------------------
+#define	kMySQLPoolMaxIdleConnections				4
+#define	kMySQLPoolPingIdleSeconds					60
+#define	kMySQLColumnBufferSize						256
+
+#define	kErrorMySQLConnectFailed					-24310
+#define	kErrorMySQLPrepareFailed					-24311
+
+typedef	vector<unsigned long long>					MySQLParamList;
+typedef	MySQLParamList::iterator					MySQLParamList_iter;
+typedef	MySQLParamList::const_iterator				MySQLParamList_const_iter;
+
+//---------------------------------------------------------------------
+// Class TMySQLConnection
+//
+// One authenticated connection to the snort database along with the
+// server-side prepared statements created on it.  Statements are keyed
+// by their SQL text and survive for the life of the connection, so the
+// query is only parsed by the server the first time it is used.
+//---------------------------------------------------------------------
+class TMySQLConnection
+{
+	private:
+		
+		struct	PreparedStatement
+			{
+				MYSQL_STMT*						stmtPtr;
+				unsigned long					columnCount;
+				vector<MYSQL_BIND>				resultBinds;
+				vector<char>					resultBuffer;
+				vector<unsigned long>			resultLengths;
+				vector<my_bool>					resultNulls;
+			};
+			
+		typedef	map<string,PreparedStatement>			PreparedStatementMap;
+		typedef	PreparedStatementMap::iterator			PreparedStatementMap_iter;
+		typedef	PreparedStatementMap::const_iterator	PreparedStatementMap_const_iter;
+		
+	public:
+		
+		TMySQLConnection (const string& server,
+						  const string& user,
+						  const string& pass,
+						  const string& db);
+			// Constructor.  Does not connect; call Connect().
+			
+	private:
+		
+		TMySQLConnection (const TMySQLConnection& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		~TMySQLConnection ();
+			// Destructor
+			
+		void Connect ();
+			// Establishes the connection, closing any existing one first.
+			// Throws an exception on failure.
+			
+		void Close ();
+			// Closes all prepared statements and the connection itself.
+			
+		bool IsUsable ();
+			// Returns true if the connection is open.  Connections that have
+			// been idle for a while are pinged first.
+			
+		bool Execute (const string& sql, const MySQLParamList& paramList);
+			// Executes the statement with the given SQL text, preparing it
+			// first if this connection has not seen it before.  Each '?' in
+			// the SQL is bound, in order, to an unsigned integer from
+			// paramList.  If the server has gone away, whether noticed while
+			// preparing or executing, the connection is reestablished and
+			// the statement retried once.  Returns false
+			// on failure, after logging the reason.
+			
+		bool FetchRow (StdStringList& row);
+			// Fetches the next row from the most recently executed statement,
+			// destructively modifying the argument to contain its columns.
+			// NULL columns are returned as empty strings.  Returns false when
+			// there are no more rows.  Rows are streamed from the server;
+			// they are not buffered on the client.
+			
+		void FinishResult ();
+			// Discards any unread rows from the last executed statement.
+			// Must be called before the connection is used again.
+			
+		bool Matches (const string& server,
+					  const string& user,
+					  const string& pass,
+					  const string& db) const;
+			// Returns true if this connection was made with the given
+			// parameters.
+			
+		// ------------------------------
+		// Accessors
+		// ------------------------------
+		
+		inline void MarkUsed ()
+			{ fLastUsedTime = time(NULL); }
+			
+	protected:
+		
+		PreparedStatement* _Prepare (const string& sql, unsigned int& errorCode);
+			// Returns the cached prepared statement for sql, creating it
+			// if needed.  Returns NULL on failure, with the MySQL error
+			// code in errorCode.
+			
+		bool _BindAndExecute (PreparedStatement* statementPtr, const MySQLParamList& paramList);
+			// Binds the parameters to the statement and executes it.
+			
+		bool _IsConnectionLost (unsigned int errorCode) const;
+			// Returns true if errorCode indicates the server went away.
+			
+		void _LogError (const string& context, const string& message) const;
+			// Writes a MySQL error message to the error log.
+			
+	protected:
+		
+		string											fServer;
+		string											fUser;
+		string											fPass;
+		string											fDB;
+		MYSQL*											fConnPtr;
+		PreparedStatementMap							fStatementMap;
+		PreparedStatement*								fActiveStatementPtr;
+		time_t											fLastUsedTime;
+};
+
+//---------------------------------------------------------------------
+// Class TMySQLConnectionPool
+//---------------------------------------------------------------------
+class TMySQLConnectionPool
+{
+	private:
+		
+		typedef	vector<TMySQLConnection*>				ConnectionList;
+		typedef	ConnectionList::iterator				ConnectionList_iter;
+		typedef	ConnectionList::const_iterator			ConnectionList_const_iter;
+		
+	public:
+		
+		TMySQLConnectionPool ();
+			// Constructor
+			
+	private:
+		
+		TMySQLConnectionPool (const TMySQLConnectionPool& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		~TMySQLConnectionPool ();
+			// Destructor.  Closes all idle connections.
+			
+		TMySQLConnection* Acquire (const string& server,
+								   const string& user,
+								   const string& pass,
+								   const string& db);
+			// Returns a usable connection made with the given parameters,
+			// reusing an idle one if possible.  The caller owns the
+			// connection until it is passed to Release().  Throws an
+			// exception if a new connection cannot be made.  The calling
+			// thread must have called mysql_thread_init(); use
+			// TMySQLConnectionLease rather than calling this directly.
+			
+		void Release (TMySQLConnection* connPtr, bool isHealthy);
+			// Returns a connection to the pool.  Unhealthy connections,
+			// and connections beyond the idle limit, are destroyed.
+			
+		void Clear ();
+			// Destroys all idle connections.
+			
+	protected:
+		
+		ConnectionList									fIdleList;
+		TPthreadMutexObj								fMutex;
+};
+
+//---------------------------------------------------------------------
+// Class TMySQLConnectionLease
+//
+// Scoped holder for a pooled connection, in the spirit of
+// TLockedPthreadMutexObj:  the connection is acquired on construction
+// and returned to the pool on destruction.  The lease also brackets the
+// client library's per-thread state, so only one lease at a time may
+// be held by a thread.
+//---------------------------------------------------------------------
+class TMySQLConnectionLease
+{
+	public:
+		
+		TMySQLConnectionLease (const string& server,
+							   const string& user,
+							   const string& pass,
+							   const string& db);
+			// Constructor.  Throws an exception if no connection can be made.
+			
+	private:
+		
+		TMySQLConnectionLease (const TMySQLConnectionLease& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		~TMySQLConnectionLease ();
+			// Destructor
+			
+		// ------------------------------
+		// Accessors
+		// ------------------------------
+		
+		inline TMySQLConnection* operator-> () const
+			{ return fConnPtr; }
+			
+		inline void MarkFailed ()
+			{ fIsHealthy = false; }
+			
+	protected:
+		
+		TMySQLConnection*								fConnPtr;
+		bool											fIsHealthy;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+TMySQLConnectionPool* GetMySQLConnectionPoolPtr ();
+	// Returns a pointer to the pool shared by all of the plugin's tasks.
+
+//---------------------------------------------------------------------
+#endif // MYSQL_POOL
@@ -43,6 +43,7 @@ using std::vector;
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kSnortEventBatchSize							500
 
 //---------------------------------------------------------------------
 #endif // PLUGIN_DEFS
@@ -27,6 +27,7 @@
 #include "gather-task.h"
 #include "catchup-task.h"
 #include "stat-task.h"
+#include "mysql-pool.h"
 
 #include "../../plugin-api.h"
 
@@ -276,5 +277,9 @@ void AgentRun ()
 void AgentStop ()
 {
 	SetRunState(false);
+	
+	// Drop idle database connections; any in use are closed when
+	// their task returns them
+	GetMySQLConnectionPoolPtr()->Clear();
 }
 
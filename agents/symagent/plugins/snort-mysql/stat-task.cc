@@ -20,7 +20,6 @@
 // Includes
 //---------------------------------------------------------------------
 #include "stat-task.h"
-#include <mysql/mysql.h>
 
 //*********************************************************************
 // Class TStatEventsTask
@@ -101,69 +100,53 @@ void TStatEventsTask::Main (TServerMessage& messageObj)
 {
     TMessageNode  eventListNode(messageObj.Append("EVENT_LIST", "", ""));
 
-    MYSQL       *conn;
-    MYSQL_RES   *result;
-    MYSQL_ROW   row;
+    MySQLParamList  paramList;
+    std::string     query = GetQuery(paramList);
+    StdStringList   row;
 
-    // TODO: Maybe we should cache this connection
-    conn = mysql_init(NULL);
+    try
+    {
+        // Connections and their prepared statements are shared by all of
+        // the plugin's tasks and live across runs
+        TMySQLConnectionLease   connLease(fserverName, fuserName, fpassword, fdbName);
 
-    if (conn == NULL) {
-        WriteToErrorLog("MySQL init ERROR");
-    }
+        if (!connLease->Execute(query, paramList)) {
+            connLease.MarkFailed();
+            return;
+        }
+
+        WriteToMessagesLog("query:");
+        WriteToMessagesLog(query);
+
+        //TODO: REALLY need to finish refactoring this
+
+        if (connLease->FetchRow(row) && row.size() >= 2) {
+            const string& min(row[0]);
+            const string& max(row[1]);
 
+            TMessageNode eventNode(eventListNode.Append("STAT","",""));
+            eventNode.AddAttribute("min", min);
+            eventNode.AddAttribute("max", max);
 
-    if (mysql_real_connect(conn, fserverName.c_str(), fuserName.c_str(), fpassword.c_str(), fdbName.c_str(), 0, NULL, 0) == NULL) {
-        WriteToErrorLog("MySQL connect ERROR"); 
+            WriteToMessagesLog("After query: ");
+            WriteToMessagesLog("max cid: " + max );
+            WriteToMessagesLog("min cid: " + min );
+        }
+    }
+    catch (TSymLibErrorObj& errObj)
+    {
+        WriteToErrorLog(errObj.GetDescription());
     }
-   
-
-    /* 
-     * Make sure this query is good.  segfault otherwise.
-     * TODO: Figure out the right way to handle bad queries (try/catch, etc.)
-     *
-     */
-    
-    /*std::string query =  "select inet_ntoa(iphdr.ip_src), inet_ntoa(iphdr.ip_dst), signature.sig_sid, signature.sig_name, count(*) "; 
-                query += "as sum from event, signature, iphdr where event.timestamp >= \"";
-                query += fstartTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and event.timestamp < \"";
-                query += fendTime.GetFormattedDateTime("%Y-%m-%d %H:%M:%S").c_str();
-                query += "\" and iphdr.cid = event.cid and signature.sig_id = event.signature group by ip_src, ip_dst, sig_name order by count(*) desc";
-                */
-
-    std::string query = GetQuery();
-    
-    mysql_query(conn, query.c_str());
-    WriteToMessagesLog("query:");
-    WriteToMessagesLog(query);
-   
-    result = mysql_store_result(conn);
-   
-    //TODO: REALLY need to finish refactoring this
-    
-    row = mysql_fetch_row(result);
-
-    string min(row[0]);
-    string max(row[1]);
-        
-    TMessageNode eventNode(eventListNode.Append("STAT","",""));
-    eventNode.AddAttribute("min", min);
-    eventNode.AddAttribute("max", max);
-
-    WriteToMessagesLog("After query: ");
-    WriteToMessagesLog("max cid: " + max );
-    WriteToMessagesLog("min cid: " + min );
-
-    mysql_free_result(result);
-    mysql_close(conn);
 }
 
 //---------------------------------------------------------------------
 // TStatEventsTask::GetQuery
 //---------------------------------------------------------------------
-std::string TStatEventsTask::GetQuery ()
+std::string TStatEventsTask::GetQuery (MySQLParamList& paramList)
 {
   std::string query = "select min(cid), max(cid) from event";
+
+  paramList.clear();
+
   return query;
 }
@@ -29,7 +29,7 @@
 
 #include "plugin-defs.h"
 #include "plugin-utils.h"
-#include <mysql/mysql.h>
+#include "mysql-pool.h"
 //---------------------------------------------------------------------
 // Import namespace symbols
 //---------------------------------------------------------------------
@@ -89,7 +89,9 @@ class TStatEventsTask : public TTaskBase
 		virtual void Main (TServerMessage& messageObj);
 			// ¥¥¥
 		
-    virtual std::string GetQuery ();
+    virtual std::string GetQuery (MySQLParamList& paramList);
+      // Returns the prepared statement text for this task, destructively
+      // modifying paramList to contain the values for its placeholders.
 
 	protected:
 		
@@ -97,8 +99,6 @@ class TStatEventsTask : public TTaskBase
 		string									  fserverName;
 		string									  fuserName;
 		string									  fpassword;
-
-    MYSQL                     fconn;
 		ModEnviron*								fParentEnvironPtr;
 			
 };
@@ -30,6 +30,7 @@
 #include "symlib-expat.h"
 #include "symlib-file-watch.h"
 #include "symlib-prefs.h"
+#include "symlib-spool.h"
 #include "symlib-ssl-encode.h"
 #include "symlib-ssl-digest.h"
 #include "symlib-task-queue.h"
@@ -331,8 +332,22 @@ void SymLibCleanup ()
 		
 		try
 		{
+			// Stop replaying spooled messages; whatever is left stays on disk
+			GetMessageSpoolPtr()->StopDrainer();
+			
 			DeleteTaskQueue();
 			
+			// Save any signatures computed since the last periodic flush
+			try
+			{
+				GetFileSignatureCachePtr()->Flush(true);
+			}
+			catch (TSymLibErrorObj& errObj)
+			{
+				WriteToErrorLog("While saving signature cache: " + errObj.GetDescription());
+				errObj.MarkAsLogged();
+			}
+			
 			if (gServerObjPtr)
 			{
 				// Gracefully disconnect, if necessary
@@ -348,7 +363,14 @@ void SymLibCleanup ()
 				DeletePIDFile();
 			}
 			
+			if (gEnvironObjPtr && BitTest(gEnvironObjPtr->DynamicDebugFlags(),kDynDebugLogMutexContention))
+				WriteMutexContentionStats();
+			
 			WriteToMessagesLog("Agent shutdown complete");
+			
+			// Make sure every queued log entry reaches the disk
+			if (gEnvironObjPtr)
+				gEnvironObjPtr->CloseFiles();
 		}
 		catch (...)
 		{
@@ -605,6 +627,56 @@ void WriteToMessagesLog (const std::string& logEntry)
 	WriteToMessagesLogFile(logEntry);
 }
 
+//---------------------------------------------------------------------
+// _DeliverSpooledMessage (static)
+//---------------------------------------------------------------------
+static bool _DeliverSpooledMessage (const std::string& message, CompressionMode compressionMode)
+{
+	bool	wasHandled = false;
+	
+	if (IsConnectedToServer())
+	{
+		TServerMessage		xmlData;
+		TServerReply		reply;
+		
+		try
+		{
+			xmlData.Parse(message);
+		}
+		catch (...)
+		{
+			// Unparseable; retrying won't help, so drop it
+			WriteToErrorLog("Discarding unreadable spooled server message");
+			return true;
+		}
+		
+		// The message carries the nonce of the login it was created under,
+		// which may not be the current one
+		xmlData.AddAttribute(kMessageTagNonce,gEnvironObjPtr->ServerNonce());
+		
+		try
+		{
+			switch (SendToServer(xmlData,reply,compressionMode))
+			{
+				case kResponseCodeUnknown:
+				case kResponseCodeDBUnavailErr:
+					// Try again later
+					break;
+				
+				default:
+					wasHandled = true;
+					break;
+			}
+		}
+		catch (...)
+		{
+			// SendToServer() has already logged the error
+		}
+	}
+	
+	return wasHandled;
+}
+
 //---------------------------------------------------------------------
 // ConnectToServer
 //---------------------------------------------------------------------
@@ -621,9 +693,13 @@ void ConnectToServer (TLoginDataNode& additionalLoginNode)
 				TMessageNode		nodeRef;
                 
         TLoginDataNode      interfaceNode("NETWORK_LIST");
+				TServerLoginScope	loginScope(gServerObjPtr);
 
 				gServerObjPtr->Connect();
 				
+				// Any token we had belonged to the old login
+				gServerObjPtr->SetReloginToken("");
+				
 				// Append login information to the message
 				nodeRef = loginMessage.Append(kMessageTypeValueLogin,"","");
 				//nodeRef.AddAttribute(kMessageTagIPAddress,gServerObjPtr->LocalIPAddressAsString());
@@ -683,6 +759,9 @@ void ConnectToServer (TLoginDataNode& additionalLoginNode)
 									// Insert our host-given nonce separately into our runtime environment
 									gEnvironObjPtr->SetServerNonce(nodeRef.GetAttributeValue(kMessageTagNonce));
 									
+									// Servers that support quick reconnects give us a token for them
+									gServerObjPtr->SetReloginToken(nodeRef.GetAttributeValue(kMessageTagReloginToken));
+									
 									// Parse out server-supplied compression designation, if any
 									compressionText = nodeRef.GetAttributeValue(kTagPrefCompression);
 									if (compressionText == "gzip")
@@ -724,6 +803,12 @@ void ConnectToServer (TLoginDataNode& additionalLoginNode)
 					gServerObjPtr->Disconnect(true);
 					throw;
 				}
+				
+				// Other threads may use the connection from here on
+				loginScope.Release();
+				
+				// Deliver anything spooled while we were away
+				GetMessageSpoolPtr()->StartDrainer(_DeliverSpooledMessage);
 			}
 		}
 	}
@@ -765,6 +850,123 @@ void ConnectToServer (TLoginDataNode& additionalLoginNode)
 	}
 }
 
+//---------------------------------------------------------------------
+// ReconnectToServer
+//---------------------------------------------------------------------
+bool ReconnectToServer ()
+{
+	bool	reconnected = false;
+	
+	try
+	{
+		if (gServerObjPtr && !gServerObjPtr->ReloginToken().empty())
+		{
+			if (gServerObjPtr->IsConnected())
+			{
+				reconnected = true;
+			}
+			else
+			{
+				TServerMessage		loginMessage;
+				TServerReply		reply;
+				TMessageNode		nodeRef;
+				TServerLoginScope	loginScope(gServerObjPtr);
+				
+				// Plugins keep running during a quick reconnect; they must
+				// not send anything until the server accepts the LOGIN
+				gServerObjPtr->Connect();
+				
+				// The token stands in for everything else a login carries
+				nodeRef = loginMessage.Append(kMessageTypeValueLogin,"","");
+				nodeRef.AddAttribute(kMessageTagClientSignature,gEnvironObjPtr->AppSignature());
+				nodeRef.AddAttribute(kMessageTagReloginToken,gServerObjPtr->ReloginToken());
+				
+				try
+				{
+					if (SendToServer(loginMessage,reply,kCompressionModeNone) == kResponseCodeOK)
+					{
+						// The server may rotate the nonce and the token
+						nodeRef = reply.FindNode(kMessageTypeValueConfig);
+						if (nodeRef.IsValid())
+						{
+							if (!nodeRef.GetAttributeValue(kMessageTagNonce).empty())
+								gEnvironObjPtr->SetServerNonce(nodeRef.GetAttributeValue(kMessageTagNonce));
+							if (!nodeRef.GetAttributeValue(kMessageTagReloginToken).empty())
+								gServerObjPtr->SetReloginToken(nodeRef.GetAttributeValue(kMessageTagReloginToken));
+						}
+						
+						reconnected = true;
+					}
+					else
+					{
+						// The server wants a full login
+						gServerObjPtr->SetReloginToken("");
+						gServerObjPtr->Disconnect();
+					}
+				}
+				catch (...)
+				{
+					// Some error occurred.  Disconnect and rethrow
+					gServerObjPtr->Disconnect(true);
+					throw;
+				}
+				
+				loginScope.Release();
+				
+				if (reconnected)
+				{
+					std::string		logString;
+					
+					logString = "Reconnected to server with relogin token";
+					if (gServerObjPtr->SessionResumed())
+						logString += " and resumed TLS session";
+					WriteToMessagesLog(logString);
+					
+					GetMessageSpoolPtr()->StartDrainer(_DeliverSpooledMessage);
+				}
+			}
+		}
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			std::string		errString;
+			
+			errString += "While reconnecting to server: " + errObj.GetDescription();
+			WriteToErrorLog(errString);
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "While reconnecting to server: Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		std::string		errString;
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		errString += "While reconnecting to server: " + newErrObj.GetDescription();
+		
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return reconnected;
+}
+
 //---------------------------------------------------------------------
 // DisconnectFromServer
 //---------------------------------------------------------------------
@@ -785,6 +987,9 @@ void DisconnectFromServer ()
 				TServerReply		reply;
 				TMessageNode		nodeRef;
 				
+				// Logging out ends the login the token would resume
+				gServerObjPtr->SetReloginToken("");
+				
 				// Append logout information to the message
 				nodeRef = logoutMessage.Append(kMessageTypeValueLogout,"","");
 				
@@ -872,7 +1077,9 @@ ResponseCode SendToServer (TServerMessage& xmlData,
 			// Add the current MAC address to the outbound message
 			//xmlData.AddAttribute(kMessageTagMACAddress,gServerObjPtr->MyMACAddress());
 			
-			if (gServerObjPtr->Send(xmlData.AsCompressedString(),compressionMode))
+			// Check again: the connection may have dropped or begun a new
+			// login while we waited for the lock
+			if (gServerObjPtr->IsConnected() && gServerObjPtr->Send(xmlData.AsCompressedString(),compressionMode))
 			{
 				std::string		receivedData(gServerObjPtr->Receive());
 				std::string		savedReceivedData(receivedData);
@@ -1065,6 +1272,60 @@ ResponseCode SendToServer (TServerMessage& xmlData,
 	return responseCode;
 }
 
+//---------------------------------------------------------------------
+// SendToServerOrSpool
+//---------------------------------------------------------------------
+ResponseCode SendToServerOrSpool (TServerMessage& xmlData,
+								  CompressionMode compressionMode)
+{
+	ResponseCode		responseCode = kResponseCodeUnknown;
+	bool				wasSent = false;
+	
+	// Older spooled messages go first, so don't jump the queue
+	if (IsConnectedToServer() && GetMessageSpoolPtr()->IsEmpty())
+	{
+		TServerReply	reply;
+		
+		try
+		{
+			responseCode = SendToServer(xmlData,reply,compressionMode);
+			wasSent = (responseCode != kResponseCodeUnknown && responseCode != kResponseCodeDBUnavailErr);
+		}
+		catch (...)
+		{
+			// SendToServer() has already logged the error
+			responseCode = kResponseCodeUnknown;
+		}
+	}
+	
+	if (!wasSent)
+	{
+		GetMessageSpoolPtr()->Append(xmlData.AsCompressedString(),compressionMode);
+		responseCode = kResponseCodeUnknown;
+	}
+	
+	return responseCode;
+}
+
+//---------------------------------------------------------------------
+// BackoffDelay
+//---------------------------------------------------------------------
+double BackoffDelay (double baseSeconds, unsigned long attemptCount, double maxSeconds)
+{
+	double		delay = baseSeconds;
+	
+	for (unsigned long x = 1; x < attemptCount && delay < maxSeconds; x++)
+		delay *= 2;
+	
+	if (delay > maxSeconds)
+		delay = maxSeconds;
+	
+	// Keep at least half of the wait and randomize the rest
+	delay = delay / 2 + (delay / 2) * (RandomULong() % 1001) / 1000.0;
+	
+	return delay;
+}
+
 //---------------------------------------------------------------------
 // AdviseServer
 //---------------------------------------------------------------------
@@ -1140,6 +1401,14 @@ void AdviseServer (std::string advisoryText, unsigned long priority)
 // GetServerCommand
 //---------------------------------------------------------------------
 bool GetServerCommand (TServerReply& serverCommand)
+{
+	return WaitForServerCommand(serverCommand,0);
+}
+
+//---------------------------------------------------------------------
+// WaitForServerCommand
+//---------------------------------------------------------------------
+bool WaitForServerCommand (TServerReply& serverCommand, double maxWaitSeconds)
 {
 	bool	success = false;
 	
@@ -1148,15 +1417,9 @@ bool GetServerCommand (TServerReply& serverCommand)
 		try
 		{
 			if (gServerObjPtr)
-			{
-				std::string		command(gServerObjPtr->GetServerCommand());
-				
-				if (!command.empty())
-				{
-					serverCommand.Parse(command);
-					success = true;
-				}
-			}
+				success = gServerObjPtr->GetServerCommand(serverCommand,maxWaitSeconds);
+			else if (maxWaitSeconds > 0)
+				Pause(maxWaitSeconds);
 		}
 		catch (TSymLibErrorObj& errObj)
 		{
@@ -1753,6 +2016,57 @@ bool IsTaskInQueue (const TTaskBase* taskObjPtr)
 	return inQueue;
 }
 
+//---------------------------------------------------------------------
+// DestroyOwnedTasks
+//---------------------------------------------------------------------
+bool DestroyOwnedTasks (const void* ownerRef, time_t timeoutInSeconds)
+{
+	bool	allDestroyed = false;
+	
+	try
+	{
+		allDestroyed = _DeleteOwnedTasksFromQueue(ownerRef,timeoutInSeconds);
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			std::string		errString;
+			
+			errString += "While destroying owned tasks: " + errObj.GetDescription();
+			WriteToErrorLog(errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "While destroying owned tasks: Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		std::string		errString;
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		errString += "While destroying owned tasks: " + newErrObj.GetDescription();
+		
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return allDestroyed;
+}
+
 //---------------------------------------------------------------------
 // TasksAreRunnable
 //---------------------------------------------------------------------
@@ -2086,6 +2400,31 @@ std::string GetNewFileWatcherData (FileWatcherRef taskRef)
 	return data;
 }
 
+//---------------------------------------------------------------------
+// GetFileWatcherReadPosition
+//---------------------------------------------------------------------
+unsigned long GetFileWatcherReadPosition (FileWatcherRef taskRef)
+{
+	unsigned long	readPosition = 0;
+	TTaskFileWatch*	taskObjPtr = reinterpret_cast<TTaskFileWatch*>(taskRef);
+	
+	if (taskObjPtr)
+		readPosition = taskObjPtr->ReadPosition();
+	
+	return readPosition;
+}
+
+//---------------------------------------------------------------------
+// SetFileWatcherUnclaimedByteCount
+//---------------------------------------------------------------------
+void SetFileWatcherUnclaimedByteCount (FileWatcherRef taskRef, unsigned long byteCount)
+{
+	TTaskFileWatch*	taskObjPtr = reinterpret_cast<TTaskFileWatch*>(taskRef);
+	
+	if (taskObjPtr)
+		taskObjPtr->SetUnclaimedByteCount(byteCount);
+}
+
 //---------------------------------------------------------------------
 // IsFileWatcherTaskInQueue
 //---------------------------------------------------------------------
@@ -2157,6 +2496,63 @@ AppExecRef CreateAppExecTask (const std::string& appPath,
 	return taskObjPtr;
 }
 
+//---------------------------------------------------------------------
+// CreateAppExecTask
+//---------------------------------------------------------------------
+AppExecRef CreateAppExecTask (const std::string& appPath,
+							  const StdStringList& appArgList,
+							  const std::string& appStdInData,
+							  time_t executionIntervalInSeconds)
+{
+	TAppExecTask*		taskObjPtr = NULL;
+	
+	try
+	{
+		taskObjPtr = new TAppExecTask(executionIntervalInSeconds);
+		
+		if (taskObjPtr)
+			taskObjPtr->SetupTask(appPath,appArgList,appStdInData);
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			std::string		errString;
+			
+			errString += "While creating an application execution task: " + errObj.GetDescription();
+			WriteToErrorLog(errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "While creating an application execution task: Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		std::string		errString;
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		errString += "While creating an application execution task: " + newErrObj.GetDescription();
+		
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return taskObjPtr;
+}
+
 //---------------------------------------------------------------------
 // DestroyAppExecTask
 //---------------------------------------------------------------------
@@ -2259,6 +2655,17 @@ void AddAppExecCallback (AppExecRef taskRef,
 	}
 }
 
+//---------------------------------------------------------------------
+// SetAppExecStreamOutput
+//---------------------------------------------------------------------
+void SetAppExecStreamOutput (AppExecRef taskRef, bool streamOutput)
+{
+	TAppExecTask*	taskObjPtr = reinterpret_cast<TAppExecTask*>(taskRef);
+	
+	if (taskObjPtr)
+		taskObjPtr->SetStreamOutput(streamOutput);
+}
+
 //---------------------------------------------------------------------
 // QueueAppExecTask
 //---------------------------------------------------------------------
@@ -2323,6 +2730,84 @@ bool IsAppExecTaskInQueue (AppExecRef taskRef)
 	return inQueue;
 }
 
+//---------------------------------------------------------------------
+// CreateXMLStreamParser
+//---------------------------------------------------------------------
+XMLStreamRef CreateXMLStreamParser (const StdStringList& watchTagList,
+									XMLStreamCallback callback,
+									void* userData)
+{
+	TXMLStreamParserObj*	parserObjPtr = NULL;
+	
+	try
+	{
+		parserObjPtr = new TXMLStreamParserObj(watchTagList,callback,userData);
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			std::string		errString;
+			
+			errString += "While creating a streaming XML parser: " + errObj.GetDescription();
+			WriteToErrorLog(errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "While creating a streaming XML parser: Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		std::string		errString;
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		errString += "While creating a streaming XML parser: " + newErrObj.GetDescription();
+		
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return parserObjPtr;
+}
+
+//---------------------------------------------------------------------
+// ParseXMLStreamData
+//---------------------------------------------------------------------
+bool ParseXMLStreamData (XMLStreamRef parserRef, const std::string& data, bool isFinal)
+{
+	bool					parsed = false;
+	TXMLStreamParserObj*	parserObjPtr = reinterpret_cast<TXMLStreamParserObj*>(parserRef);
+	
+	if (parserObjPtr)
+		parsed = parserObjPtr->ParseChunk(data,isFinal);
+	
+	return parsed;
+}
+
+//---------------------------------------------------------------------
+// DestroyXMLStreamParser
+//---------------------------------------------------------------------
+void DestroyXMLStreamParser (XMLStreamRef parserRef)
+{
+	TXMLStreamParserObj*	parserObjPtr = reinterpret_cast<TXMLStreamParserObj*>(parserRef);
+	
+	if (parserObjPtr)
+		delete(parserObjPtr);
+}
+
 //---------------------------------------------------------------------
 // GetFileSignature
 //---------------------------------------------------------------------
@@ -2336,14 +2821,9 @@ std::string GetFileSignature (const std::string& filePath)
 		
 		if (fileObj.Exists())
 		{
-			TDigest			fileSigDigestObj("SHA1");
-			TDigestContext	fileSigDigestContextObj;
-			TEncodeContext	encodeContext;
-			
-			// Compute the signature of this executable
-			fileSigDigestContextObj.Initialize(fileSigDigestObj);
-			fileSigDigestContextObj.Update(fileObj);
-			sig = encodeContext.Encode(fileSigDigestContextObj.Final());
+			// Signatures are shared by everything in the process and
+			// recomputed only when the file changes
+			sig = GetFileSignatureCachePtr()->GetSignature(filePath);
 		}
 		else
 		{
@@ -2447,6 +2927,62 @@ std::string ExecApplication (const std::string& appPath, const std::string appSt
 	return data;
 }
 
+//---------------------------------------------------------------------
+// ExecApplication
+//---------------------------------------------------------------------
+std::string ExecApplication (const std::string& appPath,
+							 const StdStringList& appArgList,
+							 const std::string appStdInData)
+{
+	std::string		data;
+	
+	try
+	{
+		if (appStdInData.empty())
+			data = ExecWithIO(appPath,appArgList);
+		else
+			data = ExecWithIO(appPath,appArgList,reinterpret_cast<const unsigned char*>(appStdInData.c_str()),appStdInData.length());
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			std::string		errString;
+			
+			errString += "While executing application '" + appPath + "': " + errObj.GetDescription();
+			WriteToErrorLog(errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "While executing application '" + appPath + "': Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		std::string		errString;
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		errString += "While executing application '" + appPath + "': " + newErrObj.GetDescription();
+		
+		WriteToErrorLog(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return data;
+}
+
 //---------------------------------------------------------------------
 // LocateFile
 //---------------------------------------------------------------------
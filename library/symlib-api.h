@@ -123,9 +123,19 @@ void ConnectToServer (TLoginDataNode& additionalLoginNode);
 	// additionalLoginNode, if any will be appended to the login messages
 	// used during the protocol.
 
+bool ReconnectToServer ();
+	// Restores a connection that was lost without logging out, using the
+	// relogin token the server handed out during the last full login.
+	// Only the token is sent; the network and plugin information sent
+	// by ConnectToServer() is not, and the server's configuration is not
+	// reloaded.  Returns false, without throwing, if there is no token or
+	// the server refused it; a full ConnectToServer() is needed then.
+	// Communication errors are thrown and the token is kept for another
+	// attempt.
+
 void DisconnectFromServer ();
 	// Destroys connection with server.  Is safe to call even we don't
-	// already have a connection.
+	// already have a connection.  Logging out discards any relogin token.
 
 bool IsConnectedToServer ();
 	// Returns a boolean indicating whether we are currently connected
@@ -138,6 +148,21 @@ ResponseCode SendToServer (TServerMessage& xmlData,
 	// reply in the receivedXMLData argument as well as a response code
 	// indicating relative success.
 
+ResponseCode SendToServerOrSpool (TServerMessage& xmlData,
+								  CompressionMode compressionMode = kCompressionModeUnspecified);
+	// Like SendToServer() but for messages whose reply is not needed and
+	// which should survive a server outage.  If the agent is not connected,
+	// the send fails, or older messages are still waiting, the message is
+	// written to the on-disk spool and kResponseCodeUnknown is returned;
+	// spooled messages are delivered in order once the agent reconnects.
+
+double BackoffDelay (double baseSeconds, unsigned long attemptCount, double maxSeconds);
+	// Returns the number of seconds to wait before retry attempt number
+	// attemptCount (the first retry is 1).  The wait starts at baseSeconds
+	// and doubles with each attempt up to maxSeconds, then is randomly cut
+	// by up to half so that clients which lost the server at the same time
+	// do not all come back at the same time.
+
 void AdviseServer (std::string advisoryText, unsigned long priority = 0);
 	// Sends advisoryText to the server in a special "notice" message
 	// format, with the given priority.  Server replies are ignored.  Note
@@ -149,6 +174,11 @@ bool GetServerCommand (TServerReply& serverCommand);
 	// modifying the argument to contain the parsed command.  Returns true
 	// if a command was found and parsed, false otherwise.
 
+bool WaitForServerCommand (TServerReply& serverCommand, double maxWaitSeconds);
+	// Same as GetServerCommand() except that, if the queue is empty, it
+	// waits up to maxWaitSeconds for the server to send a command.  The
+	// caller is woken as soon as a command arrives.
+
 unsigned long NetworkInterfaceList (StdStringList& interfaceList);
 	// Function scans the local system for network interfaces and destructively
 	// modifies the argument to contain a list of found interfaces.  Returns
@@ -208,6 +238,13 @@ bool IsTaskInQueue (const TTaskBase* taskObjPtr);
 	// Returns true if the given task object resides in either the run
 	// or wait queue, false otherwise.
 
+bool DestroyOwnedTasks (const void* ownerRef, time_t timeoutInSeconds);
+	// Destroys every queued task whose owner reference (see
+	// TTaskBase::SetOwnerRef()) matches ownerRef, including tasks
+	// those tasks queued.  Running tasks are left to finish and are
+	// waited for up to timeoutInSeconds seconds.  Returns true if none
+	// of the owner's tasks remain.
+
 bool TasksAreRunnable ();
 	// Returns a boolean indicating both whether new tasks can be
 	// placed on the queue and whether currently-executing tasks should
@@ -257,7 +294,22 @@ std::string GetNewFileWatcherData (FileWatcherRef taskRef);
 	// that the referenced file watcher task is tracking.  It is only
 	// functional when called from within a callback triggered by the
 	// kFileWatchChangeFlagDataSize flag.  taskRef is provided to the
-	// callback, making it easy to gather this information.
+	// callback, making it easy to gather this information.  At most one
+	// read window (see the read_window attribute of the <file_watch> local
+	// preference) is returned per call; if more data is pending, the
+	// callback will be invoked again with the next window, up to
+	// windows_per_pass windows per pass.
+
+unsigned long GetFileWatcherReadPosition (FileWatcherRef taskRef);
+	// Returns the offset within the watched file of the next byte that
+	// GetNewFileWatcherData() will return.
+
+void SetFileWatcherUnclaimedByteCount (FileWatcherRef taskRef, unsigned long byteCount);
+	// Tells the referenced file watcher task that the last byteCount bytes
+	// returned by GetNewFileWatcherData() have not been processed yet (a
+	// partial line, for instance).  Tail-style watchers journal their read
+	// offsets so they can resume after a restart; the journaled offset is
+	// kept behind unclaimed bytes so they will be reread.
 
 bool IsFileWatcherTaskInQueue (FileWatcherRef taskRef);
 	// Returns true if the given task object resides in either the run
@@ -271,6 +323,16 @@ AppExecRef CreateAppExecTask (const std::string& appPath,
 	// appPath argument, argument string, and appStdInData data piped to the app.  Function
 	// returns an opaque reference to the task.  Callers must eventually either
 	// hand the reference to QueueAppExecTask() or DestroyAppExecTask().
+	// The application and its arguments are run through the shell.
+
+AppExecRef CreateAppExecTask (const std::string& appPath,
+							  const StdStringList& appArgList,
+							  const std::string& appStdInData,
+							  time_t executionIntervalInSeconds);
+	// Same as above, except that the application is launched directly
+	// rather than through the shell.  Each member of appArgList is passed
+	// unchanged as one argument, so arguments that came from the server
+	// or from preferences cannot be interpreted by a shell.
 
 void DestroyAppExecTask (AppExecRef taskRef);
 	// Destroys the task referenced by the argument, freeing up memory
@@ -286,6 +348,15 @@ void AddAppExecCallback (AppExecRef taskRef,
 	// passed back to your callback routine.  This function must be called
 	// before QueueAppExecTask() is called.
 
+void SetAppExecStreamOutput (AppExecRef taskRef, bool streamOutput);
+	// If streamOutput is true then the callbacks for the application
+	// execution task referenced by taskRef receive the application's stdout
+	// in blocks as it is read rather than all at once after the application
+	// exits.  Blocks are not aligned to lines or XML elements.  Once the
+	// application exits, or if it could not be run at all, the callbacks
+	// are called one final time with empty data.  This function must be
+	// called before QueueAppExecTask() is called.
+
 void QueueAppExecTask (AppExecRef taskRef, bool runFirst);
 	// Adds the referenced application execution task to the task queue.  If runFirst
 	// is true then the task is executed at the next opportunity; otherwise,
@@ -297,6 +368,32 @@ bool IsAppExecTaskInQueue (AppExecRef taskRef);
 	// Returns true if the given task object resides in either the run
 	// or wait queue, false otherwise.
 
+//---------------------------------------------------------------------
+// XML Parsing
+//---------------------------------------------------------------------
+
+XMLStreamRef CreateXMLStreamParser (const StdStringList& watchTagList,
+									XMLStreamCallback callback,
+									void* userData = NULL);
+	// Creates a parser that reads an XML document incrementally, as it
+	// arrives, rather than all at once.  Each time an element whose tag
+	// is in watchTagList has been completely parsed it is passed to the
+	// callback along with userData.  Nothing outside of those elements is
+	// kept, so memory use depends on the size of the largest watched
+	// element rather than the size of the document.  Function returns an
+	// opaque reference to the parser; callers must eventually pass it to
+	// DestroyXMLStreamParser().
+
+bool ParseXMLStreamData (XMLStreamRef parserRef, const std::string& data, bool isFinal);
+	// Feeds the next piece of the document to the referenced parser.  The
+	// pieces need not be aligned to elements or lines.  isFinal must be
+	// true for the last piece, which may be empty.  Returns false if the
+	// document is not well-formed, after which the parser should be
+	// destroyed.
+
+void DestroyXMLStreamParser (XMLStreamRef parserRef);
+	// Destroys the referenced parser.
+
 //---------------------------------------------------------------------
 // Files and Directories
 //---------------------------------------------------------------------
@@ -304,12 +401,20 @@ bool IsAppExecTaskInQueue (AppExecRef taskRef);
 std::string GetFileSignature (const std::string& filePath);
 	// Returns the SHA1 signature of the file indicated by the argument.
 	// It's recommended that the path be a full path rather than a
-	// relative one.
+	// relative one.  Signatures are cached for the whole process and
+	// recomputed only when the file's size or times change.
 
 std::string ExecApplication (const std::string& appPath, const std::string appStdInData = "");
 	// Executes the application references by the appPath argument with
 	// the optional appStdInData data piped to the app.  Returns the
-	// application's stdout output.
+	// application's stdout output.  appPath is interpreted by the shell,
+	// so it may include arguments.
+
+std::string ExecApplication (const std::string& appPath,
+							 const StdStringList& appArgList,
+							 const std::string appStdInData = "");
+	// Same as above, except that the application is launched directly
+	// with the arguments in appArgList and no shell is involved.
 
 std::string LocateFile (const std::string& fileName, const StdStringList& directoryList);
 	// Given a filename and a list of directories to search, this function
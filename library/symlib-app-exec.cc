@@ -45,7 +45,9 @@ namespace symbiot {
 // Constructor (protected)
 //---------------------------------------------------------------------
 TAppExecTask::TAppExecTask ()
-	:	Inherited(gEnvironObjPtr->GetTaskName(),kDefaultExecutionInterval,true)
+	:	Inherited(gEnvironObjPtr->GetTaskName(),kDefaultExecutionInterval,true),
+		fUseArgList(false),
+		fStreamOutput(false)
 {
 	SetRerun(false);
 }
@@ -54,7 +56,9 @@ TAppExecTask::TAppExecTask ()
 // Constructor (protected)
 //---------------------------------------------------------------------
 TAppExecTask::TAppExecTask (time_t intervalInSeconds)
-	:	Inherited(gEnvironObjPtr->GetTaskName(),intervalInSeconds,true)
+	:	Inherited(gEnvironObjPtr->GetTaskName(),intervalInSeconds,true),
+		fUseArgList(false),
+		fStreamOutput(false)
 {
 	SetRerun(intervalInSeconds > 0);
 }
@@ -73,17 +77,34 @@ void TAppExecTask::RunTask ()
 {
 	if (fFileObj.Exists())
 	{
-		std::string		appAndArgs;
-		std::string		returnedData;
-		bool			exceptionThrown = false;
+		std::string				execPath;
+		StdStringList			execArgList;
+		const unsigned char*	stdInDataPtr = reinterpret_cast<const unsigned char*>(fAppStdInData.c_str());
+		std::string				returnedData;
+		bool					exceptionThrown = false;
 		
 		#if HAVE_DECL_PTHREAD_CANCEL_DISABLE && HAVE_DECL_PTHREAD_CANCEL_ENABLE
 			int			oldCancelState;
 		#endif
 		
-		appAndArgs = fFileObj.Path();
-		if (!fAppArgs.empty())
-			appAndArgs += " " + fAppArgs;
+		if (fUseArgList)
+		{
+			// Launch the application directly
+			execPath = fFileObj.Path();
+			execArgList = fAppArgList;
+		}
+		else
+		{
+			// The arguments are a single string, so let the shell parse them
+			std::string		appAndArgs(fFileObj.Path());
+			
+			if (!fAppArgs.empty())
+				appAndArgs += " " + fAppArgs;
+			
+			execPath = kExecShellPath;
+			execArgList.push_back("-c");
+			execArgList.push_back(appAndArgs);
+		}
 		
 		#if HAVE_DECL_PTHREAD_CANCEL_DISABLE && HAVE_DECL_PTHREAD_CANCEL_ENABLE
 			// Make sure that if we're running in a thread we have the correct cancel states set
@@ -92,10 +113,15 @@ void TAppExecTask::RunTask ()
 		
 		try
 		{
-			if (fAppStdInData.empty())
-				returnedData = ExecWithIO(appAndArgs);
+			if (fStreamOutput)
+			{
+				// Callbacks are invoked from within ExecWithIO()
+				ExecWithIO(execPath,execArgList,_StreamOutputHandler,this,stdInDataPtr,fAppStdInData.length());
+			}
 			else
-				returnedData = ExecWithIO(appAndArgs,reinterpret_cast<const unsigned char*>(fAppStdInData.c_str()),fAppStdInData.length());
+			{
+				returnedData = ExecWithIO(execPath,execArgList,stdInDataPtr,fAppStdInData.length());
+			}
 		}
 		catch (...)
 		{
@@ -108,22 +134,19 @@ void TAppExecTask::RunTask ()
 			pthread_setcancelstate(oldCancelState,NULL);
 		#endif
 		
-		if (!exceptionThrown)
+		if (!exceptionThrown || fStreamOutput)
 		{
-			// Call the callbacks with the gathered data
-			for (CallbackList_const_iter x = fCallbackList.begin(); x != fCallbackList.end(); x++)
-			{
-				AppExecCallback			functionPtr = x->first;
-				void*					userData = x->second;
-				
-				if ((*functionPtr)(returnedData,this,userData))
-				{
-					// User function returned true, indicating that processing should stop
-					break;
-				}
-			}
+			// Call the callbacks with the gathered data; in streaming mode
+			// returnedData is empty and marks the end of the output, which
+			// callbacks rely on even when the application failed
+			_CallCallbacks(returnedData);
 		}
 	}
+	else if (fStreamOutput)
+	{
+		// Nothing to run, but streaming callbacks still expect the end
+		_CallCallbacks(std::string());
+	}
 }
 
 //---------------------------------------------------------------------
@@ -136,6 +159,8 @@ void TAppExecTask::SetupTask (const TFileObj& appObj,
 	// Initialize our internal slots
 	fFileObj = appObj;
 	fAppArgs = appArgs;
+	fAppArgList.clear();
+	fUseArgList = false;
 	fAppStdInData = appStdInData;
 }
 
@@ -149,6 +174,31 @@ void TAppExecTask::SetupTask (const std::string& appPath,
 	SetupTask(TFileObj(appPath),appArgs,appStdInData);
 }
 
+//---------------------------------------------------------------------
+// TAppExecTask::SetupTask
+//---------------------------------------------------------------------
+void TAppExecTask::SetupTask (const TFileObj& appObj,
+							  const StdStringList& appArgList,
+							  const std::string& appStdInData)
+{
+	// Initialize our internal slots
+	fFileObj = appObj;
+	fAppArgs = "";
+	fAppArgList = appArgList;
+	fUseArgList = true;
+	fAppStdInData = appStdInData;
+}
+
+//---------------------------------------------------------------------
+// TAppExecTask::SetupTask
+//---------------------------------------------------------------------
+void TAppExecTask::SetupTask (const std::string& appPath,
+							  const StdStringList& appArgList,
+							  const std::string& appStdInData)
+{
+	SetupTask(TFileObj(appPath),appArgList,appStdInData);
+}
+
 //---------------------------------------------------------------------
 // TAppExecTask::AddCallback
 //---------------------------------------------------------------------
@@ -157,6 +207,40 @@ void TAppExecTask::AddCallback (AppExecCallback callbackFunction, void* userData
 	fCallbackList.push_back(make_pair(callbackFunction,userData));
 }
 
+//---------------------------------------------------------------------
+// TAppExecTask::SetStreamOutput
+//---------------------------------------------------------------------
+void TAppExecTask::SetStreamOutput (bool streamOutput)
+{
+	fStreamOutput = streamOutput;
+}
+
+//---------------------------------------------------------------------
+// TAppExecTask::_CallCallbacks (protected)
+//---------------------------------------------------------------------
+void TAppExecTask::_CallCallbacks (const std::string& returnedData)
+{
+	for (CallbackList_const_iter x = fCallbackList.begin(); x != fCallbackList.end(); x++)
+	{
+		AppExecCallback			functionPtr = x->first;
+		void*					userData = x->second;
+		
+		if ((*functionPtr)(returnedData,this,userData))
+		{
+			// User function returned true, indicating that processing should stop
+			break;
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TAppExecTask::_StreamOutputHandler (protected static)
+//---------------------------------------------------------------------
+void TAppExecTask::_StreamOutputHandler (const char* data, size_t dataLength, void* handlerData)
+{
+	reinterpret_cast<TAppExecTask*>(handlerData)->_CallCallbacks(std::string(data,dataLength));
+}
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
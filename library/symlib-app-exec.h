@@ -91,16 +91,48 @@ class TAppExecTask : public TTaskBase
 		virtual void SetupTask (const std::string& appPath,
 								const std::string& appArgs = "",
 								const std::string& appStdInData = "");
+			// Sets up the task so it can execute in the background.  The
+			// application and appArgs are run through the shell.
+		
+		virtual void SetupTask (const TFileObj& appObj,
+								const StdStringList& appArgList,
+								const std::string& appStdInData = "");
 			// Sets up the task so it can execute in the background.
 		
+		virtual void SetupTask (const std::string& appPath,
+								const StdStringList& appArgList,
+								const std::string& appStdInData = "");
+			// Sets up the task so it can execute in the background.  The
+			// application is launched directly, with each member of
+			// appArgList passed unchanged as one argument.
+		
 		virtual void AddCallback (AppExecCallback callbackFunction, void* userData = NULL);
 	
+		virtual void SetStreamOutput (bool streamOutput);
+			// If streamOutput is true then callbacks receive the application's
+			// output in blocks as it is read, followed by one final call with
+			// empty data once the application exits, instead of a single
+			// call with all of the output.  The final call is made even if
+			// the application could not be run.
+	
+	protected:
+		
+		virtual void _CallCallbacks (const std::string& returnedData);
+			// Passes returnedData to each registered callback in turn.
+		
+		static void _StreamOutputHandler (const char* data, size_t dataLength, void* handlerData);
+			// ExecWithIO() output handler used in streaming mode; handlerData
+			// is the task object.
+	
 	protected:
 		
 		TFileObj										fFileObj;
 		std::string										fAppArgs;
+		StdStringList									fAppArgList;
+		bool											fUseArgList;
 		std::string										fAppStdInData;
 		CallbackList									fCallbackList;
+		bool											fStreamOutput;
 };
 
 //---------------------------------------------------------------------
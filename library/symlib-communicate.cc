@@ -26,6 +26,8 @@
 
 #include "symlib-prefs.h"
 
+#include <sys/time.h>
+
 //---------------------------------------------------------------------
 // Begin Environment
 //---------------------------------------------------------------------
@@ -39,6 +41,32 @@ namespace symbiot {
 #define		kCACertFileName							"cacert.pem"
 #define		kAgentCertFileName						"agent.pem"
 
+//---------------------------------------------------------------------
+// _ParseCompressionParams (static)
+//---------------------------------------------------------------------
+static void _ParseCompressionParams (const TXMLNodeObj* nodePtr, CompressionParams& params)
+{
+	std::string		levelStr(nodePtr->AttributeValue(kTagPrefCompressionLevel));
+	std::string		strategyStr(nodePtr->AttributeValue(kTagPrefCompressionStrategy));
+	
+	if (!levelStr.empty())
+	{
+		int		level = static_cast<int>(StringToNum(levelStr));
+		
+		if (level >= kCompressionLevelFastest && level <= kCompressionLevelBest)
+			params.level = level;
+	}
+	
+	if (strategyStr == "default")
+		params.strategy = kCompressionStrategyDefault;
+	else if (strategyStr == "filtered")
+		params.strategy = kCompressionStrategyFiltered;
+	else if (strategyStr == "huffman")
+		params.strategy = kCompressionStrategyHuffmanOnly;
+	else if (strategyStr == "rle")
+		params.strategy = kCompressionStrategyRLE;
+}
+
 //*********************************************************************
 // Class TServerObj
 //*********************************************************************
@@ -51,9 +79,17 @@ TServerObj::TServerObj ()
 		fHostAddress(0),
 		fHostPort(0),
 		fHostSSLPort(0),
-		fCompressionMode(kCompressionModeNone)
+		fSessionResumed(false),
+		fLoggingIn(false),
+		fServerCommandPending(false),
+		fCompressionMode(kCompressionModeNone),
+		fDeflateContext(kCompressionLevelServerDefault,kCompressionStrategyDefault)
 {
 	Inherited::SetTimeout(kServerCommunicationTimeout);
+	pthread_cond_init(&fServerCommandAvailable,NULL);
+	
+	fDefaultCompressionParams.level = kCompressionLevelServerDefault;
+	fDefaultCompressionParams.strategy = kCompressionStrategyDefault;
 }
 
 //---------------------------------------------------------------------
@@ -61,7 +97,22 @@ TServerObj::TServerObj ()
 //---------------------------------------------------------------------
 TServerObj::~TServerObj ()
 {
+	ServerCommandEntry*		entryPtr = fServerCommandStack.TakeAll();
+	
 	Disconnect();
+	
+	while (entryPtr)
+	{
+		ServerCommandEntry*		nextPtr = entryPtr->nextPtr;
+		
+		delete(entryPtr);
+		entryPtr = nextPtr;
+	}
+	
+	for (ServerCommandList::iterator x = fServerCommandList.begin(); x != fServerCommandList.end(); x++)
+		delete(*x);
+	
+	pthread_cond_destroy(&fServerCommandAvailable);
 }
 
 //---------------------------------------------------------------------
@@ -88,8 +139,33 @@ void TServerObj::Connect ()
 	// Tell the SSL objects which socket to use
 	fSSLConnection.SetInputOutputSocket(GetIOSocket());
 	
+	// Offer the server our last session so it can skip the key exchange
+	fSessionResumed = false;
+	if (fSSLSession.IsInited())
+	{
+		try
+		{
+			fSSLConnection.SetCurrentSession(fSSLSession);
+		}
+		catch (...)
+		{
+			fSSLSession = TSSLSession();
+		}
+	}
+	
 	// Negotiate
-	fSSLConnection.Connect();
+	try
+	{
+		fSSLConnection.Connect();
+	}
+	catch (...)
+	{
+		// Don't offer that session again
+		fSSLSession = TSSLSession();
+		throw;
+	}
+	
+	fSessionResumed = fSSLConnection.CurrentSessionReused();
 	
 	// Initialize some of our other stuff
 	fMACAddress = Inherited::LocalMACAddress();
@@ -109,6 +185,19 @@ void TServerObj::Disconnect (bool hardDisconnect)
 {
 	try
 	{
+		if (fSSLConnection.IsConnected())
+		{
+			try
+			{
+				// Remember the session for the next Connect()
+				fSSLSession = fSSLConnection.GetCurrentSession();
+			}
+			catch (...)
+			{
+				fSSLSession = TSSLSession();
+			}
+		}
+		
 		if (!hardDisconnect)
 		{
 			try
@@ -152,24 +241,76 @@ bool TServerObj::HaveServerCommands ()
 {
 	TLockedPthreadMutexObj	lock(fServerCommandQueueLock);
 	
-	return !fServerCommandQueue.empty();
+	_CollectServerCommands();
+	
+	return !fServerCommandList.empty();
 }
 
 //---------------------------------------------------------------------
 // TServerObj::GetServerCommand
 //---------------------------------------------------------------------
-std::string TServerObj::GetServerCommand ()
+bool TServerObj::GetServerCommand (TServerReply& serverCommand, double maxWaitSeconds)
 {
-	std::string				command;
-	TLockedPthreadMutexObj	lock(fServerCommandQueueLock);
+	ServerCommandEntry*		entryPtr = NULL;
+	
+	{
+		TLockedPthreadMutexObj	lock(fServerCommandQueueLock);
+		
+		_CollectServerCommands();
+		if (!fServerCommandList.empty())
+		{
+			entryPtr = fServerCommandList.front();
+			fServerCommandList.pop_front();
+		}
+	}
+	
+	if (!entryPtr && maxWaitSeconds > 0)
+	{
+		struct timeval		timeNow;
+		struct timespec		deadline;
+		long long			deadlineNanoseconds = 0;
+		bool				timedOut = false;
+		
+		gettimeofday(&timeNow,NULL);
+		deadlineNanoseconds = static_cast<long long>(timeNow.tv_usec) * 1000 + static_cast<long long>(maxWaitSeconds * 1000000000.0);
+		deadline.tv_sec = timeNow.tv_sec + static_cast<time_t>(deadlineNanoseconds / 1000000000);
+		deadline.tv_nsec = static_cast<long>(deadlineNanoseconds % 1000000000);
+		
+		while (!entryPtr && !timedOut)
+		{
+			// Producers signal only when they queue onto an empty list, which
+			// is exactly when a waiter could be missing a command.  The flag
+			// may also be left over from commands already collected, in which
+			// case we come around and wait again.
+			{
+				TLockedPthreadMutexObj	lock(fServerCommandSignalLock);
+				int						result = 0;
+				
+				while (!fServerCommandPending && result != ETIMEDOUT)
+					result = pthread_cond_timedwait(&fServerCommandAvailable,fServerCommandSignalLock.MutexPtr(),&deadline);
+				
+				timedOut = (result == ETIMEDOUT);
+				fServerCommandPending = false;
+			}
+			
+			TLockedPthreadMutexObj	lock(fServerCommandQueueLock);
+			
+			_CollectServerCommands();
+			if (!fServerCommandList.empty())
+			{
+				entryPtr = fServerCommandList.front();
+				fServerCommandList.pop_front();
+			}
+		}
+	}
 	
-	if (!fServerCommandQueue.empty())
+	if (entryPtr)
 	{
-		command = fServerCommandQueue.front();
-		fServerCommandQueue.pop();
+		serverCommand.Swap(entryPtr->reply);
+		delete(entryPtr);
 	}
 	
-	return command;
+	return (entryPtr != NULL);
 }
 
 //---------------------------------------------------------------------
@@ -177,9 +318,27 @@ std::string TServerObj::GetServerCommand ()
 //---------------------------------------------------------------------
 void TServerObj::SaveServerCommand (const std::string& serverCommand)
 {
-	TLockedPthreadMutexObj	lock(fServerCommandQueueLock);
+	ServerCommandEntry*		entryPtr = new ServerCommandEntry;
+	
+	try
+	{
+		entryPtr->reply.Parse(serverCommand);
+	}
+	catch (...)
+	{
+		// Parse() has already logged the problem; a bad command should
+		// not fail the send that carried it
+		delete(entryPtr);
+		return;
+	}
 	
-	fServerCommandQueue.push(serverCommand);
+	if (fServerCommandStack.Push(entryPtr))
+	{
+		TLockedPthreadMutexObj	lock(fServerCommandSignalLock);
+		
+		fServerCommandPending = true;
+		pthread_cond_signal(&fServerCommandAvailable);
+	}
 }
 
 //---------------------------------------------------------------------
@@ -188,6 +347,7 @@ void TServerObj::SaveServerCommand (const std::string& serverCommand)
 void TServerObj::_Initialize ()
 {
 	const TXMLNodeObj*	serverNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefServer);
+	std::string			contextKey;
 	
 	// First, just blast the information into the slots
 	fCertDirObj.SetPath(GetPrefsPtr()->GetPrefData(kTagPrefCertDir));
@@ -196,6 +356,8 @@ void TServerObj::_Initialize ()
 	fHostPort = static_cast<unsigned int>(StringToNum(GetPrefsPtr()->GetNodePtrData(serverNodePtr,kTagPrefPort)));
 	fHostSSLPort = static_cast<unsigned int>(StringToNum(GetPrefsPtr()->GetNodePtrData(serverNodePtr,kTagPrefSSLPort)));
 	
+	_InitializeCompression();
+	
 	if (fHost.find('/') != std::string::npos)
 	{
 		StdStringList		tempList;
@@ -304,12 +466,25 @@ void TServerObj::_Initialize ()
 		}
 	}
 	
-	// Initialize the SSL context
-	fSSLContext.Initialize(kSSLClientMode,kSSLv23Protocol);
-	fSSLContext.SetCertificateAuthorityFile(fCACertFileObj);
-	fSSLContext.SetCertificate(fAgentCertFileObj,SSL_FILETYPE_PEM);
-	fSSLContext.SetPrivateKey(fAgentCertFileObj,SSL_FILETYPE_PEM);
-	fSSLContext.SetOptions(SSL_OP_NO_SSLv2);
+	// Initialize the SSL context, unless we already have one built from
+	// the same certificate files; sessions can only be resumed within
+	// the context that created them
+	contextKey = fCACertFileObj.Path() + ":" + NumToString(fCACertFileObj.ModificationTime().GetUnixSeconds());
+	contextKey += ":" + fAgentCertFileObj.Path() + ":" + NumToString(fAgentCertFileObj.ModificationTime().GetUnixSeconds());
+	
+	if (!fSSLContext.IsInited() || contextKey != fSSLContextKey)
+	{
+		fSSLSession = TSSLSession();
+		fSSLContextKey = "";
+		
+		fSSLContext.Initialize(kSSLClientMode,kSSLv23Protocol);
+		fSSLContext.SetCertificateAuthorityFile(fCACertFileObj);
+		fSSLContext.SetCertificate(fAgentCertFileObj,SSL_FILETYPE_PEM);
+		fSSLContext.SetPrivateKey(fAgentCertFileObj,SSL_FILETYPE_PEM);
+		fSSLContext.SetOptions(SSL_OP_NO_SSLv2);
+		
+		fSSLContextKey = contextKey;
+	}
 	
 	// Initialize the SSL connection
 	fSSLConnection.Initialize(fSSLContext);
@@ -317,6 +492,76 @@ void TServerObj::_Initialize ()
 	fSSLConnection.SetIOTimeout(kServerCommunicationTimeout);
 }
 
+//---------------------------------------------------------------------
+// TServerObj::_InitializeCompression (protected)
+//---------------------------------------------------------------------
+void TServerObj::_InitializeCompression ()
+{
+	const TXMLNodeObj*	compressionNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefCompression);
+	
+	fDefaultCompressionParams.level = kCompressionLevelServerDefault;
+	fDefaultCompressionParams.strategy = kCompressionStrategyDefault;
+	fCompressionParamsMap.clear();
+	
+	if (compressionNodePtr)
+	{
+		_ParseCompressionParams(compressionNodePtr,fDefaultCompressionParams);
+		
+		for (unsigned long x = 0; x < compressionNodePtr->SubnodeCount(); x++)
+		{
+			const TXMLNodeObj*	messageNodePtr = compressionNodePtr->NthSubnode(x);
+			std::string			messageType;
+			
+			if (messageNodePtr && messageNodePtr->Tag() == kTagPrefCompressionMessage)
+			{
+				messageType = messageNodePtr->AttributeValue(kTagPrefCompressionType);
+				if (!messageType.empty())
+				{
+					CompressionParams	params(fDefaultCompressionParams);
+					
+					_ParseCompressionParams(messageNodePtr,params);
+					fCompressionParamsMap[messageType] = params;
+				}
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TServerObj::_CompressionParamsForMessage (protected)
+//---------------------------------------------------------------------
+CompressionParams TServerObj::_CompressionParamsForMessage (const std::string& message) const
+{
+	CompressionParams		params(fDefaultCompressionParams);
+	
+	if (!fCompressionParamsMap.empty())
+	{
+		std::string::size_type	pos = 0;
+		unsigned int			elementCount = 0;
+		
+		// Skip the envelope's opening tag and find the first one within it;
+		// processing instructions and comments are not elements
+		while (elementCount < 2 && (pos = message.find('<',pos)) != std::string::npos)
+		{
+			++pos;
+			if (pos < message.length() && message[pos] != '?' && message[pos] != '!' && message[pos] != '/')
+				++elementCount;
+		}
+		
+		if (elementCount == 2)
+		{
+			std::string::size_type	endPos = message.find_first_of(" \t\r\n/>",pos);
+			std::string				messageClass(message,pos,(endPos == std::string::npos ? std::string::npos : endPos - pos));
+			CompressionParamsMap_const_iter	foundIter = fCompressionParamsMap.find(messageClass);
+			
+			if (foundIter != fCompressionParamsMap.end())
+				params = foundIter->second;
+		}
+	}
+	
+	return params;
+}
+
 //---------------------------------------------------------------------
 // TServerObj::_Send (protected)
 //---------------------------------------------------------------------
@@ -363,8 +608,15 @@ bool TServerObj::_Send (const std::string& stuffToSend, CompressionMode compress
 				break;
 			
 			case kCompressionModeGZip:
-				messageBuffer += "gzip" + kEOL;
-				Compress(completeDataBuffer,compressionMode);
+				{
+					CompressionParams	params(_CompressionParamsForMessage(completeDataBuffer));
+					std::string			compressedBuffer;
+					
+					messageBuffer += "gzip" + kEOL;
+					fDeflateContext.SetParameters(params.level,params.strategy);
+					GZipCompress(completeDataBuffer,compressedBuffer,fDeflateContext);
+					completeDataBuffer = compressedBuffer;
+				}
 				break;
 		}
 		messageBuffer += "Content-Length: ";
@@ -569,6 +821,27 @@ std::string TServerObj::_Receive ()
 	return reply;
 }
 
+//---------------------------------------------------------------------
+// TServerObj::_CollectServerCommands (protected)
+//---------------------------------------------------------------------
+void TServerObj::_CollectServerCommands ()
+{
+	ServerCommandEntry*		entryPtr = fServerCommandStack.TakeAll();
+	
+	if (entryPtr)
+	{
+		ServerCommandList::iterator		insertPos = fServerCommandList.end();
+		
+		// The taken list is newest first; inserting each entry ahead of
+		// the previous one puts them in arrival order
+		while (entryPtr)
+		{
+			insertPos = fServerCommandList.insert(insertPos,entryPtr);
+			entryPtr = entryPtr->nextPtr;
+		}
+	}
+}
+
 //---------------------------------------------------------------------
 // TServerObj::_LogCommunication (protected)
 //---------------------------------------------------------------------
@@ -27,12 +27,14 @@
 //---------------------------------------------------------------------
 #include "symlib-utils.h"
 
+#include "symlib-message.h"
 #include "symlib-ssl-tls.h"
 #include "symlib-tcp.h"
 #include "symlib-threads.h"
 
 #include <deque>
-#include <queue>
+#include <map>
+#include <pthread.h>
 
 //---------------------------------------------------------------------
 // Begin Environment
@@ -42,7 +44,23 @@ namespace symbiot {
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
-typedef	std::queue<std::string>						ServerCommandQueue;
+struct	ServerCommandEntry
+	{
+		TServerReply					reply;
+		ServerCommandEntry*				nextPtr;
+	};
+
+typedef	std::deque<ServerCommandEntry*>				ServerCommandList;
+
+struct	CompressionParams
+	{
+		int								level;
+		CompressionStrategy				strategy;
+	};
+
+typedef	std::map<std::string,CompressionParams>		CompressionParamsMap;
+typedef	CompressionParamsMap::iterator				CompressionParamsMap_iter;
+typedef	CompressionParamsMap::const_iterator		CompressionParamsMap_const_iter;
 
 //---------------------------------------------------------------------
 // Forward Class Declarations
@@ -78,11 +96,14 @@ class TServerObj : public TTCPConnectionObj
 		
 		virtual void Connect ();
 			// Opens a secured connection with the server defined in
-			// the local configuration file.
+			// the local configuration file.  The TLS session from the
+			// previous connection, if any, is offered to the server so that
+			// it can skip the full handshake.
 		
 		virtual void Disconnect (bool hardDisconnect = false);
 			// Disconnects an open connection with the server.  If hardDisconnect is
-			// true then the connection is simply slammed down.
+			// true then the connection is simply slammed down.  Either way, the
+			// connection's TLS session is kept for the next Connect().
 		
 		virtual bool Send (const std::string& stuffToSend, CompressionMode compressionMode = kCompressionModeUnspecified);
 			// Sends the concatenation of the internal send buffer and
@@ -96,12 +117,17 @@ class TServerObj : public TTCPConnectionObj
 		virtual bool HaveServerCommands ();
 			// Returns true if there are any pending server commands.
 		
-		virtual std::string GetServerCommand ();
-			// Returns the least-recent server command.  Will return an empty string
-			// if no commands are in the queue.
+		virtual bool GetServerCommand (TServerReply& serverCommand, double maxWaitSeconds = 0);
+			// Destructively modifies the argument to contain the least-recent
+			// server command, removing it from the queue.  If the queue is
+			// empty, waits up to maxWaitSeconds for a command to arrive.
+			// Returns true if a command was found, false otherwise.
 		
 		virtual void SaveServerCommand (const std::string& serverCommand);
-			// Puts the server command on the queue.
+			// Parses the server command and puts it on the queue, waking
+			// any thread waiting within GetServerCommand().  Queueing never
+			// blocks the caller.  Commands that cannot be parsed are logged
+			// and dropped.
 		
 		// ----------------------------------
 		// Accessors
@@ -129,7 +155,22 @@ class TServerObj : public TTCPConnectionObj
 			{ return fMACAddress; }
 		
 		inline bool IsConnected () const
-			{ return (Inherited::IsConnected() && fSSLConnection.IsConnected()); }
+			{
+				// While a login is in progress only the thread performing
+				// it may use the connection
+				return (Inherited::IsConnected() &&
+						fSSLConnection.IsConnected() &&
+						(!fLoggingIn || pthread_equal(fLoginThread,pthread_self())));
+			}
+		
+		inline void BeginLogin ()
+			{
+				fLoginThread = pthread_self();
+				fLoggingIn = true;
+			}
+		
+		inline void EndLogin ()
+			{ fLoggingIn = false; }
 		
 		inline std::string LineDelimiter () const
 			{ return fLineDelimiter; }
@@ -143,12 +184,30 @@ class TServerObj : public TTCPConnectionObj
 		inline void SetCompressionMode (CompressionMode newMode)
 			{ fCompressionMode = newMode; }
 	
+		inline bool SessionResumed () const
+			{ return fSessionResumed; }
+		
+		inline std::string ReloginToken () const
+			{ return fReloginToken; }
+		
+		inline void SetReloginToken (const std::string& reloginToken)
+			{ fReloginToken = reloginToken; }
+	
 	protected:
 		
 		virtual void _Initialize ();
 			// Initializes our internal slots from the environment,
 			// mostly the local preferences file.
 		
+		virtual void _InitializeCompression ();
+			// Reads the compression level and strategy to use for each
+			// message class from the local preferences file.
+		
+		virtual CompressionParams _CompressionParamsForMessage (const std::string& message) const;
+			// Returns the compression level and strategy that should be used
+			// for the message, based on the tag of the first element within
+			// its envelope (LOGIN, HEARTBEAT, etc.).
+		
 		virtual bool _Send (const std::string& stuffToSend, CompressionMode compressionMode);
 			// Sends the concatenation of the internal send buffer and
 			// the argument to the server.
@@ -158,6 +217,10 @@ class TServerObj : public TTCPConnectionObj
 		
 		virtual void _LogCommunication (const std::string& data, const std::string prompt) const;
 			// Debugging method that writes communication to the current log file.
+		
+		virtual void _CollectServerCommands ();
+			// Moves newly-queued server commands, oldest first, to the end of
+			// fServerCommandList.  Caller must hold fServerCommandQueueLock.
 	
 	protected:
 		
@@ -174,11 +237,62 @@ class TServerObj : public TTCPConnectionObj
 		unsigned int							fHostPort;
 		unsigned int							fHostSSLPort;
 		TSSLContext								fSSLContext;
+		std::string								fSSLContextKey;				// certificate files fSSLContext was built from
 		TSSLConnection							fSSLConnection;
+		TSSLSession								fSSLSession;
+		bool									fSessionResumed;
+		std::string								fReloginToken;
+		volatile bool							fLoggingIn;
+		pthread_t								fLoginThread;
 		std::string								fLineDelimiter;
 		std::string								fSectionDelimiter;
-		ServerCommandQueue						fServerCommandQueue;
+		TAtomicStackObj<ServerCommandEntry>		fServerCommandStack;		// newest first, pushed without locking
+		ServerCommandList						fServerCommandList;			// oldest first, guarded by fServerCommandQueueLock
+		TPthreadMutexObj						fServerCommandSignalLock;
+		pthread_cond_t							fServerCommandAvailable;
+		bool									fServerCommandPending;
 		CompressionMode							fCompressionMode;
+		CompressionParams						fDefaultCompressionParams;
+		CompressionParamsMap					fCompressionParamsMap;
+		TDeflateContext							fDeflateContext;
+};
+
+//---------------------------------------------------------------------
+// Class TServerLoginScope
+//
+// Marks the server connection as logging in from construction until
+// Release() is called or the object goes out of scope.  Meanwhile
+// TServerObj::IsConnected() is false to every other thread, so they
+// spool or skip their messages instead of sending them on a connection
+// the server has not accepted yet.
+//---------------------------------------------------------------------
+class TServerLoginScope
+{
+	public:
+		
+		TServerLoginScope (TServerObj* serverObjPtr) : fServerObjPtr(serverObjPtr)
+			{ fServerObjPtr->BeginLogin(); }
+		
+		~TServerLoginScope ()
+			{ Release(); }
+		
+		inline void Release ()
+			{
+				if (fServerObjPtr)
+				{
+					fServerObjPtr->EndLogin();
+					fServerObjPtr = NULL;
+				}
+			}
+	
+	private:
+		
+		TServerLoginScope (const TServerLoginScope& obj) {}
+			// Copy constructor is illegal
+	
+	protected:
+		
+		TServerObj*								fServerObjPtr;
 };
 
 //---------------------------------------------------------------------
@@ -63,6 +63,7 @@ namespace symbiot {
 #define		kAppArgKeyDaemonize							"--daemon"		// Same functionality as kAppArgKeyStart
 
 #define		kAppArgKeyEnableCommLogging					"--enable-comm-logging"
+#define		kAppArgKeyEnableMutexStats					"--enable-mutex-stats"
 #define		kAppArgKeyUse7200ConfFile					"--conf-use-7200"
 
 //---------------------------------------------------
@@ -87,6 +88,18 @@ typedef		enum
 					kCompressionModeGZip
 				}	CompressionMode;
 
+typedef		enum
+				{
+					kCompressionStrategyDefault = 0,
+					kCompressionStrategyFiltered,
+					kCompressionStrategyHuffmanOnly,
+					kCompressionStrategyRLE		// Same as default if zLib does not support it
+				}	CompressionStrategy;
+
+#define		kCompressionLevelFastest					1
+#define		kCompressionLevelBest						9
+#define		kCompressionLevelServerDefault				6
+
 //---------------------------------------------------
 // Dynamic debugging flags
 // (note: Max 64 bits)
@@ -94,6 +107,7 @@ typedef		enum
 
 #define		kDynDebugNone								0
 #define		kDynDebugLogServerCommunication				1
+#define		kDynDebugLogMutexContention					2
 
 //---------------------------------------------------
 // General-use data structures and whatnot
@@ -173,7 +187,26 @@ typedef		bool (*AppExecCallback) (const std::string& returnedData,
 	// that registered the callback.  If the callback returns true then
 	// no other callback functions registered with this task will be
 	// called; if false is returned then the next callback (if any)
-	// will be called.
+	// will be called.  If the task streams its output (see
+	// SetAppExecStreamOutput()) then the callback is called with each
+	// block of output as it arrives and finally with empty returnedData.
+
+//---------------------------------------------------
+// Streaming XML parser definitions
+//---------------------------------------------------
+
+class		TMessageNode;
+
+typedef		void*										XMLStreamRef;
+
+typedef		void (*XMLStreamCallback) (const TMessageNode& elementNode,
+									   void* userData);
+	// The callback function is called by a streaming XML parser each time
+	// it finishes parsing one of the elements it was asked to watch for.
+	// elementNode contains that element, its attributes and everything
+	// nested within it; it is valid only for the duration of the callback.
+	// userData is the (possibly NULL) pointer to user data passed to the
+	// function that created the parser.
 
 //---------------------------------------------------------------------
 // End Environment
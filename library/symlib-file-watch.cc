@@ -24,11 +24,14 @@
 //---------------------------------------------------------------------
 #include "symlib-file-watch.h"
 
+#include "symlib-prefs.h"
 #include "symlib-ssl-digest.h"
 #include "symlib-ssl-encode.h"
 #include "symlib-time.h"
 #include "symlib-utils.h"
 
+#include <zlib.h>
+
 //---------------------------------------------------------------------
 // Begin Environment
 //---------------------------------------------------------------------
@@ -39,6 +42,12 @@ namespace symbiot {
 //---------------------------------------------------------------------
 #define	kDefaultExecutionInterval								60
 
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static	TFileWatchJournal*								gFileWatchJournalPtr = NULL;
+static	TPthreadMutexObj								gFileWatchJournalPtrMutex;
+
 //*********************************************************************
 // Class TTaskFileWatch
 //*********************************************************************
@@ -49,6 +58,13 @@ namespace symbiot {
 TTaskFileWatch::TTaskFileWatch (FileWatchStyle watchStyle)
 	:	Inherited(gEnvironObjPtr->GetTaskName(),kDefaultExecutionInterval,true),
 		fWatchStyle(watchStyle),
+		fReadPosition(0),
+		fReadWindowSize(kFileWatchDefaultReadWindow),
+		fWindowsPerPass(kFileWatchDefaultWindowsPerPass),
+		fUnclaimedByteCount(0),
+		fHeadLength(0),
+		fHeadCRC(0),
+		fCloseAfterDispatch(false),
 		fInited(false)
 {
 }
@@ -59,6 +75,13 @@ TTaskFileWatch::TTaskFileWatch (FileWatchStyle watchStyle)
 TTaskFileWatch::TTaskFileWatch (time_t intervalInSeconds, FileWatchStyle watchStyle)
 	:	Inherited(gEnvironObjPtr->GetTaskName(),intervalInSeconds,true),
 		fWatchStyle(watchStyle),
+		fReadPosition(0),
+		fReadWindowSize(kFileWatchDefaultReadWindow),
+		fWindowsPerPass(kFileWatchDefaultWindowsPerPass),
+		fUnclaimedByteCount(0),
+		fHeadLength(0),
+		fHeadCRC(0),
+		fCloseAfterDispatch(false),
 		fInited(false)
 {
 }
@@ -68,6 +91,18 @@ TTaskFileWatch::TTaskFileWatch (time_t intervalInSeconds, FileWatchStyle watchSt
 //---------------------------------------------------------------------
 TTaskFileWatch::~TTaskFileWatch ()
 {
+	try
+	{
+		if (fWatchStyle == kWatchStyleTail)
+		{
+			_CommitToJournal();
+			GetFileWatchJournalPtr()->Flush(true);
+		}
+	}
+	catch (...)
+	{
+		// Ignore all errors
+	}
 }
 
 //---------------------------------------------------------------------
@@ -84,7 +119,28 @@ void TTaskFileWatch::SetupTask (const TFileObj& fileObj, FileWatchStyle watchSty
 	memset(&fPrevFileInfo,0,sizeof(fPrevFileInfo));
 	memset(&fInternalAccessTime,0,sizeof(fInternalAccessTime));
 	fWatchStyle = watchStyle;
+	fReadPosition = 0;
+	fUnclaimedByteCount = 0;
+	fHeadLength = 0;
+	fCloseAfterDispatch = false;
 	fInited = false;
+	
+	// Pick up the read window settings from the local configuration, if present
+	if (GetPrefsPtr()->LocalPrefsLoaded())
+	{
+		const TXMLNodeObj*	fileWatchNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefFileWatch);
+		
+		if (fileWatchNodePtr)
+		{
+			std::string		windowStr(fileWatchNodePtr->AttributeValue(kTagPrefReadWindow));
+			std::string		windowsPerPassStr(fileWatchNodePtr->AttributeValue(kTagPrefWindowsPerPass));
+			
+			if (!windowStr.empty())
+				fReadWindowSize = static_cast<unsigned long>(StringToNum(windowStr));
+			if (!windowsPerPassStr.empty())
+				fWindowsPerPass = static_cast<unsigned long>(StringToNum(windowsPerPassStr));
+		}
+	}
 }
 
 //---------------------------------------------------------------------
@@ -120,8 +176,52 @@ void TTaskFileWatch::RunTask ()
 	{
 		fileChanges = _GetStat();
 		
+		// Data left over from an earlier window-limited pass still needs
+		// to be handed to the callbacks
+		if (fWatchStyle == kWatchStyleTail && _HasUnreadData())
+			fileChanges |= kFileWatchChangeFlagDataSize;
+		
 		if (fileChanges != kFileWatchChangeFlagNone)
+		{
 			_DispatchCallbacks(fileChanges);
+			
+			// Keep handing windows to the callbacks as long as they're
+			// consuming them, but only up to our per-pass limit so a large
+			// backlog is drained over several passes
+			for (unsigned long windowCount = 1; fWatchStyle == kWatchStyleTail && _HasUnreadData(); windowCount++)
+			{
+				unsigned long	prevReadPosition = fReadPosition;
+				
+				if (fWindowsPerPass > 0 && windowCount >= fWindowsPerPass && !fCloseAfterDispatch)
+					break;
+				
+				_DispatchCallbacks(kFileWatchChangeFlagDataSize);
+				
+				if (fReadPosition == prevReadPosition)
+					break;
+			}
+		}
+		
+		_CommitToJournal();
+		
+		if (fWatchStyle == kWatchStyleTail)
+		{
+			if (fCloseAfterDispatch && fFileObj.IsOpen())
+			{
+				// This file is going away; so should its journal entry
+				GetFileWatchJournalPtr()->RemoveEntry(fCurrentFileInfo.stat.st_dev,fCurrentFileInfo.stat.st_ino);
+			}
+			
+			GetFileWatchJournalPtr()->Flush();
+		}
+		
+		if (fCloseAfterDispatch)
+		{
+			// The file we were tracking has been replaced or removed; now that
+			// its remaining data has been read we can let it go
+			fFileObj.Close();
+			fCloseAfterDispatch = false;
+		}
 	}
 }
 
@@ -143,21 +243,14 @@ std::string TTaskFileWatch::ReadAddedFileData ()
 	
 	if (fWatchStyle == kWatchStyleTail)
 	{
-		if (fInited && fCurrentFileInfo.stat.st_size != fPrevFileInfo.stat.st_size)
+		if (fInited && _HasUnreadData())
 		{
-			unsigned long	startPos = 0;
-			unsigned long	endPos = 0;
+			unsigned long	length = static_cast<unsigned long>(fCurrentFileInfo.stat.st_size) - fReadPosition;
 			
-			if (fCurrentFileInfo.stat.st_size > fPrevFileInfo.stat.st_size)
-			{
-				startPos = fPrevFileInfo.stat.st_size;
-				endPos = fCurrentFileInfo.stat.st_size;
-			}
-			else
-			{
-				startPos = 0;
-				endPos = fCurrentFileInfo.stat.st_size;
-			}
+			// Never read more than one window at a time; RunTask() will
+			// call back for the remainder
+			if (fReadWindowSize > 0 && length > fReadWindowSize)
+				length = fReadWindowSize;
 			
 			try
 			{
@@ -165,8 +258,10 @@ std::string TTaskFileWatch::ReadAddedFileData ()
 				{
 					struct stat		info;
 					
-					fFileObj.SetFilePosition(startPos);
-					fFileObj.Read(data,endPos - startPos);
+					data.reserve(length);
+					fFileObj.SetFilePosition(fReadPosition);
+					fFileObj.Read(data,length);
+					fReadPosition += data.length();
 					
 					// Log our own access to the file
 					fFileObj.StatInfo(info,true);
@@ -207,7 +302,12 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 		{
 			fCurrentFileInfo.exists = true;
 			fFileObj.Open();
+			fHeadLength = 0;
 			fFileObj.StatInfo(fCurrentFileInfo.stat,true);
+			fReadPosition = fCurrentFileInfo.stat.st_size;
+			
+			if (fWatchStyle == kWatchStyleTail)
+				_ResumeFromJournal();
 			
 			if (fWatchStyle == kWatchStyleContents)
 				fContentSig = _ComputeFileSignature();
@@ -215,6 +315,7 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 		else
 		{
 			fCurrentFileInfo.exists = false;
+			fReadPosition = 0;
 		}
 		
 		fCurrentFileInfo.timestamp = CurrentMilliseconds();
@@ -233,7 +334,12 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 					fCurrentFileInfo.exists = true;
 					changes |= kFileWatchChangeFlagAppeared;
 					fFileObj.Open();
+					fHeadLength = 0;
 					fFileObj.StatInfo(fCurrentFileInfo.stat,true);
+					fReadPosition = fCurrentFileInfo.stat.st_size;
+					
+					if (fWatchStyle == kWatchStyleTail)
+						_ResumeFromJournal();
 					
 					if (fWatchStyle == kWatchStyleContents)
 						fContentSig = _ComputeFileSignature();
@@ -244,7 +350,10 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 					fCurrentFileInfo.exists = true;
 					changes |= kFileWatchChangeFlagRotated;
 					fFileObj.Open();
+					fHeadLength = 0;
 					memset(&fCurrentFileInfo.stat,0,sizeof(fCurrentFileInfo.stat));
+					fReadPosition = 0;
+					fUnclaimedByteCount = 0;
 					fContentSig = "";
 				}
 			}
@@ -258,6 +367,7 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 				
 				memset(&fCurrentFileInfo.stat,0,sizeof(fCurrentFileInfo.stat));
 				fCurrentFileInfo.exists = false;
+				fReadPosition = 0;
 				fContentSig = "";
 			}
 			
@@ -292,6 +402,11 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 			if (fCurrentFileInfo.stat.st_size != fPrevFileInfo.stat.st_size)
 				changes |= kFileWatchChangeFlagDataSize;
 			
+			// A file that shrank has been truncated; start over at the top
+			if (static_cast<unsigned long>(fCurrentFileInfo.stat.st_size) < fReadPosition ||
+				fCurrentFileInfo.stat.st_size < fPrevFileInfo.stat.st_size)
+				fReadPosition = 0;
+			
 			if (fWatchStyle == kWatchStyleContents)
 			{
 				std::string		newSig = _ComputeFileSignature();
@@ -312,16 +427,18 @@ FileWatchChangeFlag TTaskFileWatch::_GetStat ()
 				if (tempFileInfo.st_ino != fCurrentFileInfo.stat.st_ino || tempFileInfo.st_dev != fCurrentFileInfo.stat.st_dev)
 				{
 					// There is now another file with our name on the disk;
-					// close our open pipe so the new file's info will be
-					// picked up over the next two method calls
-					fFileObj.Close();
+					// close our open pipe (once our callbacks have drained it)
+					// so the new file's info will be picked up over the next
+					// two method calls
+					fCloseAfterDispatch = true;
 				}
 			}
 			else
 			{
 				// Looks like we've been closed and deleted; close our open
-				// pipe to pick up the status on the next method call.
-				fFileObj.Close();
+				// pipe (once our callbacks have drained it) to pick up the
+				// status on the next method call.
+				fCloseAfterDispatch = true;
 			}
 		}
 	}
@@ -350,6 +467,81 @@ void TTaskFileWatch::_DispatchCallbacks (FileWatchChangeFlag flag)
 	}
 }
 
+//---------------------------------------------------------------------
+// TTaskFileWatch::_HasUnreadData (protected)
+//---------------------------------------------------------------------
+bool TTaskFileWatch::_HasUnreadData () const
+{
+	return (fFileObj.IsOpen() && static_cast<unsigned long>(fCurrentFileInfo.stat.st_size) > fReadPosition);
+}
+
+//---------------------------------------------------------------------
+// TTaskFileWatch::_ResumeFromJournal (protected)
+//---------------------------------------------------------------------
+void TTaskFileWatch::_ResumeFromJournal ()
+{
+	TFileWatchJournal::JournalEntry		entry;
+	
+	if (GetFileWatchJournalPtr()->GetEntry(fCurrentFileInfo.stat.st_dev,fCurrentFileInfo.stat.st_ino,entry))
+	{
+		unsigned long	fileSize = static_cast<unsigned long>(fCurrentFileInfo.stat.st_size);
+		bool			isValid = (entry.path == fFileObj.Path() && entry.offset <= fileSize);
+		
+		// Make sure the inode hasn't been reused for a different file
+		if (isValid && entry.headLength > 0)
+			isValid = (entry.headLength <= fileSize && _ComputeHeadCRC(entry.headLength) == entry.headCRC);
+		
+		if (isValid)
+		{
+			if (entry.offset < fReadPosition)
+			{
+				std::string		logString;
+				
+				logString = "Resuming watch of '" + fFileObj.Path() + "' at offset " + NumToString(entry.offset);
+				logString += " (" + NumToString(fReadPosition - entry.offset) + " bytes pending)";
+				WriteToMessagesLogFile(logString);
+			}
+			
+			fReadPosition = entry.offset;
+			fHeadLength = entry.headLength;
+			fHeadCRC = entry.headCRC;
+		}
+		else
+		{
+			WriteToMessagesLogFile("Ignoring journaled offset for '" + fFileObj.Path() + "'; the file has been replaced");
+			GetFileWatchJournalPtr()->RemoveEntry(fCurrentFileInfo.stat.st_dev,fCurrentFileInfo.stat.st_ino);
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TTaskFileWatch::_CommitToJournal (protected)
+//---------------------------------------------------------------------
+void TTaskFileWatch::_CommitToJournal ()
+{
+	if (fWatchStyle == kWatchStyleTail && fInited && fFileObj.IsOpen() && fCurrentFileInfo.stat.st_ino != 0)
+	{
+		TFileWatchJournal::JournalEntry		entry;
+		unsigned long						fileSize = static_cast<unsigned long>(fCurrentFileInfo.stat.st_size);
+		
+		// Fingerprint as much of the head of the file as we can, up to
+		// kFileWatchJournalHeadLength bytes; it only changes while the
+		// file is smaller than that
+		if (fHeadLength < kFileWatchJournalHeadLength && fileSize > fHeadLength)
+		{
+			fHeadLength = std::min(fileSize,static_cast<unsigned long>(kFileWatchJournalHeadLength));
+			fHeadCRC = _ComputeHeadCRC(fHeadLength);
+		}
+		
+		entry.path = fFileObj.Path();
+		entry.offset = fReadPosition - std::min(fReadPosition,fUnclaimedByteCount);
+		entry.headLength = fHeadLength;
+		entry.headCRC = fHeadCRC;
+		entry.claimed = true;
+		GetFileWatchJournalPtr()->SetEntry(fCurrentFileInfo.stat.st_dev,fCurrentFileInfo.stat.st_ino,entry);
+	}
+}
+
 //---------------------------------------------------------------------
 // TTaskFileWatch::_ComputeFileSignature (protected)
 //---------------------------------------------------------------------
@@ -372,6 +564,321 @@ std::string TTaskFileWatch::_ComputeFileSignature ()
 	return sig;
 }
 
+//---------------------------------------------------------------------
+// TTaskFileWatch::_ComputeHeadCRC (protected)
+//---------------------------------------------------------------------
+unsigned long TTaskFileWatch::_ComputeHeadCRC (unsigned long length)
+{
+	std::string		data;
+	uLong			crc = crc32(0L,Z_NULL,0);
+	
+	if (fFileObj.IsOpen() && length > 0)
+	{
+		// ReadAddedFileData() always repositions before reading, so we
+		// don't need to put the file position back
+		fFileObj.SetFilePosition(0);
+		fFileObj.Read(data,length);
+		crc = crc32(crc,reinterpret_cast<const Bytef*>(data.data()),data.length());
+	}
+	
+	return static_cast<unsigned long>(crc);
+}
+
+//*********************************************************************
+// Class TFileWatchJournal
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TFileWatchJournal::TFileWatchJournal ()
+	:	fLastFlushTime(time(NULL)),
+		fLoadTime(0),
+		fDirty(false),
+		fLoaded(false)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TFileWatchJournal::~TFileWatchJournal ()
+{
+	try
+	{
+		Flush(true);
+	}
+	catch (...)
+	{
+		// Ignore all errors
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::GetEntry
+//---------------------------------------------------------------------
+bool TFileWatchJournal::GetEntry (dev_t device, ino_t inode, JournalEntry& entry)
+{
+	bool					found = false;
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	_Load();
+	
+	EntryMap_iter	foundIter = fEntryMap.find(FileIdent(device,inode));
+	
+	if (foundIter != fEntryMap.end())
+	{
+		foundIter->second.claimed = true;
+		entry = foundIter->second;
+		found = true;
+	}
+	
+	return found;
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::SetEntry
+//---------------------------------------------------------------------
+void TFileWatchJournal::SetEntry (dev_t device, ino_t inode, const JournalEntry& entry)
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	EntryMap_iter			foundIter;
+	
+	_Load();
+	
+	foundIter = fEntryMap.find(FileIdent(device,inode));
+	if (foundIter == fEntryMap.end())
+	{
+		fEntryMap[FileIdent(device,inode)] = entry;
+		fDirty = true;
+	}
+	else if (foundIter->second.offset != entry.offset ||
+			 foundIter->second.path != entry.path ||
+			 foundIter->second.headLength != entry.headLength ||
+			 foundIter->second.headCRC != entry.headCRC)
+	{
+		foundIter->second = entry;
+		fDirty = true;
+	}
+	
+	fEntryMap[FileIdent(device,inode)].claimed = true;
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::RemoveEntry
+//---------------------------------------------------------------------
+void TFileWatchJournal::RemoveEntry (dev_t device, ino_t inode)
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	_Load();
+	
+	if (fEntryMap.erase(FileIdent(device,inode)) > 0)
+		fDirty = true;
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::Flush
+//---------------------------------------------------------------------
+void TFileWatchJournal::Flush (bool force)
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	if (force || time(NULL) - fLastFlushTime >= kFileWatchJournalFlushInterval)
+	{
+		try
+		{
+			if (fLoaded)
+				_Prune();
+			
+			if (fDirty)
+			{
+				_Write();
+				fDirty = false;
+			}
+		}
+		catch (TSymLibErrorObj& errObj)
+		{
+			if (!errObj.IsLogged())
+			{
+				WriteToErrorLogFile("While writing file watch journal: " + errObj.GetDescription());
+				errObj.MarkAsLogged();
+			}
+		}
+		catch (...)
+		{
+			WriteToErrorLogFile("While writing file watch journal: Unknown error");
+		}
+		
+		fLastFlushTime = time(NULL);
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::_Load (protected)
+//---------------------------------------------------------------------
+void TFileWatchJournal::_Load ()
+{
+	if (!fLoaded)
+	{
+		fLoaded = true;
+		fLoadTime = time(NULL);
+		
+		if (GetPrefsPtr()->LocalPrefsLoaded())
+		{
+			const TXMLNodeObj*	fileWatchNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefFileWatch);
+			
+			if (fileWatchNodePtr)
+				fPath = fileWatchNodePtr->AttributeValue(kTagPrefOffsetJournal);
+		}
+		if (fPath.empty() && !gEnvironObjPtr->LogDirectory().empty())
+			fPath = gEnvironObjPtr->LogDirectory() + kFileWatchJournalFileName;
+		
+		if (!fPath.empty())
+		{
+			TFileObj		journalFileObj(fPath);
+			
+			if (journalFileObj.Exists())
+			{
+				StdStringList	lineList;
+				
+				journalFileObj.ReadWholeFile(lineList);
+				
+				for (StdStringList_const_iter x = lineList.begin(); x != lineList.end(); x++)
+				{
+					StdStringList				fieldList;
+					std::string::size_type		fieldStart = 0;
+					
+					// Each entry is "<device> <inode> <offset> <head length> <head CRC> <path>";
+					// the path may contain spaces, so it's everything after the fifth space
+					while (fieldList.size() < 5 && fieldStart < x->length())
+					{
+						std::string::size_type	fieldEnd = x->find(' ',fieldStart);
+					
+						if (fieldEnd == std::string::npos)
+							break;
+						fieldList.push_back(x->substr(fieldStart,fieldEnd - fieldStart));
+						fieldStart = fieldEnd + 1;
+					}
+					
+					// Anything else is ignored
+					if (fieldList.size() == 5 && fieldStart < x->length())
+					{
+						FileIdent		ident(static_cast<dev_t>(strtoull(fieldList[0].c_str(),NULL,10)),
+											  static_cast<ino_t>(strtoull(fieldList[1].c_str(),NULL,10)));
+						JournalEntry	entry;
+						
+						entry.offset = strtoul(fieldList[2].c_str(),NULL,10);
+						entry.headLength = strtoul(fieldList[3].c_str(),NULL,10);
+						entry.headCRC = strtoul(fieldList[4].c_str(),NULL,10);
+						entry.path = x->substr(fieldStart);
+						entry.claimed = false;
+						fEntryMap[ident] = entry;
+					}
+				}
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::_Prune (protected)
+//---------------------------------------------------------------------
+void TFileWatchJournal::_Prune ()
+{
+	bool	pastGrace = (time(NULL) - fLoadTime >= kFileWatchJournalClaimGrace);
+	
+	for (EntryMap_iter x = fEntryMap.begin(); x != fEntryMap.end(); )
+	{
+		struct stat		info;
+		bool			isStale = false;
+		
+		if (!x->second.claimed && pastGrace)
+		{
+			// Nobody has watched this file since we started
+			isStale = true;
+		}
+		else if (stat(x->second.path.c_str(),&info) != 0 ||
+				 info.st_dev != x->first.first ||
+				 info.st_ino != x->first.second)
+		{
+			// The file has been removed or replaced, so no watcher will
+			// ever open it again
+			isStale = true;
+		}
+		
+		if (isStale)
+		{
+			fEntryMap.erase(x++);
+			fDirty = true;
+		}
+		else
+		{
+			++x;
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileWatchJournal::_Write (protected)
+//---------------------------------------------------------------------
+void TFileWatchJournal::_Write ()
+{
+	if (!fPath.empty())
+	{
+		std::string		tempPath(fPath + ".tmp");
+		TFileObj		tempFileObj(tempPath);
+		std::string		buffer;
+		
+		for (EntryMap_const_iter x = fEntryMap.begin(); x != fEntryMap.end(); x++)
+		{
+			buffer += NumToString(static_cast<unsigned long long>(x->first.first)) + " ";
+			buffer += NumToString(static_cast<unsigned long long>(x->first.second)) + " ";
+			buffer += NumToString(x->second.offset) + " ";
+			buffer += NumToString(x->second.headLength) + " ";
+			buffer += NumToString(x->second.headCRC) + " ";
+			buffer += x->second.path + "\n";
+		}
+		
+		// Write to a temporary file and make sure it's on disk before
+		// swapping it in, so a crash leaves either the old or new journal
+		tempFileObj.Open(O_WRONLY|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR);
+		tempFileObj.Write(buffer);
+		if (fsync(tempFileObj.FileDescriptor()) != 0)
+		{
+			std::string		errString;
+			
+			errString += "While syncing file watch journal '" + tempPath + "'";
+			throw TSymLibErrorObj(errno,errString);
+		}
+		tempFileObj.Close();
+		
+		RenameFileDurably(tempPath,fPath);
+	}
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetFileWatchJournalPtr
+//---------------------------------------------------------------------
+TFileWatchJournal* GetFileWatchJournalPtr ()
+{
+	if (!gFileWatchJournalPtr)
+	{
+		TLockedPthreadMutexObj		lock(gFileWatchJournalPtrMutex);
+		
+		if (!gFileWatchJournalPtr)
+		{
+			gFileWatchJournalPtr = new TFileWatchJournal;
+		}
+	}
+	
+	return gFileWatchJournalPtr;
+}
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -29,6 +29,7 @@
 
 #include "symlib-defs.h"
 #include "symlib-file.h"
+#include "symlib-mutex.h"
 #include "symlib-tasks.h"
 
 //---------------------------------------------------------------------
@@ -40,10 +41,17 @@ namespace symbiot {
 // Forward Class Declarations
 //---------------------------------------------------------------------
 class TTaskFileWatch;
+class TFileWatchJournal;
 
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kFileWatchDefaultReadWindow								1048576	// bytes
+#define	kFileWatchDefaultWindowsPerPass							16
+#define	kFileWatchJournalFlushInterval							5		// seconds
+#define	kFileWatchJournalFileName								"symagent_watch_offsets"
+#define	kFileWatchJournalHeadLength								256		// bytes
+#define	kFileWatchJournalClaimGrace								3600	// seconds
 
 //---------------------------------------------------------------------
 // Class TTaskFileWatch
@@ -102,8 +110,10 @@ class TTaskFileWatch : public TTaskBase
 			// destructively modifying the arguments to contain the results.
 		
 		virtual std::string ReadAddedFileData ();
-			// If the current data size is larger than the previous,
-			// this method returns the data that was added to the file.
+			// Returns data added to the file since the last read, up to
+			// the current read window size.  If more data remains unread
+			// then RunTask() will redispatch the kFileWatchChangeFlagDataSize
+			// callbacks until it has been consumed.
 		
 		//----------------------------------
 		// Accessors
@@ -117,6 +127,18 @@ class TTaskFileWatch : public TTaskBase
 		
 		inline std::string RealFilePath () const
 			{ return fFileObj.RealPath(); }
+		
+		inline unsigned long ReadPosition () const
+			{ return fReadPosition; }
+		
+		inline unsigned long ReadWindowSize () const
+			{ return fReadWindowSize; }
+		
+		inline void SetReadWindowSize (unsigned long windowSize)
+			{ fReadWindowSize = windowSize; }
+		
+		inline void SetUnclaimedByteCount (unsigned long byteCount)
+			{ fUnclaimedByteCount = byteCount; }
 	
 	protected:
 		
@@ -127,10 +149,26 @@ class TTaskFileWatch : public TTaskBase
 		virtual void _DispatchCallbacks (FileWatchChangeFlag flag);
 			// Dispatches to callbacks that trigger for the given flag.
 		
+		virtual bool _HasUnreadData () const;
+			// Returns true if the tracked file contains data beyond our
+			// current read position.
+		
+		virtual void _ResumeFromJournal ();
+			// Moves our read position back to the offset recorded in the
+			// journal for the currently-open file, if there is one.
+		
+		virtual void _CommitToJournal ();
+			// Records our read position, less any unclaimed bytes, in the
+			// journal for the currently-open file.
+		
 		virtual std::string _ComputeFileSignature ();
 			// Computes the signature of the contents of the current file and
 			// returns it.  The return value will be empty if the file doesn't exist.
 	
+		virtual unsigned long _ComputeHeadCRC (unsigned long length);
+			// Returns the CRC32 of the first length bytes of the current file,
+			// which identifies the file's contents in the journal.
+	
 	protected:
 		
 		TFileObj								fFileObj;
@@ -140,9 +178,112 @@ class TTaskFileWatch : public TTaskBase
 		CallbackList							fCallbackList;
 		FileWatchStyle							fWatchStyle;
 		std::string								fContentSig;
+		unsigned long							fReadPosition;
+		unsigned long							fReadWindowSize;
+		unsigned long							fWindowsPerPass;
+		unsigned long							fUnclaimedByteCount;
+		unsigned long							fHeadLength;
+		unsigned long							fHeadCRC;
+		bool									fCloseAfterDispatch;
 		bool									fInited;
 };
 
+//---------------------------------------------------------------------
+// Class TFileWatchJournal
+//
+// Persists file watcher read offsets, keyed by device and inode, so
+// that tail-style watchers can resume where they left off after the
+// agent restarts.  Each entry also records the file's path and a CRC
+// of its first bytes so that a reused inode isn't mistaken for the
+// file that was being watched.  Entries whose path no longer leads to
+// their file, and entries no watcher has claimed within
+// kFileWatchJournalClaimGrace seconds of loading, are dropped.
+// Updates are held in memory and written out at most once every
+// kFileWatchJournalFlushInterval seconds; each write replaces the
+// journal atomically via a fsync'd temporary file.
+//---------------------------------------------------------------------
+class TFileWatchJournal
+{
+	public:
+		
+		struct	JournalEntry
+			{
+				std::string						path;
+				unsigned long					offset;
+				unsigned long					headLength;		// bytes covered by headCRC
+				unsigned long					headCRC;
+				bool							claimed;		// used by a watcher since loading
+			};
+	
+	protected:
+		
+		typedef	std::pair<dev_t,ino_t>								FileIdent;
+		typedef	std::map<FileIdent,JournalEntry>					EntryMap;
+		typedef	EntryMap::iterator									EntryMap_iter;
+		typedef	EntryMap::const_iterator							EntryMap_const_iter;
+	
+	public:
+		
+		TFileWatchJournal ();
+			// Constructor
+	
+	private:
+		
+		TFileWatchJournal (const TFileWatchJournal& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		virtual ~TFileWatchJournal ();
+			// Destructor
+		
+		virtual bool GetEntry (dev_t device, ino_t inode, JournalEntry& entry);
+			// Looks up the entry recorded for the given file, destructively
+			// modifying the entry argument to contain it.  Returns false if
+			// no entry has been recorded.
+		
+		virtual void SetEntry (dev_t device, ino_t inode, const JournalEntry& entry);
+			// Records the entry for the given file.
+		
+		virtual void RemoveEntry (dev_t device, ino_t inode);
+			// Forgets any entry recorded for the given file.
+		
+		virtual void Flush (bool force = false);
+			// Drops stale entries and writes pending changes to disk if the
+			// flush interval has elapsed or force is true.  Errors are
+			// logged rather than thrown; the changes are retried on the
+			// next flush.
+	
+	protected:
+		
+		virtual void _Load ();
+			// Reads the journal from disk, if it hasn't been read already.
+		
+		virtual void _Prune ();
+			// Removes entries for files that are no longer watched.  Caller
+			// must hold fMutex.
+		
+		virtual void _Write ();
+			// Writes the journal to disk.  Caller must hold fMutex.
+	
+	protected:
+		
+		EntryMap								fEntryMap;
+		TPthreadMutexObj						fMutex;
+		std::string								fPath;
+		time_t									fLastFlushTime;
+		time_t									fLoadTime;
+		bool									fDirty;
+		bool									fLoaded;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+
+TFileWatchJournal* GetFileWatchJournalPtr ();
+	// Returns a pointer to the global file watcher offset journal.
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -27,6 +27,7 @@
 //---------------------------------------------------------------------
 #include "symlib-file.h"
 
+#include "symlib-prefs.h"
 #include "symlib-threads.h"
 #include "symlib-utils.h"
 
@@ -53,9 +54,21 @@
 #include <memory>
 #include <pwd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <signal.h>
 
+#if HAVE_SYS_POLL_H
+	#include <sys/poll.h>
+#endif
+
+#if HAVE_SPAWN_H
+	#include <spawn.h>
+#endif
+
+// Handed to launched processes as their environment
+extern char**	environ;
+
 //---------------------------------------------------------------------
 // Begin Environment
 //---------------------------------------------------------------------
@@ -69,11 +82,39 @@ const unsigned long		TFileObj::kReadWriteBlockSize = 4096;
 
 const OS_Flags			TLogFileObj::kRequiredOSFlags = (O_WRONLY | O_CREAT | O_APPEND);
 
+//---------------------------------------------------------------------
+// Module Definitions
+//---------------------------------------------------------------------
+#define		kExecReadBufferSize								4096
+#define		kExecIdleTimeout								3600		// seconds
+
 //---------------------------------------------------------------------
 // Module Global Variables
 //---------------------------------------------------------------------
 static		TPthreadMutexObj							gRealPathMutex;
 
+#if !kAtomicBuiltinsAvailable
+	static	TPthreadMutexObj							gLogQueueMutex;
+#endif
+
+//---------------------------------------------------------------------
+// _AddToLogCounter (static)
+//
+// Adds amount to the counter and returns the new value.
+//---------------------------------------------------------------------
+static long _AddToLogCounter (volatile long* counterPtr, long amount)
+{
+	#if kAtomicBuiltinsAvailable
+		return __sync_add_and_fetch(counterPtr,amount);
+	#else
+		TLockedPthreadMutexObj	lock(gLogQueueMutex);
+		
+		*counterPtr += amount;
+		
+		return *counterPtr;
+	#endif
+}
+
 //*********************************************************************
 // Module Class TKillProcess
 //*********************************************************************
@@ -94,6 +135,260 @@ class TKillProcess
 		pid_t							fPID;
 };
 
+//*********************************************************************
+// Module Class TExecSlotLimiter
+//
+// Counting semaphore that caps the number of external commands that
+// may run at once.  The cap is reread from the preferences each time
+// a slot is requested, so a change pushed from the server takes
+// effect with the next command; a cap of zero means no limit.
+//*********************************************************************
+class TExecSlotLimiter
+{
+	public:
+		
+		TExecSlotLimiter () : fRunningCount(0)
+			{
+				pthread_cond_init(&fSlotFreed,NULL);
+			}
+		
+		~TExecSlotLimiter ()
+			{
+				pthread_cond_destroy(&fSlotFreed);
+			}
+		
+		void Acquire ()
+			{
+				TLockedPthreadMutexObj		lock(fMutex);
+				unsigned long				maxProcesses = kDefaultExecMaxProcesses;
+				
+				if (GetPrefsPtr()->LocalPrefsLoaded())
+				{
+					const TXMLNodeObj*	execNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefExec);
+					
+					if (execNodePtr)
+					{
+						std::string		maxProcessesStr(GetPrefsPtr()->GetNodePtrData(execNodePtr,kTagPrefExecMaxProcesses));
+						
+						if (!maxProcessesStr.empty())
+							maxProcesses = static_cast<unsigned long>(StringToNum(maxProcessesStr));
+					}
+				}
+				
+				while (maxProcesses > 0 && fRunningCount >= maxProcesses)
+					pthread_cond_wait(&fSlotFreed,fMutex.MutexPtr());
+				
+				++fRunningCount;
+			}
+		
+		void Release ()
+			{
+				TLockedPthreadMutexObj		lock(fMutex);
+				
+				if (fRunningCount > 0)
+					--fRunningCount;
+				
+				pthread_cond_signal(&fSlotFreed);
+			}
+	
+	private:
+		
+		TPthreadMutexObj				fMutex;
+		pthread_cond_t					fSlotFreed;
+		unsigned long					fRunningCount;
+};
+
+static		TExecSlotLimiter							gExecSlotLimiter;
+
+//*********************************************************************
+// Module Class TExecSlot
+//
+// Holds an execution slot for the lifetime of the object.
+//*********************************************************************
+class TExecSlot
+{
+	public:
+		
+		TExecSlot ()
+			{
+				gExecSlotLimiter.Acquire();
+			}
+		
+		~TExecSlot ()
+			{
+				gExecSlotLimiter.Release();
+			}
+};
+
+//*********************************************************************
+// Module Class TLogWriter
+//
+// The background thread that writes queued entries for every log
+// file.  It is started in each process by the first entry that process
+// queues and sleeps whenever all of the queues are empty; a producer
+// wakes it only when it queues onto an empty list.
+//*********************************************************************
+class TLogWriter
+{
+	public:
+		
+		TLogWriter () : fIsRunning(false),fStopRequested(false),fWorkPending(false),fThreadPID(0),fExitHandlerSet(false)
+			{
+				pthread_cond_init(&fWorkAvailable,NULL);
+			}
+		
+		~TLogWriter ()
+			{
+				pthread_cond_destroy(&fWorkAvailable);
+			}
+		
+		bool Notify (TLogFileObj* logFileObjPtr)
+			{
+				// Returns false if there is no writer to hand the work to,
+				// in which case the caller must write the entries itself
+				{
+					TLockedPthreadMutexObj	lock(fListMutex);
+					
+					if (std::find(fLogFileList.begin(),fLogFileList.end(),logFileObjPtr) == fLogFileList.end())
+						fLogFileList.push_back(logFileObjPtr);
+				}
+				
+				{
+					TLockedPthreadMutexObj	lock(fMutex);
+					
+					if (fStopRequested)
+						return false;
+					
+					if (!fIsRunning || fThreadPID != getpid())
+					{
+						// Threads do not survive fork(), so a child starts its own
+						fThreadPID = getpid();
+						fIsRunning = (pthread_create(&fThread,NULL,_ThreadEntry,this) == 0);
+						if (!fIsRunning)
+							return false;
+						
+						if (!fExitHandlerSet)
+						{
+							atexit(_StopAtExit);
+							fExitHandlerSet = true;
+						}
+					}
+					
+					fWorkPending = true;
+					pthread_cond_signal(&fWorkAvailable);
+				}
+				
+				return true;
+			}
+		
+		void Unregister (TLogFileObj* logFileObjPtr)
+			{
+				{
+					TLockedPthreadMutexObj	lock(fListMutex);
+					
+					fLogFileList.erase(std::remove(fLogFileList.begin(),fLogFileList.end(),logFileObjPtr),fLogFileList.end());
+				}
+				
+				// Wait for any pass that may still be using the object
+				TLockedPthreadMutexObj	lock(fDrainMutex);
+			}
+		
+		void Stop ()
+			{
+				bool	doJoin = false;
+				
+				{
+					TLockedPthreadMutexObj	lock(fMutex);
+					
+					if (fIsRunning && fThreadPID == getpid() && !fStopRequested)
+					{
+						fStopRequested = true;
+						pthread_cond_signal(&fWorkAvailable);
+						doJoin = true;
+					}
+				}
+				
+				if (doJoin)
+				{
+					pthread_join(fThread,NULL);
+					
+					TLockedPthreadMutexObj	lock(fMutex);
+					
+					fIsRunning = false;
+					fStopRequested = false;
+				}
+				
+				// Anything queued while the thread was finishing up
+				_DrainAll();
+			}
+	
+	private:
+		
+		static void* _ThreadEntry (void* arg)
+			{
+				TLogWriter*		writerPtr = reinterpret_cast<TLogWriter*>(arg);
+				bool			isStopping = false;
+				
+				while (!isStopping)
+				{
+					{
+						TLockedPthreadMutexObj	lock(writerPtr->fMutex);
+						
+						while (!writerPtr->fWorkPending && !writerPtr->fStopRequested)
+							pthread_cond_wait(&writerPtr->fWorkAvailable,writerPtr->fMutex.MutexPtr());
+						
+						writerPtr->fWorkPending = false;
+						isStopping = writerPtr->fStopRequested;
+					}
+					
+					writerPtr->_DrainAll();
+				}
+				
+				return NULL;
+			}
+		
+		static void _StopAtExit ();
+		
+		void _DrainAll ()
+			{
+				TLockedPthreadMutexObj		drainLock(fDrainMutex);
+				std::vector<TLogFileObj*>	logFileList;
+				
+				{
+					TLockedPthreadMutexObj	lock(fListMutex);
+					
+					logFileList = fLogFileList;
+				}
+				
+				for (std::vector<TLogFileObj*>::iterator x = logFileList.begin(); x != logFileList.end(); x++)
+					(*x)->WriteQueuedEntries();
+			}
+	
+	private:
+		
+		TPthreadMutexObj				fMutex;
+		pthread_cond_t					fWorkAvailable;
+		TPthreadMutexObj				fListMutex;
+		TPthreadMutexObj				fDrainMutex;
+		std::vector<TLogFileObj*>		fLogFileList;
+		pthread_t						fThread;
+		bool							fIsRunning;
+		bool							fStopRequested;
+		bool							fWorkPending;
+		pid_t							fThreadPID;
+		bool							fExitHandlerSet;
+};
+
+static		TLogWriter									gLogWriter;
+
+//---------------------------------------------------------------------
+// TLogWriter::_StopAtExit (static private)
+//---------------------------------------------------------------------
+void TLogWriter::_StopAtExit ()
+{
+	gLogWriter.Stop();
+}
+
 //*********************************************************************
 // Class TFSObject
 //*********************************************************************
@@ -1407,7 +1702,7 @@ void TFileObj::Append (const std::string& bufferObj, OS_Mode createPerms, bool e
 //---------------------------------------------------------------------
 std::string TFileObj::Execute (const unsigned char* appData, size_t appDataLength)
 {
-	#if HAVE_WORKING_FORK
+	#if HAVE_POSIX_SPAWN || HAVE_WORKING_FORK
 		StdStringList		emptyArgList;
 		
 		return Execute(emptyArgList,appData,appDataLength);
@@ -1421,9 +1716,7 @@ std::string TFileObj::Execute (const unsigned char* appData, size_t appDataLengt
 //---------------------------------------------------------------------
 std::string TFileObj::Execute (const StdStringList& args, const unsigned char* appData, size_t appDataLength)
 {
-	#if HAVE_WORKING_FORK
-		std::string		command;
-		
+	#if HAVE_POSIX_SPAWN || HAVE_WORKING_FORK
 		if (Path().empty())
 			throw TSymLibErrorObj(EFAULT,"No pathname is specified while attempting to execute a file");
 		
@@ -1435,20 +1728,9 @@ std::string TFileObj::Execute (const StdStringList& args, const unsigned char* a
 			throw TSymLibErrorObj(ENOENT,errString);
 		}
 		
-		// Build the command to execute
-		command += Path();
-		for (StdStringList_const_iter x = args.begin(); x != args.end(); x++)
-		{
-			command += " ";
-			
-			// Wrap the argument in quotes if it contains a space
-			if (x->find(' ') >= 0)
-				command += "\"" + *x + "\"";
-			else
-				command += *x;
-		}
-		
-		return ExecWithIO(command,appData,appDataLength);
+		// The arguments are passed as-is, without a shell, so they
+		// need no quoting
+		return ExecWithIO(Path(),args,appData,appDataLength);
 	#else
 		return std::string();
 	#endif
@@ -1520,7 +1802,13 @@ void TFileObj::Rotate (unsigned int maxVersionNum)
 // Constructor
 //---------------------------------------------------------------------
 TLogFileObj::TLogFileObj ()
-	:	fMaxFileSize(0)
+	:	fMaxFileSize(0),
+		fQueuedCount(0),
+		fDroppedCount(0),
+		fTrackedSize(0),
+		fStampTime(0),
+		fNewFileUserID(0),
+		fNewFileGroupID(0)
 {
 }
 
@@ -1529,7 +1817,13 @@ TLogFileObj::TLogFileObj ()
 //---------------------------------------------------------------------
 TLogFileObj::TLogFileObj (const std::string& path)
 	:	Inherited(path),
-		fMaxFileSize(0)
+		fMaxFileSize(0),
+		fQueuedCount(0),
+		fDroppedCount(0),
+		fTrackedSize(0),
+		fStampTime(0),
+		fNewFileUserID(0),
+		fNewFileGroupID(0)
 {
 }
 
@@ -1538,7 +1832,13 @@ TLogFileObj::TLogFileObj (const std::string& path)
 //---------------------------------------------------------------------
 TLogFileObj::TLogFileObj (const TLogFileObj& obj)
 	:	Inherited(obj),
-		fMaxFileSize(0)
+		fMaxFileSize(0),
+		fQueuedCount(0),
+		fDroppedCount(0),
+		fTrackedSize(0),
+		fStampTime(0),
+		fNewFileUserID(0),
+		fNewFileGroupID(0)
 {
 }
 
@@ -1547,6 +1847,9 @@ TLogFileObj::TLogFileObj (const TLogFileObj& obj)
 //---------------------------------------------------------------------
 TLogFileObj::~TLogFileObj ()
 {
+	// Make sure the writer is done with us, then write what's left
+	gLogWriter.Unregister(this);
+	WriteQueuedEntries();
 }
 
 //---------------------------------------------------------------------
@@ -1624,31 +1927,7 @@ void TLogFileObj::WriteEntry (const std::string& logEntry, bool throwOnError, bo
 		entry += kDelim;
 		entry += timeObj.GetFormattedDateTime("%H:%M:%S");		// Current time
 		entry += kDelim;
-		entry += "[";
-		entry += NumToString(getpid());
-		
-		// Insert thread-aware information if we have it
-		if (gEnvironObjPtr)
-		{
-			TPthreadObj*		threadObjPtr = MyThreadObjPtr();
-			
-			if (threadObjPtr && threadObjPtr->InternalID() != 0)
-			{
-				if (gEnvironObjPtr->AppPID() != getpid())
-				{
-					entry += " (" + NumToString(gEnvironObjPtr->AppPID());
-					if (threadObjPtr)
-						entry += ":" + NumToString(threadObjPtr->InternalID());
-					entry += ")";
-				}
-				else
-				{
-					entry += ":" + NumToString(threadObjPtr->InternalID());
-				}
-			}
-		}
-		
-		entry += "]";
+		entry += _ThreadTag();
 		entry += kDelim;
 		entry += logEntry;										// Given log entry
 		
@@ -1678,6 +1957,120 @@ void TLogFileObj::WriteEntry (const std::string& logEntry, bool throwOnError, bo
 	}
 }
 
+//---------------------------------------------------------------------
+// TLogFileObj::QueueEntry
+//---------------------------------------------------------------------
+void TLogFileObj::QueueEntry (const std::string& logEntry)
+{
+	try
+	{
+		if (_AddToLogCounter(&fQueuedCount,1) > kLogQueueMaxEntries)
+		{
+			// The writer has fallen behind; drop the entry rather than let
+			// the queue grow without bound
+			_AddToLogCounter(&fQueuedCount,-1);
+			_AddToLogCounter(&fDroppedCount,1);
+		}
+		else
+		{
+			LogQueueEntry*		entryPtr = new LogQueueEntry;
+			
+			entryPtr->timestamp = time(NULL);
+			entryPtr->text = _ThreadTag() + "\t" + logEntry + "\n";
+			
+			if (fQueue.Push(entryPtr))
+			{
+				// The queue was empty so the writer may be asleep; if it
+				// cannot be started then write the entry ourselves
+				if (!gLogWriter.Notify(this))
+					WriteQueuedEntries();
+			}
+		}
+	}
+	catch (...)
+	{
+		// Silently ignore all errors
+	}
+}
+
+//---------------------------------------------------------------------
+// TLogFileObj::WriteQueuedEntries
+//---------------------------------------------------------------------
+void TLogFileObj::WriteQueuedEntries ()
+{
+	TLockedPthreadMutexObj	lock(fWriteMutex);
+	LogQueueEntry*			entryListPtr = fQueue.TakeAll();
+	LogQueueEntry*			orderedListPtr = NULL;
+	long					entryCount = 0;
+	long					droppedCount = _AddToLogCounter(&fDroppedCount,0);
+	
+	// Entries were pushed onto the head of the list, so reverse it to
+	// get them back in the order they were queued
+	while (entryListPtr)
+	{
+		LogQueueEntry*	entryPtr = entryListPtr;
+		
+		entryListPtr = entryPtr->nextPtr;
+		entryPtr->nextPtr = orderedListPtr;
+		orderedListPtr = entryPtr;
+		++entryCount;
+	}
+	
+	if (entryCount > 0)
+		_AddToLogCounter(&fQueuedCount,-entryCount);
+	
+	if (droppedCount > 0)
+	{
+		// Note the loss after whatever survived it
+		LogQueueEntry*		noteEntryPtr = NULL;
+		LogQueueEntry**		tailHandle = &orderedListPtr;
+		
+		_AddToLogCounter(&fDroppedCount,-droppedCount);
+		
+		try
+		{
+			noteEntryPtr = new LogQueueEntry;
+			noteEntryPtr->nextPtr = NULL;
+			noteEntryPtr->timestamp = time(NULL);
+			noteEntryPtr->text = _ThreadTag() + "\t" + NumToString(droppedCount) + " log entries were dropped because the log queue was full\n";
+			
+			while (*tailHandle)
+				tailHandle = &((*tailHandle)->nextPtr);
+			*tailHandle = noteEntryPtr;
+		}
+		catch (...)
+		{
+			delete(noteEntryPtr);
+		}
+	}
+	
+	try
+	{
+		if (orderedListPtr && !Path().empty())
+			_WriteBatch(orderedListPtr);
+	}
+	catch (...)
+	{
+		// There is nowhere to report a failure to write the log
+	}
+	
+	while (orderedListPtr)
+	{
+		LogQueueEntry*	entryPtr = orderedListPtr;
+		
+		orderedListPtr = entryPtr->nextPtr;
+		delete(entryPtr);
+	}
+}
+
+//---------------------------------------------------------------------
+// TLogFileObj::StopLogWriter (static)
+//---------------------------------------------------------------------
+void TLogFileObj::StopLogWriter ()
+{
+	gLogWriter.Stop();
+}
+
 //---------------------------------------------------------------------
 // TLogFileObj::EnsureRestrictedFlags (protected)
 //---------------------------------------------------------------------
@@ -1694,6 +2087,161 @@ OS_Flags TLogFileObj::EnsureRestrictedFlags (OS_Flags flags)
 	return flags;
 }
 
+//---------------------------------------------------------------------
+// TLogFileObj::_ThreadTag (protected)
+//---------------------------------------------------------------------
+std::string TLogFileObj::_ThreadTag () const
+{
+	std::string		tag;
+	
+	tag += "[";
+	tag += NumToString(getpid());
+	
+	// Insert thread-aware information if we have it
+	if (gEnvironObjPtr)
+	{
+		TPthreadObj*		threadObjPtr = MyThreadObjPtr();
+		
+		if (threadObjPtr && threadObjPtr->InternalID() != 0)
+		{
+			if (gEnvironObjPtr->AppPID() != getpid())
+			{
+				tag += " (" + NumToString(gEnvironObjPtr->AppPID());
+				if (threadObjPtr)
+					tag += ":" + NumToString(threadObjPtr->InternalID());
+				tag += ")";
+			}
+			else
+			{
+				tag += ":" + NumToString(threadObjPtr->InternalID());
+			}
+		}
+	}
+	
+	tag += "]";
+	
+	return tag;
+}
+
+//---------------------------------------------------------------------
+// TLogFileObj::_TimestampPrefix (protected)
+//---------------------------------------------------------------------
+const std::string& TLogFileObj::_TimestampPrefix (time_t timestamp)
+{
+	if (fStampPrefix.empty() || timestamp != fStampTime)
+	{
+		TTimeObj	timeObj(timestamp);
+		
+		fStampPrefix = timeObj.GetFormattedDateTime("%Y-%m-%d\t%H:%M:%S\t");
+		fStampTime = timestamp;
+	}
+	
+	return fStampPrefix;
+}
+
+//---------------------------------------------------------------------
+// TLogFileObj::_OpenForQueuedEntries (protected)
+//---------------------------------------------------------------------
+void TLogFileObj::_OpenForQueuedEntries ()
+{
+	bool	isNewFile = !Exists();
+	
+	Inherited::Open(kRequiredOSFlags,(S_IRUSR | S_IWUSR));
+	
+	if (isNewFile)
+	{
+		fTrackedSize = 0;
+		
+		try
+		{
+			if (fNewFileUserID > 0)
+				SetOwner(fNewFileUserID,true);
+			if (fNewFileGroupID > 0)
+				SetGroup(fNewFileGroupID,true);
+		}
+		catch (...)
+		{
+			// Ignore all errors
+		}
+	}
+	else
+	{
+		fTrackedSize = Size();
+	}
+}
+
+//---------------------------------------------------------------------
+// TLogFileObj::_WriteBatch (protected)
+//---------------------------------------------------------------------
+void TLogFileObj::_WriteBatch (LogQueueEntry* entryListPtr)
+{
+	struct iovec		ioList[kLogWriterBatchSize];
+	
+	if (!IsOpen())
+		_OpenForQueuedEntries();
+	
+	while (entryListPtr)
+	{
+		int				ioCount = 0;
+		
+		// Size is tracked here rather than asked of the file system
+		if (fMaxFileSize > 0 && fTrackedSize >= fMaxFileSize)
+		{
+			Rotate();
+			if (!IsOpen())
+				_OpenForQueuedEntries();
+			fTrackedSize = 0;
+		}
+		
+		// Gather up to a batch of entries; the date/time prefix is only
+		// reformatted when the second changes
+		while (entryListPtr && ioCount < kLogWriterBatchSize)
+		{
+			entryListPtr->text.insert(0,_TimestampPrefix(entryListPtr->timestamp));
+			
+			ioList[ioCount].iov_base = const_cast<char*>(entryListPtr->text.data());
+			ioList[ioCount].iov_len = entryListPtr->text.length();
+			++ioCount;
+			
+			entryListPtr = entryListPtr->nextPtr;
+		}
+		
+		{
+			// One lock for the whole batch, in case another process is
+			// writing to the same log
+			TExclusiveFileLock	fileLockObj(FileDescriptor());
+			struct iovec*		ioPtr = ioList;
+			
+			while (ioCount > 0)
+			{
+				ssize_t		bytesWritten = writev(FileDescriptor(),ioPtr,ioCount);
+				
+				if (bytesWritten < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					throw TSymLibErrorObj(errno,"While writing to a log file");
+				}
+				
+				fTrackedSize += bytesWritten;
+				
+				// Skip past whatever was written, in case it was only part
+				while (ioCount > 0 && static_cast<size_t>(bytesWritten) >= ioPtr->iov_len)
+				{
+					bytesWritten -= ioPtr->iov_len;
+					++ioPtr;
+					--ioCount;
+				}
+				if (ioCount > 0)
+				{
+					ioPtr->iov_base = static_cast<char*>(ioPtr->iov_base) + bytesWritten;
+					ioPtr->iov_len -= bytesWritten;
+				}
+			}
+		}
+	}
+}
+
 //*********************************************************************
 // Class TDirObj
 //*********************************************************************
@@ -1981,6 +2529,223 @@ std::string MakeLogPath (const std::string& pathPrefix)
 	return fullPath;
 }
 
+//---------------------------------------------------------------------
+// _AppendExecOutput (static)
+//---------------------------------------------------------------------
+static void _AppendExecOutput (const char* data, size_t dataLength, void* handlerData)
+{
+	reinterpret_cast<std::string*>(handlerData)->append(data,dataLength);
+}
+
+//---------------------------------------------------------------------
+// _CreateExecPipe (static)
+//---------------------------------------------------------------------
+static bool _CreateExecPipe (int pipeFDs[2])
+{
+	// Both ends are created close-on-exec so that no other process
+	// launched concurrently by another thread inherits them; the child
+	// receives its ends through dup2(), which clears the flag on the copy
+	#if HAVE_PIPE2 && defined(O_CLOEXEC)
+		return (pipe2(pipeFDs,O_CLOEXEC) == 0);
+	#else
+		// Not atomic, but narrows the window as far as plain pipe() allows
+		if (pipe(pipeFDs) != 0)
+			return false;
+		
+		fcntl(pipeFDs[0],F_SETFD,FD_CLOEXEC);
+		fcntl(pipeFDs[1],F_SETFD,FD_CLOEXEC);
+		
+		return true;
+	#endif
+}
+
+//---------------------------------------------------------------------
+// _SpawnProcess (static)
+//---------------------------------------------------------------------
+static pid_t _SpawnProcess (const std::string& appPath, const StdStringList& argList, int inputFD, int outputFD)
+{
+	pid_t					childPID = -1;
+	std::vector<char*>		argv;
+	
+	// Build the argument vector before launching, since nothing
+	// should be allocated in a vfork'd child
+	argv.push_back(const_cast<char*>(appPath.c_str()));
+	for (StdStringList_const_iter x = argList.begin(); x != argList.end(); x++)
+		argv.push_back(const_cast<char*>(x->c_str()));
+	argv.push_back(NULL);
+	
+	#if HAVE_POSIX_SPAWN
+		posix_spawn_file_actions_t	fileActions;
+		posix_spawnattr_t			spawnAttr;
+		sigset_t					signalSet;
+		short						spawnFlags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+		int							spawnResult = 0;
+		
+		#if defined(POSIX_SPAWN_USEVFORK)
+			spawnFlags |= POSIX_SPAWN_USEVFORK;
+		#endif
+		
+		posix_spawn_file_actions_init(&fileActions);
+		posix_spawn_file_actions_adddup2(&fileActions,inputFD,STDIN_FILENO);
+		posix_spawn_file_actions_adddup2(&fileActions,outputFD,STDOUT_FILENO);
+		
+		// The child starts with no blocked signals and with SIGPIPE restored
+		// to its default action; the agent itself ignores SIGPIPE
+		posix_spawnattr_init(&spawnAttr);
+		posix_spawnattr_setflags(&spawnAttr,spawnFlags);
+		sigemptyset(&signalSet);
+		posix_spawnattr_setsigmask(&spawnAttr,&signalSet);
+		sigaddset(&signalSet,SIGPIPE);
+		posix_spawnattr_setsigdefault(&spawnAttr,&signalSet);
+		
+		spawnResult = posix_spawn(&childPID,appPath.c_str(),&fileActions,&spawnAttr,&argv[0],environ);
+		
+		posix_spawnattr_destroy(&spawnAttr);
+		posix_spawn_file_actions_destroy(&fileActions);
+		
+		if (spawnResult != 0)
+		{
+			childPID = -1;
+			errno = spawnResult;
+		}
+	#else
+		childPID = fork();
+		if (childPID == 0)
+		{
+			// Child process
+			sigset_t		signalSet;
+			
+			sigemptyset(&signalSet);
+			sigprocmask(SIG_SETMASK,&signalSet,NULL);
+			signal(SIGPIPE,SIG_DFL);
+			
+			dup2(inputFD,STDIN_FILENO);
+			dup2(outputFD,STDOUT_FILENO);
+			
+			execv(appPath.c_str(),&argv[0]);
+			
+			// Only reached if the exec failed; _exit() skips the parent's
+			// static destructors and stdio buffers
+			_exit(127);
+		}
+	#endif
+	
+	return childPID;
+}
+
+//---------------------------------------------------------------------
+// _PumpExecIO (static)
+//---------------------------------------------------------------------
+static void _PumpExecIO (int inputFD,
+						 int outputFD,
+						 const unsigned char* appData,
+						 size_t appDataLength,
+						 ExecOutputHandler outputHandler,
+						 void* handlerData)
+{
+	char			readBuffer[kExecReadBufferSize];
+	size_t			bytesWritten = 0;
+	
+	fcntl(outputFD,F_SETFL,fcntl(outputFD,F_GETFL)|O_NONBLOCK);
+	fcntl(inputFD,F_SETFL,fcntl(inputFD,F_GETFL)|O_NONBLOCK);
+	
+	if (!appData || appDataLength == 0)
+	{
+		// Nothing to send, so the child sees end-of-file right away
+		close(inputFD);
+		inputFD = -1;
+	}
+	
+	try
+	{
+		// Bump the timeout up --ME
+		time_t	expireTime = time(NULL) + kExecIdleTimeout;
+		
+		while (time(NULL) <= expireTime)
+		{
+			int		bytesRead = 0;
+			
+			#if HAVE_POLL
+				struct pollfd	pollInfo[2];
+				nfds_t			pollCount = 1;
+				
+				// Wait for output, or for room to write the child's input, waking
+				// up once a second to check the timeout
+				pollInfo[0].fd = outputFD;
+				pollInfo[0].events = POLLIN;
+				pollInfo[0].revents = 0;
+				
+				if (inputFD >= 0)
+				{
+					pollInfo[1].fd = inputFD;
+					pollInfo[1].events = POLLOUT;
+					pollInfo[1].revents = 0;
+					++pollCount;
+				}
+				
+				if (poll(pollInfo,pollCount,1000) == 0)
+					continue;
+			#endif
+			
+			if (inputFD >= 0)
+			{
+				ssize_t		writeResult = write(inputFD,appData + bytesWritten,appDataLength - bytesWritten);
+				
+				if (writeResult > 0)
+					bytesWritten += writeResult;
+				
+				if (bytesWritten >= appDataLength || (writeResult < 0 && errno != EAGAIN && errno != EINTR))
+				{
+					// Either all data has been sent or the child stopped reading
+					close(inputFD);
+					inputFD = -1;
+				}
+			}
+			
+			bytesRead = read(outputFD,readBuffer,sizeof(readBuffer));
+			
+			if (bytesRead == 0)
+			{
+				// We're done
+				break;
+			}
+			else if (bytesRead > 0)
+			{
+				(*outputHandler)(readBuffer,bytesRead,handlerData);
+				expireTime = time(NULL) + kExecIdleTimeout;
+				// Bump the timeout up --ME
+			}
+			else
+			{
+				if (errno == EAGAIN || errno == EINTR)
+				{
+					// No data cause we're non-blocking
+					#if !HAVE_POLL
+						Pause(.5);
+					#endif
+				}
+				else
+				{
+					// Error condition
+					std::string		logString;
+					
+					logString = "OS error while reading data from external app: " + NumToString(errno);
+					WriteToErrorLogFile(logString);
+					WriteToMessagesLogFile(logString);
+					break;
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		// Do nothing here
+	}
+	
+	if (inputFD >= 0)
+		close(inputFD);
+}
+
 //---------------------------------------------------------------------
 // ExecWithIO
 //---------------------------------------------------------------------
@@ -1988,13 +2753,66 @@ std::string ExecWithIO (const std::string& appCommand, const unsigned char* appD
 {
 	std::string		output;
 	
-	#if HAVE_WORKING_FORK
-		int					ioPipe[2];
-		int					forkResult;
-		const int			kInput = 0;
-		const int			kOutput = 1;
+	ExecWithIO(appCommand,_AppendExecOutput,&output,appData,appDataLength);
+	
+	return output;
+}
+
+//---------------------------------------------------------------------
+// ExecWithIO
+//---------------------------------------------------------------------
+void ExecWithIO (const std::string& appCommand,
+				 ExecOutputHandler outputHandler,
+				 void* handlerData,
+				 const unsigned char* appData,
+				 size_t appDataLength)
+{
+	StdStringList		shellArgList;
+	
+	shellArgList.push_back("-c");
+	shellArgList.push_back(appCommand);
+	
+	ExecWithIO(kExecShellPath,shellArgList,outputHandler,handlerData,appData,appDataLength);
+}
+
+//---------------------------------------------------------------------
+// ExecWithIO
+//---------------------------------------------------------------------
+std::string ExecWithIO (const std::string& appPath,
+						const StdStringList& argList,
+						const unsigned char* appData,
+						size_t appDataLength)
+{
+	std::string		output;
+	
+	ExecWithIO(appPath,argList,_AppendExecOutput,&output,appData,appDataLength);
+	
+	return output;
+}
+
+//---------------------------------------------------------------------
+// ExecWithIO
+//---------------------------------------------------------------------
+void ExecWithIO (const std::string& appPath,
+				 const StdStringList& argList,
+				 ExecOutputHandler outputHandler,
+				 void* handlerData,
+				 const unsigned char* appData,
+				 size_t appDataLength)
+{
+	#if HAVE_POSIX_SPAWN || HAVE_WORKING_FORK
+		TExecSlot			execSlot;
+		int					inputPipe[2];
+		int					outputPipe[2];
+		pid_t				childPID = -1;
+		const int			kReadEnd = 0;
+		const int			kWriteEnd = 1;
 		struct sigaction	mySigAction;
 		struct sigaction	oldSigAction;
+		std::string			appCommand(appPath);
+		
+		for (StdStringList_const_iter x = argList.begin(); x != argList.end(); x++)
+			appCommand += " " + *x;
 		
 		if (BitTest(gEnvironObjPtr->DynamicDebugFlags(),kDynDebugLogServerCommunication))
 		{
@@ -2011,136 +2829,62 @@ std::string ExecWithIO (const std::string& appCommand, const unsigned char* appD
 		sigaction(SIGCHLD,&mySigAction,&oldSigAction);
 		
 		// Create pipes to use for communication
-		if (pipe(ioPipe) == 0)
+		if (_CreateExecPipe(inputPipe))
 		{
-			// Fork
-			forkResult = fork();
-			if (forkResult == 0)
+			if (_CreateExecPipe(outputPipe))
 			{
-				// Child process
-				FILE*			appPipe = NULL;
-				sigset_t		signalSet;
-				
-				sigprocmask(SIG_SETMASK,NULL,&signalSet);
-				sigaddset(&signalSet,SIGPIPE);
-				sigprocmask(SIG_SETMASK,&signalSet,NULL);
-				
-				pthread_sigmask(SIG_SETMASK,NULL,&signalSet);
-				sigaddset(&signalSet,SIGPIPE);
-				pthread_sigmask(SIG_SETMASK,&signalSet,NULL);
+				childPID = _SpawnProcess(appPath,argList,inputPipe[kReadEnd],outputPipe[kWriteEnd]);
 				
-				errno = 0;
-				dup2(ioPipe[kOutput],fileno(stdout));
-				// setvbuf(stdout,NULL,_IONBF,BUFSIZ);
-				close(ioPipe[kInput]);
+				// The child has its own copies of these now
+				close(inputPipe[kReadEnd]);
+				close(outputPipe[kWriteEnd]);
 				
-				try
+				if (childPID > 0)
 				{
-					fflush(NULL);
-					appPipe = popen(appCommand.c_str(),"w");
-					if (appPipe)
 					{
-						if (appData && appDataLength > 0)
+						TKillProcess	killProc(childPID);
+				
+						if (BitTest(gEnvironObjPtr->DynamicDebugFlags(),kDynDebugLogServerCommunication))
 						{
-							for (size_t x = 0; x < appDataLength; x++)
-								fprintf(appPipe,"%c",appData[x]);
+							std::string		logString;
+							
+							logString = "Executing system command: '" + appCommand + "' as pid " + NumToString(childPID);
+							WriteToMessagesLogFile(logString);
 						}
-						pclose(appPipe);
+						
+						_PumpExecIO(inputPipe[kWriteEnd],outputPipe[kReadEnd],appData,appDataLength,outputHandler,handlerData);
+						
+						close(outputPipe[kReadEnd]);
 					}
-				}
-				catch (...)
-				{
-					// Do nothing here, since we're just about to exit anyway
-				}
-				
-				// Stop the child process
-				exit(0);
-			}
-			else if (forkResult > 0)
-			{
-				// Parent process
-				char			oneChar;
-				int				oldFlags = fcntl(ioPipe[kInput],F_GETFL);
-				
-				{
-					TKillProcess	killProc(forkResult);
-					
-					fcntl(ioPipe[kInput],F_SETFL,oldFlags|O_NONBLOCK);
 					
 					if (BitTest(gEnvironObjPtr->DynamicDebugFlags(),kDynDebugLogServerCommunication))
 					{
 						std::string		logString;
 						
-						logString = "Executing system command: '" + appCommand + "' from parent ppid " + NumToString(forkResult);
+						logString = "Ending execution of system command: " + appCommand + "; waiting for pid to terminate";
 						WriteToMessagesLogFile(logString);
 					}
 					
-					close(ioPipe[kOutput]);
-					
-					try
-					{
-						// Bump the timeout up --ME
-						int		expireTime = time(NULL) + 3600;
-						
-						while (time(NULL) <= expireTime)
-						{
-							int		bytesRead = read(ioPipe[kInput],&oneChar,sizeof(oneChar));
-							
-							if (bytesRead == 0)
-							{
-								// We're done
-								break;
-							}
-							else if (bytesRead > 0)
-							{
-								output += oneChar;
-								expireTime = time(NULL) + 3600;
-								// Bump the timeout up --ME
-							}
-							else
-							{
-								if (errno == EAGAIN)
-								{
-									// No data cause we're non-blocking
-									Pause(.5);
-								}
-								else
-								{
-									// Error condition
-									std::string		logString;
-									
-									logString = "OS error while reading data from external app: " + NumToString(errno);
-									WriteToErrorLogFile(logString);
-									WriteToMessagesLogFile(logString);
-									break;
-								}
-							}
-						}
-					}
-					catch (...)
-					{
-						// Do nothing here
-					}
-					
-					close(ioPipe[kInput]);
+					// Make sure the process terminates
+					waitpid(childPID,NULL,0);
 				}
-				
-				if (BitTest(gEnvironObjPtr->DynamicDebugFlags(),kDynDebugLogServerCommunication))
+				else
 				{
 					std::string		logString;
 					
-					logString = "Ending execution of system command: " + appCommand + "; waiting for pid to terminate";
-					WriteToMessagesLogFile(logString);
+					logString = "Unable to launch external app '" + appPath + "': OS error " + NumToString(errno);
+					WriteToErrorLogFile(logString);
+					
+					// Cleanup pipes
+					close(inputPipe[kWriteEnd]);
+					close(outputPipe[kReadEnd]);
 				}
-				
-				// Make sure the process terminates
-				waitpid(forkResult,NULL,0);
 			}
 			else
 			{
 				// Cleanup pipes
-				close(ioPipe[kInput]);
-				close(ioPipe[kOutput]);
+				close(inputPipe[kReadEnd]);
+				close(inputPipe[kWriteEnd]);
 			}
 		}
 		
@@ -2155,8 +2899,42 @@ std::string ExecWithIO (const std::string& appCommand, const unsigned char* appD
 		sigaction(SIGCHLD,&oldSigAction,NULL);
 		
 	#endif
+}
+
+//---------------------------------------------------------------------
+// RenameFileDurably
+//---------------------------------------------------------------------
+void RenameFileDurably (const std::string& fromPath, const std::string& toPath)
+{
+	std::string				dirPath(".");
+	std::string::size_type	delimPos = toPath.rfind(kPathDelimiterAsChar);
+	int						dirFD = -1;
 	
-	return output;
+	if (rename(fromPath.c_str(),toPath.c_str()) != 0)
+	{
+		std::string		errString;
+		
+		errString += "While renaming '" + fromPath + "' to '" + toPath + "'";
+		throw TSymLibErrorObj(errno,errString);
+	}
+	
+	if (delimPos != std::string::npos)
+		dirPath = (delimPos == 0 ? kPathDelimiterAsString : toPath.substr(0,delimPos));
+	
+	// The rename is only durable once the directory entry is on disk
+	dirFD = OpenWithoutInterrupts(dirPath.c_str(),O_RDONLY);
+	if (dirFD < 0 || fsync(dirFD) != 0)
+	{
+		int				errNum = errno;
+		std::string		errString;
+		
+		if (dirFD >= 0)
+			CloseWithoutInterrupts(dirFD,false);
+		
+		errString += "While syncing directory '" + dirPath + "'";
+		throw TSymLibErrorObj(errNum,errString);
+	}
+	CloseWithoutInterrupts(dirFD,false);
 }
 
 //---------------------------------------------------------------------
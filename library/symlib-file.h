@@ -32,6 +32,7 @@
 
 #include "symlib-defs.h"
 #include "symlib-exception.h"
+#include "symlib-mutex.h"
 #include "symlib-time.h"
 
 #include <algorithm>
@@ -71,6 +72,21 @@ typedef		std::vector<TFSObject*>							TFSObjectPtrList;
 typedef		TFSObjectPtrList::iterator						TFSObjectPtrList_iter;
 typedef		TFSObjectPtrList::const_iterator				TFSObjectPtrList_const_iter;
 
+#define		kDefaultExecMaxProcesses						4
+#define		kExecShellPath									"/bin/sh"
+
+typedef		void (*ExecOutputHandler) (const char* data, size_t dataLength, void* handlerData);
+
+#define		kLogQueueMaxEntries								10000
+#define		kLogWriterBatchSize								64
+
+struct		LogQueueEntry
+	{
+		LogQueueEntry*					nextPtr;
+		time_t							timestamp;
+		std::string						text;
+	};
+
 //---------------------------------------------------------------------
 // Class TFSObject
 //---------------------------------------------------------------------
@@ -485,18 +501,54 @@ class TLogFileObj : public TFileObj
 			// date, time and process ID number.  If throwOnError is false then
 			// all exceptions will be silently caught by this method.
 		
+		virtual void QueueEntry (const std::string& logEntry);
+			// Like WriteEntry() but does not wait for the disk.  The entry is
+			// stamped and queued without taking a lock; a single background
+			// thread shared by all log files writes the queued entries in
+			// batches.  If kLogQueueMaxEntries entries are already waiting the
+			// new one is dropped and the number dropped is logged once the
+			// backlog has been written.  Never throws.
+		
+		virtual void WriteQueuedEntries ();
+			// Writes every entry queued so far.  Normally called only by the
+			// background thread.
+		
+		static void StopLogWriter ();
+			// Writes the entries queued for every log file and stops the
+			// background thread; the next QueueEntry() starts it again.
+			// Call before forking or exiting so that nothing is lost.
+		
 		inline unsigned long MaxFileSize () const
 			{ return fMaxFileSize; }
 		
 		inline void SetMaxFileSize (unsigned long maxFileSize)
 			{ fMaxFileSize = maxFileSize; }
 			
+		inline void SetNewFileOwner (uid_t userID, gid_t groupID)
+			{ fNewFileUserID = userID; fNewFileGroupID = groupID; }
+			// Sets the owner and group given to the file when QueueEntry()
+			// creates it.  Zero leaves that part of the ownership alone.
 	
 	protected:
 		
 		virtual OS_Flags EnsureRestrictedFlags (OS_Flags flags);
 			// Returns an adjusted version of the argument, guaranteeing that
 			// certain flags are set correctly for log file access.
+		
+		virtual std::string _ThreadTag () const;
+			// Returns the bracketed process and thread ID field of an entry.
+		
+		virtual const std::string& _TimestampPrefix (time_t timestamp);
+			// Returns the date and time fields of an entry, formatting them
+			// again only when the second changes.
+		
+		virtual void _OpenForQueuedEntries ();
+			// Opens the file for the background writer, learning its size
+			// and setting the ownership of a newly-created file.
+		
+		virtual void _WriteBatch (LogQueueEntry* entryListPtr);
+			// Writes the given list of entries, in order, rotating the file
+			// as its size passes the maximum.
 	
 	// Certain inherited methods in our parent should be illegal for this object
 	private:
@@ -524,6 +576,15 @@ class TLogFileObj : public TFileObj
 	protected:
 		
 		unsigned long									fMaxFileSize;
+		TAtomicStackObj<LogQueueEntry>					fQueue;
+		volatile long									fQueuedCount;
+		volatile long									fDroppedCount;
+		TPthreadMutexObj								fWriteMutex;
+		unsigned long									fTrackedSize;
+		time_t											fStampTime;
+		std::string										fStampPrefix;
+		uid_t											fNewFileUserID;
+		gid_t											fNewFileGroupID;
 };
 
 //---------------------------------------------------------------------
@@ -688,10 +749,50 @@ std::string MakeLogPath (const std::string& pathPrefix);
 
 std::string ExecWithIO (const std::string& appCommand, const unsigned char* appData = NULL, size_t appDataLength = 0);
 	// Function executes a command designated by the appCommand argument
-	// in a forked process and collects the command's output into the
-	// returned temporary string.  If appData is present, that data
+	// through the shell (kExecShellPath) and collects the command's output
+	// into the returned temporary string.  If appData is present, that data
 	// is piped to the command after launch.
 
+void ExecWithIO (const std::string& appCommand,
+				 ExecOutputHandler outputHandler,
+				 void* handlerData,
+				 const unsigned char* appData = NULL,
+				 size_t appDataLength = 0);
+	// Same as above, except that the command's output is not collected.
+	// Instead, outputHandler is called with each block of output as soon
+	// as it is read from the command.  Blocks are not aligned to lines or
+	// any other boundary.  The handlerData argument is passed unchanged
+	// to the handler.  Both versions wait for an execution slot first,
+	// so that no more than the <exec><max_processes> preference's number
+	// of commands (default kDefaultExecMaxProcesses) run at once across
+	// the entire process.
+
+std::string ExecWithIO (const std::string& appPath,
+						const StdStringList& argList,
+						const unsigned char* appData = NULL,
+						size_t appDataLength = 0);
+	// Same as the first version of ExecWithIO(), except that the application
+	// at appPath is launched directly with the arguments in argList.  No
+	// shell is involved, so the arguments are neither split nor expanded
+	// and need no quoting.  appPath is not searched for in $PATH.  The
+	// application is started with posix_spawn() where available, so the
+	// agent's memory is never copied.
+
+void ExecWithIO (const std::string& appPath,
+				 const StdStringList& argList,
+				 ExecOutputHandler outputHandler,
+				 void* handlerData,
+				 const unsigned char* appData = NULL,
+				 size_t appDataLength = 0);
+	// Streaming version of the above; see the second version of
+	// ExecWithIO() for a description of outputHandler and handlerData.
+
+void RenameFileDurably (const std::string& fromPath, const std::string& toPath);
+	// Renames fromPath to toPath, replacing any existing toPath, then fsyncs
+	// the directory containing toPath so that the rename itself survives a
+	// crash.  fromPath should already have been fsync'd.  Throws an
+	// exception on error.
+
 std::string GetCurrentDirectory ();
 	// Returns the current working directory as a temporary string.
 
@@ -24,9 +24,12 @@
 //---------------------------------------------------------------------
 #include "symlib-message.h"
 
+#include "symlib-prefs.h"
 #include "symlib-utils.h"
 #include "symlib-xml.h"
 
+#include <algorithm>
+
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
@@ -715,6 +718,14 @@ void TMessage::Reset ()
 	}
 }
 
+//---------------------------------------------------------------------
+// TMessage::Swap
+//---------------------------------------------------------------------
+void TMessage::Swap (TMessage& obj)
+{
+	std::swap(fMessageObjPtr,obj.fMessageObjPtr);
+}
+
 //---------------------------------------------------------------------
 // TMessage::Parse
 //---------------------------------------------------------------------
@@ -1128,7 +1139,62 @@ TPreferenceNode TPreferenceNode::FindNode (const std::string& tag,
 		
 		if (thisNodePtr)
 		{
-			TXMLNodeObj*	tempNodePtr = const_cast<TXMLNodeObj*>(thisNodePtr->FindNode(tag,attribute,attributeValue));
+			// Our preferences keep an index, so this is cheap even when
+			// called for every entry in a large configuration
+			TXMLNodeObj*	tempNodePtr = const_cast<TXMLNodeObj*>(GetPrefsPtr()->GetNodePtr(thisNodePtr,tag,attribute,attributeValue));
+			
+			if (tempNodePtr)
+				nodeRef.SetPtr(tempNodePtr);
+		}
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			WriteToErrorLogFile(errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+		throw;
+	}
+	catch (int errNum)
+	{
+		std::string			errString;
+		TSymLibErrorObj		newErrObj(errNum);
+		
+		errString = "Generic Error: ";
+		errString += NumToString(errNum);
+		WriteToErrorLogFile(errString);
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	catch (...)
+	{
+		TSymLibErrorObj	newErrObj(-1,"Unknown error");
+		
+		WriteToErrorLogFile("Unknown Error...");
+		
+		newErrObj.MarkAsLogged();
+		throw newErrObj;
+	}
+	
+	return nodeRef;
+}
+
+//---------------------------------------------------------------------
+// TPreferenceNode::FindNodeAtPath
+//---------------------------------------------------------------------
+TPreferenceNode TPreferenceNode::FindNodeAtPath (const std::string& path) const
+{
+	TMessageNode		nodeRef;
+	
+	try
+	{
+		TXMLNodeObj*	thisNodePtr = _ConvertMessageNodeObj(this);
+		
+		if (thisNodePtr)
+		{
+			TXMLNodeObj*	tempNodePtr = const_cast<TXMLNodeObj*>(GetPrefsPtr()->GetNodePtrAtPath(thisNodePtr,path));
 			
 			if (tempNodePtr)
 				nodeRef.SetPtr(tempNodePtr);
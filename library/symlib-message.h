@@ -56,6 +56,7 @@ class TLoginDataNode;
 #define	kMessageTagMACAddress							"mac_id"
 #define	kMessageTagIPAddress							"ip"
 #define	kMessageTagNonce								"nonce"
+#define	kMessageTagReloginToken							"relogin_token"
 #define	kMessageTagLoad									"load"
 #define	kMessageTagValue								"value"
 
@@ -160,6 +161,10 @@ class TMessage
 		virtual void Reset ();
 			// Resets the object to empty values.
 		
+		virtual void Swap (TMessage& obj);
+			// Exchanges the contents of this message with those of the
+			// argument without copying either one.
+		
 		virtual void Parse (const std::string& data);
 			// Parses the argument's contents, replacing any data we're
 			// currently holding with the results.
@@ -278,6 +283,10 @@ class TPreferenceNode : public TMessageNode
 										  const std::string& attributeValue = "") const;
 			// Returns a reference to a node matching the given criteria.
 		
+		virtual TPreferenceNode FindNodeAtPath (const std::string& path) const;
+			// Returns a reference to the node reached through the slash-delimited
+			// list of tags in the argument, e.g. "WATCH_FILE/PATTERN_LIST".
+		
 		virtual std::string AsString (const std::string& indent = "\t",
 									  const std::string& lineDelimiter = "\n") const;
 			// Returns the current message as a human-readable string.
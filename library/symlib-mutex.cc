@@ -25,10 +25,13 @@
 //---------------------------------------------------------------------
 // Includes
 //---------------------------------------------------------------------
+#include "symlib-config.h"
+
 #include "symlib-mutex.h"
 
 #include "symlib-exception.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <signal.h>
 #include <sys/time.h>
@@ -42,6 +45,80 @@ namespace symbiot {
 //---------------------------------------------------------------------
 // Module Definitions
 //---------------------------------------------------------------------
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+	#define	kMutexClockIsMonotonic						1
+#else
+	#define	kMutexClockIsMonotonic						0
+#endif
+
+#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+	#define	kMutexStatsAreLockFree						1
+#else
+	#define	kMutexStatsAreLockFree						0
+#endif
+
+typedef		std::vector<TAdaptiveMutexObj*>				AdaptiveMutexPtrList;
+typedef		AdaptiveMutexPtrList::iterator				AdaptiveMutexPtrList_iter;
+
+//---------------------------------------------------------------------
+// Module Globals
+//
+// These are plain pthread mutexes rather than objects so they are
+// usable by other module globals during static initialization.
+//---------------------------------------------------------------------
+static		pthread_mutex_t							gAdaptiveMutexListMutex = PTHREAD_MUTEX_INITIALIZER;
+static		AdaptiveMutexPtrList*					gAdaptiveMutexListPtr = NULL;
+static		MutexContentionStats					gTimedLockStats;
+
+#if !kMutexStatsAreLockFree
+	static	pthread_mutex_t							gTimedLockStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+//---------------------------------------------------------------------
+// _CurrentMicroseconds (static)
+//
+// Returns the time in microseconds, from the monotonic clock if we
+// have one.  Only differences between two results are meaningful.
+//---------------------------------------------------------------------
+static unsigned long long _CurrentMicroseconds ()
+{
+	#if kMutexClockIsMonotonic
+		struct timespec		now;
+		
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		
+		return static_cast<unsigned long long>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+	#else
+		struct timeval		now;
+		
+		gettimeofday(&now,NULL);
+		
+		return static_cast<unsigned long long>(now.tv_sec) * 1000000 + now.tv_usec;
+	#endif
+}
+
+//---------------------------------------------------------------------
+// _MicrosecondsToTimespec (static)
+//---------------------------------------------------------------------
+static void _MicrosecondsToTimespec (unsigned long long microseconds, struct timespec& timeSpec)
+{
+	timeSpec.tv_sec = static_cast<time_t>(microseconds / 1000000);
+	timeSpec.tv_nsec = static_cast<long>(microseconds % 1000000) * 1000;
+}
+
+//---------------------------------------------------------------------
+// _AddToTimedLockStat (static)
+//---------------------------------------------------------------------
+static void _AddToTimedLockStat (unsigned long long* counterPtr, unsigned long long amount)
+{
+	#if kMutexStatsAreLockFree
+		__sync_add_and_fetch(counterPtr,amount);
+	#else
+		TLockedPthreadMutexObj	lock(gTimedLockStatsMutex);
+		
+		*counterPtr += amount;
+	#endif
+}
 
 //*********************************************************************
 // Class TPthreadMutexObj
@@ -131,11 +208,29 @@ void TPthreadMutexObj::Unlock ()
 {
 	int			result = 0;
 	
+	// Clear the flag while we still own the mutex, so that it cannot
+	// overwrite the flag set by the next thread to seize it
+	fIsLocked = false;
+	
 	result = pthread_mutex_unlock(&fMutex);
 	if (result != 0)
+	{
+		fIsLocked = true;
 		throw TSymLibErrorObj(result,"While calling pthread_mutex_unlock");
+	}
+}
 	
-	fIsLocked = false;
+//*********************************************************************
+// Class TLockedPthreadMutexObj
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TLockedPthreadMutexObj::TLockedPthreadMutexObj (TAdaptiveMutexObj& mutexObj)
+	:	fMutexPtr(mutexObj.MutexPtr())
+{
+	mutexObj.Lock();
 }
 
 //*********************************************************************
@@ -149,52 +244,292 @@ TLockedPthreadMutexTimeoutObj::TLockedPthreadMutexTimeoutObj (pthread_mutex_t& m
 	:	fMutexPtr(&mutex),
 		fIsLocked(false)
 {
-	time_t	expireTime;
+	_Seize(static_cast<unsigned long long>(std::max(seconds,static_cast<time_t>(0))) * 1000000);
+}
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TLockedPthreadMutexTimeoutObj::TLockedPthreadMutexTimeoutObj (TPthreadMutexObj& mutexObj, time_t seconds)
+	:	fMutexPtr(mutexObj.MutexPtr()),
+		fIsLocked(false)
+{
+	_Seize(static_cast<unsigned long long>(std::max(seconds,static_cast<time_t>(0))) * 1000000);
+}
 	
-	if (seconds < 0)
-		seconds = 0;
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TLockedPthreadMutexTimeoutObj::TLockedPthreadMutexTimeoutObj (pthread_mutex_t& mutex, const struct timespec& timeout)
+	:	fMutexPtr(&mutex),
+		fIsLocked(false)
+{
+	if (timeout.tv_sec < 0)
+		_Seize(0);
+	else
+		_Seize(static_cast<unsigned long long>(timeout.tv_sec) * 1000000 + std::max(timeout.tv_nsec,0L) / 1000);
+}
 	
-	expireTime = time(NULL) + seconds;
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TLockedPthreadMutexTimeoutObj::TLockedPthreadMutexTimeoutObj (TPthreadMutexObj& mutexObj, const struct timespec& timeout)
+	:	fMutexPtr(mutexObj.MutexPtr()),
+		fIsLocked(false)
+{
+	if (timeout.tv_sec < 0)
+		_Seize(0);
+	else
+		_Seize(static_cast<unsigned long long>(timeout.tv_sec) * 1000000 + std::max(timeout.tv_nsec,0L) / 1000);
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TLockedPthreadMutexTimeoutObj::~TLockedPthreadMutexTimeoutObj ()
+{
+	if (fIsLocked)
+		pthread_mutex_unlock(fMutexPtr);
+}
+
+//---------------------------------------------------------------------
+// TLockedPthreadMutexTimeoutObj::_Seize (private)
+//---------------------------------------------------------------------
+void TLockedPthreadMutexTimeoutObj::_Seize (unsigned long long timeoutMicroseconds)
+{
+	int		lockResult = pthread_mutex_trylock(fMutexPtr);
 	
-	do
+	if (lockResult == EBUSY)
 	{
-		int lockResult = pthread_mutex_trylock(fMutexPtr);
+		unsigned long long		startTime = _CurrentMicroseconds();
+		unsigned long long		deadline = startTime + (timeoutMicroseconds / 1000) * 1000;
+		unsigned long long		now = startTime;
+		
+		#if HAVE_PTHREAD_MUTEX_CLOCKLOCK && kMutexClockIsMonotonic
+			struct timespec		deadlineSpec;
+			
+			_MicrosecondsToTimespec(deadline,deadlineSpec);
+			
+			do
+			{
+				lockResult = pthread_mutex_clocklock(fMutexPtr,CLOCK_MONOTONIC,&deadlineSpec);
+			}
+			while (lockResult == EINTR);
+			
+			now = _CurrentMicroseconds();
+		#elif HAVE_PTHREAD_MUTEX_TIMEDLOCK
+			// pthread_mutex_timedlock() wants a wall clock deadline; wait
+			// in short slices so that a change to the system time cannot
+			// move our real deadline by more than one slice
+			lockResult = ETIMEDOUT;
+			while ((lockResult == ETIMEDOUT || lockResult == EINTR) && now < deadline)
+			{
+				unsigned long long	sliceLength = std::min(deadline - now,static_cast<unsigned long long>(kTimedLockMaxSliceMS) * 1000);
+				struct timeval		wallTime;
+				struct timespec		sliceEnd;
+				
+				gettimeofday(&wallTime,NULL);
+				_MicrosecondsToTimespec(static_cast<unsigned long long>(wallTime.tv_sec) * 1000000 + wallTime.tv_usec + sliceLength,sliceEnd);
+				
+				lockResult = pthread_mutex_timedlock(fMutexPtr,&sliceEnd);
+				now = _CurrentMicroseconds();
+			}
+		#else
+			// No blocking timed lock available; poll, backing off up to
+			// ten milliseconds between attempts
+			unsigned long		napLength = 50;
+			
+			while (lockResult == EBUSY && now < deadline)
+			{
+				usleep(static_cast<unsigned long>(std::min(static_cast<unsigned long long>(napLength),deadline - now)));
+				lockResult = pthread_mutex_trylock(fMutexPtr);
+				now = _CurrentMicroseconds();
+				napLength = std::min(napLength * 2,10000UL);
+			}
+		#endif
 		
-		if (lockResult == 0)
-			fIsLocked = true;
-	} while (!fIsLocked && time(NULL) < expireTime);
+		_AddToTimedLockStat(&gTimedLockStats.waits,1);
+		_AddToTimedLockStat(&gTimedLockStats.waitMicroseconds,now - startTime);
+	}
+	
+	fIsLocked = (lockResult == 0);
+	
+	if (fIsLocked)
+		_AddToTimedLockStat(&gTimedLockStats.acquisitions,1);
+	else
+		_AddToTimedLockStat(&gTimedLockStats.timeouts,1);
 }
 
+//*********************************************************************
+// Class TAdaptiveMutexObj
+//*********************************************************************
+
 //---------------------------------------------------------------------
 // Constructor
 //---------------------------------------------------------------------
-TLockedPthreadMutexTimeoutObj::TLockedPthreadMutexTimeoutObj (TPthreadMutexObj& mutexObj, time_t seconds)
-	:	fMutexPtr(mutexObj.MutexPtr()),
-		fIsLocked(false)
+TAdaptiveMutexObj::TAdaptiveMutexObj (const std::string& name)
+	:	fName(name),
+		fAcquisitionCount(0),
+		fWaitCount(0),
+		fWaitMicroseconds(0)
 {
-	time_t	expireTime;
+	pthread_mutex_t		temp = PTHREAD_MUTEX_INITIALIZER;
 	
-	if (seconds < 0)
-		seconds = 0;
+	fMutex = temp;
+	pthread_mutex_init(&fMutex,NULL);
+	
+	// Register ourselves for GetMutexContentionStats()
+	pthread_mutex_lock(&gAdaptiveMutexListMutex);
+	if (!gAdaptiveMutexListPtr)
+		gAdaptiveMutexListPtr = new AdaptiveMutexPtrList;
+	gAdaptiveMutexListPtr->push_back(this);
+	pthread_mutex_unlock(&gAdaptiveMutexListMutex);
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TAdaptiveMutexObj::~TAdaptiveMutexObj ()
+{
+	pthread_mutex_lock(&gAdaptiveMutexListMutex);
+	if (gAdaptiveMutexListPtr)
+	{
+		AdaptiveMutexPtrList_iter	foundIter = std::find(gAdaptiveMutexListPtr->begin(),gAdaptiveMutexListPtr->end(),this);
+		
+		if (foundIter != gAdaptiveMutexListPtr->end())
+			gAdaptiveMutexListPtr->erase(foundIter);
+	}
+	pthread_mutex_unlock(&gAdaptiveMutexListMutex);
 	
-	expireTime = time(NULL) + seconds;
+	pthread_mutex_destroy(&fMutex);
+}
+
+//---------------------------------------------------------------------
+// TAdaptiveMutexObj::Lock
+//---------------------------------------------------------------------
+void TAdaptiveMutexObj::Lock ()
+{
+	int			result = pthread_mutex_trylock(&fMutex);
 	
-	do
+	if (result == EBUSY)
 	{
-		int lockResult = pthread_mutex_trylock(fMutexPtr);
+		unsigned long long		startTime = _CurrentMicroseconds();
 		
-		if (lockResult == 0)
-			fIsLocked = true;
-	} while (!fIsLocked && time(NULL) < expireTime);
+		// Spin briefly, then give up and sleep until it's released
+		for (unsigned int x = 0; x < kAdaptiveMutexSpinCount && result == EBUSY; x++)
+			result = pthread_mutex_trylock(&fMutex);
+		
+		if (result == EBUSY)
+			result = pthread_mutex_lock(&fMutex);
+		
+		if (result == 0)
+		{
+			++fWaitCount;
+			fWaitMicroseconds += _CurrentMicroseconds() - startTime;
+		}
+	}
+	
+	if (result != 0)
+		throw TSymLibErrorObj(result,"While calling pthread_mutex_lock");
+	
+	++fAcquisitionCount;
 }
 
 //---------------------------------------------------------------------
-// Destructor
+// TAdaptiveMutexObj::TryLock
 //---------------------------------------------------------------------
-TLockedPthreadMutexTimeoutObj::~TLockedPthreadMutexTimeoutObj ()
+bool TAdaptiveMutexObj::TryLock ()
 {
-	if (fIsLocked)
-		pthread_mutex_unlock(fMutexPtr);
+	bool		wasSeized = false;
+	int			result = 0;
+	
+	result = pthread_mutex_trylock(&fMutex);
+	
+	if (result == 0)
+	{
+		wasSeized = true;
+		++fAcquisitionCount;
+	}
+	else if (result == EBUSY)
+		wasSeized = false;
+	else
+		throw TSymLibErrorObj(result,"While calling pthread_mutex_trylock");
+	
+	return wasSeized;
+}
+
+//---------------------------------------------------------------------
+// TAdaptiveMutexObj::Unlock
+//---------------------------------------------------------------------
+void TAdaptiveMutexObj::Unlock ()
+{
+	int			result = 0;
+	
+	result = pthread_mutex_unlock(&fMutex);
+	if (result != 0)
+		throw TSymLibErrorObj(result,"While calling pthread_mutex_unlock");
+}
+
+//---------------------------------------------------------------------
+// TAdaptiveMutexObj::GetStats
+//---------------------------------------------------------------------
+void TAdaptiveMutexObj::GetStats (MutexContentionStats& stats)
+{
+	// Read the counters under the lock but without counting ourselves
+	pthread_mutex_lock(&fMutex);
+	stats.name = fName;
+	stats.acquisitions = fAcquisitionCount;
+	stats.waits = fWaitCount;
+	stats.waitMicroseconds = fWaitMicroseconds;
+	stats.timeouts = 0;
+	pthread_mutex_unlock(&fMutex);
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetMutexContentionStats
+//---------------------------------------------------------------------
+void GetMutexContentionStats (MutexContentionStatsList& statsList)
+{
+	MutexContentionStats	timedLockStats;
+	
+	statsList.clear();
+	
+	pthread_mutex_lock(&gAdaptiveMutexListMutex);
+	if (gAdaptiveMutexListPtr)
+	{
+		for (AdaptiveMutexPtrList_iter x = gAdaptiveMutexListPtr->begin(); x != gAdaptiveMutexListPtr->end(); x++)
+		{
+			MutexContentionStats	stats;
+			
+			(*x)->GetStats(stats);
+			statsList.push_back(stats);
+		}
+	}
+	pthread_mutex_unlock(&gAdaptiveMutexListMutex);
+	
+	timedLockStats.name = "timed locks";
+	
+	#if kMutexStatsAreLockFree
+		timedLockStats.acquisitions = __sync_add_and_fetch(&gTimedLockStats.acquisitions,0);
+		timedLockStats.waits = __sync_add_and_fetch(&gTimedLockStats.waits,0);
+		timedLockStats.waitMicroseconds = __sync_add_and_fetch(&gTimedLockStats.waitMicroseconds,0);
+		timedLockStats.timeouts = __sync_add_and_fetch(&gTimedLockStats.timeouts,0);
+	#else
+		{
+			TLockedPthreadMutexObj	lock(gTimedLockStatsMutex);
+			
+			timedLockStats.acquisitions = gTimedLockStats.acquisitions;
+			timedLockStats.waits = gTimedLockStats.waits;
+			timedLockStats.waitMicroseconds = gTimedLockStats.waitMicroseconds;
+			timedLockStats.timeouts = gTimedLockStats.timeouts;
+		}
+	#endif
+	
+	statsList.push_back(timedLockStats);
 }
 
 //---------------------------------------------------------------------
@@ -29,6 +29,10 @@
 // Includes
 //---------------------------------------------------------------------
 #include <pthread.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
 
 //---------------------------------------------------------------------
 // Begin Environment
@@ -41,10 +45,33 @@ namespace symbiot {
 class TPthreadMutexObj;
 class TLockedPthreadMutexObj;
 class TLockedPthreadMutexTimeoutObj;
+class TAdaptiveMutexObj;
+template <class ENTRY_CLASS> class TAtomicStackObj;
 
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kAdaptiveMutexSpinCount							100		// lock attempts before blocking
+#define	kTimedLockMaxSliceMS							100		// see TLockedPthreadMutexTimeoutObj
+
+// GCC's atomic builtins let some shared data be updated without a lock
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+	#define	kAtomicBuiltinsAvailable					1
+#endif
+
+struct	MutexContentionStats
+	{
+		std::string					name;
+		unsigned long long			acquisitions;
+		unsigned long long			waits;				// acquisitions that found the mutex locked
+		unsigned long long			waitMicroseconds;	// total time spent in those waits
+		unsigned long long			timeouts;
+		MutexContentionStats () : acquisitions(0),waits(0),waitMicroseconds(0),timeouts(0) {}
+	};
+
+typedef	std::vector<MutexContentionStats>				MutexContentionStatsList;
+typedef	MutexContentionStatsList::iterator				MutexContentionStatsList_iter;
+typedef	MutexContentionStatsList::const_iterator		MutexContentionStatsList_const_iter;
 
 //---------------------------------------------------------------------
 // Class TPthreadMutexObj
@@ -135,6 +162,8 @@ class TLockedPthreadMutexObj
 		TLockedPthreadMutexObj (TPthreadMutexObj& mutexObj) : fMutexPtr(mutexObj.MutexPtr())
 			{ pthread_mutex_lock(fMutexPtr); }
 		
+		TLockedPthreadMutexObj (TAdaptiveMutexObj& mutexObj);
+		
 		~TLockedPthreadMutexObj ()
 			{ pthread_mutex_unlock(fMutexPtr); }
 	
@@ -149,7 +178,15 @@ class TLockedPthreadMutexObj
 // Simple class that seizes a mutex lock during construction and
 // releases it during destruction.  Will accept either pthread_mutex_t
 // mutexes or TPthreadMutexObj instances.  Second argument to
-// indicates the number of seconds to wait before giving up.
+// indicates the number of seconds to wait before giving up, or a
+// relative timeout with millisecond resolution.
+//
+// The waiting thread blocks in the kernel rather than polling.  The
+// deadline is measured against the monotonic clock where the system
+// has one, so setting the system time does not shorten or extend the
+// wait.  If only pthread_mutex_timedlock() is available the wait is
+// made in slices of at most kTimedLockMaxSliceMS milliseconds, each
+// checked against the monotonic deadline.
 //---------------------------------------------------------------------
 class TLockedPthreadMutexTimeoutObj
 {
@@ -159,17 +196,177 @@ class TLockedPthreadMutexTimeoutObj
 		
 		TLockedPthreadMutexTimeoutObj (TPthreadMutexObj& mutexObj, time_t seconds);
 		
+		TLockedPthreadMutexTimeoutObj (pthread_mutex_t& mutex, const struct timespec& timeout);
+		
+		TLockedPthreadMutexTimeoutObj (TPthreadMutexObj& mutexObj, const struct timespec& timeout);
+		
 		~TLockedPthreadMutexTimeoutObj ();
 		
 		inline bool IsLocked () const
 			{ return fIsLocked; }
 	
+	private:
+		
+		void _Seize (unsigned long long timeoutMicroseconds);
+			// Seizes the lock, waiting up to timeoutMicroseconds (rounded
+			// to whole milliseconds) before giving up.
+	
 	private:
 		
 		pthread_mutex_t*							fMutexPtr;
 		bool										fIsLocked;
 };
 
+//---------------------------------------------------------------------
+// Class TAdaptiveMutexObj
+//
+// Mutex for short critical sections.  A thread that finds it locked
+// retries up to kAdaptiveMutexSpinCount times before blocking, on
+// the assumption that the holder will release it in less time than
+// it takes to sleep and be woken.
+//
+// Each instance counts its acquisitions, how many of them had to wait
+// and for how long; the counters are updated while the lock is held so
+// they cost no extra synchronization.  GetMutexContentionStats()
+// reports the counters of every instance by name.
+//---------------------------------------------------------------------
+class TAdaptiveMutexObj
+{
+	public:
+		
+		TAdaptiveMutexObj (const std::string& name = "unnamed");
+			// Constructor; name identifies the mutex in contention reports
+	
+	private:
+		
+		TAdaptiveMutexObj (const TAdaptiveMutexObj& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		~TAdaptiveMutexObj ();
+			// Destructor
+		
+		void Lock ();
+			// Method seizes the lock on the current mutex, blocking
+			// until the lock is actually seized.
+		
+		bool TryLock ();
+			// Attempts to seize a lock like a call to Lock() but does
+			// not block if unable to actually seize the lock.  Returns
+			// a boolean indicating whether the seizure was successful.
+		
+		void Unlock ();
+			// Method unlocks the previously-sized mutex, relinquishing
+			// its hold.
+		
+		void GetStats (MutexContentionStats& stats);
+			// Destructively modifies stats to contain a copy of this
+			// mutex's counters.
+		
+		inline const std::string& Name () const
+			{ return fName; }
+		
+		inline pthread_mutex_t* MutexPtr ()
+			{ return &fMutex; }
+	
+	protected:
+		
+		pthread_mutex_t								fMutex;
+		std::string									fName;
+		unsigned long long							fAcquisitionCount;
+		unsigned long long							fWaitCount;
+		unsigned long long							fWaitMicroseconds;
+};
+
+//---------------------------------------------------------------------
+// Class TAtomicStackObj
+//
+// An intrusive list that any number of threads may push entries onto
+// while one thread periodically takes the whole list.  ENTRY_CLASS must
+// have a public ENTRY_CLASS* member named nextPtr, which the stack
+// owns while the entry is on it.  Where kAtomicBuiltinsAvailable is
+// defined neither operation locks; otherwise both use a mutex.
+//---------------------------------------------------------------------
+template <class ENTRY_CLASS>
+class TAtomicStackObj
+{
+	public:
+		
+		TAtomicStackObj ()
+			:	fHeadPtr(NULL)
+			{
+			}
+	
+	private:
+		
+		TAtomicStackObj (const TAtomicStackObj& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		bool Push (ENTRY_CLASS* entryPtr)
+			{
+				#if kAtomicBuiltinsAvailable
+					ENTRY_CLASS*		oldHeadPtr = NULL;
+					ENTRY_CLASS*		foundHeadPtr = NULL;
+					
+					// Guess that the list is empty; a failed swap tells us the real
+					// head, so the head is never read outside of an atomic operation
+					do
+					{
+						oldHeadPtr = foundHeadPtr;
+						entryPtr->nextPtr = oldHeadPtr;
+						foundHeadPtr = __sync_val_compare_and_swap(&fHeadPtr,oldHeadPtr,entryPtr);
+					}
+					while (foundHeadPtr != oldHeadPtr);
+					
+					return (oldHeadPtr == NULL);
+				#else
+					TLockedPthreadMutexObj	lock(fMutex);
+					
+					entryPtr->nextPtr = fHeadPtr;
+					fHeadPtr = entryPtr;
+					
+					return (entryPtr->nextPtr == NULL);
+				#endif
+			}
+			// Pushes entryPtr onto the head of the list; returns true if the
+			// list was empty.
+		
+		ENTRY_CLASS* TakeAll ()
+			{
+				#if kAtomicBuiltinsAvailable
+					return __sync_lock_test_and_set(&fHeadPtr,static_cast<ENTRY_CLASS*>(NULL));
+				#else
+					TLockedPthreadMutexObj	lock(fMutex);
+					ENTRY_CLASS*			entryListPtr = fHeadPtr;
+					
+					fHeadPtr = NULL;
+					
+					return entryListPtr;
+				#endif
+			}
+			// Empties the list, returning its former contents (newest first).
+	
+	protected:
+		
+		ENTRY_CLASS* volatile						fHeadPtr;
+		
+		#if !kAtomicBuiltinsAvailable
+			TPthreadMutexObj						fMutex;
+		#endif
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+
+void GetMutexContentionStats (MutexContentionStatsList& statsList);
+	// Destructively modifies statsList to contain the counters of every
+	// TAdaptiveMutexObj instance plus one entry, named "timed locks",
+	// that totals every TLockedPthreadMutexTimeoutObj acquisition.
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -68,6 +68,9 @@ TLibSymPrefs::TLibSymPrefs ()
 //---------------------------------------------------------------------
 TLibSymPrefs::~TLibSymPrefs ()
 {
+	TLockedPthreadMutexObj		lock(fIndexMutex);
+	
+	_ClearIndexes();
 }
 
 //---------------------------------------------------------------------
@@ -104,17 +107,32 @@ void TLibSymPrefs::LoadLocalConfFile ()
 		throw TSymLibErrorObj(kErrorLocalPreferencesPermissionsBad,errString);
 	}
 	
-	if (!configParser.ParseConfig(configFile,fPrefRootNode))
-		throw TSymLibErrorObj(kErrorLocalPreferenceCorrupt);
-	
-	// Validate the parsed preferences
-	_ValidateLocalConf();
-	
-	// Setup the node that will contain the server-provided preferences
-	remoteRootNodePtr = new TXMLNodeObj;
-	remoteRootNodePtr->SetTag(kTagPreferences);
-	remoteRootNodePtr->AddAttribute(kTagPrefAttribWhere,kTagPrefAttribValueRemote);
-	fPrefRemoteHomeNodePtr = const_cast<TXMLNodeObj*>(fPrefRootNode.Append(remoteRootNodePtr));
+	{
+		// Lookups must not see the tree until it and the indexes agree
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		
+		try
+		{
+			if (!configParser.ParseConfig(configFile,fPrefRootNode))
+				throw TSymLibErrorObj(kErrorLocalPreferenceCorrupt);
+			
+			// Validate the parsed preferences
+			_ValidateLocalConf();
+			
+			// Setup the node that will contain the server-provided preferences
+			remoteRootNodePtr = new TXMLNodeObj;
+			remoteRootNodePtr->SetTag(kTagPreferences);
+			remoteRootNodePtr->AddAttribute(kTagPrefAttribWhere,kTagPrefAttribValueRemote);
+			fPrefRemoteHomeNodePtr = const_cast<TXMLNodeObj*>(fPrefRootNode.Append(remoteRootNodePtr));
+		}
+		catch (...)
+		{
+			_ClearIndexes();
+			throw;
+		}
+		
+		_ClearIndexes();
+	}
 	
 	// Extract some choice preferences
 	loggingNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefLogging);
@@ -132,7 +150,13 @@ void TLibSymPrefs::ClearPrefNodePtr()
 	
   remoteRootNodePtr->SetTag(kTagPreferences);
 	remoteRootNodePtr->AddAttribute(kTagPrefAttribWhere,kTagPrefAttribValueRemote);
-	fPrefRemoteHomeNodePtr = const_cast<TXMLNodeObj*>(fPrefRootNode.Append(remoteRootNodePtr));
+	
+	{
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		
+		fPrefRemoteHomeNodePtr = const_cast<TXMLNodeObj*>(fPrefRootNode.Append(remoteRootNodePtr));
+		_ClearIndexes();
+	}
 }
 
 //---------------------------------------------------------------------
@@ -141,13 +165,22 @@ void TLibSymPrefs::ClearPrefNodePtr()
 const TXMLNodeObj* TLibSymPrefs::AppendPrefNodePtr (const std::string& tag,
 													const std::string& data)
 {
+	const TXMLNodeObj*	newNodePtr = NULL;
+	
 	if (!LocalPrefsLoaded())
 		throw TSymLibErrorObj(kErrorLocalPreferenceNotLoaded,"Within TLibSymPrefs::AppendPrefNodePtr()");
 	
 	// New nodes appended through this function will always be appended to the remote
 	// preference section
 	
-	return fPrefRemoteHomeNodePtr->Append(tag,data);
+	{
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		
+		newNodePtr = fPrefRemoteHomeNodePtr->Append(tag,data);
+		_ClearIndexes();
+	}
+	
+	return newNodePtr;
 }
 
 //---------------------------------------------------------------------
@@ -155,13 +188,22 @@ const TXMLNodeObj* TLibSymPrefs::AppendPrefNodePtr (const std::string& tag,
 //---------------------------------------------------------------------
 const TXMLNodeObj* TLibSymPrefs::AppendPrefNodePtr (const TXMLNodeObj* nodeObjPtr)
 {
+	const TXMLNodeObj*	newNodePtr = NULL;
+	
 	if (!LocalPrefsLoaded())
 		throw TSymLibErrorObj(kErrorLocalPreferenceNotLoaded,"Within TLibSymPrefs::AppendPrefNodePtr()");
 	
 	// New nodes appended through this function will always be appended to the remote
 	// preference section
 	
-	return fPrefRemoteHomeNodePtr->Append(new TXMLNodeObj(*nodeObjPtr));
+	{
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		
+		newNodePtr = fPrefRemoteHomeNodePtr->Append(new TXMLNodeObj(*nodeObjPtr));
+		_ClearIndexes();
+	}
+	
+	return newNodePtr;
 }
 
 //---------------------------------------------------------------------
@@ -176,9 +218,9 @@ const TXMLNodeObj* TLibSymPrefs::GetPrefNodePtr (const std::string& tag,
 	if (!LocalPrefsLoaded())
 		throw TSymLibErrorObj(kErrorLocalPreferenceNotLoaded,"Within TLibSymPrefs::GetPrefNodePtr()");
 	
-	foundNodePtr = fPrefLocalHomeNodePtr->FindNode(tag,attribute,attributeValue);
+	foundNodePtr = GetNodePtr(fPrefLocalHomeNodePtr,tag,attribute,attributeValue);
 	if (!foundNodePtr && fPrefRemoteHomeNodePtr)
-		foundNodePtr = fPrefRemoteHomeNodePtr->FindNode(tag,attribute,attributeValue);
+		foundNodePtr = GetNodePtr(fPrefRemoteHomeNodePtr,tag,attribute,attributeValue);
 	
 	return foundNodePtr;
 }
@@ -209,11 +251,25 @@ const TXMLNodeObj* TLibSymPrefs::GetNodePtr (const TXMLNodeObj* parentNodePtr,
 											 const std::string& attributeValue) const
 {
 	const TXMLNodeObj*	foundNodePtr = NULL;
+	bool				isIndexed = false;
 	
 	if (parentNodePtr == NULL)
 		throw TSymLibErrorObj(EINVAL);
 	
-	foundNodePtr = parentNodePtr->FindNode(tag,attribute,attributeValue);
+	{
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		const TXMLNodeIndexObj*		indexPtr = _GetIndexPtr(parentNodePtr);
+		
+		if (indexPtr)
+		{
+			foundNodePtr = indexPtr->FindNode(tag,attribute,attributeValue);
+			isIndexed = true;
+		}
+	}
+	
+	// Nodes outside our preferences are searched without holding the lock
+	if (!isIndexed)
+		foundNodePtr = parentNodePtr->FindNode(tag,attribute,attributeValue);
 	
 	return foundNodePtr;
 }
@@ -229,16 +285,60 @@ std::string TLibSymPrefs::GetNodePtrData (const TXMLNodeObj* parentNodePtr,
 	std::string			data;
 	const TXMLNodeObj*	foundNodePtr = NULL;
 	
-	if (parentNodePtr == NULL)
-		throw TSymLibErrorObj(EINVAL);
-	
-	foundNodePtr = parentNodePtr->FindNode(tag,attribute,attributeValue);
+	foundNodePtr = GetNodePtr(parentNodePtr,tag,attribute,attributeValue);
 	if (foundNodePtr)
 		data = foundNodePtr->Data();
 	
 	return data;
 }
 
+//---------------------------------------------------------------------
+// TLibSymPrefs::GetPrefNodePtrAtPath
+//---------------------------------------------------------------------
+const TXMLNodeObj* TLibSymPrefs::GetPrefNodePtrAtPath (const std::string& path) const
+{
+	const TXMLNodeObj*	foundNodePtr = NULL;
+	
+	if (!LocalPrefsLoaded())
+		throw TSymLibErrorObj(kErrorLocalPreferenceNotLoaded,"Within TLibSymPrefs::GetPrefNodePtrAtPath()");
+	
+	foundNodePtr = GetNodePtrAtPath(fPrefLocalHomeNodePtr,path);
+	if (!foundNodePtr && fPrefRemoteHomeNodePtr)
+		foundNodePtr = GetNodePtrAtPath(fPrefRemoteHomeNodePtr,path);
+	
+	return foundNodePtr;
+}
+
+//---------------------------------------------------------------------
+// TLibSymPrefs::GetNodePtrAtPath
+//---------------------------------------------------------------------
+const TXMLNodeObj* TLibSymPrefs::GetNodePtrAtPath (const TXMLNodeObj* parentNodePtr,
+												   const std::string& path) const
+{
+	const TXMLNodeObj*	foundNodePtr = NULL;
+	bool				isIndexed = false;
+	
+	if (parentNodePtr == NULL)
+		throw TSymLibErrorObj(EINVAL);
+	
+	{
+		TLockedPthreadMutexObj		lock(fIndexMutex);
+		const TXMLNodeIndexObj*		indexPtr = _GetIndexPtr(parentNodePtr);
+		
+		if (indexPtr)
+		{
+			foundNodePtr = indexPtr->FindNodeAtPath(path);
+			isIndexed = true;
+		}
+	}
+	
+	// Nodes outside our preferences are walked without holding the lock
+	if (!isIndexed)
+		foundNodePtr = _FindNodeAtPath(parentNodePtr,path);
+	
+	return foundNodePtr;
+}
+
 //---------------------------------------------------------------------
 // TLibSymPrefs::_FindLocalConfFile (protected)
 //---------------------------------------------------------------------
@@ -334,6 +434,79 @@ void TLibSymPrefs::_ValidateLocalConf ()
 		throw TSymLibErrorObj(kErrorLocalPreferenceCorrupt);
 }
 
+//---------------------------------------------------------------------
+// TLibSymPrefs::_GetIndexPtr (protected)
+//---------------------------------------------------------------------
+const TXMLNodeIndexObj* TLibSymPrefs::_GetIndexPtr (const TXMLNodeObj* nodePtr) const
+{
+	const TXMLNodeIndexObj*		indexPtr = NULL;
+	NodeIndexMap_const_iter		foundIter = fIndexMap.find(nodePtr);
+	
+	if (foundIter != fIndexMap.end())
+	{
+		indexPtr = foundIter->second;
+	}
+	else if (nodePtr == fPrefLocalHomeNodePtr || nodePtr == fPrefRemoteHomeNodePtr)
+	{
+		indexPtr = fIndexMap[nodePtr] = new TXMLNodeIndexObj(nodePtr);
+	}
+	else
+	{
+		// Only index nodes we own; anything else could change under us
+		const TXMLNodeIndexObj*		localIndexPtr = (fPrefLocalHomeNodePtr ? _GetIndexPtr(fPrefLocalHomeNodePtr) : NULL);
+		const TXMLNodeIndexObj*		remoteIndexPtr = (fPrefRemoteHomeNodePtr ? _GetIndexPtr(fPrefRemoteHomeNodePtr) : NULL);
+		
+		if ((localIndexPtr && localIndexPtr->Contains(nodePtr)) || (remoteIndexPtr && remoteIndexPtr->Contains(nodePtr)))
+			indexPtr = fIndexMap[nodePtr] = new TXMLNodeIndexObj(nodePtr);
+	}
+	
+	return indexPtr;
+}
+
+//---------------------------------------------------------------------
+// TLibSymPrefs::_FindNodeAtPath (static protected)
+//---------------------------------------------------------------------
+const TXMLNodeObj* TLibSymPrefs::_FindNodeAtPath (const TXMLNodeObj* nodePtr,
+												  const std::string& path)
+{
+	const TXMLNodeObj*	foundNodePtr = NULL;
+	
+	if (path.empty())
+	{
+		foundNodePtr = nodePtr;
+	}
+	else
+	{
+		std::string::size_type	slashPos = path.find('/');
+		std::string				tag(path,0,slashPos);
+		std::string				remainingPath;
+		
+		if (slashPos != std::string::npos)
+			remainingPath = path.substr(slashPos + 1);
+		
+		// Try each matching subnode in document order, as the index does
+		for (unsigned long x = 0; !foundNodePtr && x < nodePtr->SubnodeCount(); x++)
+		{
+			const TXMLNodeObj*	subnodePtr = nodePtr->NthSubnode(x);
+			
+			if (subnodePtr && subnodePtr->Tag() == tag)
+				foundNodePtr = _FindNodeAtPath(subnodePtr,remainingPath);
+		}
+	}
+	
+	return foundNodePtr;
+}
+
+//---------------------------------------------------------------------
+// TLibSymPrefs::_ClearIndexes (protected)
+//---------------------------------------------------------------------
+void TLibSymPrefs::_ClearIndexes ()
+{
+	for (NodeIndexMap_iter x = fIndexMap.begin(); x != fIndexMap.end(); x++)
+		delete(x->second);
+	fIndexMap.clear();
+}
+
 //*********************************************************************
 // Global Functions
 //*********************************************************************
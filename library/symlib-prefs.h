@@ -27,6 +27,7 @@
 //---------------------------------------------------------------------
 #include "symlib-utils.h"
 
+#include "symlib-mutex.h"
 #include "symlib-xml.h"
 
 //---------------------------------------------------------------------
@@ -54,12 +55,38 @@ class TLibSymPrefs;
 #define	kTagPrefSSLPort									"ssl_port"
 
 #define	kTagPrefCompression							"compression"
+#define	kTagPrefCompressionMessage						"message"
+#define	kTagPrefCompressionType							"type"
+#define	kTagPrefCompressionLevel						"level"
+#define	kTagPrefCompressionStrategy						"strategy"
+
+#define	kTagPrefFileWatch							"file_watch"
+#define	kTagPrefReadWindow								"read_window"
+#define	kTagPrefWindowsPerPass							"windows_per_pass"
+#define	kTagPrefOffsetJournal							"offset_journal"
+
+#define	kTagPrefSignatures							"signatures"
+#define	kTagPrefSignatureCacheFile						"cache_file"
+
+#define	kTagPrefExec								"exec"
+#define	kTagPrefExecMaxProcesses						"max_processes"
+
+#define	kTagPrefSpool								"spool"
+#define	kTagPrefSpoolDir							"directory"
+#define	kTagPrefSpoolMaxSize							"max_size"
+#define	kTagPrefSpoolDrainRate						"drain_rate"
 
 //---------------------------------------------------------------------
 // Class TLibSymPrefs
 //---------------------------------------------------------------------
 class TLibSymPrefs
 {
+	protected:
+		
+		typedef	std::map<const TXMLNodeObj*,TXMLNodeIndexObj*>		NodeIndexMap;
+		typedef	NodeIndexMap::iterator									NodeIndexMap_iter;
+		typedef	NodeIndexMap::const_iterator							NodeIndexMap_const_iter;
+	
 	public:
 		
 		TLibSymPrefs ();
@@ -109,6 +136,16 @@ class TLibSymPrefs
 											const std::string& attribute = "",
 											const std::string& attributeValue = "") const;
 		
+		virtual const TXMLNodeObj* GetPrefNodePtrAtPath (const std::string& path) const;
+			// Returns the node reached through the slash-delimited list of tags
+			// in the argument (e.g. "server/host"), looking first in the local
+			// preferences and then in the server-provided ones, or NULL.
+		
+		virtual const TXMLNodeObj* GetNodePtrAtPath (const TXMLNodeObj* parentNodePtr,
+													 const std::string& path) const;
+			// Same as GetPrefNodePtrAtPath() but the path is relative to
+			// parentNodePtr.
+		
 		// ----------------------------------
 		// Accessors
 		// ----------------------------------
@@ -129,11 +166,30 @@ class TLibSymPrefs
 			// whether it appears valid or not.  An exception is thrown
 			// if an error is found.
 	
+		virtual const TXMLNodeIndexObj* _GetIndexPtr (const TXMLNodeObj* nodePtr) const;
+			// Returns the index of the hierarchy beginning with nodePtr, building
+			// it if necessary, if nodePtr is part of our preferences; returns
+			// NULL otherwise.  Caller must hold fIndexMutex.
+		
+		static const TXMLNodeObj* _FindNodeAtPath (const TXMLNodeObj* nodePtr,
+												   const std::string& path);
+			// Walks the slash-delimited path from nodePtr without an index,
+			// returning the same node TXMLNodeIndexObj::FindNodeAtPath()
+			// would, or NULL.
+		
+		virtual void _ClearIndexes ();
+			// Discards all indexes.  Must be called after the preferences
+			// are modified, without releasing fIndexMutex in between, so
+			// that no lookup can index the old tree.  Caller must hold
+			// fIndexMutex.
+	
 	protected:
 		
 		TXMLNodeObj								fPrefRootNode;
 		const TXMLNodeObj*						fPrefLocalHomeNodePtr;
 		TXMLNodeObj*							fPrefRemoteHomeNodePtr;
+		mutable TPthreadMutexObj				fIndexMutex;
+		mutable NodeIndexMap					fIndexMap;
 };
 
 //---------------------------------------------------------------------
@@ -0,0 +1,686 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Symbiot Master Library
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					21 Mar 2005
+#		Last Modified:				21 Mar 2005
+#		
+#######################################################################
+*/
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "symlib-spool.h"
+
+#include "symlib-prefs.h"
+#include "symlib-threads.h"
+#include "symlib-utils.h"
+#include "symlib-xml.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/time.h>
+#include <zlib.h>
+
+//---------------------------------------------------------------------
+// Begin Environment
+//---------------------------------------------------------------------
+namespace symbiot {
+
+//---------------------------------------------------------------------
+// Module Definitions
+//---------------------------------------------------------------------
+#define	kSpoolRecordMagic										0x53594D53	// "SYMS"
+#define	kSpoolRecordHeaderSize									20			// bytes
+#define	kSpoolSequenceDigits									10
+
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static	TMessageSpool*									gMessageSpoolPtr = NULL;
+static	TPthreadMutexObj								gMessageSpoolPtrMutex;
+
+//---------------------------------------------------------------------
+// _AppendUInt32 (static)
+//---------------------------------------------------------------------
+static void _AppendUInt32 (std::string& buffer, uint32_t value)
+{
+	uint32_t	netValue = htonl(value);
+	
+	buffer.append(reinterpret_cast<const char*>(&netValue),sizeof(netValue));
+}
+
+//---------------------------------------------------------------------
+// _ExtractUInt32 (static)
+//---------------------------------------------------------------------
+static uint32_t _ExtractUInt32 (const std::string& buffer, unsigned long offset)
+{
+	uint32_t	netValue = 0;
+	
+	memcpy(&netValue,buffer.data() + offset,sizeof(netValue));
+	
+	return ntohl(netValue);
+}
+
+//---------------------------------------------------------------------
+// _RecordCRC (static)
+//---------------------------------------------------------------------
+static uint32_t _RecordCRC (const std::string& buffer, unsigned long offset, unsigned long length)
+{
+	uLong	crc = crc32(0L,Z_NULL,0);
+	
+	crc = crc32(crc,reinterpret_cast<const Bytef*>(buffer.data() + offset),length);
+	
+	return static_cast<uint32_t>(crc);
+}
+
+//---------------------------------------------------------------------
+// _SegmentOrder (static)
+//---------------------------------------------------------------------
+static bool _SegmentOrder (const std::pair<unsigned long,std::string>& a, const std::pair<unsigned long,std::string>& b)
+{
+	return a.first < b.first;
+}
+
+//*********************************************************************
+// Class TMessageSpool
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TMessageSpool::TMessageSpool ()
+	:	fMaxSize(kMessageSpoolDefaultMaxSize),
+		fDrainRate(kMessageSpoolDefaultDrainRate),
+		fTotalSize(0),
+		fNextSequence(1),
+		fDrainSequence(0),
+		fDrainOffset(0),
+		fDrainNextOffset(0),
+		fLoaded(false),
+		fDrainerThreadObjPtr(NULL),
+		fDeliverProcPtr(NULL),
+		fStopRequested(false),
+		fWorkPending(false)
+{
+	pthread_cond_init(&fWorkAvailable,NULL);
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TMessageSpool::~TMessageSpool ()
+{
+	StopDrainer();
+	
+	try
+	{
+		TLockedPthreadMutexObj	lock(fMutex);
+		
+		_CloseActiveSegment();
+	}
+	catch (...)
+	{
+		// Ignore all errors
+	}
+	
+	pthread_cond_destroy(&fWorkAvailable);
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::Append
+//---------------------------------------------------------------------
+bool TMessageSpool::Append (const std::string& message, CompressionMode compressionMode)
+{
+	bool	wasAppended = false;
+	
+	try
+	{
+		TLockedPthreadMutexObj	lock(fMutex);
+		
+		_Load();
+		
+		if (!fDirPath.empty())
+		{
+			std::string		payload(AsZLibCompressed(message));
+			std::string		record;
+			
+			// Each record is a header of five 32-bit values in network
+			// order (magic, payload size, expanded size, payload CRC32,
+			// compression mode) followed by the compressed message
+			record.reserve(kSpoolRecordHeaderSize + payload.length());
+			_AppendUInt32(record,kSpoolRecordMagic);
+			_AppendUInt32(record,payload.length());
+			_AppendUInt32(record,message.length());
+			_AppendUInt32(record,_RecordCRC(payload,0,payload.length()));
+			_AppendUInt32(record,compressionMode);
+			record += payload;
+			
+			if (!fActiveFileObj.IsOpen())
+			{
+				SpoolSegment	segment;
+				std::string		sequenceStr(NumToString(fNextSequence));
+				
+				segment.sequence = fNextSequence++;
+				segment.path = fDirPath + kMessageSpoolSegmentPrefix;
+				segment.path += std::string(kSpoolSequenceDigits - std::min(sequenceStr.length(),static_cast<std::string::size_type>(kSpoolSequenceDigits)),'0') + sequenceStr;
+				segment.size = 0;
+				
+				fActiveFileObj.SetPath(segment.path);
+				fActiveFileObj.Open(O_WRONLY|O_CREAT|O_APPEND,S_IRUSR|S_IWUSR);
+				fSegmentList.push_back(segment);
+			}
+			
+			fActiveFileObj.Write(record);
+			fSegmentList.back().size += record.length();
+			fTotalSize += record.length();
+			wasAppended = true;
+			
+			if (fSegmentList.back().size >= kMessageSpoolSegmentMaxSize)
+				_CloseActiveSegment();
+				
+			_EnforceMaxSize();
+		}
+	}
+	catch (TSymLibErrorObj& errObj)
+	{
+		if (!errObj.IsLogged())
+		{
+			WriteToErrorLogFile("While spooling server message: " + errObj.GetDescription());
+			errObj.MarkAsLogged();
+		}
+	}
+	catch (...)
+	{
+		WriteToErrorLogFile("While spooling server message: Unknown error");
+	}
+	
+	if (wasAppended)
+	{
+		TLockedPthreadMutexObj	lock(fDrainerMutex);
+		
+		fWorkPending = true;
+		pthread_cond_signal(&fWorkAvailable);
+	}
+	
+	return wasAppended;
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::IsEmpty
+//---------------------------------------------------------------------
+bool TMessageSpool::IsEmpty ()
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	_Load();
+	
+	return fSegmentList.empty();
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::StartDrainer
+//---------------------------------------------------------------------
+void TMessageSpool::StartDrainer (SpoolDeliverProc deliverProcPtr)
+{
+	TLockedPthreadMutexObj	lock(fDrainerMutex);
+	
+	fDeliverProcPtr = deliverProcPtr;
+	
+	if (fDrainerThreadObjPtr && fDrainerThreadObjPtr->HasCompleted() && !fStopRequested)
+	{
+		// The drainer died on an error; reap it so it can be restarted
+		delete(fDrainerThreadObjPtr);
+		fDrainerThreadObjPtr = NULL;
+	}
+	
+	if (!fDrainerThreadObjPtr && fDeliverProcPtr)
+	{
+		fStopRequested = false;
+		fDrainerThreadObjPtr = new TPthreadObj(_DrainerEntry);
+		
+		try
+		{
+			fDrainerThreadObjPtr->Run(this);
+		}
+		catch (...)
+		{
+			delete(fDrainerThreadObjPtr);
+			fDrainerThreadObjPtr = NULL;
+			WriteToErrorLogFile("Unable to start the message spool drainer");
+		}
+	}
+	
+	fWorkPending = true;
+	pthread_cond_signal(&fWorkAvailable);
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::StopDrainer
+//---------------------------------------------------------------------
+void TMessageSpool::StopDrainer ()
+{
+	TPthreadObj*	threadObjPtr = NULL;
+	
+	{
+		TLockedPthreadMutexObj	lock(fDrainerMutex);
+		
+		if (fDrainerThreadObjPtr && !fStopRequested)
+		{
+			fStopRequested = true;
+			pthread_cond_signal(&fWorkAvailable);
+			threadObjPtr = fDrainerThreadObjPtr;
+		}
+	}
+	
+	if (threadObjPtr)
+	{
+		// Deleting the thread object joins the drainer thread
+		delete(threadObjPtr);
+		
+		TLockedPthreadMutexObj	lock(fDrainerMutex);
+		
+		fDrainerThreadObjPtr = NULL;
+		fStopRequested = false;
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_Load (protected)
+//---------------------------------------------------------------------
+void TMessageSpool::_Load ()
+{
+	if (!fLoaded)
+	{
+		const TXMLNodeObj*	spoolNodePtr = NULL;
+		
+		fLoaded = true;
+		
+		if (GetPrefsPtr()->LocalPrefsLoaded())
+			spoolNodePtr = GetPrefsPtr()->GetPrefNodePtr(kTagPrefSpool);
+			
+		if (spoolNodePtr)
+		{
+			std::string		maxSizeStr(spoolNodePtr->AttributeValue(kTagPrefSpoolMaxSize));
+			std::string		drainRateStr(spoolNodePtr->AttributeValue(kTagPrefSpoolDrainRate));
+			
+			fDirPath = spoolNodePtr->AttributeValue(kTagPrefSpoolDir);
+			
+			if (!maxSizeStr.empty())
+				fMaxSize = static_cast<unsigned long>(StringToNum(maxSizeStr));
+				
+			if (!drainRateStr.empty() && StringToNum(drainRateStr) > 0)
+				fDrainRate = static_cast<unsigned long>(StringToNum(drainRateStr));
+		}
+		
+		if (fDirPath.empty() && !gEnvironObjPtr->LogDirectory().empty())
+			fDirPath = gEnvironObjPtr->LogDirectory() + kMessageSpoolDirName;
+			
+		if (!fDirPath.empty() && fMaxSize > 0)
+		{
+			TDirObj		spoolDirObj(fDirPath);
+			DIR*		dirPtr = NULL;
+			
+			if (fDirPath[fDirPath.length() - 1] != '/')
+				fDirPath += "/";
+				
+			try
+			{
+				if (!spoolDirObj.Exists())
+					spoolDirObj.Create(S_IRWXU);
+			}
+			catch (TSymLibErrorObj& errObj)
+			{
+				if (!errObj.IsLogged())
+				{
+					WriteToErrorLogFile("While creating message spool directory: " + errObj.GetDescription());
+					errObj.MarkAsLogged();
+				}
+			}
+			
+			dirPtr = opendir(fDirPath.c_str());
+			if (dirPtr)
+			{
+				std::vector< std::pair<unsigned long,std::string> >		foundList;
+				struct dirent*											entryPtr = NULL;
+				std::string												prefix(kMessageSpoolSegmentPrefix);
+				
+				while ((entryPtr = readdir(dirPtr)) != NULL)
+				{
+					std::string		fileName(entryPtr->d_name);
+					
+					if (fileName.length() > prefix.length() && fileName.compare(0,prefix.length(),prefix) == 0)
+						foundList.push_back(std::make_pair(strtoul(fileName.c_str() + prefix.length(),NULL,10),fDirPath + fileName));
+				}
+				
+				closedir(dirPtr);
+				
+				// Segments left by an earlier run are delivered first
+				std::sort(foundList.begin(),foundList.end(),_SegmentOrder);
+				for (unsigned long x = 0; x < foundList.size(); x++)
+				{
+					SpoolSegment	segment;
+					
+					segment.sequence = foundList[x].first;
+					segment.path = foundList[x].second;
+					segment.size = TFileObj(segment.path).Size();
+					
+					fSegmentList.push_back(segment);
+					fTotalSize += segment.size;
+					fNextSequence = segment.sequence + 1;
+				}
+				
+				if (!fSegmentList.empty())
+					WriteToMessagesLogFile("Found " + NumToString(fTotalSize) + " bytes of spooled server messages");
+					
+				_EnforceMaxSize();
+			}
+			else
+			{
+				WriteToErrorLogFile("Message spool directory '" + fDirPath + "' is not usable; undeliverable server messages will be lost");
+				fDirPath = "";
+			}
+		}
+		else
+		{
+			fDirPath = "";
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_CloseActiveSegment (protected)
+//---------------------------------------------------------------------
+void TMessageSpool::_CloseActiveSegment ()
+{
+	if (fActiveFileObj.IsOpen())
+	{
+		fsync(fActiveFileObj.FileDescriptor());
+		fActiveFileObj.Close(false);
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_EnforceMaxSize (protected)
+//---------------------------------------------------------------------
+void TMessageSpool::_EnforceMaxSize ()
+{
+	while (fTotalSize > fMaxSize && !fSegmentList.empty())
+	{
+		SpoolSegment	segment(fSegmentList.front());
+		
+		if (fSegmentList.size() == 1)
+			_CloseActiveSegment();
+			
+		TFileObj(segment.path).Delete(false);
+		fSegmentList.pop_front();
+		fTotalSize -= std::min(fTotalSize,segment.size);
+		
+		if (segment.sequence == fDrainSequence)
+		{
+			fDrainBuffer.erase();
+			fDrainSequence = 0;
+		}
+		
+		WriteToErrorLogFile("Message spool is over " + NumToString(fMaxSize) + " bytes; discarded the oldest messages in '" + segment.path + "'");
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_NextMessage (protected)
+//---------------------------------------------------------------------
+bool TMessageSpool::_NextMessage (std::string& message, CompressionMode& compressionMode)
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	_Load();
+	
+	while (!fSegmentList.empty())
+	{
+		SpoolSegment&	segment(fSegmentList.front());
+		bool			segmentDone = false;
+		
+		if (fDrainSequence != segment.sequence)
+		{
+			// Start on the oldest segment; if we're still appending to it
+			// then new messages go to a fresh segment from now on
+			if (fSegmentList.size() == 1)
+				_CloseActiveSegment();
+				
+			fDrainBuffer.erase();
+			fDrainSequence = segment.sequence;
+			fDrainOffset = 0;
+			fDrainNextOffset = 0;
+			
+			try
+			{
+				TFileObj	segmentFileObj(segment.path);
+				
+				segmentFileObj.ReadWholeFile(fDrainBuffer);
+			}
+			catch (...)
+			{
+				WriteToErrorLogFile("Unable to read message spool segment '" + segment.path + "'");
+				fDrainBuffer.erase();
+			}
+		}
+		
+		while (!segmentDone)
+		{
+			if (fDrainOffset + kSpoolRecordHeaderSize > fDrainBuffer.length())
+			{
+				segmentDone = true;
+			}
+			else
+			{
+				unsigned long	payloadSize = _ExtractUInt32(fDrainBuffer,fDrainOffset + 4);
+				unsigned long	expandedSize = _ExtractUInt32(fDrainBuffer,fDrainOffset + 8);
+				bool			isValid = false;
+				
+				if (_ExtractUInt32(fDrainBuffer,fDrainOffset) == kSpoolRecordMagic &&
+					payloadSize <= fDrainBuffer.length() - fDrainOffset - kSpoolRecordHeaderSize &&
+					_ExtractUInt32(fDrainBuffer,fDrainOffset + 12) == _RecordCRC(fDrainBuffer,fDrainOffset + kSpoolRecordHeaderSize,payloadSize))
+				{
+					try
+					{
+						ZLibExpand(fDrainBuffer.substr(fDrainOffset + kSpoolRecordHeaderSize,payloadSize),message);
+						isValid = (message.length() == expandedSize);
+					}
+					catch (...)
+					{
+						isValid = false;
+					}
+				}
+				
+				if (isValid)
+				{
+					compressionMode = static_cast<CompressionMode>(_ExtractUInt32(fDrainBuffer,fDrainOffset + 16));
+					fDrainNextOffset = fDrainOffset + kSpoolRecordHeaderSize + payloadSize;
+					
+					return true;
+				}
+				else
+				{
+					// Skip ahead to the next thing that looks like a record
+					std::string		magic;
+					unsigned long	nextPos = std::string::npos;
+					
+					_AppendUInt32(magic,kSpoolRecordMagic);
+					nextPos = fDrainBuffer.find(magic,fDrainOffset + 1);
+					
+					WriteToErrorLogFile("Skipping damaged record in message spool segment '" + segment.path + "'");
+					
+					if (nextPos == std::string::npos)
+						segmentDone = true;
+					else
+						fDrainOffset = nextPos;
+				}
+			}
+		}
+		
+		// Everything in the segment has been delivered or is unreadable
+		TFileObj(segment.path).Delete(false);
+		fTotalSize -= std::min(fTotalSize,segment.size);
+		fSegmentList.pop_front();
+		fDrainBuffer.erase();
+		fDrainSequence = 0;
+	}
+	
+	return false;
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_RemoveMessage (protected)
+//---------------------------------------------------------------------
+void TMessageSpool::_RemoveMessage ()
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	// The segment may have been discarded while the message was out
+	if (!fSegmentList.empty() && fSegmentList.front().sequence == fDrainSequence)
+	{
+		fDrainOffset = fDrainNextOffset;
+		
+		if (fDrainOffset >= fDrainBuffer.length())
+		{
+			TFileObj(fSegmentList.front().path).Delete(false);
+			fTotalSize -= std::min(fTotalSize,fSegmentList.front().size);
+			fSegmentList.pop_front();
+			fDrainBuffer.erase();
+			fDrainSequence = 0;
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_DrainerEntry (static protected)
+//---------------------------------------------------------------------
+void* TMessageSpool::_DrainerEntry (void* arg)
+{
+	TMessageSpool*	spoolPtr = reinterpret_cast<TMessageSpool*>(arg);
+	
+	try
+	{
+		spoolPtr->_Drain();
+	}
+	catch (...)
+	{
+		WriteToErrorLogFile("Message spool drainer stopped unexpectedly");
+	}
+	
+	return NULL;
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_Drain (protected)
+//---------------------------------------------------------------------
+void TMessageSpool::_Drain ()
+{
+	bool	keepRunning = true;
+	
+	while (keepRunning)
+	{
+		std::string			message;
+		CompressionMode		compressionMode = kCompressionModeUnspecified;
+		
+		if (!_NextMessage(message,compressionMode))
+		{
+			// Nothing to do until something is spooled
+			keepRunning = _WaitForWork(0,true);
+		}
+		else if (fDeliverProcPtr(message,compressionMode))
+		{
+			_RemoveMessage();
+			
+			// Pace ourselves so a long backlog doesn't swamp the server
+			keepRunning = _WaitForWork(1.0 / fDrainRate,false);
+		}
+		else
+		{
+			// Not deliverable right now; we're woken early on reconnect
+			keepRunning = _WaitForWork(kMessageSpoolRetryInterval,true);
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TMessageSpool::_WaitForWork (protected)
+//---------------------------------------------------------------------
+bool TMessageSpool::_WaitForWork (double maxWaitSeconds, bool wakeOnWork)
+{
+	TLockedPthreadMutexObj	lock(fDrainerMutex);
+	struct timespec			deadline;
+	
+	if (maxWaitSeconds > 0)
+	{
+		struct timeval		now;
+		
+		gettimeofday(&now,NULL);
+		deadline.tv_sec = now.tv_sec + static_cast<time_t>(maxWaitSeconds);
+		deadline.tv_nsec = now.tv_usec * 1000 + static_cast<long>((maxWaitSeconds - static_cast<time_t>(maxWaitSeconds)) * 1000000000.0);
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+	
+	while (!fStopRequested && !(wakeOnWork && fWorkPending))
+	{
+		if (maxWaitSeconds > 0)
+		{
+			if (pthread_cond_timedwait(&fWorkAvailable,fDrainerMutex.MutexPtr(),&deadline) == ETIMEDOUT)
+				break;
+		}
+		else
+		{
+			pthread_cond_wait(&fWorkAvailable,fDrainerMutex.MutexPtr());
+		}
+	}
+	
+	if (wakeOnWork)
+		fWorkPending = false;
+		
+	return !fStopRequested;
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetMessageSpoolPtr
+//---------------------------------------------------------------------
+TMessageSpool* GetMessageSpoolPtr ()
+{
+	if (!gMessageSpoolPtr)
+	{
+		TLockedPthreadMutexObj		lock(gMessageSpoolPtrMutex);
+		
+		if (!gMessageSpoolPtr)
+		{
+			gMessageSpoolPtr = new TMessageSpool;
+		}
+	}
+	
+	return gMessageSpoolPtr;
+}
+
+//---------------------------------------------------------------------
+// End Environment
+//---------------------------------------------------------------------
+} // namespace symbiot
@@ -0,0 +1,190 @@
+/*
+#######################################################################
+#		SYMBIOT
+#		
+#		Real-time Network Threat Modeling
+#		(C) 2002-2004 Symbiot, Inc.	---	ALL RIGHTS RESERVED
+#		
+#		Symbiot Master Library
+#		
+#		http://www.symbiot.com
+#		
+#######################################################################
+#		Author: Borrowed Time, Inc.
+#		e-mail: libsymbiot@bti.net
+#		
+#		Created:					21 Mar 2005
+#		Last Modified:				21 Mar 2005
+#		
+#######################################################################
+*/
+
+#if !defined(SYMLIB_SPOOL)
+#define SYMLIB_SPOOL
+
+//---------------------------------------------------------------------
+// Includes
+//---------------------------------------------------------------------
+#include "symlib-config.h"
+
+#include "symlib-defs.h"
+#include "symlib-file.h"
+#include "symlib-mutex.h"
+
+#include <deque>
+#include <pthread.h>
+
+//---------------------------------------------------------------------
+// Begin Environment
+//---------------------------------------------------------------------
+namespace symbiot {
+
+//---------------------------------------------------------------------
+// Forward Class Declarations
+//---------------------------------------------------------------------
+class TMessageSpool;
+class TPthreadObj;
+
+//---------------------------------------------------------------------
+// Definitions
+//---------------------------------------------------------------------
+#define	kMessageSpoolDirName									"symagent_spool"
+#define	kMessageSpoolSegmentPrefix								"segment-"
+#define	kMessageSpoolSegmentMaxSize								262144		// bytes
+#define	kMessageSpoolDefaultMaxSize								67108864	// bytes
+#define	kMessageSpoolDefaultDrainRate							20			// messages per second
+#define	kMessageSpoolRetryInterval								5			// seconds
+
+typedef	bool (*SpoolDeliverProc)(const std::string& message, CompressionMode compressionMode);
+	// Called by the drainer for each spooled message, oldest first.  Returns
+	// true if the message has been dealt with and can be removed from the
+	// spool, false if it should be offered again later.
+
+//---------------------------------------------------------------------
+// Class TMessageSpool
+//
+// A durable, size-capped queue of messages bound for the server.
+// Messages are zLib-compressed and appended to segment files within the
+// spool directory, each framed by its length and CRC32 so that damaged
+// records are detected and skipped.  When the spool exceeds its maximum
+// size the oldest segments are discarded.  A background thread hands the
+// messages, in order and at a bounded rate, to a delivery function;
+// delivery is at-least-once, since a segment is only deleted once all
+// of its messages have been delivered.
+//---------------------------------------------------------------------
+class TMessageSpool
+{
+	protected:
+		
+		struct	SpoolSegment
+			{
+				unsigned long					sequence;
+				std::string						path;
+				unsigned long					size;
+			};
+			
+		typedef	std::deque<SpoolSegment>							SegmentList;
+		typedef	SegmentList::iterator								SegmentList_iter;
+		typedef	SegmentList::const_iterator							SegmentList_const_iter;
+		
+	public:
+		
+		TMessageSpool ();
+			// Constructor
+			
+	private:
+		
+		TMessageSpool (const TMessageSpool& obj) {}
+			// Copy constructor is illegal
+			
+	public:
+		
+		virtual ~TMessageSpool ();
+			// Destructor
+			
+		virtual bool Append (const std::string& message, CompressionMode compressionMode);
+			// Writes the message to the end of the spool and wakes the
+			// drainer.  Returns false if the message could not be written.
+			
+		virtual bool IsEmpty ();
+			// Returns true if no messages are waiting in the spool.
+			
+		virtual void StartDrainer (SpoolDeliverProc deliverProcPtr);
+			// Starts the background thread that hands spooled messages to
+			// deliverProcPtr, if it isn't already running, and wakes it.
+			// Should be called whenever the messages may be deliverable,
+			// such as after connecting to the server.
+			
+		virtual void StopDrainer ();
+			// Stops the background thread, waiting for any delivery in
+			// progress to finish.
+			
+	protected:
+		
+		virtual void _Load ();
+			// Reads the spool settings and finds the segments left by an
+			// earlier run, if that hasn't been done already.  Caller must
+			// hold fMutex.
+			
+		virtual void _CloseActiveSegment ();
+			// Flushes and closes the segment being appended to, if any, so
+			// the next Append() starts a new one.  Caller must hold fMutex.
+			
+		virtual void _EnforceMaxSize ();
+			// Deletes the oldest segments until the spool fits within its
+			// maximum size.  Caller must hold fMutex.
+			
+		virtual bool _NextMessage (std::string& message, CompressionMode& compressionMode);
+			// Destructively modifies the arguments to contain the oldest
+			// spooled message.  Returns false if the spool is empty.
+			
+		virtual void _RemoveMessage ();
+			// Removes the message last returned by _NextMessage().
+			
+		static void* _DrainerEntry (void* arg);
+			// Entry point for fDrainerThreadObjPtr; arg is the spool object.
+			
+		virtual void _Drain ();
+			// Main loop of the drainer thread.
+			
+		virtual bool _WaitForWork (double maxWaitSeconds, bool wakeOnWork);
+			// Sleeps until maxWaitSeconds have passed (forever if zero) or,
+			// if wakeOnWork is true, until new work is signalled.  Returns
+			// false if the drainer has been asked to stop.
+			
+	protected:
+		
+		TPthreadMutexObj						fMutex;
+		std::string								fDirPath;
+		unsigned long							fMaxSize;
+		unsigned long							fDrainRate;
+		SegmentList								fSegmentList;				// oldest first
+		unsigned long							fTotalSize;
+		unsigned long							fNextSequence;
+		TFileObj								fActiveFileObj;				// newest segment, while it's being appended to
+		std::string								fDrainBuffer;				// contents of the oldest segment
+		unsigned long							fDrainSequence;
+		unsigned long							fDrainOffset;
+		unsigned long							fDrainNextOffset;
+		bool									fLoaded;
+		TPthreadMutexObj						fDrainerMutex;
+		pthread_cond_t							fWorkAvailable;
+		TPthreadObj*							fDrainerThreadObjPtr;		// joinable; deleting it joins the drainer
+		SpoolDeliverProc						fDeliverProcPtr;
+		bool									fStopRequested;
+		bool									fWorkPending;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+
+TMessageSpool* GetMessageSpoolPtr ();
+	// Returns a pointer to the global server message spool.
+
+//---------------------------------------------------------------------
+// End Environment
+//---------------------------------------------------------------------
+} // namespace symbiot
+
+#endif // SYMLIB_SPOOL
@@ -27,6 +27,10 @@
 //---------------------------------------------------------------------
 #include "symlib-ssl-digest.h"
 
+#include "symlib-prefs.h"
+#include "symlib-ssl-encode.h"
+#include "symlib-utils.h"
+
 #include <algorithm>
 
 //---------------------------------------------------------------------
@@ -34,6 +38,12 @@
 //---------------------------------------------------------------------
 namespace symbiot {
 
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static	TFileSignatureCache*							gFileSignatureCachePtr = NULL;
+static	TPthreadMutexObj								gFileSignatureCachePtrMutex;
+
 //*********************************************************************
 // Class TDigest
 //*********************************************************************
@@ -396,6 +406,264 @@ void TDigestContext::GetAllAlgorithmNames (StdStringList& digestNameList)
 	sort(digestNameList.begin(),digestNameList.end());
 }
 
+//*********************************************************************
+// Class TFileSignatureCache
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TFileSignatureCache::TFileSignatureCache ()
+	:	fLastFlushTime(time(NULL)),
+		fDirty(false),
+		fLoaded(false)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TFileSignatureCache::~TFileSignatureCache ()
+{
+	try
+	{
+		Flush(true);
+	}
+	catch (...)
+	{
+		// Ignore all errors
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::GetSignature
+//---------------------------------------------------------------------
+std::string TFileSignatureCache::GetSignature (const std::string& filePath)
+{
+	std::string		sig;
+	TFileObj		fileObj(filePath);
+	struct stat		statInfo;
+	FileIdent		ident;
+	bool			found = false;
+	
+	// Stat through the open descriptor so that what we look up is
+	// exactly what we would hash
+	fileObj.Open(O_RDONLY);
+	fileObj.StatInfo(statInfo);
+	ident = FileIdent(statInfo.st_dev,statInfo.st_ino);
+	
+	{
+		TLockedPthreadMutexObj	lock(fMutex);
+		SignatureMap_const_iter	foundIter;
+		
+		_Load();
+		
+		foundIter = fSignatureMap.find(ident);
+		if (foundIter != fSignatureMap.end() && _IsSameFile(foundIter->second,statInfo))
+		{
+			sig = foundIter->second.signature;
+			found = true;
+		}
+	}
+	
+	if (!found)
+	{
+		struct stat		finalStatInfo;
+		
+		// Hash without holding the lock; large files would otherwise
+		// stall every other thread asking for a signature
+		sig = _ComputeSignature(fileObj);
+		fileObj.StatInfo(finalStatInfo);
+		
+		// Don't remember a signature if the file changed while we read it
+		if (finalStatInfo.st_size == statInfo.st_size &&
+			finalStatInfo.st_mtime == statInfo.st_mtime &&
+			finalStatInfo.st_ctime == statInfo.st_ctime)
+		{
+			TLockedPthreadMutexObj	lock(fMutex);
+			CachedSignature			cachedSig;
+			
+			cachedSig.size = statInfo.st_size;
+			cachedSig.modTime = statInfo.st_mtime;
+			cachedSig.changeTime = statInfo.st_ctime;
+			cachedSig.signature = sig;
+			
+			// Entries for deleted files are never reclaimed individually,
+			// so start over rather than let the cache grow without bound
+			if (fSignatureMap.size() >= kFileSignatureCacheMaxEntries && fSignatureMap.find(ident) == fSignatureMap.end())
+				fSignatureMap.clear();
+			
+			fSignatureMap[ident] = cachedSig;
+			fDirty = true;
+		}
+		
+		try
+		{
+			Flush();
+		}
+		catch (...)
+		{
+			// Persistence is best-effort; the signature itself is fine
+		}
+	}
+	
+	fileObj.Close();
+	
+	return sig;
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::Flush
+//---------------------------------------------------------------------
+void TFileSignatureCache::Flush (bool force)
+{
+	TLockedPthreadMutexObj	lock(fMutex);
+	
+	if (fDirty && (force || time(NULL) - fLastFlushTime >= kFileSignatureCacheFlushInterval))
+	{
+		// Note the attempt first so a failing write isn't retried on every call
+		fLastFlushTime = time(NULL);
+		_Write();
+		fDirty = false;
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::_ComputeSignature (static protected)
+//---------------------------------------------------------------------
+std::string TFileSignatureCache::_ComputeSignature (TFileObj& fileObj)
+{
+	TDigest			fileSigDigestObj("SHA1");
+	TDigestContext	fileSigDigestContextObj;
+	TEncodeContext	encodeContext;
+	
+	fileSigDigestContextObj.Initialize(fileSigDigestObj);
+	fileSigDigestContextObj.Update(fileObj);
+	
+	return encodeContext.Encode(fileSigDigestContextObj.Final());
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::_IsSameFile (static protected)
+//---------------------------------------------------------------------
+bool TFileSignatureCache::_IsSameFile (const CachedSignature& cachedSig, const struct stat& statInfo)
+{
+	// The inode change time can't be set from user space, so a file that
+	// was rewritten and had its modification time restored still misses
+	return (cachedSig.size == static_cast<unsigned long long>(statInfo.st_size) &&
+			cachedSig.modTime == statInfo.st_mtime &&
+			cachedSig.changeTime == statInfo.st_ctime);
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::_Load (protected)
+//---------------------------------------------------------------------
+void TFileSignatureCache::_Load ()
+{
+	if (!fLoaded)
+	{
+		fLoaded = true;
+		
+		if (GetPrefsPtr()->LocalPrefsLoaded())
+			fPath = GetPrefsPtr()->GetPrefData(kTagPrefSignatureCacheFile);
+		
+		if (!fPath.empty())
+		{
+			TFileObj		cacheFileObj(fPath);
+			
+			if (cacheFileObj.Exists())
+			{
+				StdStringList	lineList;
+				
+				cacheFileObj.ReadWholeFile(lineList);
+				
+				for (StdStringList_const_iter x = lineList.begin(); x != lineList.end(); x++)
+				{
+					StdStringList	fieldList;
+					
+					SplitStdString(' ',*x,fieldList,false);
+					
+					// Each entry is "<device> <inode> <size> <mtime> <ctime> <signature>";
+					// anything else is ignored
+					if (fieldList.size() == 6)
+					{
+						FileIdent			ident(static_cast<dev_t>(strtoull(fieldList[0].c_str(),NULL,10)),
+												  static_cast<ino_t>(strtoull(fieldList[1].c_str(),NULL,10)));
+						CachedSignature		cachedSig;
+						
+						cachedSig.size = strtoull(fieldList[2].c_str(),NULL,10);
+						cachedSig.modTime = static_cast<time_t>(strtoll(fieldList[3].c_str(),NULL,10));
+						cachedSig.changeTime = static_cast<time_t>(strtoll(fieldList[4].c_str(),NULL,10));
+						cachedSig.signature = fieldList[5];
+						
+						fSignatureMap[ident] = cachedSig;
+					}
+				}
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TFileSignatureCache::_Write (protected)
+//---------------------------------------------------------------------
+void TFileSignatureCache::_Write ()
+{
+	if (!fPath.empty())
+	{
+		std::string		tempPath(fPath + ".tmp");
+		TFileObj		tempFileObj(tempPath);
+		std::string		buffer;
+		
+		for (SignatureMap_const_iter x = fSignatureMap.begin(); x != fSignatureMap.end(); x++)
+		{
+			buffer += NumToString(static_cast<unsigned long long>(x->first.first)) + " ";
+			buffer += NumToString(static_cast<unsigned long long>(x->first.second)) + " ";
+			buffer += NumToString(x->second.size) + " ";
+			buffer += NumToString(static_cast<long long>(x->second.modTime)) + " ";
+			buffer += NumToString(static_cast<long long>(x->second.changeTime)) + " ";
+			buffer += x->second.signature + "\n";
+		}
+		
+		// Write to a temporary file and make sure it's on disk before
+		// swapping it in, so a crash leaves either the old or new cache
+		tempFileObj.Open(O_WRONLY|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR);
+		tempFileObj.Write(buffer);
+		if (fsync(tempFileObj.FileDescriptor()) != 0)
+		{
+			std::string		errString;
+			
+			errString += "While syncing signature cache '" + tempPath + "'";
+			throw TSymLibErrorObj(errno,errString);
+		}
+		tempFileObj.Close();
+		
+		RenameFileDurably(tempPath,fPath);
+	}
+}
+
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// GetFileSignatureCachePtr
+//---------------------------------------------------------------------
+TFileSignatureCache* GetFileSignatureCachePtr ()
+{
+	if (!gFileSignatureCachePtr)
+	{
+		TLockedPthreadMutexObj		lock(gFileSignatureCachePtrMutex);
+		
+		if (!gFileSignatureCachePtr)
+		{
+			gFileSignatureCachePtr = new TFileSignatureCache;
+		}
+	}
+	
+	return gFileSignatureCachePtr;
+}
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -30,6 +30,8 @@
 //---------------------------------------------------------------------
 #include "symlib-ssl-util.h"
 
+#include "symlib-mutex.h"
+
 //---------------------------------------------------------------------
 // Begin Environment
 //---------------------------------------------------------------------
@@ -38,12 +40,15 @@ namespace symbiot {
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kFileSignatureCacheFlushInterval						60		// seconds
+#define	kFileSignatureCacheMaxEntries							8192
 
 //---------------------------------------------------------------------
 // Forward Class Declarations
 //---------------------------------------------------------------------
 class TDigest;
 class TDigestContext;
+class TFileSignatureCache;
 
 //---------------------------------------------------------------------
 // Class TDigest
@@ -264,6 +269,94 @@ class TDigestContext : public TUpdateScanMixin
 		TDigest									fAlgorithm;
 };
 
+//---------------------------------------------------------------------
+// Class TFileSignatureCache
+//
+// Process-wide cache of file signatures, keyed by device and inode.
+// An entry is only trusted while the file's size, modification time
+// and inode change time are unchanged, so upgraded or rewritten files
+// are always rehashed.  If the <signatures><cache_file> preference
+// names a file then the cache is loaded from it on first use and
+// rewritten, at most once every kFileSignatureCacheFlushInterval
+// seconds, as new signatures are computed.
+//---------------------------------------------------------------------
+class TFileSignatureCache
+{
+	protected:
+		
+		typedef	std::pair<dev_t,ino_t>								FileIdent;
+		
+		struct	CachedSignature
+			{
+				unsigned long long					size;
+				time_t								modTime;
+				time_t								changeTime;
+				std::string							signature;
+			};
+		
+		typedef	std::map<FileIdent,CachedSignature>					SignatureMap;
+		typedef	SignatureMap::iterator								SignatureMap_iter;
+		typedef	SignatureMap::const_iterator						SignatureMap_const_iter;
+	
+	public:
+		
+		TFileSignatureCache ();
+			// Constructor
+	
+	private:
+		
+		TFileSignatureCache (const TFileSignatureCache& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		virtual ~TFileSignatureCache ();
+			// Destructor
+		
+		virtual std::string GetSignature (const std::string& filePath);
+			// Returns the encoded SHA1 signature of the file indicated by
+			// the argument, computing it only if there is no valid cache
+			// entry for the file.  Throws an exception if the file cannot
+			// be read.
+		
+		virtual void Flush (bool force = false);
+			// Writes pending changes to disk if the flush interval has
+			// elapsed or force is true.  Does nothing if persistence has
+			// not been configured.
+	
+	protected:
+		
+		static std::string _ComputeSignature (TFileObj& fileObj);
+			// Reads the file and returns its encoded SHA1 signature.
+		
+		static bool _IsSameFile (const CachedSignature& cachedSig, const struct stat& statInfo);
+			// Returns true if the cached entry was computed from a file
+			// whose size and times match statInfo.
+		
+		virtual void _Load ();
+			// Reads the cache from disk, if it hasn't been read already.
+			// Caller must hold fMutex.
+		
+		virtual void _Write ();
+			// Writes the cache to disk.  Caller must hold fMutex.
+	
+	protected:
+		
+		SignatureMap							fSignatureMap;
+		TPthreadMutexObj						fMutex;
+		std::string								fPath;
+		time_t									fLastFlushTime;
+		bool									fDirty;
+		bool									fLoaded;
+};
+
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+
+TFileSignatureCache* GetFileSignatureCachePtr ();
+	// Returns a pointer to the process-wide file signature cache.
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -830,6 +830,25 @@ TSSLSession::~TSSLSession ()
 	_Free();
 }
 
+//---------------------------------------------------------------------
+// TSSLSession::operator=
+//---------------------------------------------------------------------
+TSSLSession& TSSLSession::operator= (const TSSLSession& obj)
+{
+	if (obj.fSessionPtr != fSessionPtr)
+	{
+		_Free();
+		
+		if (obj.fSessionPtr)
+		{
+			fSessionPtr = const_cast<SSL_SESSION*>(obj.fSessionPtr);
+			++fSessionPtr->references;
+		}
+	}
+	
+	return *this;
+}
+
 //---------------------------------------------------------------------
 // TSSLSession::GetTimeStarted
 //---------------------------------------------------------------------
@@ -404,6 +404,10 @@ class TSSLSession
 		virtual ~TSSLSession ();
 			// Destructor
 		
+		TSSLSession& operator= (const TSSLSession& obj);
+			// Assignment operator; releases the current session, if any, and
+			// shares the one held by the argument.
+		
 		virtual time_t GetTimeStarted ();
 			// Returns the time the current session was started, in Unix seconds.
 			// OpenSSL functions:  SSL_SESSION_get_time
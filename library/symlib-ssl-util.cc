@@ -930,7 +930,7 @@ void TUpdateScanMixin::Update (TFileObj& fileObj)
 	bool			wasOpen = fileObj.IsOpen();
 	unsigned long	oldFilePos = 0;
 	std::string		buffer;
-	size_t			kBufferSize = 4096;
+	ssize_t			bytesRead = 0;
 	
 	if (wasOpen)
 	{
@@ -946,14 +946,27 @@ void TUpdateScanMixin::Update (TFileObj& fileObj)
 		fileObj.Open(O_RDONLY);
 	}
 	
-	// Loop through the file, calling the update method as we go
-	while (!fileObj.IsEOF())
+	// Loop through the file, calling the update method as we go.  The
+	// descriptor is read directly into one large reused buffer; going
+	// through TFileObj::Read() would copy every 4K block twice.
+	do
 	{
-		buffer = "";
-		fileObj.Read(buffer,kBufferSize);
-		if (!buffer.empty())
+		buffer.resize(kUpdateScanBufferSize);
+		bytesRead = read(fileObj.FileDescriptor(),const_cast<char*>(buffer.data()),buffer.length());
+		if (bytesRead < 0)
+		{
+			std::string		errString;
+			
+			errString += "While attempting to read from file '" + fileObj.Path() + "'";
+			throw TSymLibErrorObj(errno,errString);
+		}
+		else if (bytesRead > 0)
+		{
+			buffer.resize(bytesRead);
 			Update(buffer);
+		}
 	}
+	while (bytesRead > 0);
 	
 	if (wasOpen)
 	{
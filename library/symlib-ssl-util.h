@@ -73,6 +73,9 @@ namespace symbiot {
 // Definitions
 //---------------------------------------------------------------------
 
+// Size of the blocks read by TUpdateScanMixin
+#define		kUpdateScanBufferSize							262144
+
 // Error codes used throughout the SSL library suite
 #define		kSSLMessageDigestAlgoUnknown					-31011
 #define		kSSLMessageDigestAlgoNotSet						-31012
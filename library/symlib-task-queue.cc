@@ -203,6 +203,45 @@ bool TQueue::DeleteTask (const TTaskBase* taskObjPtr)
 	return wasDeleted;
 }
 
+//---------------------------------------------------------------------
+// TQueue::DeleteOwnedTasks
+//---------------------------------------------------------------------
+unsigned long TQueue::DeleteOwnedTasks (const void* ownerRef)
+{
+	unsigned long	runningCount = 0;
+	
+	if (ownerRef)
+	{
+		TLockedPthreadMutexObj		lock(fQueueMutex);
+		WaitQueue_iter				x = fWaitQueue.begin();
+		
+		while (x != fWaitQueue.end())
+		{
+			if (x->taskObjPtr->OwnerRef() == ownerRef)
+			{
+				delete(x->taskObjPtr);
+				x = fWaitQueue.erase(x);
+			}
+			else
+			{
+				x++;
+			}
+		}
+		
+		for (RunQueue_iter x = fRunQueue.begin(); x != fRunQueue.end(); x++)
+		{
+			if ((*x)->ContextPtr()->OwnerRef() == ownerRef)
+			{
+				// _ManageTasks() deletes it instead of requeuing it
+				(*x)->ContextPtr()->SetRerun(false);
+				++runningCount;
+			}
+		}
+	}
+	
+	return runningCount;
+}
+
 //---------------------------------------------------------------------
 // TQueue::ManageTasks
 //---------------------------------------------------------------------
@@ -625,6 +664,36 @@ bool _IsTaskInQueue (const TTaskBase* taskObjPtr)
 	return inQueue;
 }
 
+//---------------------------------------------------------------------
+// _DeleteOwnedTasksFromQueue
+//---------------------------------------------------------------------
+bool _DeleteOwnedTasksFromQueue (const void* ownerRef, time_t timeoutInSeconds)
+{
+	bool	allDeleted = true;
+	
+	if (gTaskQueuePtr && ownerRef)
+	{
+		time_t		expireTime = time(NULL) + timeoutInSeconds;
+		
+		// Running tasks may queue new ones before they finish, so the
+		// waiting queue is swept again on every pass.  A finished task
+		// is deleted by the queue runner while it holds the queue lock,
+		// so a count of zero means no owned task code is still executing.
+		while (gTaskQueuePtr->DeleteOwnedTasks(ownerRef) > 0)
+		{
+			if (time(NULL) >= expireTime)
+			{
+				allDeleted = false;
+				break;
+			}
+			
+			Pause(.2);
+		}
+	}
+	
+	return allDeleted;
+}
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -128,6 +128,12 @@ class TQueue
 			// Returns a boolean indicating whether the task was actually found
 			// and deleted or not.
 		
+		virtual unsigned long DeleteOwnedTasks (const void* ownerRef);
+			// Deletes the waiting tasks whose owner reference matches the
+			// argument and keeps its running tasks from being rescheduled;
+			// those are deleted by ManageTasks() once they finish.  Returns
+			// the number of owned tasks still running.
+		
 		virtual void ManageTasks ();
 			// Executes waiting tasks that have execution time less than
 			// or equal to the current time, checks for finished tasks
@@ -229,6 +235,12 @@ bool _IsTaskInQueue (const TTaskBase* taskObjPtr);
 	// Returns true if the given task object resides in either the run
 	// or wait queue, false otherwise.
 
+bool _DeleteOwnedTasksFromQueue (const void* ownerRef, time_t timeoutInSeconds);
+	// Deletes every queued task owned by ownerRef and waits up to
+	// timeoutInSeconds for its running tasks to finish and be deleted.
+	// Running tasks are not cancelled.  Returns true if none of the
+	// owner's tasks remain in the queue.
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
@@ -32,6 +32,29 @@
 //---------------------------------------------------------------------
 namespace symbiot {
 
+//---------------------------------------------------------------------
+// Module Globals
+//---------------------------------------------------------------------
+static		pthread_key_t						gTaskOwnerKey;
+static		pthread_once_t						gTaskOwnerKeyOnce = PTHREAD_ONCE_INIT;
+
+//---------------------------------------------------------------------
+// CreateTaskOwnerKey
+//---------------------------------------------------------------------
+static void CreateTaskOwnerKey ()
+{
+	pthread_key_create(&gTaskOwnerKey,NULL);
+}
+
+//---------------------------------------------------------------------
+// SetCurrentTaskOwnerRef
+//---------------------------------------------------------------------
+static void SetCurrentTaskOwnerRef (const void* ownerRef)
+{
+	pthread_once(&gTaskOwnerKeyOnce,CreateTaskOwnerKey);
+	pthread_setspecific(gTaskOwnerKey,ownerRef);
+}
+
 //*********************************************************************
 // Class TTaskBase
 //*********************************************************************
@@ -41,7 +64,8 @@ namespace symbiot {
 //---------------------------------------------------------------------
 TTaskBase::TTaskBase ()
 	:	fExecInterval(0),
-		fRerun(false)
+		fRerun(false),
+		fOwnerRef(CurrentTaskOwnerRef())
 {
 }
 
@@ -54,7 +78,8 @@ TTaskBase::TTaskBase (const std::string& taskName,
 	:	fTaskName(taskName),
 		fExecInterval(intervalInSeconds),
 		fParentThread(pthread_self()),
-		fRerun(rerun)
+		fRerun(rerun),
+		fOwnerRef(CurrentTaskOwnerRef())
 {
 }
 
@@ -74,16 +99,34 @@ void TTaskBase::ThreadMain (void* /* argPtr */)
 	{
 		pthread_testcancel();
 		gEnvironObjPtr->SetTaskName(fTaskName);
+		// Tasks created while this one runs belong to our owner
+		SetCurrentTaskOwnerRef(fOwnerRef);
 		RunTask();
+		SetCurrentTaskOwnerRef(NULL);
 		gEnvironObjPtr->RemoveTaskName();
 	}
 	catch (...)
 	{
+		SetCurrentTaskOwnerRef(NULL);
 		gEnvironObjPtr->RemoveTaskName();
 		throw;
 	}
 }
 
+//*********************************************************************
+// Global Functions
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// CurrentTaskOwnerRef
+//---------------------------------------------------------------------
+const void* CurrentTaskOwnerRef ()
+{
+	pthread_once(&gTaskOwnerKeyOnce,CreateTaskOwnerKey);
+	
+	return pthread_getspecific(gTaskOwnerKey);
+}
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
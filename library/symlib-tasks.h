@@ -47,6 +47,11 @@ class TTaskBase;
 //
 // Base class.  Tasks should derive from this class.  The
 // entry point of the task is the RunTask() method.
+//
+// Every task may carry an owner reference, an opaque pointer naming
+// whoever is responsible for it (the agent uses the plugin object).
+// A new task takes the owner of the task whose thread creates it, so
+// tasks queued by an owned task are owned as well.
 //---------------------------------------------------------------------
 class TTaskBase
 {
@@ -98,6 +103,12 @@ class TTaskBase
 		inline pthread_t ParentThreadID () const
 			{ return fParentThread; }
 	
+		inline const void* OwnerRef () const
+			{ return fOwnerRef; }
+		
+		inline void SetOwnerRef (const void* ownerRef)
+			{ fOwnerRef = ownerRef; }
+	
 	public:
 		
 		virtual void ThreadMain (void* argPtr = NULL);
@@ -111,8 +122,16 @@ class TTaskBase
 		time_t									fExecInterval;
 		pthread_t								fParentThread;
 		bool									fRerun;
+		const void*								fOwnerRef;
 };
 
+//---------------------------------------------------------------------
+// Global Function Declarations
+//---------------------------------------------------------------------
+const void* CurrentTaskOwnerRef ();
+	// Returns the owner reference of the task running in the calling
+	// thread, or NULL if the thread is not running an owned task.
+
 //---------------------------------------------------------------------
 // End Environment
 //---------------------------------------------------------------------
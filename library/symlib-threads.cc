@@ -30,6 +30,8 @@
 #include "symlib-exception.h"
 
 #include <cerrno>
+#include <iterator>
+#include <map>
 #include <signal.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -45,9 +47,13 @@ namespace symbiot {
 typedef		void*	(*ThreadEntryPoint)(void*);
 typedef		void*	ThreadArgumentPtr;
 
-typedef		std::vector<TPthreadObj*>			PthreadObjPtrList;
-typedef		PthreadObjPtrList::iterator			PthreadObjPtrList_iter;
-typedef		PthreadObjPtrList::const_iterator	PthreadObjPtrList_const_iter;
+typedef		std::map<unsigned long,TPthreadObj*>	PthreadObjPtrMap;			// key = internal ID
+typedef		PthreadObjPtrMap::iterator				PthreadObjPtrMap_iter;
+typedef		PthreadObjPtrMap::const_iterator		PthreadObjPtrMap_const_iter;
+
+typedef		std::map<pthread_t,TPthreadObj*>		ThreadIDObjPtrMap;			// key = thread ID
+typedef		ThreadIDObjPtrMap::iterator				ThreadIDObjPtrMap_iter;
+typedef		ThreadIDObjPtrMap::const_iterator		ThreadIDObjPtrMap_const_iter;
 
 // -------------------------------------
 
@@ -58,15 +64,18 @@ class TPthreadTrackerObj
 		TPthreadTrackerObj () {}
 		~TPthreadTrackerObj () {}
 		
-		PthreadObjPtrList				fTrackedThreads;
+		PthreadObjPtrMap				fTrackedThreads;
+		ThreadIDObjPtrMap				fThreadIDMap;
 };
 
 //---------------------------------------------------------------------
 // Module Globals
 //---------------------------------------------------------------------
 static		TPthreadTrackerObj*					gPthreadTrackObjPtr = NULL;
-static		TPthreadMutexObj					gTrackedThreadsMutex;
+static		TAdaptiveMutexObj					gTrackedThreadsMutex("thread tracker");
 static		TPthreadMutexObj					gPthreadTrackCreateMutex;
+static		pthread_key_t						gCurrentThreadKey;
+static		pthread_once_t						gCurrentThreadKeyOnce = PTHREAD_ONCE_INIT;
 
 //---------------------------------------------------------------------
 // Singleton Accessors
@@ -86,6 +95,14 @@ TPthreadTrackerObj* PthreadTrackObjPtr ()
 	return gPthreadTrackObjPtr;
 }
 
+//---------------------------------------------------------------------
+// CreateCurrentThreadKey
+//---------------------------------------------------------------------
+static void CreateCurrentThreadKey ()
+{
+	pthread_key_create(&gCurrentThreadKey,NULL);
+}
+
 //*********************************************************************
 // Class TPthreadObj
 //*********************************************************************
@@ -266,14 +283,27 @@ void TPthreadObj::Run (ThreadArgumentPtr argPtr)
 		throw TSymLibErrorObj(ESRCH,"No thread function defined");
 	
 	fFunctionArgPtr = argPtr;
+	
+	// Forget the thread from any earlier run
+	if (fRunning != kThreadObjStateNotStarted)
+	{
+		ThreadIDObjPtrMap_iter	foundIter = PthreadTrackObjPtr()->fThreadIDMap.find(fThread);
+		
+		if (foundIter != PthreadTrackObjPtr()->fThreadIDMap.end() && foundIter->second == this)
+			PthreadTrackObjPtr()->fThreadIDMap.erase(foundIter);
+	}
+	
 	MarkAsRunning();
 
 	createResult = pthread_create(&fThread,&fAttributes,_ThreadRunner,this);
 	
 	if (createResult != 0) {
+		// There is no thread to join, so don't let the destructor try
+		fRunning = kThreadObjStateNotStarted;
 		throw TSymLibErrorObj(createResult,"While calling pthread_create");
-		MarkAsStopped();
 	}
+	
+	PthreadTrackObjPtr()->fThreadIDMap[fThread] = this;
 }
 
 //---------------------------------------------------------------------
@@ -281,7 +311,7 @@ void TPthreadObj::Run (ThreadArgumentPtr argPtr)
 //---------------------------------------------------------------------
 void TPthreadObj::Join (void** returnValueHandle)
 {
-	if (DetachState() != PTHREAD_CREATE_DETACHED)
+	if (fRunning != kThreadObjStateNotStarted && DetachState() != PTHREAD_CREATE_DETACHED)
 	{
 		if (pthread_join(fThread,returnValueHandle) != 0)
 			throw TSymLibErrorObj(errno,"While calling pthread_join");
@@ -456,16 +486,16 @@ void TPthreadObj::SetScope (int newScope)
 void TPthreadObj::BeginTracking ()
 {
 	TLockedPthreadTrackerObj		trackerLock;
+	PthreadObjPtrMap&				trackedThreads(PthreadTrackObjPtr()->fTrackedThreads);
 	
-	fID = 0;
+	// Determine a unique internal ID to return; the map is ordered by
+	// ID so the highest one in use is the last one
+	fID = 1;
+	if (!trackedThreads.empty())
+		fID = trackedThreads.rbegin()->first + 1;
 	
-	// Determine a unique internal ID to return
-	for (PthreadObjPtrList_const_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
-		fID = std::max(fID,(*x)->InternalID());
-	++fID;
-	
-	// Push a pointer to the thread object onto our list
-	PthreadTrackObjPtr()->fTrackedThreads.push_back(this);
+	// Insert a pointer to the thread object into our map
+	trackedThreads[fID] = this;
 }
 
 //---------------------------------------------------------------------
@@ -474,16 +504,32 @@ void TPthreadObj::BeginTracking ()
 void TPthreadObj::EndTracking ()
 {
 	TLockedPthreadTrackerObj		trackerLock;
+	PthreadObjPtrMap_iter			foundIter = PthreadTrackObjPtr()->fTrackedThreads.find(fID);
+	
+	if (foundIter != PthreadTrackObjPtr()->fTrackedThreads.end() && foundIter->second == this)
+		PthreadTrackObjPtr()->fTrackedThreads.erase(foundIter);
 	
-	// Delete the object based on its address
-	for (PthreadObjPtrList_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
+	if (fRunning != kThreadObjStateNotStarted)
 	{
-		if ((*x) == this)
-		{
-			PthreadTrackObjPtr()->fTrackedThreads.erase(x);
-			break;
-		}
+		ThreadIDObjPtrMap_iter	foundIDIter = PthreadTrackObjPtr()->fThreadIDMap.find(fThread);
+		
+		if (foundIDIter != PthreadTrackObjPtr()->fThreadIDMap.end() && foundIDIter->second == this)
+			PthreadTrackObjPtr()->fThreadIDMap.erase(foundIDIter);
 	}
+	
+	// Don't leave a dangling pointer behind if we're being destroyed
+	// from within our own thread
+	if (MyThreadObjPtr() == this)
+		_SetCurrentThreadObjPtr(NULL);
+}
+
+//---------------------------------------------------------------------
+// TPthreadObj::_SetCurrentThreadObjPtr (static protected)
+//---------------------------------------------------------------------
+void TPthreadObj::_SetCurrentThreadObjPtr (TPthreadObj* threadObjPtr)
+{
+	pthread_once(&gCurrentThreadKeyOnce,CreateCurrentThreadKey);
+	pthread_setspecific(gCurrentThreadKey,threadObjPtr);
 }
 
 //*********************************************************************
@@ -523,9 +569,9 @@ unsigned long PthreadCount (bool onlyRunning)
 	{
 		TLockedPthreadTrackerObj		trackerLock;
 		
-		for (PthreadObjPtrList_const_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
+		for (PthreadObjPtrMap_const_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
 		{
-			if ((*x)->IsRunning())
+			if (x->second->IsRunning())
 				++threadCount;
 		}
 	}
@@ -538,15 +584,9 @@ unsigned long PthreadCount (bool onlyRunning)
 //---------------------------------------------------------------------
 TPthreadObj* MyThreadObjPtr ()
 {
-	TPthreadObj*		threadObjPtr = NULL;
+	pthread_once(&gCurrentThreadKeyOnce,CreateCurrentThreadKey);
 	
-	if (PthreadCount() > 0)
-	{
-		TLockedPthreadTrackerObj	trackerLock;
-		threadObjPtr = FindThreadObjPtrByThreadID(pthread_self());
-	}
-	
-	return threadObjPtr;
+	return static_cast<TPthreadObj*>(pthread_getspecific(gCurrentThreadKey));
 }
 
 //---------------------------------------------------------------------
@@ -557,7 +597,12 @@ TPthreadObj* GetIndexedThreadObjPtr (unsigned long n)
 	TPthreadObj*			foundPtr = NULL;
 	
 	if (n < PthreadTrackObjPtr()->fTrackedThreads.size())
-		foundPtr = PthreadTrackObjPtr()->fTrackedThreads[n];
+	{
+		PthreadObjPtrMap_const_iter	foundIter = PthreadTrackObjPtr()->fTrackedThreads.begin();
+		
+		std::advance(foundIter,n);
+		foundPtr = foundIter->second;
+	}
 	
 	return foundPtr;
 }
@@ -568,15 +613,10 @@ TPthreadObj* GetIndexedThreadObjPtr (unsigned long n)
 TPthreadObj* FindThreadObjPtrByThreadID (pthread_t threadID)
 {
 	TPthreadObj*			foundPtr = NULL;
+	ThreadIDObjPtrMap_iter	foundIter = PthreadTrackObjPtr()->fThreadIDMap.find(threadID);
 	
-	for (PthreadObjPtrList_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
-	{
-		if ((*x)->ThreadID() == threadID)
-		{
-			foundPtr = (*x);
-			break;
-		}
-	}
+	if (foundIter != PthreadTrackObjPtr()->fThreadIDMap.end())
+		foundPtr = foundIter->second;
 	
 	return foundPtr;
 }
@@ -587,15 +627,10 @@ TPthreadObj* FindThreadObjPtrByThreadID (pthread_t threadID)
 TPthreadObj* FindThreadObjPtrByInternalID (unsigned long internalID)
 {
 	TPthreadObj*			foundPtr = NULL;
+	PthreadObjPtrMap_iter	foundIter = PthreadTrackObjPtr()->fTrackedThreads.find(internalID);
 	
-	for (PthreadObjPtrList_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
-	{
-		if ((*x)->InternalID() == internalID)
-		{
-			foundPtr = (*x);
-			break;
-		}
-	}
+	if (foundIter != PthreadTrackObjPtr()->fTrackedThreads.end())
+		foundPtr = foundIter->second;
 	
 	return foundPtr;
 }
@@ -607,8 +642,8 @@ void CancelAllPthreads ()
 {
 	TLockedPthreadTrackerObj		trackerLock;
 	
-	for (PthreadObjPtrList_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
-		(*x)->Cancel();
+	for (PthreadObjPtrMap_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
+		x->second->Cancel();
 }
 
 //---------------------------------------------------------------------
@@ -618,8 +653,8 @@ void JoinAllPthreads ()
 {
 	TLockedPthreadTrackerObj		trackerLock;
 	
-	for (PthreadObjPtrList_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
-		(*x)->Join();
+	for (PthreadObjPtrMap_iter x = PthreadTrackObjPtr()->fTrackedThreads.begin(); x != PthreadTrackObjPtr()->fTrackedThreads.end(); x++)
+		x->second->Join();
 }
 
 //---------------------------------------------------------------------
@@ -117,6 +117,9 @@ class TPthreadObj
 				
 				if (threadObjPtr && threadObjPtr->ThreadFunctionPtr())
 				{
+					// Remember which object this thread belongs to
+					_SetCurrentThreadObjPtr(threadObjPtr);
+					
 					// Set the exception variable
 					threadObjPtr->ClearException();
 					
@@ -172,7 +175,10 @@ class TPthreadObj
 					
 					// Delete the thread if indicated
 					if (threadObjPtr->DeleteWhenComplete())
+					{
+						_SetCurrentThreadObjPtr(NULL);
 						delete(threadObjPtr);
+					}
 				}
 			}
 		
@@ -374,6 +380,10 @@ class TPthreadObj
 		
 		virtual void EndTracking ();
 			// Removes our pointer from the module global.
+		
+		static void _SetCurrentThreadObjPtr (TPthreadObj* threadObjPtr);
+			// Records threadObjPtr in thread-specific storage as the object
+			// that owns the calling thread; MyThreadObjPtr() returns it.
 	
 	protected:
 		
@@ -847,15 +857,16 @@ class TContextPthreadPool : public TPthreadPoolBase<TContextPthreadObj<CONTEXT_C
 // Class TLockedPthreadTrackerObj
 //
 // This module tracks instances of TPthreadObj (and subclasses) through
-// an STL vector.  In a multithreaded application, care must be taken
-// when inserting and deleting vector members to ensure that no other
-// concurrent thread makes simultaneous changes.  This class seizes
-// a mutex surrounding that vector, preventing other threads from
-// making changes.
+// STL maps keyed by internal ID and by thread ID.  In a multithreaded
+// application, care must be taken when inserting and deleting map
+// members to ensure that no other concurrent thread makes simultaneous
+// changes.  This class seizes a mutex surrounding those maps, preventing
+// other threads from making changes.
 //
 // You should also instantiate a TLockedPthreadTrackerObj whenever you
 // retrieve a pointer to a TPthreadObj via a call to FindThreadObjPtrByThreadID(),
-// FindThreadObjPtrByInternalID(), or GetIndexedThreadObjPtr().
+// FindThreadObjPtrByInternalID(), or GetIndexedThreadObjPtr().  There is
+// no need to do so for MyThreadObjPtr(), which does not use the maps.
 //
 // Be sure that you destruct instances of this object quickly, as
 // it will prevent other threads from starting or stopping, as well
@@ -880,11 +891,12 @@ unsigned long PthreadCount (bool onlyRunning = false);
 
 TPthreadObj* MyThreadObjPtr ();
 	// Returns a pointer to the thread object associated with the current
-	// thread, or NULL if no such object was found.
+	// thread, or NULL if no such object was found.  The pointer is kept
+	// in thread-specific storage, so this call neither locks nor searches.
 
 TPthreadObj* GetIndexedThreadObjPtr (unsigned long n);
 	// Returns a pointer to the thread object at the indicated position
-	// (zero-based).  Be sure to instantiate a TLockedPthreadTrackerObj
+	// (zero-based, in order of internal ID).  Be sure to instantiate a TLockedPthreadTrackerObj
 	// object before calling this function to ensure that the returned
 	// object pointer remains valid.
 
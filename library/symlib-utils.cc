@@ -29,6 +29,7 @@
 #include "symlib-task-queue.h"
 #include "symlib-threads.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <grp.h>
 #include <map>
@@ -72,8 +73,10 @@ static bool                             	gSRANDCalled = false;
 // Constructor
 //---------------------------------------------------------------------
 TSymLibEnvironObj::TSymLibEnvironObj (int argc, char** argv)
-	:	fDynDebugFlags(kDynDebugNone),
+	:	fTaskNameMapMutex("task names"),
+		fDynDebugFlags(kDynDebugNone),
 		fLogUserID(0),
+		fLogGroupID(0),
 		fAppPID(getpid()),
 		fIsDaemon(false)
 {
@@ -158,41 +161,7 @@ void TSymLibEnvironObj::SetLogDirectory (const std::string& logDir, bool createI
 void TSymLibEnvironObj::WriteToErrorLogFile (const std::string& logEntry)
 {
 	if (!fErrorLogFileObj.Path().empty())
-	{
-		std::string		myEntry;
-		bool			logFileExists = fErrorLogFileObj.Exists();
-		
-		myEntry += GetTaskName() + ": " + logEntry;
-		
-		fErrorLogFileObj.WriteEntry(myEntry,false,true);
-		
-		if (!logFileExists && fErrorLogFileObj.Exists())
-		{
-			if (fLogUserID > 0)
-			{
-				try
-				{
-					fErrorLogFileObj.SetOwner(fLogUserID,true);
-				}
-				catch (...)
-				{
-					// Ignore all errors
-				}
-			}
-			
-			if (fLogGroupID > 0)
-			{
-				try
-				{
-					fErrorLogFileObj.SetGroup(fLogGroupID,true);
-				}
-				catch (...)
-				{
-					// Ignore all errors
-				}
-			}
-		}
-	}
+		fErrorLogFileObj.QueueEntry(GetTaskName() + ": " + logEntry);
 }
 
 //---------------------------------------------------------------------
@@ -201,41 +170,7 @@ void TSymLibEnvironObj::WriteToErrorLogFile (const std::string& logEntry)
 void TSymLibEnvironObj::WriteToMessagesLogFile (const std::string& logEntry)
 {
 	if (!fMessagesLogFileObj.Path().empty())
-	{
-		std::string		myEntry;
-		bool			logFileExists = fMessagesLogFileObj.Exists();
-		
-		myEntry += GetTaskName() + ": " + logEntry;
-		
-		fMessagesLogFileObj.WriteEntry(myEntry,false,true);
-		
-		if (!logFileExists && fMessagesLogFileObj.Exists())
-		{
-			if (fLogUserID > 0)
-			{
-				try
-				{
-					fMessagesLogFileObj.SetOwner(fLogUserID,true);
-				}
-				catch (...)
-				{
-					// Ignore all errors
-				}
-			}
-			
-			if (fLogGroupID > 0)
-			{
-				try
-				{
-					fMessagesLogFileObj.SetGroup(fLogGroupID,true);
-				}
-				catch (...)
-				{
-					// Ignore all errors
-				}
-			}
-		}
-	}
+		fMessagesLogFileObj.QueueEntry(GetTaskName() + ": " + logEntry);
 }
 
 //---------------------------------------------------------------------
@@ -244,6 +179,7 @@ void TSymLibEnvironObj::WriteToMessagesLogFile (const std::string& logEntry)
 void TSymLibEnvironObj::SetLogUser (uid_t userID)
 {
 	fLogUserID = userID;
+	_UpdateLogFileOwner();
 }
 
 //---------------------------------------------------------------------
@@ -253,6 +189,7 @@ void TSymLibEnvironObj::SetLogUser (const std::string& userName)
 {
 	if (!userName.empty())
 		fLogUserID = MapUserNameToUID(userName.c_str());
+	_UpdateLogFileOwner();
 }
 
 //---------------------------------------------------------------------
@@ -261,6 +198,7 @@ void TSymLibEnvironObj::SetLogUser (const std::string& userName)
 void TSymLibEnvironObj::SetLogGroup (gid_t groupID)
 {
 	fLogGroupID = groupID;
+	_UpdateLogFileOwner();
 }
 
 //---------------------------------------------------------------------
@@ -270,6 +208,7 @@ void TSymLibEnvironObj::SetLogGroup (const std::string& groupName)
 {
 	if (!groupName.empty())
 		fLogGroupID = MapGroupNameToGID(groupName.c_str());
+	_UpdateLogFileOwner();
 }
 
 //---------------------------------------------------------------------
@@ -277,6 +216,9 @@ void TSymLibEnvironObj::SetLogGroup (const std::string& groupName)
 //---------------------------------------------------------------------
 void TSymLibEnvironObj::CloseFiles ()
 {
+	// Write anything still queued and stop the writer thread first
+	TLogFileObj::StopLogWriter();
+	
 	if (fErrorLogFileObj.IsOpen())
 		fErrorLogFileObj.Close();
 	if (fMessagesLogFileObj.IsOpen())
@@ -338,6 +280,170 @@ void TSymLibEnvironObj::RemoveTaskName ()
 		fTaskNameMap.erase(threadObjPtr->InternalID());
 }
 
+//---------------------------------------------------------------------
+// TSymLibEnvironObj::_UpdateLogFileOwner (protected)
+//---------------------------------------------------------------------
+void TSymLibEnvironObj::_UpdateLogFileOwner ()
+{
+	fErrorLogFileObj.SetNewFileOwner(fLogUserID,fLogGroupID);
+	fMessagesLogFileObj.SetNewFileOwner(fLogUserID,fLogGroupID);
+}
+
+//*********************************************************************
+// Class TDeflateContext
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TDeflateContext::TDeflateContext (int level, CompressionStrategy strategy)
+	:	fStreamPtr(NULL),
+		fLevel(level),
+		fStrategy(strategy),
+		fStreamLevel(level),
+		fStreamStrategy(strategy),
+		fStreamForGZip(false)
+{
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TDeflateContext::~TDeflateContext ()
+{
+	_End();
+}
+
+//---------------------------------------------------------------------
+// TDeflateContext::SetParameters
+//---------------------------------------------------------------------
+void TDeflateContext::SetParameters (int level, CompressionStrategy strategy)
+{
+	fLevel = std::max(kCompressionLevelFastest,std::min(level,kCompressionLevelBest));
+	fStrategy = strategy;
+}
+
+//---------------------------------------------------------------------
+// TDeflateContext::Compress
+//---------------------------------------------------------------------
+void TDeflateContext::Compress (const std::string& inBuffer, std::string& outBuffer, bool forGZip)
+{
+	z_stream*	zlibStreamPtr = reinterpret_cast<z_stream*>(fStreamPtr);
+	int			zlibStrategy = Z_DEFAULT_STRATEGY;
+	int			zlibResult = Z_OK;
+	
+	switch (fStrategy)
+	{
+		case kCompressionStrategyDefault:
+			zlibStrategy = Z_DEFAULT_STRATEGY;
+			break;
+		
+		case kCompressionStrategyFiltered:
+			zlibStrategy = Z_FILTERED;
+			break;
+		
+		case kCompressionStrategyHuffmanOnly:
+			zlibStrategy = Z_HUFFMAN_ONLY;
+			break;
+		
+		case kCompressionStrategyRLE:
+			#if defined(Z_RLE)
+				zlibStrategy = Z_RLE;
+			#endif
+			break;
+	}
+	
+	// The header format is fixed when the stream is created
+	if (zlibStreamPtr && forGZip != fStreamForGZip)
+	{
+		_End();
+		zlibStreamPtr = NULL;
+	}
+	
+	if (!zlibStreamPtr)
+	{
+		zlibStreamPtr = new z_stream;
+		memset(zlibStreamPtr,0,sizeof(z_stream));
+		zlibStreamPtr->zalloc = NULL;
+		zlibStreamPtr->zfree = NULL;
+		
+		// Initialize the deflation function
+		zlibResult = deflateInit2(zlibStreamPtr,fLevel,Z_DEFLATED,(forGZip ? -MAX_WBITS : MAX_WBITS),MAX_MEM_LEVEL,zlibStrategy);
+		
+		if (zlibResult != Z_OK)
+		{
+			delete(zlibStreamPtr);
+			
+			if (zlibResult == Z_MEM_ERROR)
+				throw TSymLibErrorObj(ENOMEM,"Cannot allocate memory for zLib compression");
+			throw TSymLibErrorObj(EINVAL,"Invalid argument to zLib compression");
+		}
+		
+		fStreamPtr = zlibStreamPtr;
+		fStreamLevel = fLevel;
+		fStreamStrategy = fStrategy;
+		fStreamForGZip = forGZip;
+	}
+	else
+	{
+		// Reuse the stream and the memory zLib allocated for it
+		deflateReset(zlibStreamPtr);
+		
+		if (fLevel != fStreamLevel || fStrategy != fStreamStrategy)
+		{
+			// Nothing has been compressed since the reset, so this only
+			// changes the parameters
+			if (deflateParams(zlibStreamPtr,fLevel,zlibStrategy) != Z_OK)
+			{
+				_End();
+				throw TSymLibErrorObj(EINVAL,"Invalid argument to zLib compression");
+			}
+			fStreamLevel = fLevel;
+			fStreamStrategy = fStrategy;
+		}
+	}
+	
+	outBuffer = "";
+	zlibStreamPtr->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(inBuffer.data()));
+	zlibStreamPtr->avail_in = inBuffer.length();
+	
+	// Let zLib write straight into the output buffer, growing it one
+	// chunk at a time until the stream is finished
+	do
+	{
+		unsigned long	usedLength = outBuffer.length();
+		
+		outBuffer.resize(usedLength + kDeflateChunkSize);
+		zlibStreamPtr->next_out = reinterpret_cast<Bytef*>(const_cast<char*>(outBuffer.data())) + usedLength;
+		zlibStreamPtr->avail_out = kDeflateChunkSize;
+		
+		zlibResult = deflate(zlibStreamPtr,Z_FINISH);
+		outBuffer.resize(usedLength + kDeflateChunkSize - zlibStreamPtr->avail_out);
+	}
+	while (zlibResult == Z_OK);
+	
+	if (zlibResult != Z_STREAM_END)
+	{
+		_End();
+		throw TSymLibErrorObj(EINVAL,"While compressing with zLib");
+	}
+}
+
+//---------------------------------------------------------------------
+// TDeflateContext::_End (protected)
+//---------------------------------------------------------------------
+void TDeflateContext::_End ()
+{
+	z_stream*	zlibStreamPtr = reinterpret_cast<z_stream*>(fStreamPtr);
+	
+	if (zlibStreamPtr)
+	{
+		deflateEnd(zlibStreamPtr);
+		delete(zlibStreamPtr);
+		fStreamPtr = NULL;
+	}
+}
+
 //*********************************************************************
 // Global Functions
 //*********************************************************************
@@ -354,6 +460,9 @@ void LibraryInit (int argc, char** argv, const std::string& agentName)
 	if (find(gEnvironObjPtr->ArgListBegin() + 1,gEnvironObjPtr->ArgListEnd(),kAppArgKeyEnableCommLogging) != gEnvironObjPtr->ArgListEnd())
 		gEnvironObjPtr->SetDynamicDebugFlag(kDynDebugLogServerCommunication);
 		
+	if (find(gEnvironObjPtr->ArgListBegin() + 1,gEnvironObjPtr->ArgListEnd(),kAppArgKeyEnableMutexStats) != gEnvironObjPtr->ArgListEnd())
+		gEnvironObjPtr->SetDynamicDebugFlag(kDynDebugLogMutexContention);
+		
 	if (find(gEnvironObjPtr->ArgListBegin() + 1,gEnvironObjPtr->ArgListEnd(),kAppArgKeyUse7200ConfFile) != gEnvironObjPtr->ArgListEnd()) {
 		gEnvironObjPtr->SetConfFileLoc("7200.symagent.xml");
 	}
@@ -391,6 +500,31 @@ void WriteToMessagesLogFile (const std::string& logEntry)
 	}
 }
 
+//---------------------------------------------------------------------
+// WriteMutexContentionStats
+//---------------------------------------------------------------------
+void WriteMutexContentionStats ()
+{
+	MutexContentionStatsList	statsList;
+	
+	GetMutexContentionStats(statsList);
+	
+	for (MutexContentionStatsList_const_iter x = statsList.begin(); x != statsList.end(); x++)
+	{
+		std::string		logEntry;
+		
+		logEntry = "Mutex contention: " + x->name + ": ";
+		logEntry += NumToString(x->acquisitions) + " acquisitions, ";
+		logEntry += NumToString(x->waits) + " waits totalling ";
+		logEntry += NumToString(x->waitMicroseconds / 1000) + " ms";
+		
+		if (x->timeouts > 0)
+			logEntry += ", " + NumToString(x->timeouts) + " timeouts";
+		
+		WriteToMessagesLogFile(logEntry);
+	}
+}
+
 //---------------------------------------------------------------------
 // PIDFileObj
 //---------------------------------------------------------------------
@@ -514,53 +648,9 @@ std::string AsCompressed (const std::string& buffer, CompressionMode mode)
 //---------------------------------------------------------------------
 void ZLibCompress (const std::string& inBuffer, std::string& outBuffer, bool forGZip)
 {
-	z_stream	zlibStream;
-	int			zlibResult = 0;
-	int			windowBits = (forGZip ? -MAX_WBITS : MAX_WBITS);
-	
-	// Reserve the memory for our outbound buffer
-	outBuffer = "";
-	outBuffer.resize(inBuffer.length()*2);
-	
-	// Initialize the zLib stream parameter
-	zlibStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(inBuffer.data()));
-	zlibStream.avail_in = inBuffer.length();
-	zlibStream.total_in = 0;
-	zlibStream.next_out = reinterpret_cast<Bytef*>(const_cast<char*>(outBuffer.data()));
-	zlibStream.avail_out = outBuffer.length();
-	zlibStream.total_out = 0;
-	zlibStream.zalloc = NULL;
-	zlibStream.zfree = NULL;
-	
-	// Initialize the deflation function
-	zlibResult = deflateInit2(&zlibStream,Z_BEST_COMPRESSION,Z_DEFLATED,windowBits,MAX_MEM_LEVEL,Z_DEFAULT_STRATEGY);
-	
-	if (zlibResult == Z_STREAM_ERROR)
-		throw TSymLibErrorObj(EINVAL,"Invalid argument to zLib compression");
-	if (zlibResult == Z_MEM_ERROR)
-		throw TSymLibErrorObj(ENOMEM,"Cannot allocate memory for zLib compression");
+	TDeflateContext		deflateContext(kCompressionLevelBest,kCompressionStrategyDefault);
 	
-	try
-	{
-		// Do the whole compress at once
-		zlibResult = deflate(&zlibStream,Z_FINISH);
-		if (zlibResult != Z_OK && zlibResult != Z_STREAM_END)
-			throw zlibResult;
-		
-		// Resize our output buffer to exactly what zLib created
-		outBuffer.resize(zlibStream.total_out);
-		
-		// Cleanup zLib
-		deflateEnd(&zlibStream);
-	}
-	catch (...)
-	{
-		// Cleanup zLib
-		deflateEnd(&zlibStream);
-		
-		// Re-throw exception
-		throw;
-	}
+	deflateContext.Compress(inBuffer,outBuffer,forGZip);
 }
 
 //---------------------------------------------------------------------
@@ -590,6 +680,16 @@ std::string AsZLibCompressed (const std::string& dataBuffer, bool forGZip)
 // GZipCompress
 //---------------------------------------------------------------------
 void GZipCompress (const std::string& inBuffer, std::string& outBuffer)
+{
+	TDeflateContext		deflateContext(kCompressionLevelBest,kCompressionStrategyDefault);
+	
+	GZipCompress(inBuffer,outBuffer,deflateContext);
+}
+
+//---------------------------------------------------------------------
+// GZipCompress
+//---------------------------------------------------------------------
+void GZipCompress (const std::string& inBuffer, std::string& outBuffer, TDeflateContext& deflateContext)
 {
 	std::string		interimBuffer;
 	uint32_t		inputLength = inBuffer.length();
@@ -600,7 +700,7 @@ void GZipCompress (const std::string& inBuffer, std::string& outBuffer)
 	char			GZipHeader[kGZipHeaderSize] = {0x1f,0x8b,Z_DEFLATED,0,0,0,0,0,0,kOSCode};
 	
 	// Compress the input into our interim buffer using zLib
-	ZLibCompress(inBuffer,interimBuffer,true);
+	deflateContext.Compress(inBuffer,interimBuffer,true);
 	
 	// Checksum the original input
 	inputCRC = crc32(0L,Z_NULL,0);
@@ -47,10 +47,12 @@ namespace symbiot {
 // Forward Class Declarations
 //---------------------------------------------------------------------
 class TSymLibEnvironObj;
+class TDeflateContext;
 
 //---------------------------------------------------------------------
 // Definitions
 //---------------------------------------------------------------------
+#define	kDeflateChunkSize							16384	// bytes of output produced per deflate() call
 
 //--------------------------------------------------------------------
 // Global Variable Declaractions
@@ -88,13 +90,14 @@ class TSymLibEnvironObj
 			// logging-related slots.
 		
 		void WriteToErrorLogFile (const std::string& logEntry);
-			// Writes the argument to the current error log file.
+			// Queues the argument for the current error log file.
 		
 		void WriteToMessagesLogFile (const std::string& logEntry);
-			// Writes the argument to the current messages log file.
+			// Queues the argument for the current messages log file.
 		
 		void CloseFiles ();
-			// Closes any files the environmental object may have open.
+			// Writes any queued log entries, then closes any files the
+			// environmental object may have open.
 		
 		void SetTaskName (const std::string& taskName);
 			// Sets the task name for the current execution thread.
@@ -189,6 +192,11 @@ class TSymLibEnvironObj
 		inline bool IsDaemon () const
 			{ return fIsDaemon; }
 	
+	protected:
+		
+		void _UpdateLogFileOwner ();
+			// Passes the log user and group on to the log file objects.
+	
 	private:
 		
 		std::string								fAppName;
@@ -199,7 +207,7 @@ class TSymLibEnvironObj
 		TLogFileObj								fMessagesLogFileObj;
 		std::string								fAgentName;
 		TaskNameMap								fTaskNameMap;
-		TPthreadMutexObj						fTaskNameMapMutex;
+		TAdaptiveMutexObj						fTaskNameMapMutex;
 		std::string								fServerNonce;
 		std::string								fConfigFileLoc;
 		unsigned long long						fDynDebugFlags;
@@ -209,6 +217,68 @@ class TSymLibEnvironObj
 		bool									fIsDaemon;
 };
 
+//---------------------------------------------------------------------
+// Class TDeflateContext
+//
+// A zLib compression stream that is kept between messages.  Each
+// Compress() call resets the stream rather than allocating a new one,
+// and the compressed data is produced kDeflateChunkSize bytes at a
+// time directly into the output buffer.  Not thread safe; callers
+// sharing a context must serialize their calls.
+//---------------------------------------------------------------------
+class TDeflateContext
+{
+	public:
+		
+		TDeflateContext (int level = kCompressionLevelBest,
+						 CompressionStrategy strategy = kCompressionStrategyDefault);
+			// Constructor
+	
+	private:
+		
+		TDeflateContext (const TDeflateContext& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		~TDeflateContext ();
+			// Destructor
+		
+		void SetParameters (int level, CompressionStrategy strategy);
+			// Sets the compression level (1-9) and strategy used by
+			// subsequent calls to Compress().
+		
+		void Compress (const std::string& inBuffer, std::string& outBuffer, bool forGZip = false);
+			// Compresses the contents of inBuffer, destructively modifying
+			// outBuffer to contain the results.  Will throw exceptions for
+			// failures.  The forGZip argument, if true, tells the function to
+			// omit the normal zlib header/footer from the compressed package.
+		
+		// ------------------------------------
+		// Accessors
+		// ------------------------------------
+		
+		inline int Level () const
+			{ return fLevel; }
+		
+		inline CompressionStrategy Strategy () const
+			{ return fStrategy; }
+	
+	protected:
+		
+		void _End ();
+			// Releases the zLib stream, if any.
+	
+	protected:
+		
+		void*									fStreamPtr;
+		int										fLevel;
+		CompressionStrategy						fStrategy;
+		int										fStreamLevel;
+		CompressionStrategy						fStreamStrategy;
+		bool									fStreamForGZip;
+};
+
 //---------------------------------------------------------------------
 // Global Template Functions
 //---------------------------------------------------------------------
@@ -275,6 +345,10 @@ void WriteToErrorLogFile (const std::string& logEntry);
 void WriteToMessagesLogFile (const std::string& logEntry);
 	// Writes the argument to the current messages log file.
 
+void WriteMutexContentionStats ();
+	// Writes the contention counters of the library's mutexes to the
+	// messages log file, one line per mutex.
+
 TFileObj PIDFileObj ();
 	// Returns a TFileObj pointing to the PID file for this application.
 	// Note that the file might not exist; this function merely constructs
@@ -305,10 +379,11 @@ std::string AsCompressed (const std::string& buffer, CompressionMode mode);
 	// mode, returning the results in a new temporary buffer.
 
 void ZLibCompress (const std::string& inBuffer, std::string& outBuffer, bool forGZip = false);
-	// Compresses the contents of inBuffer using zLib, destructively
-	// modifying outBuffer to contain the results.  Will throw exceptions
-	// for failures.  The forGZip argument, if true, tells the function to
-	// omit the normal zlib header/footer from the compressed package.
+	// Compresses the contents of inBuffer using zLib at the best
+	// compression level, destructively modifying outBuffer to contain
+	// the results.  Will throw exceptions for failures.  The forGZip
+	// argument, if true, tells the function to omit the normal zlib
+	// header/footer from the compressed package.
 
 void ZLibCompress (std::string& buffer, bool forGZip = false);
 	// Same as above, except the compressed data overwrites the original.
@@ -322,6 +397,10 @@ void GZipCompress (const std::string& inBuffer, std::string& outBuffer);
 	// in a gzip-compatible envelope.  The results are written to outBuffer,
 	// destructively modifying it.
 
+void GZipCompress (const std::string& inBuffer, std::string& outBuffer, TDeflateContext& deflateContext);
+	// Same as above, except deflateContext, with its level and strategy,
+	// is used for the compression.
+
 void GZipCompress (std::string& buffer);
 	// Same as above, except the compressed data overwrites the original.
 
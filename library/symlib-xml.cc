@@ -24,8 +24,10 @@
 //---------------------------------------------------------------------
 #include "symlib-xml.h"
 
+#include "symlib-message.h"
 #include "symlib-utils.h"
 
+#include <memory>
 #include <unistd.h>
 
 //---------------------------------------------------------------------
@@ -288,6 +290,137 @@ std::string TXMLNodeObj::_EscapeForXML (const std::string& s)
 	return newString;
 }
 
+//*********************************************************************
+// Class TXMLNodeIndexObj
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TXMLNodeIndexObj::TXMLNodeIndexObj ()
+	:	fRootNodePtr(NULL)
+{
+}
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TXMLNodeIndexObj::TXMLNodeIndexObj (const TXMLNodeObj* rootNodePtr)
+	:	fRootNodePtr(NULL)
+{
+	Build(rootNodePtr);
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TXMLNodeIndexObj::~TXMLNodeIndexObj ()
+{
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::Build
+//---------------------------------------------------------------------
+void TXMLNodeIndexObj::Build (const TXMLNodeObj* rootNodePtr)
+{
+	Clear();
+	
+	fRootNodePtr = rootNodePtr;
+	if (fRootNodePtr)
+		_Add(fRootNodePtr,"");
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::Clear
+//---------------------------------------------------------------------
+void TXMLNodeIndexObj::Clear ()
+{
+	fRootNodePtr = NULL;
+	fKeyMap.clear();
+	fPathMap.clear();
+	fNodeSet.clear();
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::FindNode
+//---------------------------------------------------------------------
+const TXMLNodeObj* TXMLNodeIndexObj::FindNode (const std::string& tag,
+											   const std::string& attribute,
+											   const std::string& attributeValue) const
+{
+	const TXMLNodeObj*	foundNodePtr = NULL;
+	NodeMap_const_iter	foundIter = fKeyMap.find(_MakeKey(tag,attribute,attributeValue));
+	
+	if (foundIter != fKeyMap.end())
+		foundNodePtr = foundIter->second;
+	
+	return foundNodePtr;
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::FindNodeAtPath
+//---------------------------------------------------------------------
+const TXMLNodeObj* TXMLNodeIndexObj::FindNodeAtPath (const std::string& path) const
+{
+	const TXMLNodeObj*	foundNodePtr = NULL;
+	NodeMap_const_iter	foundIter = fPathMap.find(path);
+	
+	if (foundIter != fPathMap.end())
+		foundNodePtr = foundIter->second;
+	
+	return foundNodePtr;
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::Contains
+//---------------------------------------------------------------------
+bool TXMLNodeIndexObj::Contains (const TXMLNodeObj* nodePtr) const
+{
+	return (fNodeSet.find(nodePtr) != fNodeSet.end());
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::_Add (protected)
+//---------------------------------------------------------------------
+void TXMLNodeIndexObj::_Add (const TXMLNodeObj* nodePtr, const std::string& path)
+{
+	// Nodes are visited in the same order FindNode() visits them and
+	// insert() never replaces an entry, so the first match wins
+	fNodeSet.insert(nodePtr);
+	fPathMap.insert(NodeMap::value_type(path,nodePtr));
+	fKeyMap.insert(NodeMap::value_type(_MakeKey(nodePtr->fTag,"",""),nodePtr));
+	
+	for (ExpatAttributeMap_const_iter x = nodePtr->fAttributes.begin(); x != nodePtr->fAttributes.end(); x++)
+		fKeyMap.insert(NodeMap::value_type(_MakeKey(nodePtr->fTag,x->first,x->second),nodePtr));
+	
+	for (TXMLNodeObjList_const_iter y = nodePtr->fTXMLNodeObjList.begin(); y != nodePtr->fTXMLNodeObjList.end(); y++)
+	{
+		if (*y)
+			_Add(*y,(path.empty() ? (*y)->fTag : path + "/" + (*y)->fTag));
+	}
+}
+
+//---------------------------------------------------------------------
+// TXMLNodeIndexObj::_MakeKey (static protected)
+//---------------------------------------------------------------------
+std::string TXMLNodeIndexObj::_MakeKey (const std::string& tag,
+										const std::string& attribute,
+										const std::string& attributeValue)
+{
+	std::string		key(tag);
+	
+	// Tags and attribute names can't contain a NUL, so it's a safe separator
+	if (!attribute.empty())
+	{
+		key += '\0';
+		key += attribute;
+		key += '\0';
+		key += attributeValue;
+	}
+	
+	return key;
+}
+
 //*********************************************************************
 // Class TConfigXMLObj
 //*********************************************************************
@@ -426,6 +559,139 @@ TConfigXMLObj* TConfigXMLObj::_NewObject () const
 	return new TConfigXMLObj;
 }
 
+//*********************************************************************
+// Class TXMLStreamParserObj
+//*********************************************************************
+
+//---------------------------------------------------------------------
+// Constructor
+//---------------------------------------------------------------------
+TXMLStreamParserObj::TXMLStreamParserObj (const StdStringList& watchTagList,
+										  XMLStreamCallback callback,
+										  void* userData)
+	:	Inherited(),
+		fWatchTagList(watchTagList),
+		fCallback(callback),
+		fUserData(userData)
+{
+	EnableElementHandling();
+	EnableCharacterDataHandling(true,false); // auto-trim, don't pass empty data
+	EnableCDataSectionHandling();
+}
+
+//---------------------------------------------------------------------
+// Destructor
+//---------------------------------------------------------------------
+TXMLStreamParserObj::~TXMLStreamParserObj ()
+{
+	_ClearParseStack();
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::Reset
+//---------------------------------------------------------------------
+void TXMLStreamParserObj::Reset ()
+{
+	Inherited::Reset();
+	_ClearParseStack();
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::ParseChunk
+//---------------------------------------------------------------------
+bool TXMLStreamParserObj::ParseChunk (const std::string& data, bool isFinal)
+{
+	XML_Status	parseStatus = XML_STATUS_OK;
+	
+	if (!data.empty())
+		parseStatus = Parse(data);
+	
+	if (parseStatus == XML_STATUS_OK && isFinal)
+		parseStatus = Finalize();
+	
+	return (parseStatus == XML_STATUS_OK);
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::ElementHandler_Start
+//---------------------------------------------------------------------
+void TXMLStreamParserObj::ElementHandler_Start (const std::string& name,
+												const ExpatAttributeMap& specificAttributeMap,
+												const ExpatAttributeMap& inheritedAttributeMap)
+{
+	// Build nodes only within a watched element
+	if (!fParseStack.empty() || std::find(fWatchTagList.begin(),fWatchTagList.end(),name) != fWatchTagList.end())
+	{
+		fParseStack.push_back(new TXMLNodeObj(name));
+		
+		for (ExpatAttributeMap_const_iter x = inheritedAttributeMap.begin(); x != inheritedAttributeMap.end(); x++)
+			fParseStack.back()->AddAttribute(x->first,x->second);
+		
+		for (ExpatAttributeMap_const_iter x = specificAttributeMap.begin(); x != specificAttributeMap.end(); x++)
+			fParseStack.back()->AddAttribute(x->first,x->second);
+	}
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::ElementHandler_End
+//---------------------------------------------------------------------
+void TXMLStreamParserObj::ElementHandler_End (const std::string& name)
+{
+	if (!fParseStack.empty())
+	{
+		TXMLNodeObj*	currentNodePtr(fParseStack.back());
+		
+		fParseStack.pop_back();
+		
+		if (fParseStack.empty())
+		{
+			// A watched element is complete; hand it off, then discard it
+			std::auto_ptr<TXMLNodeObj>	nodeObjPtr(currentNodePtr);
+			TMessageNode				elementNode;
+			
+			elementNode.SetPtr(currentNodePtr);
+			
+			if (fCallback)
+				(*fCallback)(elementNode,fUserData);
+		}
+		else
+		{
+			fParseStack.back()->Append(currentNodePtr);
+		}
+	}
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::CharacterDataHandler
+//---------------------------------------------------------------------
+void TXMLStreamParserObj::CharacterDataHandler (const std::string& data)
+{
+	if (!fParseStack.empty())
+		fParseStack.back()->SetData(fParseStack.back()->Data() + data);
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::_NewObject (protected)
+//---------------------------------------------------------------------
+TXMLStreamParserObj* TXMLStreamParserObj::_NewObject () const
+{
+	return new TXMLStreamParserObj(fWatchTagList,fCallback,fUserData);
+}
+
+//---------------------------------------------------------------------
+// TXMLStreamParserObj::_ClearParseStack (protected)
+//---------------------------------------------------------------------
+void TXMLStreamParserObj::_ClearParseStack ()
+{
+	// Nodes are appended to their parents only when they are complete,
+	// so every node still on the stack is owned directly
+	while (!fParseStack.empty())
+	{
+		delete(fParseStack.back());
+		fParseStack.pop_back();
+	}
+}
+
 //*********************************************************************
 // Class TSymbiotMessageBase
 //*********************************************************************
@@ -30,6 +30,8 @@
 #include "symlib-expat.h"
 #include "symlib-file.h"
 
+#include <map>
+#include <set>
 #include <vector>
 
 //---------------------------------------------------------------------
@@ -41,7 +43,9 @@ namespace symbiot {
 // Forward Class Declarations
 //---------------------------------------------------------------------
 class TXMLNodeObj;
+class TXMLNodeIndexObj;
 class TConfigXMLObj;
+class TXMLStreamParserObj;
 class TSymbiotMessageBase;
 
 //---------------------------------------------------------------------
@@ -191,6 +195,92 @@ class TXMLNodeObj
 		std::string									fData;
 		TXMLNodeObjList								fTXMLNodeObjList;
 		ExpatAttributeMap							fAttributes;
+	
+	friend class TXMLNodeIndexObj;
+};
+
+//---------------------------------------------------------------------
+// Class TXMLNodeIndexObj
+//
+// A lookup table for a TXMLNodeObj hierarchy, built in one pass, that
+// answers the same questions as TXMLNodeObj::FindNode() without
+// walking the tree each time.  The index holds pointers into the tree
+// and is not updated when the tree changes; whoever owns the tree must
+// Build() it again (or Clear() it) after modifying it.
+//---------------------------------------------------------------------
+class TXMLNodeIndexObj
+{
+	protected:
+		
+		typedef	std::map<std::string,const TXMLNodeObj*>		NodeMap;
+		typedef	NodeMap::const_iterator							NodeMap_const_iter;
+		typedef	std::set<const TXMLNodeObj*>					NodeSet;
+	
+	public:
+		
+		TXMLNodeIndexObj ();
+			// Constructor
+		
+		TXMLNodeIndexObj (const TXMLNodeObj* rootNodePtr);
+			// Constructor; builds the index for the given hierarchy
+		
+		virtual ~TXMLNodeIndexObj ();
+			// Destructor
+		
+		virtual void Build (const TXMLNodeObj* rootNodePtr);
+			// Discards the current index and indexes every node in the
+			// hierarchy beginning with rootNodePtr, by tag, by tag with each
+			// of its attribute values, and by path.
+		
+		virtual void Clear ();
+			// Discards the current index.
+		
+		virtual const TXMLNodeObj* FindNode (const std::string& tag,
+											 const std::string& attribute = "",
+											 const std::string& attributeValue = "") const;
+			// Returns the same node as calling FindNode() with the same
+			// arguments on the root node would, or NULL if there isn't one.
+		
+		virtual const TXMLNodeObj* FindNodeAtPath (const std::string& path) const;
+			// Returns the first node, in document order, reached from the root
+			// node through the slash-delimited list of tags in the argument
+			// (e.g. "server/host"), or NULL if there isn't one.  An empty
+			// path returns the root node.
+		
+		virtual bool Contains (const TXMLNodeObj* nodePtr) const;
+			// Returns true if the argument is within the indexed hierarchy.
+		
+		// -------------------------------------------
+		// Accessors
+		// -------------------------------------------
+		
+		inline const TXMLNodeObj* RootNodePtr () const
+			{ return fRootNodePtr; }
+		
+		inline unsigned long NodeCount () const
+			{ return fNodeSet.size(); }
+	
+	protected:
+		
+		virtual void _Add (const TXMLNodeObj* nodePtr, const std::string& path);
+			// Internal recursive method supporting Build().
+		
+		static std::string _MakeKey (const std::string& tag,
+									 const std::string& attribute,
+									 const std::string& attributeValue);
+			// Returns the key used for the fKeyMap entry of the arguments.
+	
+	private:
+		
+		TXMLNodeIndexObj (const TXMLNodeIndexObj& obj) {}
+			// Copy constructor is illegal
+	
+	protected:
+		
+		const TXMLNodeObj*							fRootNodePtr;
+		NodeMap										fKeyMap;
+		NodeMap										fPathMap;
+		NodeSet										fNodeSet;
 };
 
 //---------------------------------------------------------------------
@@ -272,6 +362,73 @@ class TConfigXMLObj : public TExpatBaseObj
 		TXMLNodeObjList								fParseStack;
 };
 
+//---------------------------------------------------------------------
+// Class TXMLStreamParserObj
+//
+// Subclass of TExpatBaseObj that parses a document incrementally, as
+// its data arrives, without ever holding the whole document.  Only
+// elements whose tags are in the watch list are built into nodes;
+// each one is handed to the callback as soon as its end tag is seen
+// and then discarded.  Watched elements nested within another watched
+// element are delivered only as part of the outer one.
+//---------------------------------------------------------------------
+class TXMLStreamParserObj : public TExpatBaseObj
+{
+	protected:
+		
+		typedef		TExpatBaseObj					Inherited;
+	
+	public:
+		
+		TXMLStreamParserObj (const StdStringList& watchTagList,
+							 XMLStreamCallback callback,
+							 void* userData);
+			// Constructor
+	
+	private:
+		
+		TXMLStreamParserObj (const TXMLStreamParserObj& obj) {}
+			// Copy constructor is illegal
+	
+	public:
+		
+		virtual ~TXMLStreamParserObj ();
+			// Destructor
+		
+		virtual void Reset ();
+			// Resets the object so a new document can be parsed.
+		
+		virtual bool ParseChunk (const std::string& data, bool isFinal);
+			// Parses the next piece of the document.  isFinal must be true
+			// for the last piece (which may be empty).  Returns false if the
+			// document is not well-formed.
+		
+		virtual void ElementHandler_Start (const std::string& name,
+										   const ExpatAttributeMap& specificAttributeMap,
+										   const ExpatAttributeMap& inheritedAttributeMap);
+			// Override.
+		
+		virtual void ElementHandler_End (const std::string& name);
+			// Override.
+		
+		virtual void CharacterDataHandler (const std::string& data);
+			// Override.  Character data may arrive in several pieces, so it is
+			// appended to the current node's data.
+	
+	protected:
+		
+		virtual TXMLStreamParserObj* _NewObject () const;
+			// Returns a new object of this type.
+		
+		virtual void _ClearParseStack ();
+			// Destroys any partially-built nodes.
+		
+		StdStringList								fWatchTagList;
+		XMLStreamCallback							fCallback;
+		void*										fUserData;
+		TXMLNodeObjList								fParseStack;
+};
+
 //---------------------------------------------------------------------
 // Class TSymbiotMessageBase
 //---------------------------------------------------------------------